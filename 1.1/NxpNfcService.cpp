@@ -24,7 +24,7 @@
 #include <hidl/LegacySupport.h>
 #include "Nfc.h"
 #include "NxpNfc.h"
-#include "eSEClientExtns.h"
+#include "phNxpNciHal_BootTasks.h"
 
 // Generated HIDL files
 using android::hardware::nfc::V1_1::INfc;
@@ -50,9 +50,14 @@ int main() {
         return -1;
     }
 
-    initializeEseClient();
-    configureRpcThreadpool(1, true /*callerWillJoin*/);
-    checkEseClientUpdate();
+    /* a second thread serves the NxpNfc calls of the eSE update while an
+     * open waits for it */
+    configureRpcThreadpool(2, true /*callerWillJoin*/);
+    /* eSE client update runs in the background, open waits for it, up to
+     * PH_NXP_BOOT_OPEN_WAIT_MS */
+    phNxpNciHal_bootTasksStart(
+        PH_NXP_BOOT_STEPS_ALL &
+        ~PH_NXP_BOOT_STEP_BIT(PH_NXP_BOOT_STEP_FW_RECOVERY));
     status = nfc_service->registerAsService();
     if (status != OK) {
         LOG_ALWAYS_FATAL("Could not register service for NFC HAL Iface (%d).", status);
@@ -70,9 +75,6 @@ int main() {
     if (status != OK) {
         ALOGE("Could not register service for NXP NFC Extn Iface (%d).", status);
     }
-    ALOGE("Before calling JCOP JCOS_doDownload");
-    perform_eSEClientUpdate();
-    ALOGE("After calling JCOS_doDownload");
     ALOGI("NFC service is ready");
     joinRpcThreadpool();
     return 1;
@@ -66,8 +66,8 @@ Return<V1_0::NfcStatus> Nfc::open(
 }
 
 Return<uint32_t> Nfc::write(const hidl_vec<uint8_t>& data) {
-  hidl_vec<uint8_t> copy = data;
-  return phNxpNciHal_write(copy.size(), &copy[0]);
+  /* HAL does not modify the packet, it copies it before any rewrite */
+  return phNxpNciHal_write(data.size(), data.data());
 }
 
 Return<V1_0::NfcStatus> Nfc::coreInitialized(const hidl_vec<uint8_t>& data) {
@@ -24,11 +24,7 @@
 #include <hidl/LegacySupport.h>
 #include "Nfc.h"
 #include "NxpNfc.h"
-#include "eSEClientExtns.h"
-
-#if(NXP_NFC_RECOVERY == TRUE)
-#include "phNxpNciHal_Recovery.h"
-#endif
+#include "phNxpNciHal_BootTasks.h"
 
 // Generated HIDL files
 using android::hardware::nfc::V1_2::INfc;
@@ -55,12 +51,12 @@ int main() {
         return -1;
       }
 
-      configureRpcThreadpool(1, true /*callerWillJoin*/);
-#if(NXP_NFC_RECOVERY == TRUE)
-      phNxpNciHal_RecoverFWTearDown();
-#endif
-      initializeEseClient();
-      checkEseClientUpdate();
+      /* a second thread serves the NxpNfc calls of the eSE update while an
+       * open waits for it */
+      configureRpcThreadpool(2, true /*callerWillJoin*/);
+      /* FW teardown recovery and eSE client update run in the background,
+       * open waits for them, up to PH_NXP_BOOT_OPEN_WAIT_MS */
+      phNxpNciHal_bootTasksStart(PH_NXP_BOOT_STEPS_ALL);
       status = nfc_service->registerAsService();
       if (status != OK) {
         LOG_ALWAYS_FATAL("Could not register service for NFC HAL Iface (%d).",
@@ -79,9 +75,6 @@ int main() {
         ALOGE("Could not register service for NXP NFC Extn Iface (%d).",
               status);
       }
-    ALOGE("Before calling JCOP JCOS_doDownload");
-    perform_eSEClientUpdate();
-    ALOGE("After calling JCOS_doDownload");
     ALOGI("NFC service is ready");
     joinRpcThreadpool();
     } catch (const std::length_error &le) {
@@ -0,0 +1,302 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Measures the cost of the NCI extension dispatch of the HAL, per packet,
+ * on the read path (phNxpNciHal_process_ext_rsp) and the write path
+ * (phNxpNciHal_write_ext), without NFCC.
+ *
+ *   nxp_ext_dispatch_bench [-n <calls per packet>] [-p]
+ *
+ *   -p   register the handlers of a chip older than SN100U
+ *
+ * The packets are the ones seen most in a reader mode transaction, chosen
+ * so that the handlers they reach change no HAL state between calls. Each
+ * call works on a fresh copy of the packet, the copy is accounted.
+ *
+ * As a baseline, the same packets also go through the header tests of the
+ * if/else chains the dispatch tables replaced, in their original order and
+ * against the same HAL state. Branch bodies are reduced to a counter, the
+ * ones the benchmark packets reach only log or clear HAL state.
+ */
+
+#include <Nxp_Features.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal.h>
+#include <phNxpNciHal_NfcDepSWPrio.h>
+#include <phNxpNciHal_dta.h>
+#include <phNxpNciHal_ext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NXP_EXT_BENCH_DEFAULT_CALLS 200000
+
+typedef enum {
+  NXP_EXT_BENCH_READ = 0x00, /* phNxpNciHal_process_ext_rsp */
+  NXP_EXT_BENCH_WRITE,       /* phNxpNciHal_write_ext */
+} nxp_ext_bench_path_t;
+
+typedef struct {
+  const char* name;
+  nxp_ext_bench_path_t path;
+  uint8_t len;
+  uint8_t data[16];
+} nxp_ext_bench_pkt_t;
+
+static const nxp_ext_bench_pkt_t sPackets[] = {
+    {"data", NXP_EXT_BENCH_READ, 7, {0x00, 0x00, 0x04, 0x11, 0x22, 0x33, 0x44}},
+    {"CORE_CONN_CREDITS_NTF", NXP_EXT_BENCH_READ, 6,
+     {0x60, 0x06, 0x03, 0x01, 0x00, 0x01}},
+    {"RF_FIELD_INFO_NTF", NXP_EXT_BENCH_READ, 4, {0x61, 0x07, 0x01, 0x01}},
+    {"RF_DISCOVER_NTF", NXP_EXT_BENCH_READ, 12,
+     {0x61, 0x03, 0x09, 0x01, 0x04, 0x00, 0x05, 0x04, 0x00, 0x00, 0x00, 0x02}},
+    {"CORE_GET_CONFIG_RSP", NXP_EXT_BENCH_READ, 9,
+     {0x40, 0x03, 0x06, 0x00, 0x01, 0xA0, 0x44, 0x01, 0x00}},
+    {"data", NXP_EXT_BENCH_WRITE, 7, {0x00, 0x00, 0x04, 0x11, 0x22, 0x33, 0x44}},
+    {"CORE_GET_CONFIG_CMD", NXP_EXT_BENCH_WRITE, 6,
+     {0x20, 0x03, 0x03, 0x01, 0xA0, 0x44}},
+    {"CORE_SET_CONFIG_CMD", NXP_EXT_BENCH_WRITE, 7,
+     {0x20, 0x02, 0x04, 0x01, 0x00, 0x01, 0x01}},
+    {"RF_DISCOVER_CMD", NXP_EXT_BENCH_WRITE, 8,
+     {0x21, 0x03, 0x05, 0x02, 0x00, 0x01, 0x01, 0x01}},
+};
+
+extern uint8_t icode_detected;
+extern uint8_t icode_send_eof;
+extern phNxpNciProfile_Control_t nxpprofile_ctrl;
+extern uint32_t cleanup_timer;
+extern bool bEnableMfcExtns;
+extern bool bEnableMfcReader;
+extern bool bDisableLegacyMfcExtns;
+extern uint32_t wFwVerRsp;
+extern uint16_t wFwVer;
+
+/* Counts the legacy branches taken, keeps the tests from being optimized out */
+static volatile uint32_t sLegacyHits;
+
+/* Header tests of the legacy phNxpNciHal_process_ext_rsp */
+static NFCSTATUS nxp_ext_bench_legacy_rsp(uint8_t* p_ntf, uint16_t* p_len) {
+  if (p_ntf[0] == 0x6F && (p_ntf[1] == 0x35 || p_ntf[1] == 0x36))
+    sLegacyHits++;
+  if (p_ntf[0] == 0x01 && p_ntf[1] == 0x00 && p_ntf[5] == 0x81 &&
+      p_ntf[23] == 0x82 && p_ntf[26] == 0xA0 && p_ntf[27] == 0xFE) {
+    sLegacyHits++;
+  } else if (p_ntf[0] == 0x60 && p_ntf[1] == 0x07 && p_ntf[2] == 0x01 &&
+             p_ntf[3] == 0xE2) {
+    sLegacyHits++;
+  }
+  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && *p_len < 14)
+    return NFCSTATUS_FAILED;
+  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && p_ntf[4] == 0x03 &&
+      p_ntf[5] == 0x05 && nxpprofile_ctrl.profile_type == EMV_CO_PROFILE)
+    sLegacyHits++;
+  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && p_ntf[4] == 0x01 &&
+      p_ntf[5] == 0x05 && p_ntf[6] == 0x02)
+    sLegacyHits++;
+  if (bDisableLegacyMfcExtns && bEnableMfcExtns && p_ntf[0] == 0)
+    sLegacyHits++;
+  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05) sLegacyHits++;
+  /* phNxpNciHal_ext_process_nfc_init_rsp */
+  if (p_ntf[0] == NCI_MT_RSP &&
+      ((p_ntf[1] & NCI_OID_MASK) == NCI_MSG_CORE_RESET)) {
+    sLegacyHits++;
+  } else if (p_ntf[0] == NCI_MT_NTF &&
+             ((p_ntf[1] & NCI_OID_MASK) == NCI_MSG_CORE_RESET)) {
+    sLegacyHits++;
+  } else if (p_ntf[0] == NCI_MT_RSP &&
+             ((p_ntf[1] & NCI_OID_MASK) == NCI_MSG_CORE_INIT)) {
+    sLegacyHits++;
+  }
+  if (p_ntf[0] == NCI_MT_NTF &&
+      ((p_ntf[1] & NCI_OID_MASK) == NCI_MSG_CORE_RESET) &&
+      p_ntf[3] == CORE_RESET_TRIGGER_TYPE_POWERED_ON)
+    return NFCSTATUS_FAILED;
+  if (p_ntf[0] == 0x42 && p_ntf[1] == 0x01 && p_ntf[2] == 0x01 &&
+      p_ntf[3] == 0x00) {
+    sLegacyHits++;
+  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && p_ntf[2] == 0x15 &&
+             p_ntf[4] == 0x01 && p_ntf[5] == 0x06 && p_ntf[6] == 0x06) {
+    sLegacyHits++;
+  } else if (nfcFL.chipType < sn100u && icode_detected == 1 &&
+             icode_send_eof == 2) {
+    sLegacyHits++;
+  } else if (nfcFL.chipType < sn100u && p_ntf[0] == 0x00 &&
+             p_ntf[1] == 0x00 && icode_detected == 1) {
+    sLegacyHits++;
+  } else if (nfcFL.chipType < sn100u && p_ntf[2] == 0x02 &&
+             p_ntf[1] == 0x00 && icode_detected == 1) {
+    sLegacyHits++;
+  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x06 && icode_detected == 1) {
+    sLegacyHits++;
+  } else if (*p_len == 4 && p_ntf[0] == 0x40 && p_ntf[1] == 0x02 &&
+             p_ntf[2] == 0x01 && p_ntf[3] == 0x06) {
+    sLegacyHits++;
+  }
+  if (p_ntf[0] == 0x60 && p_ntf[1] == 0x07 && p_ntf[2] == 0x01) {
+    return NFCSTATUS_FAILED;
+  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x21 && p_ntf[2] == 0x00) {
+    return NFCSTATUS_FAILED;
+  } else if (p_ntf[0] == 0x42 && p_ntf[1] == 0x00) {
+    sLegacyHits++;
+  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x03) {
+    if (cleanup_timer != 0) return NFCSTATUS_FAILED;
+  } else if (p_ntf[0] == 0x41 && p_ntf[1] == 0x04 && cleanup_timer != 0) {
+    return NFCSTATUS_FAILED;
+  } else if (*p_len == 4 && p_ntf[0] == 0x4F && p_ntf[1] == 0x11 &&
+             p_ntf[2] == 0x01) {
+    sLegacyHits++;
+  } else if (*p_len == 4 && p_ntf[0] == 0x6F && p_ntf[1] == 0x11 &&
+             p_ntf[2] == 0x01) {
+    sLegacyHits++;
+  }
+  return NFCSTATUS_SUCCESS;
+}
+
+/* Header tests of the legacy phNxpNciHal_write_ext */
+static NFCSTATUS nxp_ext_bench_legacy_cmd(uint16_t* cmd_len,
+                                          uint8_t* p_cmd_data) {
+  phNxpNciHal_NfcDep_cmd_ext(p_cmd_data, cmd_len);
+  if (phNxpDta_IsEnable() == true) sLegacyHits++;
+  if (p_cmd_data[0] == 0xFE && p_cmd_data[1] == 0xFE &&
+      p_cmd_data[2] == 0xFE) {
+    return NFCSTATUS_FAILED;
+  } else if (p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02 &&
+             (p_cmd_data[2] == 0x05 || p_cmd_data[2] == 0x32) &&
+             (p_cmd_data[3] == 0x01 || p_cmd_data[3] == 0x02) &&
+             p_cmd_data[4] == 0xA0 && p_cmd_data[5] == 0x44 &&
+             p_cmd_data[6] == 0x01) {
+    sLegacyHits++;
+  }
+  if (nxpprofile_ctrl.profile_type == EMV_CO_PROFILE) {
+    if (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x06 &&
+        p_cmd_data[2] == 0x01 && p_cmd_data[3] == 0x03) {
+      sLegacyHits++;
+    } else if (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x03) {
+      sLegacyHits++;
+    }
+  }
+  if (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x03) sLegacyHits++;
+  if (*cmd_len <= (NCI_MAX_DATA_LEN - 3) && bEnableMfcReader &&
+      (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x00) &&
+      (nxpprofile_ctrl.profile_type == NFC_FORUM_PROFILE)) {
+    sLegacyHits++;
+  } else if ((*cmd_len >= 6) &&
+             (p_cmd_data[3] == 0x81 && p_cmd_data[4] == 0x01 &&
+              p_cmd_data[5] == 0x03)) {
+    sLegacyHits++;
+  } else if (icode_detected) {
+    sLegacyHits++;
+  } else if (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x03) {
+    sLegacyHits++;
+  } else if (p_cmd_data[0] == 0x22 && p_cmd_data[1] == 0x00 &&
+             p_cmd_data[2] == 0x01 && p_cmd_data[3] == 0x00) {
+    return NFCSTATUS_FAILED;
+  } else if ((p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02) &&
+             (p_cmd_data[2] == 0x09 && p_cmd_data[3] == 0x04)) {
+    sLegacyHits++;
+  } else if ((p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02) &&
+             ((p_cmd_data[2] == 0x07 && p_cmd_data[3] == 0x03) ||
+              (p_cmd_data[2] == 0x03 && p_cmd_data[3] == 0x01 &&
+               p_cmd_data[4] == 0x32))) {
+    return NFCSTATUS_FAILED;
+  } else if ((p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02) &&
+             (p_cmd_data[2] == 0x04 && p_cmd_data[3] == 0x01 &&
+              p_cmd_data[4] == 0x32 && p_cmd_data[5] == 0x00)) {
+    sLegacyHits++;
+  } else if ((wFwVerRsp & 0x0000FFFF) == wFwVer) {
+    sLegacyHits++;
+  }
+  return NFCSTATUS_SUCCESS;
+}
+
+static uint64_t nxp_ext_bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Returns the time spent in count calls for the packet, in ns */
+static uint64_t nxp_ext_bench_run(const nxp_ext_bench_pkt_t* p_pkt,
+                                  uint32_t count, bool legacy,
+                                  uint32_t* p_failed) {
+  uint8_t data[NCI_MAX_DATA_LEN];
+  uint8_t rsp[NCI_MAX_DATA_LEN];
+  uint16_t len;
+  uint16_t rsp_len;
+  uint64_t start = nxp_ext_bench_now_ns();
+
+  for (uint32_t i = 0; i < count; i++) {
+    memcpy(data, p_pkt->data, p_pkt->len);
+    len = p_pkt->len;
+    if (legacy) {
+      if (((p_pkt->path == NXP_EXT_BENCH_READ)
+               ? nxp_ext_bench_legacy_rsp(data, &len)
+               : nxp_ext_bench_legacy_cmd(&len, data)) != NFCSTATUS_SUCCESS)
+        (*p_failed)++;
+    } else if (p_pkt->path == NXP_EXT_BENCH_READ) {
+      if (phNxpNciHal_process_ext_rsp(data, &len) != NFCSTATUS_SUCCESS)
+        (*p_failed)++;
+    } else {
+      rsp_len = 0;
+      if (phNxpNciHal_write_ext(&len, data, &rsp_len, rsp) !=
+          NFCSTATUS_SUCCESS)
+        (*p_failed)++;
+    }
+  }
+  return nxp_ext_bench_now_ns() - start;
+}
+
+int main(int argc, char** argv) {
+  uint32_t count = NXP_EXT_BENCH_DEFAULT_CALLS;
+  tNFC_chipType chipType = sn100u;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:p")) != -1) {
+    if (opt == 'n') {
+      count = (uint32_t)strtoul(optarg, NULL, 0);
+    } else if (opt == 'p') {
+      chipType = pn557;
+    } else {
+      printf("usage: %s [-n <calls per packet>] [-p]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (count == 0) count = NXP_EXT_BENCH_DEFAULT_CALLS;
+  CONFIGURE_FEATURELIST(chipType);
+  phNxpNciHal_ext_init();
+
+  printf("%-6s %-22s %10s %10s %8s\n", "path", "packet", "ns/call",
+         "legacy ns", "failed");
+  for (const nxp_ext_bench_pkt_t& pkt : sPackets) {
+    uint32_t failed = 0;
+    uint32_t legacy_failed = 0;
+    /* warm up the tables and caches */
+    nxp_ext_bench_run(&pkt, count / 10 + 1, false, &failed);
+    nxp_ext_bench_run(&pkt, count / 10 + 1, true, &legacy_failed);
+    failed = 0;
+    uint64_t ns = nxp_ext_bench_run(&pkt, count, false, &failed);
+    uint64_t legacy_ns = nxp_ext_bench_run(&pkt, count, true, &legacy_failed);
+    printf("%-6s %-22s %10.1f %10.1f %8u\n",
+           (pkt.path == NXP_EXT_BENCH_READ) ? "read" : "write", pkt.name,
+           (double)ns / count, (double)legacy_ns / count, failed);
+  }
+  return 0;
+}
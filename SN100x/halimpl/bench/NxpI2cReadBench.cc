@@ -0,0 +1,233 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Compares the NXP_I2C_FRAMED_READ_LEN values on NfccI2cTransport::Read,
+ * against a simulated NFCC.
+ *
+ *   nxp_i2c_read_bench [-n <packets>] [-f] [-t <us per transaction>]
+ *                      [-k <bus kHz>] [len ...]
+ *
+ *   -f   FW download mode packets instead of NCI ones
+ *   -t   fixed cost of an I2C transaction, default 30 us
+ *   -k   I2C clock, default 400 kHz
+ *
+ * Without len on the command line, 0 (multi-read), 8, 16, 32 and 258 are
+ * compared. The transport is built into the bench and its read() and
+ * select() calls are wrapped at link time: a read continues the current
+ * packet of the NFCC and is padded with 0xFF past its end, as the NFCC
+ * does. The traffic is fixed, 90% of the packets are under 20 bytes. Every
+ * packet is checked to be read back intact.
+ */
+
+#include <NfccI2cTransport.h>
+#include <NfccTransportFactory.h>
+#include <errno.h>
+#include <phNxpConfig.h>
+#include <phNxpLog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#define NXP_I2C_BENCH_DEFAULT_PACKETS 2000
+#define NXP_I2C_BENCH_DEFAULT_TRANSACTION_US 30
+#define NXP_I2C_BENCH_DEFAULT_KHZ 400
+#define NXP_I2C_BENCH_MAX_LENS 16
+/* longest packet, FW download mode one with its CRC */
+#define NXP_I2C_BENCH_BUF_LEN (2 + 0xFF + 2)
+/* bits per byte on the bus, ACK included */
+#define NXP_I2C_BENCH_BITS_PER_BYTE 9
+
+extern "C" ssize_t __real_read(int fd, void* pBuf, size_t count);
+extern "C" int __real_select(int nfds, fd_set* pRead, fd_set* pWrite,
+                             fd_set* pExcept, struct timeval* pTimeout);
+
+/* Globals of the HAL the transport uses, the log ones come from
+ * NxpHalTestStubs.cc */
+phTmlNfc_i2cfragmentation_t fragmentation_enabled = I2C_FRAGMENTATION_ENABLED;
+phTmlNfc_Context_t* gpphTmlNfc_Context = NULL;
+spTransport gpTransportObj;
+
+/* Simulated NFCC */
+static int sDevFd = -1;
+static std::deque<std::vector<uint8_t>> sPending;
+static size_t sOffset = 0;
+static uint64_t sReads = 0;
+static double sBusUs = 0;
+static unsigned long sFramedReadLen = 0;
+static uint32_t sTransactionUs = NXP_I2C_BENCH_DEFAULT_TRANSACTION_US;
+static uint32_t sBusKhz = NXP_I2C_BENCH_DEFAULT_KHZ;
+
+extern "C" int GetNxpNumValue(const char* name, void* pValue,
+                              unsigned long len) {
+  if (strcmp(name, NAME_NXP_I2C_FRAMED_READ_LEN) != 0 || sFramedReadLen == 0 ||
+      len != sizeof(unsigned long))
+    return 0;
+  *(unsigned long*)pValue = sFramedReadLen;
+  return 1;
+}
+
+void phNxpNciHal_print_packet(const char* pString, const uint8_t* p_data,
+                              uint16_t len) {
+  (void)pString;
+  (void)p_data;
+  (void)len;
+}
+
+extern "C" ssize_t __wrap_read(int fd, void* pBuf, size_t count) {
+  uint8_t* pData = (uint8_t*)pBuf;
+
+  if (fd != sDevFd) return __real_read(fd, pBuf, count);
+  if (sPending.empty()) {
+    errno = EIO;
+    return -1;
+  }
+  sReads++;
+  sBusUs += sTransactionUs +
+            (double)count * NXP_I2C_BENCH_BITS_PER_BYTE * 1000 / sBusKhz;
+  std::vector<uint8_t>& packet = sPending.front();
+  for (size_t i = 0; i < count; i++) {
+    pData[i] = (sOffset < packet.size()) ? packet[sOffset++] : 0xFF;
+  }
+  if (sOffset >= packet.size()) {
+    sPending.pop_front();
+    sOffset = 0;
+  }
+  return count;
+}
+
+extern "C" int __wrap_select(int nfds, fd_set* pRead, fd_set* pWrite,
+                             fd_set* pExcept, struct timeval* pTimeout) {
+  if (pRead == NULL || sDevFd < 0 || !FD_ISSET(sDevFd, pRead))
+    return __real_select(nfds, pRead, pWrite, pExcept, pTimeout);
+  return 1;
+}
+
+/* Fixed traffic, seeded */
+static std::vector<std::vector<uint8_t>> nxp_i2c_bench_traffic(uint32_t count,
+                                                               bool fwDnld) {
+  std::vector<std::vector<uint8_t>> traffic;
+
+  srand(1);
+  for (uint32_t i = 0; i < count; i++) {
+    int len = (i % 10 == 0) ? 200 + rand() % 55 : rand() % 20;
+    std::vector<uint8_t> packet;
+    if (fwDnld) {
+      /* header, payload and CRC */
+      packet = {0x00, (uint8_t)len};
+      for (int j = 0; j < len + 2; j++) packet.push_back((uint8_t)rand());
+    } else {
+      packet = {(uint8_t)(0x60 | (rand() & 0x03)), (uint8_t)rand(),
+                (uint8_t)len};
+      for (int j = 0; j < len; j++) packet.push_back((uint8_t)rand());
+    }
+    traffic.push_back(packet);
+  }
+  return traffic;
+}
+
+/* Reads the traffic with a framed read length, returns the bad packets */
+static uint32_t nxp_i2c_bench_run(unsigned long framedLen, bool fwDnld,
+                                  const std::vector<std::vector<uint8_t>>& traffic,
+                                  NfccReadStats_t* pStats) {
+  std::shared_ptr<NfccI2cTransport> transport =
+      std::make_shared<NfccI2cTransport>();
+  phTmlNfc_Config_t config;
+  uint8_t buffer[NXP_I2C_BENCH_BUF_LEN];
+  void* pDevHandle = NULL;
+  uint32_t bad = 0;
+
+  memset(&config, 0x00, sizeof(config));
+  config.pDevName = (int8_t*)"/dev/null";
+  sFramedReadLen = framedLen;
+  gpTransportObj = transport;
+  if (transport->OpenAndConfigure(&config, &pDevHandle) != NFCSTATUS_SUCCESS) {
+    printf("transport open failed\n");
+    return traffic.size();
+  }
+  transport->EnableFwDnldMode(fwDnld);
+  sDevFd = (int)(intptr_t)pDevHandle;
+  sPending.assign(traffic.begin(), traffic.end());
+  sOffset = 0;
+  sReads = 0;
+  sBusUs = 0;
+
+  for (const std::vector<uint8_t>& packet : traffic) {
+    int ret = transport->Read(pDevHandle, buffer, sizeof(buffer));
+    if (ret != (int)packet.size() || memcmp(buffer, packet.data(), ret) != 0)
+      bad++;
+  }
+  transport->GetReadStats(pStats);
+  sDevFd = -1;
+  transport->Close(pDevHandle);
+  gpTransportObj = NULL;
+  return bad;
+}
+
+int main(int argc, char** argv) {
+  unsigned long lens[NXP_I2C_BENCH_MAX_LENS] = {0, 8, 16, 32, 258};
+  int numLens = 5;
+  uint32_t count = NXP_I2C_BENCH_DEFAULT_PACKETS;
+  bool fwDnld = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:ft:k:")) != -1) {
+    if (opt == 'n') {
+      count = (uint32_t)strtoul(optarg, NULL, 0);
+    } else if (opt == 'f') {
+      fwDnld = true;
+    } else if (opt == 't') {
+      sTransactionUs = (uint32_t)strtoul(optarg, NULL, 0);
+    } else if (opt == 'k') {
+      sBusKhz = (uint32_t)strtoul(optarg, NULL, 0);
+    } else {
+      printf(
+          "usage: %s [-n <packets>] [-f] [-t <us per transaction>] "
+          "[-k <bus kHz>] [len ...]\n",
+          argv[0]);
+      return 1;
+    }
+  }
+  if (count == 0) count = NXP_I2C_BENCH_DEFAULT_PACKETS;
+  if (sBusKhz == 0) sBusKhz = NXP_I2C_BENCH_DEFAULT_KHZ;
+  if (optind < argc) {
+    numLens = 0;
+    for (int i = optind; i < argc && numLens < NXP_I2C_BENCH_MAX_LENS; i++) {
+      lens[numLens++] = strtoul(argv[i], NULL, 0);
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> traffic =
+      nxp_i2c_bench_traffic(count, fwDnld);
+  printf("%-5s %-7s %12s %12s %10s %6s\n", "len", "framed", "reads/pkt",
+         "bus us/pkt", "pad bytes", "bad");
+  for (int i = 0; i < numLens; i++) {
+    NfccReadStats_t stats;
+    memset(&stats, 0x00, sizeof(stats));
+    uint32_t bad = nxp_i2c_bench_run(lens[i], fwDnld, traffic, &stats);
+    printf("%-5lu %-7u %12.2f %12.1f %10llu %6u\n", lens[i], stats.dwFramedLen,
+           (double)sReads / count, sBusUs / count,
+           (unsigned long long)stats.qwPadBytes, bad);
+  }
+  return 0;
+}
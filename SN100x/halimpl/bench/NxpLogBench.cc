@@ -0,0 +1,118 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Measures the cost of a NXPLOG_* call on the logging thread, written inline
+ * to logcat and queued to the asynchronous log sink.
+ *
+ *   nxp_log_bench [-n <logs per run>]
+ *
+ * Logs are issued in bursts of half a ring so that none is dropped, the
+ * time spent waiting for the drainer between bursts is not accounted.
+ */
+
+#include <phNxpLog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NXP_LOG_BENCH_DEFAULT_LOGS 20000
+#define NXP_LOG_BENCH_BURST (NXPLOG_ASYNC_RING_SIZE / 2)
+
+typedef enum {
+  NXP_LOG_BENCH_STATUS = 0x00, /* few integer arguments */
+  NXP_LOG_BENCH_PACKET,        /* hex dump of a NCI packet */
+  NXP_LOG_BENCH_MAX
+} nxp_log_bench_msg_t;
+
+static const char* sMsgName[NXP_LOG_BENCH_MAX] = {"status", "packet"};
+
+static uint64_t nxp_log_bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Returns the time spent in NXPLOG_* calls, in ns */
+static uint64_t nxp_log_bench_run(nxp_log_bench_msg_t msg, uint32_t count) {
+  static const char* kPacket =
+      "6105200101048004000000000A46666D0101110202038003";
+  uint64_t total = 0;
+  uint32_t i = 0;
+
+  while (i < count) {
+    uint32_t burst = (count - i < NXP_LOG_BENCH_BURST) ? (count - i)
+                                                       : NXP_LOG_BENCH_BURST;
+    uint64_t start = nxp_log_bench_now_ns();
+    for (uint32_t j = 0; j < burst; j++, i++) {
+      if (msg == NXP_LOG_BENCH_STATUS) {
+        NXPLOG_NCIHAL_D("%s: status=0x%02x len=%d seq=%u", __func__, 0x00, 24,
+                        i);
+      } else {
+        NXPLOG_NCIR_D("len = %3d <= %s", 24, kPacket);
+      }
+    }
+    total += nxp_log_bench_now_ns() - start;
+    if (gLog_async_enabled) phNxpLog_AsyncFlush();
+  }
+  return total;
+}
+
+int main(int argc, char** argv) {
+  uint32_t count = NXP_LOG_BENCH_DEFAULT_LOGS;
+  uint64_t inline_ns[NXP_LOG_BENCH_MAX];
+  uint64_t async_ns[NXP_LOG_BENCH_MAX];
+  phNxpLog_AsyncStats_t stats;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    if (opt == 'n') {
+      count = (uint32_t)strtoul(optarg, NULL, 0);
+    } else {
+      printf("usage: %s [-n <logs per run>]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (count == 0) count = NXP_LOG_BENCH_DEFAULT_LOGS;
+  memset(&gLog_level, NXPLOG_LOG_DEBUG_LOGLEVEL, sizeof(gLog_level));
+
+  for (int msg = 0; msg < NXP_LOG_BENCH_MAX; msg++) {
+    inline_ns[msg] = nxp_log_bench_run((nxp_log_bench_msg_t)msg, count);
+  }
+  if (!phNxpLog_AsyncStart()) {
+    printf("asynchronous log sink not available\n");
+    return 1;
+  }
+  for (int msg = 0; msg < NXP_LOG_BENCH_MAX; msg++) {
+    async_ns[msg] = nxp_log_bench_run((nxp_log_bench_msg_t)msg, count);
+  }
+  phNxpLog_AsyncFlush();
+  phNxpLog_AsyncGetStats(&stats);
+
+  printf("%-8s %12s %12s\n", "log", "inline ns", "async ns");
+  for (int msg = 0; msg < NXP_LOG_BENCH_MAX; msg++) {
+    printf("%-8s %12.1f %12.1f\n", sMsgName[msg],
+           (double)inline_ns[msg] / count, (double)async_ns[msg] / count);
+  }
+  printf("posted %llu, dropped %llu, inline fallback %llu\n",
+         (unsigned long long)stats.posted, (unsigned long long)stats.dropped,
+         (unsigned long long)stats.sync);
+  return 0;
+}
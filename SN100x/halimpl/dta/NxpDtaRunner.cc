@@ -0,0 +1,462 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Runs the DTA command and response handling of the HAL for a list of DTA
+ * pattern numbers, without NFCC.
+ *
+ *   nxp_dta_runner [-j <workers>] [-v] [pattern ...]
+ *
+ *   -j   number of patterns run at the same time, default is the number of
+ *        online CPUs
+ *   -v   enable the HAL debug logs
+ *
+ * DTA mode is a set of HAL globals, so each pattern is run in a worker
+ * process of its own. The worker enables DTA mode with the pattern number
+ * and plays the script below: packets written by libnfc-nci go through the
+ * HAL write path extensions like in phNxpNciHal_write_internal, packets of
+ * the scripted NFCC go through the HAL read path extensions like in
+ * phNxpNciHal_read_complete. The packets put on the bus, the ones answered
+ * by the HAL itself and the ones handed to libnfc-nci are checked against
+ * the script. The result and the time spent are reported per pattern.
+ *
+ * Without pattern on the command line, the patterns 0x0000 to 0x000B and
+ * the analog test pattern 0x1000 are run.
+ */
+
+#include <Nxp_Features.h>
+#include <errno.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal_dta.h>
+#include <phNxpNciHal_ext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define NXP_DTA_ANALOG_PATTERN 0x1000
+#define NXP_DTA_DEFAULT_PATTERNS 12
+#define NXP_DTA_MAX_PATTERNS 64
+/* A worker not done within this time is killed and reported as failed */
+#define NXP_DTA_PATTERN_TIMEOUT_SEC 10
+
+typedef enum {
+  NXP_DTA_SCOPE_ALL = 0x00,
+  NXP_DTA_SCOPE_ANALOG,     /* analog test pattern only */
+  NXP_DTA_SCOPE_NOT_ANALOG, /* all patterns but the analog test one */
+} nxp_dta_scope_t;
+
+/* One command of libnfc-nci, packets are written in hex */
+typedef struct {
+  const char* name;
+  nxp_dta_scope_t scope;
+  const char* host;    /* written by libnfc-nci */
+  const char* bus;     /* expected on the bus, NULL if the HAL answers */
+  const char* hal_rsp; /* expected HAL answer when bus is NULL */
+  const char* ntf;     /* sent by the NFCC after its response, optional */
+} nxp_dta_step_t;
+
+/* Result written by a worker to its pipe */
+typedef struct {
+  uint32_t steps;
+  uint32_t failed;
+  uint64_t elapsed; /* ns spent in the script */
+} nxp_dta_result_t;
+
+typedef struct {
+  uint16_t pattern;
+  pid_t pid;
+  int fd;
+  int status;
+  nxp_dta_result_t result;
+} nxp_dta_worker_t;
+
+static const nxp_dta_step_t sDtaScript[] = {
+    {"set config ATR_RES general bytes blocked", NXP_DTA_SCOPE_ALL,
+     "20 02 17 01 29 14 46 66 6D 01 01 11 02 02 07 80 03 02 00 03 04 01 32 07 "
+     "01 03",
+     NULL, "40 02 02 00 00", NULL},
+    {"T3T polling of wildcard system code answered", NXP_DTA_SCOPE_ALL,
+     "21 08 04 FF FF 01 0F", NULL, "41 08 01 00", NULL},
+    {"set config LA_SEL_INFO updated", NXP_DTA_SCOPE_ALL,
+     "20 02 10 05 30 01 04 31 01 00 32 01 00 38 01 00 50 01 00",
+     "20 02 10 05 30 01 04 31 01 00 32 01 40 38 01 00 50 01 02", NULL, NULL},
+    {"dirty set config blocked", NXP_DTA_SCOPE_ALL,
+     "20 02 0D 04 30 01 04 31 01 00 32 01 00 50 01 00", NULL,
+     "40 02 02 00 00", NULL},
+    {"dirty set config leading LA_SEL_INFO blocked", NXP_DTA_SCOPE_ALL,
+     "20 02 0D 04 32 01 00 30 01 04 31 01 00 50 01 00", NULL,
+     "40 02 02 00 00", NULL},
+    {"analog set config LA_SEL_INFO blocked", NXP_DTA_SCOPE_ANALOG,
+     "20 02 0D 04 30 01 04 31 01 00 32 01 20 50 01 00", NULL,
+     "40 02 02 00 00", NULL},
+    {"analog set config LA_SEL_INFO sent", NXP_DTA_SCOPE_NOT_ANALOG,
+     "20 02 0D 04 30 01 04 31 01 00 32 01 20 50 01 00",
+     "20 02 0D 04 30 01 04 31 01 00 32 01 20 50 01 00", NULL, NULL},
+    {"analog set config LF_PROTOCOL_TYPE blocked", NXP_DTA_SCOPE_ANALOG,
+     "20 02 04 01 50 01 00", NULL, "40 02 02 00 00", NULL},
+    {"analog set config LF_PROTOCOL_TYPE sent", NXP_DTA_SCOPE_NOT_ANALOG,
+     "20 02 04 01 50 01 00", "20 02 04 01 50 01 00", NULL, NULL},
+    {"NFCEE discover answered", NXP_DTA_SCOPE_ALL, "22 00 01 00", NULL,
+     "42 00 02 00 00", NULL},
+    {"RF discover gets NFC-F listen", NXP_DTA_SCOPE_ALL,
+     "21 03 05 02 00 01 01 01",
+     "21 03 0B 05 00 01 01 01 80 01 82 01 85 01", NULL,
+     /* T1T activated on frame RF interface */
+     "61 05 11 01 01 01 00 FF 01 06 0C 00 11 22 33 44 00 00 00 00"},
+    {"T1T RID UID echo cleared", NXP_DTA_SCOPE_ALL,
+     "00 00 07 78 00 00 11 22 33 44", "00 00 07 78 00 00 00 00 00 00", NULL,
+     "00 00 06 11 48 11 22 33 44"},
+    {"T1T RID UID echo kept after first RID", NXP_DTA_SCOPE_ALL,
+     "00 00 07 78 00 00 11 22 33 44", "00 00 07 78 00 00 11 22 33 44", NULL,
+     "00 00 06 11 48 11 22 33 44"},
+    {"RF deactivate sent", NXP_DTA_SCOPE_ALL, "21 06 01 00", "21 06 01 00",
+     NULL, "61 06 02 00 00"},
+};
+
+static bool sVerbose;
+
+static uint64_t nxp_dta_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static std::vector<uint8_t> nxp_dta_hex(const char* p_hex) {
+  std::vector<uint8_t> data;
+  while (p_hex != NULL && *p_hex != '\0') {
+    char* p_end;
+    if (*p_hex == ' ') {
+      p_hex++;
+      continue;
+    }
+    data.push_back((uint8_t)strtoul(p_hex, &p_end, 16));
+    p_hex = p_end;
+  }
+  return data;
+}
+
+static std::string nxp_dta_dump(const uint8_t* p_data, uint16_t len) {
+  std::string dump;
+  char byte[4];
+  for (uint16_t i = 0; i < len; i++) {
+    snprintf(byte, sizeof(byte), "%02X", p_data[i]);
+    dump += byte;
+  }
+  return dump;
+}
+
+/*******************************************************************************
+**
+** Function         nxp_dta_nfcc_rsp
+**
+** Description      Scripted NFCC: answers a command with a response of
+**                  status OK and a data packet with one credit.
+**
+** Returns          Packet sent by the NFCC
+**
+*******************************************************************************/
+static std::vector<uint8_t> nxp_dta_nfcc_rsp(const uint8_t* p_cmd) {
+  if ((p_cmd[0] & NCI_MT_MASK) == 0x00) {
+    /* CORE_CONN_CREDITS_NTF for the connection of the packet */
+    return {0x60, 0x06, 0x03, 0x01, (uint8_t)(p_cmd[0] & 0x0F), 0x01};
+  }
+  if (p_cmd[0] == 0x20 && p_cmd[1] == 0x02) {
+    return {0x40, 0x02, 0x02, 0x00, 0x00};
+  }
+  return {(uint8_t)(NCI_MT_RSP | (p_cmd[0] & 0x0F)), p_cmd[1], 0x01, 0x00};
+}
+
+/*******************************************************************************
+**
+** Function         nxp_dta_read
+**
+** Description      Passes a packet of the NFCC through the HAL read path
+**                  extensions and checks it reaches libnfc-nci unchanged.
+**
+** Returns          true if the packet is delivered as sent
+**
+*******************************************************************************/
+static bool nxp_dta_read(const std::vector<uint8_t>& packet,
+                         std::string* p_log) {
+  uint8_t rx[NCI_MAX_DATA_LEN] = {0};
+  uint16_t rx_len = packet.size();
+
+  memcpy(rx, packet.data(), rx_len);
+  if (phNxpNciHal_process_ext_rsp(rx, &rx_len) != NFCSTATUS_SUCCESS) {
+    *p_log += "  NFCC " + nxp_dta_dump(packet.data(), packet.size()) +
+              " dropped by HAL\n";
+    return false;
+  }
+  if (rx_len != packet.size() || memcmp(rx, packet.data(), rx_len) != 0) {
+    *p_log += "  NFCC " + nxp_dta_dump(packet.data(), packet.size()) +
+              " delivered as " + nxp_dta_dump(rx, rx_len) + "\n";
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nxp_dta_run_step
+**
+** Description      Writes the command of a step through the HAL write path
+**                  extensions and checks where it ends up.
+**
+** Returns          true if the step behaves as scripted
+**
+*******************************************************************************/
+static bool nxp_dta_run_step(const nxp_dta_step_t* p_step,
+                             std::string* p_log) {
+  std::vector<uint8_t> host = nxp_dta_hex(p_step->host);
+  std::vector<uint8_t> expected;
+  uint8_t cmd[NCI_MAX_DATA_LEN] = {0};
+  uint8_t rsp[NCI_MAX_DATA_LEN] = {0};
+  uint16_t cmd_len = host.size();
+  uint16_t rsp_len = 0;
+  NFCSTATUS status = NFCSTATUS_SUCCESS;
+  std::string log;
+  bool passed = true;
+
+  memcpy(cmd, host.data(), cmd_len);
+  if (!phNxpNciHal_write_ext_is_passthrough(cmd_len, cmd)) {
+    status = phNxpNciHal_write_ext(&cmd_len, cmd, &rsp_len, rsp);
+  }
+
+  if (p_step->bus == NULL) {
+    expected = nxp_dta_hex(p_step->hal_rsp);
+    if (status == NFCSTATUS_SUCCESS) {
+      log += "  sent " + nxp_dta_dump(cmd, cmd_len) + ", expected HAL answer " +
+             nxp_dta_dump(expected.data(), expected.size()) + "\n";
+      passed = false;
+    } else if (rsp_len != expected.size() ||
+               memcmp(rsp, expected.data(), rsp_len) != 0) {
+      log += "  HAL answered " + nxp_dta_dump(rsp, rsp_len) + ", expected " +
+             nxp_dta_dump(expected.data(), expected.size()) + "\n";
+      passed = false;
+    }
+  } else {
+    expected = nxp_dta_hex(p_step->bus);
+    if (status != NFCSTATUS_SUCCESS) {
+      log += "  HAL answered " + nxp_dta_dump(rsp, rsp_len) + ", expected " +
+             nxp_dta_dump(expected.data(), expected.size()) + " on the bus\n";
+      passed = false;
+    } else if (cmd_len != expected.size() ||
+               memcmp(cmd, expected.data(), cmd_len) != 0) {
+      log += "  sent " + nxp_dta_dump(cmd, cmd_len) + ", expected " +
+             nxp_dta_dump(expected.data(), expected.size()) + "\n";
+      passed = false;
+    } else {
+      passed = nxp_dta_read(nxp_dta_nfcc_rsp(cmd), &log);
+    }
+  }
+  if (p_step->ntf != NULL) {
+    passed &= nxp_dta_read(nxp_dta_hex(p_step->ntf), &log);
+  }
+
+  if (!passed) *p_log += std::string(" ") + p_step->name + ":\n" + log;
+  return passed;
+}
+
+/*******************************************************************************
+**
+** Function         nxp_dta_worker
+**
+** Description      Runs the script for one pattern and writes the result to
+**                  the pipe of the parent. Runs in its own process.
+**
+** Returns          Exit status of the worker
+**
+*******************************************************************************/
+static int nxp_dta_worker(uint16_t pattern, int fd) {
+  nxp_dta_result_t result = {};
+  bool analog = (pattern == NXP_DTA_ANALOG_PATTERN);
+  tNFC_chipType chipType = sn100u;
+  std::string log;
+  uint64_t start;
+
+  alarm(NXP_DTA_PATTERN_TIMEOUT_SEC);
+  if (sVerbose) {
+    memset(&gLog_level, NXPLOG_LOG_DEBUG_LOGLEVEL, sizeof(gLog_level));
+  }
+  CONFIGURE_FEATURELIST(chipType);
+  phNxpNciHal_ext_init();
+
+  start = nxp_dta_now_ns();
+  phNxpEnable_DtaMode(pattern);
+  for (const nxp_dta_step_t& step : sDtaScript) {
+    if ((step.scope == NXP_DTA_SCOPE_ANALOG && !analog) ||
+        (step.scope == NXP_DTA_SCOPE_NOT_ANALOG && analog)) {
+      continue;
+    }
+    result.steps++;
+    if (!nxp_dta_run_step(&step, &log)) result.failed++;
+  }
+  phNxpDisable_DtaMode();
+  result.elapsed = nxp_dta_now_ns() - start;
+
+  if (!log.empty()) {
+    char title[32];
+    snprintf(title, sizeof(title), "pattern 0x%04X\n", pattern);
+    log = title + log;
+    /* one write, so that the logs of the workers do not interleave */
+    if (write(STDOUT_FILENO, log.data(), log.size()) < 0) result.failed++;
+  }
+  if (write(fd, &result, sizeof(result)) != sizeof(result)) return 1;
+  return (result.failed == 0) ? 0 : 1;
+}
+
+/*******************************************************************************
+**
+** Function         nxp_dta_start
+**
+** Description      Forks the worker process of a pattern.
+**
+** Returns          true if the worker is started
+**
+*******************************************************************************/
+static bool nxp_dta_start(nxp_dta_worker_t* p_worker) {
+  int fds[2];
+
+  if (pipe(fds) != 0) {
+    printf("pipe failed: %s\n", strerror(errno));
+    return false;
+  }
+  fflush(stdout);
+  p_worker->pid = fork();
+  if (p_worker->pid == 0) {
+    close(fds[0]);
+    _exit(nxp_dta_worker(p_worker->pattern, fds[1]));
+  }
+  close(fds[1]);
+  if (p_worker->pid < 0) {
+    printf("fork failed: %s\n", strerror(errno));
+    close(fds[0]);
+    return false;
+  }
+  p_worker->fd = fds[0];
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nxp_dta_collect
+**
+** Description      Waits for one worker to exit and reads its result.
+**
+** Returns          Worker which exited, NULL if none is left
+**
+*******************************************************************************/
+static nxp_dta_worker_t* nxp_dta_collect(
+    std::vector<nxp_dta_worker_t>* p_workers) {
+  int status;
+  pid_t pid;
+
+  do {
+    pid = waitpid(-1, &status, 0);
+  } while (pid < 0 && errno == EINTR);
+  if (pid < 0) return NULL;
+
+  for (nxp_dta_worker_t& worker : *p_workers) {
+    if (worker.pid != pid) continue;
+    worker.status = status;
+    if (read(worker.fd, &worker.result, sizeof(worker.result)) !=
+        sizeof(worker.result)) {
+      /* killed before reporting */
+      worker.result.failed = 1;
+    }
+    close(worker.fd);
+    return &worker;
+  }
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  std::vector<nxp_dta_worker_t> workers;
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t failed = 0;
+  uint64_t total = 0;
+  size_t next = 0;
+  long running = 0;
+  uint64_t start;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "j:v")) != -1) {
+    if (opt == 'j') {
+      jobs = strtol(optarg, NULL, 0);
+    } else if (opt == 'v') {
+      sVerbose = true;
+    } else {
+      printf("usage: %s [-j <workers>] [-v] [pattern ...]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (jobs <= 0) jobs = 1;
+  for (int i = optind; i < argc && workers.size() < NXP_DTA_MAX_PATTERNS;
+       i++) {
+    workers.push_back({(uint16_t)strtoul(argv[i], NULL, 0), 0, -1, 0, {}});
+  }
+  if (workers.empty()) {
+    for (uint16_t pattern = 0; pattern < NXP_DTA_DEFAULT_PATTERNS; pattern++)
+      workers.push_back({pattern, 0, -1, 0, {}});
+    workers.push_back({NXP_DTA_ANALOG_PATTERN, 0, -1, 0, {}});
+  }
+
+  start = nxp_dta_now_ns();
+  while (next < workers.size() || running > 0) {
+    if (next < workers.size() && running < jobs) {
+      if (!nxp_dta_start(&workers[next])) {
+        workers[next].result.failed = 1;
+        workers[next].pid = -1;
+      } else {
+        running++;
+      }
+      next++;
+      continue;
+    }
+    if (nxp_dta_collect(&workers) == NULL) break;
+    running--;
+  }
+
+  printf("%-8s %6s %6s %10s  %s\n", "pattern", "steps", "failed", "time us",
+         "worker");
+  for (const nxp_dta_worker_t& worker : workers) {
+    char state[32];
+    if (worker.pid < 0) {
+      snprintf(state, sizeof(state), "not started");
+    } else if (WIFSIGNALED(worker.status)) {
+      snprintf(state, sizeof(state), "killed by signal %d",
+               WTERMSIG(worker.status));
+    } else {
+      snprintf(state, sizeof(state), "exit %d", WEXITSTATUS(worker.status));
+    }
+    printf("0x%04X   %6u %6u %10.1f  %s\n", worker.pattern, worker.result.steps,
+           worker.result.failed, worker.result.elapsed / 1000.0, state);
+    if (worker.result.failed != 0 || worker.status != 0) failed++;
+    total += worker.result.elapsed;
+  }
+  printf("%zu patterns, %u failed, %ld workers, wall %.1f ms, "
+         "script %.1f ms\n",
+         workers.size(), failed, jobs, (nxp_dta_now_ns() - start) / 1000000.0,
+         total / 1000000.0);
+  return (failed == 0) ? 0 : 1;
+}
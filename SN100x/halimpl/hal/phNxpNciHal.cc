@@ -24,10 +24,18 @@
 #include <cutils/properties.h>
 #include <phNxpNciHal.h>
 #include <phNxpNciHal_Adaptation.h>
+#include <phNxpNciHal_BootTasks.h>
+#include <phNxpNciHal_ConfigReload.h>
+#include <phNxpNciHal_ConfigSnapshot.h>
 #include <phNxpNciHal_Dnld.h>
+#include <phNxpNciHal_ExtCmdAsync.h>
+#include <phNxpNciHal_LatencyStats.h>
+#include <phNxpNciHal_Liveness.h>
 #include <phNxpNciHal_NfcDepSWPrio.h>
+#include <phNxpNciHal_ThreadPolicy.h>
 #include <phNxpNciHal_ext.h>
 #include <phTmlNfc.h>
+#include <phTmlNfc_Trace.h>
 #if(NXP_EXTNS == TRUE)
 #include "phNxpNciHal_nciParser.h"
 #endif
@@ -108,6 +116,14 @@ static uint8_t write_unlocked_status = NFCSTATUS_SUCCESS;
 uint8_t wFwUpdateReq = false;
 uint8_t wRfUpdateReq = false;
 uint32_t timeoutTimerId = 0;
+/* TX descriptor pool for packets rewritten by HAL extensions */
+static phNxpNciHal_TxDesc_t sTxDescPool[NXP_TX_DESC_POOL_SIZE];
+static uint8_t sTxDescNext = 0;
+static pthread_mutex_t sTxDescLock = PTHREAD_MUTEX_INITIALIZER;
+/* Buffer last handed to TML, which may retransmit it until the next write */
+static const uint8_t* sTmlTxBuf = NULL;
+/* Descriptor kept in use while TML still references it */
+static phNxpNciHal_TxDesc_t* sTxDescHeld = NULL;
 #ifndef FW_DWNLD_FLAG
 uint8_t fw_dwnld_flag = false;
 #endif
@@ -142,6 +158,12 @@ static void phNxpNciHal_write_complete(void* pContext,
 static void phNxpNciHal_read_complete(void* pContext,
                                       phTmlNfc_TransactInfo_t* pInfo);
 static void phNxpNciHal_close_complete(NFCSTATUS status);
+static phNxpNciHal_TxDesc_t* phNxpNciHal_tx_desc_alloc(uint16_t data_len,
+                                                      const uint8_t* p_data);
+static void phNxpNciHal_tx_desc_release(phNxpNciHal_TxDesc_t* p_desc);
+static bool phNxpNciHal_tx_desc_owns(const uint8_t* p_data);
+static void phNxpNciHal_tx_desc_on_write(const uint8_t* p_data);
+static void phNxpNciHal_tx_desc_reset(void);
 static void phNxpNciHal_core_initialized_complete(NFCSTATUS status);
 static void phNxpNciHal_power_cycle_complete(NFCSTATUS status);
 static void phNxpNciHal_kill_client_thread(
@@ -214,6 +236,7 @@ void* phNxpNciHal_client_thread(void* arg) {
   phLibNfc_Message_t msg;
 
   NXPLOG_NCIHAL_D("thread started");
+  phNxpNciHal_threadPolicyApply(PH_NXP_THREAD_CLIENT);
 
   p_nxpncihal_ctrl->thread_running = 1;
 
@@ -691,6 +714,7 @@ int phNxpNciHal_MinOpen (){
   NFCSTATUS status = NFCSTATUS_SUCCESS;
   NXPLOG_NCIHAL_D("phNxpNci_MinOpen(): enter");
 
+  phNxpNciHal_bootTasksWait(PH_NXP_BOOT_STEPS_MIN_OPEN, 0);
   AutoThreadMutex a(sHalFnLock);
   if (nxpncihal_ctrl.halStatus == HAL_STATUS_MIN_OPEN) {
     NXPLOG_NCIHAL_D("phNxpNciHal_MinOpen(): already open");
@@ -896,6 +920,11 @@ int phNxpNciHal_open(nfc_stack_callback_t* p_cback,
   NFCSTATUS wConfigStatus = NFCSTATUS_SUCCESS;
   NFCSTATUS status = NFCSTATUS_SUCCESS;
   NXPLOG_NCIHAL_E("phNxpNciHal_open NFC HAL OPEN");
+  phTmlNfc_TraceOpen();
+  phTmlNfc_TraceEvent(PH_TMLNFC_TRACE_EVT_OPEN, NULL, 0);
+  /* open fails below if the eSE update is still running past the wait */
+  phNxpNciHal_bootTasksWait(PH_NXP_BOOT_STEPS_OPEN,
+                            PH_NXP_BOOT_OPEN_WAIT_MS);
 #ifdef ENABLE_ESE_CLIENT
   if(ese_update != ESE_UPDATE_COMPLETED)
   {
@@ -926,6 +955,9 @@ int phNxpNciHal_open(nfc_stack_callback_t* p_cback,
   }
   /* Call open complete */
   phNxpNciHal_open_complete(wConfigStatus);
+  phNxpNciHal_extCmdAsyncStart();
+  phNxpNciHal_configReloadStart();
+  phNxpNciHal_livenessStart();
 
   return wConfigStatus;
 
@@ -1040,6 +1072,7 @@ static void phNxpNciHal_open_complete(NFCSTATUS status) {
  *
  ******************************************************************************/
 int phNxpNciHal_write(uint16_t data_len, const uint8_t* p_data) {
+  phTmlNfc_TraceRecord(PH_TMLNFC_TRACE_HOST_TX, p_data, data_len);
   if (bDisableLegacyMfcExtns && bEnableMfcExtns && p_data[0] == 0x00) {
     return NxpMfcReaderInstance.Write(data_len, p_data);
   }
@@ -1055,21 +1088,21 @@ int phNxpNciHal_write(uint16_t data_len, const uint8_t* p_data) {
  *                  is called to check if there is any extension processing
  *                  is required for the NCI packet being sent out.
  *
- * Returns          It returns number of bytes successfully written to NFCC.
+ * Returns          It returns number of bytes successfully written to NFCC,
+ *                  NFCSTATUS_FAILED if the HAL is not open, 0 if the packet
+ *                  is longer than NCI_MAX_DATA_LEN allows.
  *
  ******************************************************************************/
 int phNxpNciHal_write_internal(uint16_t data_len, const uint8_t* p_data) {
   NFCSTATUS status = NFCSTATUS_FAILED;
   static phLibNfc_Message_t msg;
+  phNxpNciHal_TxDesc_t* p_desc = NULL;
   if (nxpncihal_ctrl.halStatus != HAL_STATUS_OPEN) {
     return NFCSTATUS_FAILED;
   }
-  /* Create local copy of cmd_data */
-  memcpy(nxpncihal_ctrl.p_cmd_data, p_data, data_len);
-  nxpncihal_ctrl.cmd_len = data_len;
-  if ((nxpncihal_ctrl.cmd_len + MAX_NXP_HAL_EXTN_BYTES)> NCI_MAX_DATA_LEN) {
-    NXPLOG_NCIHAL_D("cmd_len exceeds limit NCI_MAX_DATA_LEN");
-    goto clean_and_return;
+  if ((data_len + MAX_NXP_HAL_EXTN_BYTES) > NCI_MAX_DATA_LEN) {
+    NXPLOG_NCIHAL_E("cmd_len exceeds limit NCI_MAX_DATA_LEN");
+    return 0;
   }
 #ifdef P2P_PRIO_LOGIC_HAL_IMP
   /* Specific logic to block RF disable when P2P priority logic is busy */
@@ -1080,10 +1113,27 @@ int phNxpNciHal_write_internal(uint16_t data_len, const uint8_t* p_data) {
   }
 #endif
 
+  if (phNxpNciHal_write_ext_is_passthrough(data_len, p_data)) {
+    /* No extension touches this packet, it is written from the caller's
+     * buffer */
+    CONCURRENCY_LOCK();
+    data_len = phNxpNciHal_write_unlocked(data_len, p_data, ORIG_LIBNFC);
+    CONCURRENCY_UNLOCK();
+    goto clean_and_return;
+  }
+
+  /* Extension may rewrite the packet, stage a private copy of it */
+  p_desc = phNxpNciHal_tx_desc_alloc(data_len, p_data);
+  if (p_desc == NULL) {
+    NXPLOG_NCIHAL_E("No free TX descriptor");
+    data_len = 0;
+    goto clean_and_return;
+  }
+
   /* Check for NXP ext before sending write */
-  status =
-      phNxpNciHal_write_ext(&nxpncihal_ctrl.cmd_len, nxpncihal_ctrl.p_cmd_data,
-                            &nxpncihal_ctrl.rsp_len, nxpncihal_ctrl.p_rsp_data);
+  status = phNxpNciHal_write_ext(&p_desc->len, p_desc->p_data,
+                                 &nxpncihal_ctrl.rsp_len,
+                                 nxpncihal_ctrl.p_rsp_data);
   if (status != NFCSTATUS_SUCCESS) {
     /* Do not send packet to PN54X, send response directly */
     msg.eMsgType = NCI_HAL_RX_MSG;
@@ -1096,8 +1146,8 @@ int phNxpNciHal_write_internal(uint16_t data_len, const uint8_t* p_data) {
   }
 
   CONCURRENCY_LOCK();
-  data_len = phNxpNciHal_write_unlocked(nxpncihal_ctrl.cmd_len,
-                                        nxpncihal_ctrl.p_cmd_data, ORIG_LIBNFC);
+  data_len = phNxpNciHal_write_unlocked(p_desc->len, p_desc->p_data,
+                                        ORIG_LIBNFC);
   CONCURRENCY_UNLOCK();
 
   if (nfcFL.chipType < sn100u && icode_send_eof == 1) {
@@ -1110,10 +1160,166 @@ int phNxpNciHal_write_internal(uint16_t data_len, const uint8_t* p_data) {
   }
 
 clean_and_return:
-  /* No data written */
+  phNxpNciHal_tx_desc_release(p_desc);
   return data_len;
 }
 
+/******************************************************************************
+ * Function         phNxpNciHal_tx_desc_alloc
+ *
+ * Description      This function takes a free TX descriptor from the pool and
+ *                  copies the outbound packet into it. Descriptors are handed
+ *                  out round robin, skipping the one TML may still
+ *                  retransmit.
+ *
+ * Returns          Pointer to the descriptor, NULL if the pool is exhausted.
+ *
+ ******************************************************************************/
+static phNxpNciHal_TxDesc_t* phNxpNciHal_tx_desc_alloc(uint16_t data_len,
+                                                      const uint8_t* p_data) {
+  phNxpNciHal_TxDesc_t* p_desc = NULL;
+  pthread_mutex_lock(&sTxDescLock);
+  for (int i = 0; i < NXP_TX_DESC_POOL_SIZE; i++) {
+    sTxDescNext = (sTxDescNext + 1) % NXP_TX_DESC_POOL_SIZE;
+    if (!sTxDescPool[sTxDescNext].in_use) {
+      p_desc = &sTxDescPool[sTxDescNext];
+      p_desc->in_use = TRUE;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&sTxDescLock);
+  if (p_desc != NULL) {
+    memcpy(p_desc->p_data, p_data, data_len);
+    p_desc->len = data_len;
+  }
+  return p_desc;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_tx_desc_release
+ *
+ * Description      This function returns a TX descriptor to the pool once it
+ *                  has been written. A descriptor which is still the buffer
+ *                  of TML is held instead, TML may retransmit it until it is
+ *                  given another buffer; the one held before is returned as
+ *                  soon as that happened. p_desc may be NULL.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_tx_desc_release(phNxpNciHal_TxDesc_t* p_desc) {
+  pthread_mutex_lock(&sTxDescLock);
+  if (sTxDescHeld != NULL && sTxDescHeld->p_data != sTmlTxBuf) {
+    sTxDescHeld->in_use = FALSE;
+    sTxDescHeld = NULL;
+  }
+  if (p_desc != NULL) {
+    if (p_desc->p_data == sTmlTxBuf) {
+      sTxDescHeld = p_desc;
+    } else {
+      p_desc->in_use = FALSE;
+    }
+  }
+  pthread_mutex_unlock(&sTxDescLock);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_tx_desc_owns
+ *
+ * Description      This function tells whether p_data is the buffer of a TX
+ *                  descriptor.
+ *
+ * Returns          true if p_data belongs to the pool.
+ *
+ ******************************************************************************/
+static bool phNxpNciHal_tx_desc_owns(const uint8_t* p_data) {
+  for (int i = 0; i < NXP_TX_DESC_POOL_SIZE; i++) {
+    if (p_data == sTxDescPool[i].p_data) return true;
+  }
+  return false;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_tx_desc_on_write
+ *
+ * Description      This function records the buffer TML has accepted to
+ *                  write, it stays referenced by TML until the next one.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_tx_desc_on_write(const uint8_t* p_data) {
+  pthread_mutex_lock(&sTxDescLock);
+  sTmlTxBuf = p_data;
+  pthread_mutex_unlock(&sTxDescLock);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_tx_desc_reset
+ *
+ * Description      This function returns the held TX descriptor to the pool,
+ *                  once TML is shut down.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_tx_desc_reset(void) {
+  pthread_mutex_lock(&sTxDescLock);
+  sTmlTxBuf = NULL;
+  if (sTxDescHeld != NULL) {
+    sTxDescHeld->in_use = FALSE;
+    sTxDescHeld = NULL;
+  }
+  pthread_mutex_unlock(&sTxDescLock);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_nfccHangRecovery
+ *
+ * Description      Resets the NFCC which no longer takes or answers commands
+ *                  and sends a CORE_RESET_NTF to libnfc-nci, which triggers
+ *                  its recovery. With NXP_EXTNS the process is aborted
+ *                  instead, to be restarted.
+ *
+ * Returns          true if libnfc-nci was told about the hang
+ *
+ ******************************************************************************/
+bool phNxpNciHal_nfccHangRecovery(void) {
+  static uint8_t reset_ntf[] = {0x60, 0x00, 0x06, 0xA0, 0x00,
+                                0xC7, 0xD4, 0x00, 0x00};
+  NFCSTATUS status;
+
+  status = phTmlNfc_IoCtl(phTmlNfc_e_ResetDevice);
+
+  if (NFCSTATUS_SUCCESS == status) {
+    NXPLOG_NCIHAL_D("PN54X Reset - SUCCESS\n");
+  } else {
+    NXPLOG_NCIHAL_D("PN54X Reset - FAILED\n");
+  }
+  if (nxpncihal_ctrl.p_nfc_stack_data_cback == NULL ||
+      nxpncihal_ctrl.hal_open_status != true) {
+    return false;
+  }
+  phNxpNciHal_livenessOnHang();
+  if (nxpncihal_ctrl.p_rx_data != NULL) {
+    NXPLOG_NCIHAL_D(
+        "Send the Core Reset NTF to upper layer, which will trigger the "
+        "recovery\n");
+    // Send the Core Reset NTF to upper layer, which will trigger the
+    // recovery.
+#if(NXP_EXTNS == TRUE)
+    abort();
+#endif
+    nxpncihal_ctrl.rx_data_len = sizeof(reset_ntf);
+    memcpy(nxpncihal_ctrl.p_rx_data, reset_ntf, sizeof(reset_ntf));
+    (*nxpncihal_ctrl.p_nfc_stack_data_cback)(nxpncihal_ctrl.rx_data_len,
+                                             nxpncihal_ctrl.p_rx_data);
+  } else {
+    (*nxpncihal_ctrl.p_nfc_stack_data_cback)(0x00, NULL);
+  }
+  return true;
+}
+
 /******************************************************************************
  * Function         phNxpNciHal_write_unlocked
  *
@@ -1131,8 +1337,7 @@ int phNxpNciHal_write_unlocked(uint16_t data_len, const uint8_t *p_data,
   phNxpNciHal_Sem_t cb_data;
   nxpncihal_ctrl.retry_cnt = 0;
   int sem_val = 0;
-  static uint8_t reset_ntf[] = {0x60, 0x00, 0x06, 0xA0, 0x00,
-                                0xC7, 0xD4, 0x00, 0x00};
+  const uint8_t* p_tx = p_data;
   /* Create the local semaphore */
   if (phNxpNciHal_init_cb_data(&cb_data, NULL) != NFCSTATUS_SUCCESS) {
     NXPLOG_NCIHAL_D("phNxpNciHal_write_unlocked Create cb data failed");
@@ -1140,13 +1345,22 @@ int phNxpNciHal_write_unlocked(uint16_t data_len, const uint8_t *p_data,
     goto clean_and_return;
   }
 
-  /* Create local copy of cmd_data */
-  memcpy(nxpncihal_ctrl.p_cmd_data, p_data, data_len);
+  /* The caller's buffer is sent in place, the write completes before
+   * return. A TX descriptor is held until TML no longer uses it; any other
+   * buffer TML may retransmit after return is copied first */
+  if (!phNxpNciHal_tx_desc_owns(p_data) && phTmlNfc_MayRetransmit(p_data) &&
+      p_data != nxpncihal_ctrl.p_cmd_data) {
+    memcpy(nxpncihal_ctrl.p_cmd_data, p_data, data_len);
+    p_tx = nxpncihal_ctrl.p_cmd_data;
+  }
+  /* Only the header is kept to match the response/notification */
   nxpncihal_ctrl.cmd_len = data_len;
+  memcpy(nxpncihal_ctrl.last_cmd_hdr, p_tx,
+         (data_len < NCI_HEADER_SIZE) ? data_len : NCI_HEADER_SIZE);
   write_unlocked_status = NFCSTATUS_FAILED;
   /* check for write synchronyztion */
   if(phNxpNciHal_check_ncicmd_write_window(nxpncihal_ctrl.cmd_len,
-                         nxpncihal_ctrl.p_cmd_data) != NFCSTATUS_SUCCESS) {
+                         p_tx) != NFCSTATUS_SUCCESS) {
     NXPLOG_NCIHAL_D("phNxpNciHal_write_unlocked  CMD window  check failed");
     data_len = 0;
     goto clean_and_return;
@@ -1158,9 +1372,10 @@ int phNxpNciHal_write_unlocked(uint16_t data_len, const uint8_t *p_data,
 retry:
 
   data_len = nxpncihal_ctrl.cmd_len;
+  phNxpNciHal_latencyOnTx(p_tx, data_len);
 
   status = phTmlNfc_Write(
-      (uint8_t*)nxpncihal_ctrl.p_cmd_data, (uint16_t)nxpncihal_ctrl.cmd_len,
+      p_tx, (uint16_t)nxpncihal_ctrl.cmd_len,
       (pphTmlNfc_TransactCompletionCb_t)&phNxpNciHal_write_complete,
       (void*)&cb_data);
   if (status != NFCSTATUS_PENDING) {
@@ -1168,9 +1383,10 @@ retry:
     data_len = 0;
     goto clean_and_return;
   }
+  phNxpNciHal_tx_desc_on_write(p_tx);
 
   /* Wait for callback response */
-  if (SEM_WAIT(cb_data)) {
+  if (phNxpNciHal_lockStatsSemWait(PH_NXP_LOCK_SITE_WRITE_CB, &cb_data.sem)) {
     NXPLOG_NCIHAL_E("write_unlocked semaphore error");
     data_len = 0;
     goto clean_and_return;
@@ -1190,31 +1406,7 @@ retry:
           "0x%x)",
           nxpncihal_ctrl.retry_cnt);
 
-      status = phTmlNfc_IoCtl(phTmlNfc_e_ResetDevice);
-
-      if (NFCSTATUS_SUCCESS == status) {
-        NXPLOG_NCIHAL_D("PN54X Reset - SUCCESS\n");
-      } else {
-        NXPLOG_NCIHAL_D("PN54X Reset - FAILED\n");
-      }
-      if (nxpncihal_ctrl.p_nfc_stack_data_cback != NULL &&
-          nxpncihal_ctrl.hal_open_status == true) {
-        if (nxpncihal_ctrl.p_rx_data != NULL) {
-          NXPLOG_NCIHAL_D(
-              "Send the Core Reset NTF to upper layer, which will trigger the "
-              "recovery\n");
-          // Send the Core Reset NTF to upper layer, which will trigger the
-          // recovery.
-#if(NXP_EXTNS == TRUE)
-          abort();
-#endif
-          nxpncihal_ctrl.rx_data_len = sizeof(reset_ntf);
-          memcpy(nxpncihal_ctrl.p_rx_data, reset_ntf, sizeof(reset_ntf));
-          (*nxpncihal_ctrl.p_nfc_stack_data_cback)(nxpncihal_ctrl.rx_data_len,
-                                                   nxpncihal_ctrl.p_rx_data);
-        } else {
-          (*nxpncihal_ctrl.p_nfc_stack_data_cback)(0x00, NULL);
-        }
+      if (phNxpNciHal_nfccHangRecovery()) {
         write_unlocked_status = NFCSTATUS_FAILED;
       }
     }
@@ -1225,7 +1417,7 @@ retry:
 clean_and_return:
     if(write_unlocked_status == NFCSTATUS_FAILED) {
       sem_getvalue(&(nxpncihal_ctrl.syncSpiNfc), &sem_val);
-      if(((nxpncihal_ctrl.p_cmd_data[0] & NCI_MT_MASK) == NCI_MT_CMD)  && sem_val == 0 ) {
+      if(((nxpncihal_ctrl.last_cmd_hdr[0] & NCI_MT_MASK) == NCI_MT_CMD)  && sem_val == 0 ) {
         sem_post(&(nxpncihal_ctrl.syncSpiNfc));
         NXPLOG_NCIHAL_D(
               "HAL write  failed CMD window check releasing \n");
@@ -1283,6 +1475,8 @@ static void phNxpNciHal_read_complete(void* pContext,
   }
   if (pInfo->wStatus == NFCSTATUS_SUCCESS) {
     NXPLOG_NCIHAL_D("read successful status = 0x%x", pInfo->wStatus);
+    phNxpNciHal_latencyOnRx(pInfo->pBuff, pInfo->wLength, pInfo->qwRxTimeUs);
+    phNxpNciHal_livenessOnRx(pInfo->qwRxTimeUs);
 
     /*Check the Omapi command response and store in dedicated buffer to solve sync issue*/
     if(pInfo->pBuff[0] == 0x4F && pInfo->pBuff[1] == 0x01 && pInfo->pBuff[2] == 0x01) {
@@ -1319,9 +1513,9 @@ static void phNxpNciHal_read_complete(void* pContext,
     else if ((nxpncihal_ctrl.hal_ext_enabled == TRUE) &&
              ((nxpncihal_ctrl.p_rx_data[0x00] & NCI_MT_MASK) == NCI_MT_NTF) &&
 #if (NXP_EXTNS == TRUE)
-             ((nxpncihal_ctrl.p_cmd_data[0x00] & NCI_GID_MASK) ==
+             ((nxpncihal_ctrl.last_cmd_hdr[0x00] & NCI_GID_MASK) ==
                      (nxpncihal_ctrl.p_rx_data[0x00] & NCI_GID_MASK)) &&
-             ((nxpncihal_ctrl.p_cmd_data[0x01] & NCI_OID_MASK) ==
+             ((nxpncihal_ctrl.last_cmd_hdr[0x01] & NCI_OID_MASK) ==
                      (nxpncihal_ctrl.p_rx_data[0x01] & NCI_OID_MASK)) &&
 #endif
              (nxpncihal_ctrl.nci_info.wait_for_ntf == TRUE)) {
@@ -1340,6 +1534,8 @@ static void phNxpNciHal_read_complete(void* pContext,
     else if ((nxpncihal_ctrl.p_nfc_stack_data_cback != NULL) &&
              (status == NFCSTATUS_SUCCESS)) {
       NxpMfcReaderInstance.MfcNotifyOnAckReceived(nxpncihal_ctrl.p_rx_data);
+      phNxpNciHal_latencyOnNtfDelivered(nxpncihal_ctrl.p_rx_data,
+                                        pInfo->qwRxTimeUs);
       (*nxpncihal_ctrl.p_nfc_stack_data_cback)(nxpncihal_ctrl.rx_data_len,
                                                nxpncihal_ctrl.p_rx_data);
       //workaround for sync issue between SPI and NFC
@@ -1370,9 +1566,9 @@ static void phNxpNciHal_read_complete(void* pContext,
 
   if (nxpncihal_ctrl.halStatus == HAL_STATUS_CLOSE &&
 #if (NXP_EXTNS == TRUE)
-  (nxpncihal_ctrl.p_cmd_data[0x00] & NCI_GID_MASK) ==
+  (nxpncihal_ctrl.last_cmd_hdr[0x00] & NCI_GID_MASK) ==
           (nxpncihal_ctrl.p_rx_data[0x00] & NCI_GID_MASK) &&
-  (nxpncihal_ctrl.p_cmd_data[0x01] & NCI_OID_MASK) ==
+  (nxpncihal_ctrl.last_cmd_hdr[0x01] & NCI_OID_MASK) ==
           (nxpncihal_ctrl.p_rx_data[0x01] & NCI_OID_MASK) &&
 #endif
   nxpncihal_ctrl.nci_info.wait_for_ntf == FALSE) {
@@ -1452,6 +1648,9 @@ int phNxpNciHal_core_initialized(uint16_t core_init_rsp_params_len, uint8_t* p_c
   uint8_t swp_full_pwr_mode_on_cmd[] = {0x20, 0x02, 0x05, 0x01,
                                         0xA0, 0xF1, 0x01, 0x01};
   uint8_t enable_ce_in_phone_off = 0x01;
+
+  phTmlNfc_TraceEvent(PH_TMLNFC_TRACE_EVT_CORE_INITIALIZED,
+                      p_core_init_rsp_params, core_init_rsp_params_len);
   uint8_t enable_ven_cfg = 0x01;
 
   static uint8_t android_l_aid_matching_mode_on_cmd[] = {
@@ -1463,6 +1662,7 @@ int phNxpNciHal_core_initialized(uint16_t core_init_rsp_params_len, uint8_t* p_c
   long bufflen = 260;
   long retlen = 0;
   phNxpNci_EEPROM_info_t mEEPROM_info = {.request_mode = 0};
+  phNxpNci_EEPROM_txn_t eeprom_txn;
 #if (NFC_NXP_HFO_SETTINGS == TRUE)
   /* Temp fix to re-apply the proper clock setting */
   int temp_fix = 1;
@@ -1575,26 +1775,32 @@ int phNxpNciHal_core_initialized(uint16_t core_init_rsp_params_len, uint8_t* p_c
     }
   }
 
-  status = phNxpNciHal_setAutonomousMode();
-  if (status != NFCSTATUS_SUCCESS) {
-    NXPLOG_NCIHAL_E("Set Autonomous enable: Failed");
-    retry_core_init_cnt++;
-    goto retry_core_init;
-  }
+  /* Update the EEPROM fields below in one transaction */
+  phNxpNciHal_eeprom_txn_init(&eeprom_txn);
+  phNxpNciHal_setAutonomousMode(&eeprom_txn);
 
   mEEPROM_info.buffer = &enable_ven_cfg;
   mEEPROM_info.bufflen = sizeof(enable_ven_cfg);
   mEEPROM_info.request_type = EEPROM_ENABLE_VEN_CFG;
   mEEPROM_info.request_mode = SET_EEPROM_DATA;
-  request_EEPROM(&mEEPROM_info);
+  phNxpNciHal_eeprom_txn_add(&eeprom_txn, &mEEPROM_info);
 
   mEEPROM_info.buffer = &enable_ce_in_phone_off;
   mEEPROM_info.bufflen = sizeof(enable_ce_in_phone_off);
   mEEPROM_info.request_type = EEPROM_CE_PHONE_OFF_CFG;
   mEEPROM_info.request_mode = SET_EEPROM_DATA;
-  request_EEPROM(&mEEPROM_info);
+  phNxpNciHal_eeprom_txn_add(&eeprom_txn, &mEEPROM_info);
 
+  phNxpNciHal_eeprom_txn_commit(&eeprom_txn);
   config_access = false;
+
+  if (phNxpNciHal_eeprom_txn_status(&eeprom_txn, EEPROM_AUTONOMOUS_MODE) !=
+      NFCSTATUS_SUCCESS) {
+    NXPLOG_NCIHAL_E("Set Autonomous enable: Failed");
+    retry_core_init_cnt++;
+    goto retry_core_init;
+  }
+  /* read outside config_access, its failure is no config file error */
   status = phNxpNciHal_read_fw_dw_status(fw_dwnld_flag);
   if (status != NFCSTATUS_SUCCESS) {
     NXPLOG_NCIHAL_E("%s: NXP get FW DW Flag failed", __FUNCTION__);
@@ -1754,16 +1960,13 @@ int phNxpNciHal_core_initialized(uint16_t core_init_rsp_params_len, uint8_t* p_c
       if(retlen > 0)
         phNxpNciHal_enableDefaultUICC2SWPline((uint8_t)retlen);
     }
+    /* Read and update the EEPROM fields below in one transaction */
+    phNxpNciHal_eeprom_txn_init(&eeprom_txn);
     if (nfcFL.chipType != pn557) {
-      status = phNxpNciHal_setGuardTimer();
-      if (status != NFCSTATUS_SUCCESS) {
-        NXPLOG_NCIHAL_E("phNxpNciHal_setGuardTimer failed");
-        retry_core_init_cnt++;
-        goto retry_core_init;
-      }
+      phNxpNciHal_setGuardTimer(&eeprom_txn);
     }
 #if(NXP_EXTNS == TRUE && NXP_SRD == TRUE)
-    status = phNxpNciHal_setSrdtimeout();
+    status = phNxpNciHal_setSrdtimeout(&eeprom_txn);
     if (status != NFCSTATUS_SUCCESS &&
         status != NFCSTATUS_FEATURE_NOT_SUPPORTED) {
       NXPLOG_NCIHAL_E("phNxpNciHal_setSrdtimeout failed");
@@ -1787,8 +1990,26 @@ int phNxpNciHal_core_initialized(uint16_t core_init_rsp_params_len, uint8_t* p_c
     mEEPROM_info.bufflen = sizeof(cmd_t4t_nfcee_cfg);
     mEEPROM_info.request_type = EEPROM_T4T_NFCEE_ENABLE;
     mEEPROM_info.request_mode = SET_EEPROM_DATA;
-    request_EEPROM(&mEEPROM_info);
-    if (phNxpNciHal_configure_merge_sak() != NFCSTATUS_SUCCESS) {
+    phNxpNciHal_eeprom_txn_add(&eeprom_txn, &mEEPROM_info);
+    phNxpNciHal_configure_merge_sak(&eeprom_txn);
+    phNxpNciHal_eeprom_txn_commit(&eeprom_txn);
+
+    if (phNxpNciHal_eeprom_txn_status(&eeprom_txn, EEPROM_GUARD_TIMER) !=
+        NFCSTATUS_SUCCESS) {
+      NXPLOG_NCIHAL_E("phNxpNciHal_setGuardTimer failed");
+      retry_core_init_cnt++;
+      goto retry_core_init;
+    }
+#if(NXP_EXTNS == TRUE && NXP_SRD == TRUE)
+    if (phNxpNciHal_eeprom_txn_status(&eeprom_txn, EEPROM_SRD_TIMEOUT) !=
+        NFCSTATUS_SUCCESS) {
+      NXPLOG_NCIHAL_E("phNxpNciHal_setSrdtimeout failed");
+      retry_core_init_cnt++;
+      goto retry_core_init;
+    }
+#endif
+    if (phNxpNciHal_eeprom_txn_status(&eeprom_txn, EEPROM_ISODEP_MERGE_SAK) !=
+        NFCSTATUS_SUCCESS) {
       NXPLOG_NCIHAL_E("Applying iso_dep sak merge settings failed");
     }
   }
@@ -2205,6 +2426,7 @@ static void phNxpNciHal_core_initialized_complete(NFCSTATUS status) {
  *
  ******************************************************************************/
 int phNxpNciHal_pre_discover(void) {
+  phTmlNfc_TraceEvent(PH_TMLNFC_TRACE_EVT_PRE_DISCOVER, NULL, 0);
   /* Nothing to do here for initial version */
   return NFCSTATUS_SUCCESS;
 }
@@ -2224,6 +2446,33 @@ static void phNxpNciHal_release_info(void) {
     mGetCfg_info = NULL;
   }
 }
+/******************************************************************************
+ * Function         phNxpNciHal_msgqStatsLog
+ *
+ * Description      Logs the statistics of the lanes of the client thread
+ *                  queue.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpNciHal_msgqStatsLog(intptr_t msqid) {
+  static const char* laneName[PH_DAL4NFC_MSGQ_LANE_MAX] = {"high", "low"};
+  phDal4Nfc_MsgQStats_t stats;
+
+  if (phDal4Nfc_msgstats(msqid, &stats) != 0) return;
+  for (int i = 0; i < PH_DAL4NFC_MSGQ_LANE_MAX; i++) {
+    const phDal4Nfc_MsgQLaneStats_t* pLane = &stats.tLane[i];
+    NXPLOG_NCIHAL_D(
+        "msgq %s: %u msgs, max depth %u, wait avg %llu us max %llu us, "
+        "aged %u",
+        laneName[i], pLane->dwCount, pLane->dwMaxDepth,
+        (unsigned long long)(pLane->dwCount
+                                 ? pLane->qwWaitTotalNs / pLane->dwCount / 1000
+                                 : 0),
+        (unsigned long long)(pLane->qwWaitMaxNs / 1000), pLane->dwAged);
+  }
+}
+
 /******************************************************************************
  * Function         phNxpNciHal_close
  *
@@ -2247,8 +2496,10 @@ int phNxpNciHal_close(bool bShutdown) {
   unsigned long uiccListenMask = 0x00;
   unsigned long eseListenMask = 0x00;
   uint8_t retry = 0;
+  uint8_t shutdown_flag = (uint8_t)bShutdown;
 
-
+  phTmlNfc_TraceEvent(PH_TMLNFC_TRACE_EVT_CLOSE, &shutdown_flag,
+                      sizeof(shutdown_flag));
   phNxpNciHal_deinitializeRegRfFwDnld();
   AutoThreadMutex a(sHalFnLock);
   if (nxpncihal_ctrl.halStatus == HAL_STATUS_CLOSE) {
@@ -2273,6 +2524,10 @@ int phNxpNciHal_close(bool bShutdown) {
   }
 #endif
 
+  /* no probe may run into the commands below */
+  phNxpNciHal_livenessStop();
+  /* queued commands are dropped, the ones below are sent synchronously */
+  phNxpNciHal_extCmdAsyncStop();
 
   CONCURRENCY_LOCK();
   int sem_val;
@@ -2385,7 +2640,9 @@ int phNxpNciHal_close(bool bShutdown) {
     }
 
     phTmlNfc_CleanUp();
+    phNxpNciHal_tx_desc_reset();
 
+    phNxpNciHal_msgqStatsLog(nxpncihal_ctrl.gDrvCfg.nClientId);
     phDal4Nfc_msgrelease(nxpncihal_ctrl.gDrvCfg.nClientId);
 
     memset(&nxpncihal_ctrl, 0x00, sizeof(nxpncihal_ctrl));
@@ -2398,8 +2655,14 @@ int phNxpNciHal_close(bool bShutdown) {
   phNxpNciHal_cleanup_monitor();
   write_unlocked_status = NFCSTATUS_SUCCESS;
   phNxpNciHal_release_info();
+  phNxpNciHal_configReloadStop();
   /* reset config cache */
   resetNxpConfig();
+  phNxpNciHal_lockStatsLog();
+  phNxpNciHal_latencyStatsLog();
+  phNxpNciHal_livenessStatsLog();
+  phTmlNfc_TraceClose();
+  phNxpLog_AsyncFlush();
   /* Return success always */
   return NFCSTATUS_SUCCESS;
 }
@@ -2516,69 +2779,12 @@ int phNxpNciHal_configDiscShutdown(void) {
  ******************************************************************************/
 
 void phNxpNciHal_getVendorConfig(android::hardware::nfc::V1_1::NfcConfig& config) {
-  unsigned long num = 0;
-  std::array<uint8_t, NXP_MAX_CONFIG_STRING_LEN> buffer;
-  buffer.fill(0);
-  long retlen = 0;
-  memset(&config, 0x00, sizeof(android::hardware::nfc::V1_1::NfcConfig));
-  memset(&config_ext, 0x00, sizeof(nxp_nfc_config_ext_t));
+  phNxpNciHal_ConfigSnapshotRef_t pSnap = phNxpNciHal_configSnapshot();
 
-  if ((GetNxpNumValue(NAME_NXP_AUTONOMOUS_ENABLE, &num, sizeof(num)))) {
-    config_ext.autonomous_mode = (uint8_t)num;
-  }
-  if ((GetNxpNumValue(NAME_NXP_GUARD_TIMER_VALUE, &num, sizeof(num)))) {
-    config_ext.guard_timer_value = (uint8_t)num;
-  }
-  if (GetNxpNumValue(NAME_NFA_POLL_BAIL_OUT_MODE, &num, sizeof(num))) {
-    config.nfaPollBailOutMode = (bool)num;
-  }
-  if (GetNxpNumValue(NAME_ISO_DEP_MAX_TRANSCEIVE, &num, sizeof(num))) {
-    config.maxIsoDepTransceiveLength = (uint32_t)num;
-  }
-  if (GetNxpNumValue(NAME_DEFAULT_OFFHOST_ROUTE, &num, sizeof(num))) {
-    config.defaultOffHostRoute = (uint8_t)num;
-  }
-  if (GetNxpNumValue(NAME_DEFAULT_NFCF_ROUTE, &num, sizeof(num))) {
-    config.defaultOffHostRouteFelica = (uint8_t)num;
-  }
-  if (GetNxpNumValue(NAME_DEFAULT_SYS_CODE_ROUTE, &num, sizeof(num))) {
-    config.defaultSystemCodeRoute = (uint8_t)num;
-  }
-  if (GetNxpNumValue(NAME_DEFAULT_SYS_CODE_PWR_STATE, &num, sizeof(num))) {
-    config.defaultSystemCodePowerState =
-        phNxpNciHal_updateAutonomousPwrState((uint8_t)num);
-  }
-  if (GetNxpNumValue(NAME_DEFAULT_ROUTE, &num, sizeof(num))) {
-    config.defaultRoute = (uint8_t)num;
-  }
-  if (GetNxpByteArrayValue(NAME_DEVICE_HOST_WHITE_LIST, (char*)buffer.data(), buffer.size(), &retlen)) {
-    config.hostWhitelist.resize(retlen);
-    for (long i = 0; i < retlen; i++)
-      config.hostWhitelist[i] = buffer[i];
-  }
-  if (GetNxpNumValue(NAME_OFF_HOST_ESE_PIPE_ID, &num, sizeof(num))) {
-    config.offHostESEPipeId = (uint8_t)num;
-  }
-  if (GetNxpNumValue(NAME_OFF_HOST_SIM_PIPE_ID, &num, sizeof(num))) {
-    config.offHostSIMPipeId = (uint8_t)num;
-  }
-  if ((GetNxpByteArrayValue(NAME_NFA_PROPRIETARY_CFG, (char*)buffer.data(), buffer.size(), &retlen))
-         && (retlen == 9)) {
-    config.nfaProprietaryCfg.protocol18092Active = (uint8_t) buffer[0];
-    config.nfaProprietaryCfg.protocolBPrime = (uint8_t) buffer[1];
-    config.nfaProprietaryCfg.protocolDual = (uint8_t) buffer[2];
-    config.nfaProprietaryCfg.protocol15693 = (uint8_t) buffer[3];
-    config.nfaProprietaryCfg.protocolKovio = (uint8_t) buffer[4];
-    config.nfaProprietaryCfg.protocolMifare = (uint8_t) buffer[5];
-    config.nfaProprietaryCfg.discoveryPollKovio = (uint8_t) buffer[6];
-    config.nfaProprietaryCfg.discoveryPollBPrime = (uint8_t) buffer[7];
-    config.nfaProprietaryCfg.discoveryListenBPrime = (uint8_t) buffer[8];
-  } else {
-    memset(&config.nfaProprietaryCfg, 0xFF, sizeof(ProtocolDiscoveryConfig));
-  }
-  if ((GetNxpNumValue(NAME_PRESENCE_CHECK_ALGORITHM, &num, sizeof(num))) && (num <= 2) ) {
-      config.presenceCheckAlgorithm = (PresenceCheckAlgorithm)num;
-  }
+  config_ext = pSnap->tConfigExt;
+  config = pSnap->tVendorConfig.v1_1;
+  config.defaultSystemCodePowerState = phNxpNciHal_updateAutonomousPwrState(
+      config.defaultSystemCodePowerState);
 }
 
 
@@ -2593,29 +2799,12 @@ void phNxpNciHal_getVendorConfig(android::hardware::nfc::V1_1::NfcConfig& config
  ******************************************************************************/
 
 void phNxpNciHal_getVendorConfig_1_2(android::hardware::nfc::V1_2::NfcConfig& config) {
-  unsigned long num = 0;
-  std::array<uint8_t, NXP_MAX_CONFIG_STRING_LEN> buffer;
-  buffer.fill(0);
-  long retlen = 0;
-  memset(&config, 0x00, sizeof(android::hardware::nfc::V1_2::NfcConfig));
-  phNxpNciHal_getVendorConfig(config.v1_1);
-
-  if (GetNxpByteArrayValue(NAME_OFFHOST_ROUTE_UICC, (char*)buffer.data(), buffer.size(), &retlen)) {
-    config.offHostRouteUicc.resize(retlen);
-    for(long i=0; i<retlen; i++)
-      config.offHostRouteUicc[i] = buffer[i];
-  }
-
-  if (GetNxpByteArrayValue(NAME_OFFHOST_ROUTE_ESE, (char*)buffer.data(), buffer.size(), &retlen)) {
-    config.offHostRouteEse.resize(retlen);
-    for(long i=0; i<retlen; i++)
-      config.offHostRouteEse[i] = buffer[i];
-  }
-
-  if (GetNxpNumValue(NAME_DEFAULT_ISODEP_ROUTE, &num, sizeof(num))) {
-      config.defaultIsoDepRoute = num;
-  }
+  phNxpNciHal_ConfigSnapshotRef_t pSnap = phNxpNciHal_configSnapshot();
 
+  config.offHostRouteUicc = pSnap->tVendorConfig.offHostRouteUicc;
+  config.offHostRouteEse = pSnap->tVendorConfig.offHostRouteEse;
+  config.defaultIsoDepRoute = pSnap->tVendorConfig.defaultIsoDepRoute;
+  phNxpNciHal_getVendorConfig(config.v1_1);
 }
 
 /******************************************************************************
@@ -2709,6 +2898,7 @@ void phNxpNciHal_release_control(void) {
  ******************************************************************************/
 int phNxpNciHal_power_cycle(void) {
   NXPLOG_NCIHAL_D("Power Cycle");
+  phTmlNfc_TraceEvent(PH_TMLNFC_TRACE_EVT_POWER_CYCLE, NULL, 0);
   NFCSTATUS status = NFCSTATUS_FAILED;
   if (nxpncihal_ctrl.halStatus != HAL_STATUS_OPEN) {
     NXPLOG_NCIHAL_D("Power Cycle failed due to hal status not open");
@@ -2761,7 +2951,8 @@ static void phNxpNciHal_power_cycle_complete(NFCSTATUS status) {
  *
  ******************************************************************************/
 
-int phNxpNciHal_check_ncicmd_write_window(uint16_t cmd_len, uint8_t* p_cmd) {
+int phNxpNciHal_check_ncicmd_write_window(uint16_t cmd_len,
+                                          const uint8_t* p_cmd) {
   UNUSED_PROP(cmd_len);
   NFCSTATUS status = NFCSTATUS_FAILED;
   int sem_timedout = 2, s;
@@ -2769,10 +2960,8 @@ int phNxpNciHal_check_ncicmd_write_window(uint16_t cmd_len, uint8_t* p_cmd) {
   if ((p_cmd[0] & 0xF0) == 0x20) {
     clock_gettime(CLOCK_REALTIME, &ts);
     ts.tv_sec += sem_timedout;
-    while ((s = sem_timedwait(&nxpncihal_ctrl.syncSpiNfc, &ts)) == -1 &&
-           errno == EINTR){
-      continue; /* Restart if interrupted by handler */
-    }
+    s = phNxpNciHal_lockStatsSemTimedWait(PH_NXP_LOCK_SITE_WRITE_WINDOW,
+                                          &nxpncihal_ctrl.syncSpiNfc, &ts);
     if (s != -1) {
       status = NFCSTATUS_SUCCESS;
     }
@@ -4032,9 +4221,7 @@ static void phNxpNciHal_initialize_mifare_flag() {
   bDisableLegacyMfcExtns = true;
   //1: Enable Mifare Classic protocol in RF Discovery.
   //0: Remove Mifare Classic protocol in RF Discovery.
-  if(GetNxpNumValue(NAME_MIFARE_READER_ENABLE, &num, sizeof(num))) {
-    bEnableMfcReader = (num == 0) ? false : true;
-  }
+  bEnableMfcReader = (phNxpNciHal_configSnapshot()->dwMifareReaderEnable != 0);
   //1: Use legacy JNI MFC extns.
   //0: Disable legacy JNI MFC extns, use hal MFC Extns instead.
   if(GetNxpNumValue(NAME_LEGACY_MIFARE_READER, &num, sizeof(num))) {
@@ -4042,6 +4229,102 @@ static void phNxpNciHal_initialize_mifare_flag() {
   }
 }
 
+/*****************************************************************************
+ * Function         phNxpNciHal_get_cfg_dest
+ *
+ * Description      Gives where the value of a parameter of get_cfg_arr is
+ *                  stored in mGetCfg_info.
+ *
+ * Returns          Value buffer, NULL if the parameter is not stored.
+ *                  p_len and p_max_len are set to its length field and size.
+ *
+ *****************************************************************************/
+static uint8_t* phNxpNciHal_get_cfg_dest(uint8_t param_id, uint8_t** p_len,
+                                         uint8_t* p_max_len) {
+  switch (param_id) {
+    case TOTAL_DURATION:
+      *p_len = &mGetCfg_info->total_duration_len;
+      *p_max_len = sizeof(mGetCfg_info->total_duration);
+      return mGetCfg_info->total_duration;
+    case ATR_REQ_GEN_BYTES_POLL:
+      *p_len = &mGetCfg_info->atr_req_gen_bytes_len;
+      *p_max_len = sizeof(mGetCfg_info->atr_req_gen_bytes);
+      return mGetCfg_info->atr_req_gen_bytes;
+    case ATR_REQ_GEN_BYTES_LIS:
+      *p_len = &mGetCfg_info->atr_res_gen_bytes_len;
+      *p_max_len = sizeof(mGetCfg_info->atr_res_gen_bytes);
+      return mGetCfg_info->atr_res_gen_bytes;
+    case LEN_WT:
+      *p_len = &mGetCfg_info->pmid_wt_len;
+      *p_max_len = sizeof(mGetCfg_info->pmid_wt);
+      return mGetCfg_info->pmid_wt;
+    default:
+      return NULL;
+  }
+}
+
+/*****************************************************************************
+ * Function         phNxpNciHal_store_get_cfg_rsp
+ *
+ * Description      Demultiplexes the parameters of a CORE_GET_CONFIG_RSP
+ *                  into mGetCfg_info. With STATUS_OK, a parameter returned
+ *                  with an empty value is not supported by the NFCC. With
+ *                  STATUS_INVALID_PARAM, the response only lists the
+ *                  parameters not supported. Nothing is taken from a response
+ *                  of another status.
+ *
+ * Returns          Mask of the get_cfg_arr entries received, with their value
+ *                  or as not supported. p_unsupported is set to the mask of
+ *                  the ones not supported.
+ *
+ *****************************************************************************/
+static uint32_t phNxpNciHal_store_get_cfg_rsp(uint8_t* p_rsp, uint16_t rsp_len,
+                                              uint32_t* p_unsupported) {
+  uint32_t received = 0;
+  uint8_t num_cfgs = sizeof(get_cfg_arr) / sizeof(uint8_t);
+  uint8_t *p_val, *p_val_len;
+  uint8_t max_len;
+  uint8_t rsp_status;
+  uint16_t idx;
+
+  *p_unsupported = 0;
+  if (rsp_len < 5 || p_rsp[0] != 0x40 || p_rsp[1] != 0x03) {
+    return 0;
+  }
+  rsp_status = p_rsp[3];
+  if (rsp_status != GET_CFG_STATUS_OK &&
+      rsp_status != GET_CFG_STATUS_INVALID_PARAM) {
+    NXPLOG_NCIHAL_E("%s: status 0x%02x", __func__, rsp_status);
+    return 0;
+  }
+  if (rsp_len > p_rsp[2] + NCI_HEADER_SIZE) {
+    rsp_len = p_rsp[2] + NCI_HEADER_SIZE;
+  }
+  /* 40 03 len status num_params {id len value}... */
+  idx = 5;
+  for (uint8_t param = 0; param < p_rsp[4] && idx + 2 <= rsp_len; param++) {
+    uint8_t param_id = p_rsp[idx];
+    uint8_t param_len = p_rsp[idx + 1];
+    idx += 2;
+    if (idx + param_len > rsp_len) break;
+    for (uint8_t cfg = 0; cfg < num_cfgs; cfg++) {
+      if (get_cfg_arr[cfg] != param_id) continue;
+      received |= (1U << cfg);
+      if (rsp_status == GET_CFG_STATUS_INVALID_PARAM || param_len == 0) {
+        *p_unsupported |= (1U << cfg);
+        continue;
+      }
+      p_val = phNxpNciHal_get_cfg_dest(param_id, &p_val_len, &max_len);
+      if (p_val != NULL) {
+        *p_val_len = (param_len < max_len) ? param_len : max_len;
+        memcpy(p_val, &p_rsp[idx], *p_val_len);
+      }
+    }
+    idx += param_len;
+  }
+  return received;
+}
+
 /*****************************************************************************
  * Function         phNxpNciHal_send_get_cfgs
  *
@@ -4050,41 +4333,91 @@ static void phNxpNciHal_initialize_mifare_flag() {
  *                  Response of getConfigs(EEPROM stored) will be
  *                  compared with request coming from MW during discovery.
  *                  If same, then current setConfigs will be dropped
+ *                  Parameters are packed in a single CORE_GET_CONFIG_CMD as
+ *                  long as the command and the expected response fit in the
+ *                  NFCC max control packet payload.
+ *                  A parameter the NFCC does not support is skipped, one
+ *                  which still fails after GET_CFG_MAX_RETRY is given up;
+ *                  the others are read anyway.
  *
- * Returns          Returns NFCSTATUS_SUCCESS if sending cmd is successful and
- *                  response is received.
+ * Returns          Returns NFCSTATUS_SUCCESS if every parameter was read or
+ *                  is not supported, NFCSTATUS_FAILED otherwise.
  *
  *****************************************************************************/
 NFCSTATUS phNxpNciHal_send_get_cfgs() {
   NXPLOG_NCIHAL_D("%s Enter", __func__);
   NFCSTATUS status = NFCSTATUS_FAILED;
   uint8_t num_cfgs = sizeof(get_cfg_arr) / sizeof(uint8_t);
-  uint8_t cfg_count = 0, retry_cnt = 0;
-  if (mGetCfg_info != NULL) {
-      mGetCfg_info->isGetcfg = true;
-  }
-  uint8_t cmd_get_cfg[] = {0x20, 0x03, 0x02, 0x01, 0x00};
+  uint8_t retry_cnt[sizeof(get_cfg_arr)] = {0};
+  uint32_t pending = (1U << num_cfgs) - 1;
+  uint32_t batch, received, unsupported;
+  bool failed = false;
+  uint16_t max_payload, rsp_payload;
+  uint8_t cmd_get_cfg[NCI_HEADER_SIZE + 1 + sizeof(get_cfg_arr)];
+  uint8_t *p_val_len, max_len;
 
-  while (cfg_count < num_cfgs) {
-    cmd_get_cfg[sizeof(cmd_get_cfg) - 1] = get_cfg_arr[cfg_count];
-
-  retry_get_cfg:
-    status = phNxpNciHal_send_ext_cmd(sizeof(cmd_get_cfg), cmd_get_cfg);
-    if (status != NFCSTATUS_SUCCESS && retry_cnt < 3) {
-      NXPLOG_NCIHAL_E("cmd_get_cfg failed");
-      retry_cnt++;
-      goto retry_get_cfg;
-    }
-    if (retry_cnt == 3) {
-      break;
-    }
-    cfg_count++;
-    retry_cnt = 0;
+  if (mGetCfg_info == NULL) {
+    return NFCSTATUS_FAILED;
   }
-  if (mGetCfg_info != NULL) {
-    mGetCfg_info->isGetcfg = false;
+  mGetCfg_info->isGetcfg = true;
+  max_payload = nxpncihal_ctrl.nci_info.max_ctrl_payload;
+  if (max_payload < NCI_MIN_CTRL_PAYLOAD) {
+    max_payload = NCI_MIN_CTRL_PAYLOAD;
+  }
+
+  while (pending != 0) {
+    /* A parameter which failed before is read alone */
+    batch = 0;
+    cmd_get_cfg[0] = 0x20;
+    cmd_get_cfg[1] = 0x03;
+    cmd_get_cfg[3] = 0;
+    rsp_payload = 2;
+    for (uint8_t cfg = 0; cfg < num_cfgs; cfg++) {
+      if (!(pending & (1U << cfg))) continue;
+      if (batch != 0 && retry_cnt[cfg] != 0) continue;
+      if (phNxpNciHal_get_cfg_dest(get_cfg_arr[cfg], &p_val_len, &max_len) ==
+          NULL) {
+        max_len = 0xFF;
+      }
+      if (batch != 0 && (cmd_get_cfg[3] + 2 > max_payload ||
+                         rsp_payload + 2 + max_len > max_payload)) {
+        continue;
+      }
+      cmd_get_cfg[NCI_HEADER_SIZE + 1 + cmd_get_cfg[3]++] = get_cfg_arr[cfg];
+      rsp_payload += 2 + max_len;
+      batch |= (1U << cfg);
+      if (retry_cnt[cfg] != 0) break;
+    }
+    cmd_get_cfg[2] = cmd_get_cfg[3] + 1;
+
+    status = phNxpNciHal_send_ext_cmd(NCI_HEADER_SIZE + cmd_get_cfg[2],
+                                      cmd_get_cfg);
+    unsupported = 0;
+    received = (status == NFCSTATUS_SUCCESS)
+                   ? phNxpNciHal_store_get_cfg_rsp(nxpncihal_ctrl.p_rx_data,
+                                                   nxpncihal_ctrl.rx_data_len,
+                                                   &unsupported)
+                   : 0;
+    unsupported &= batch;
+    pending &= ~(batch & received);
+    for (uint8_t cfg = 0; cfg < num_cfgs; cfg++) {
+      if (unsupported & (1U << cfg)) {
+        NXPLOG_NCIHAL_D("cmd_get_cfg 0x%02x not supported, skipped",
+                        get_cfg_arr[cfg]);
+        continue;
+      }
+      /* the other parameters are left out of an INVALID_PARAM response */
+      if (!(batch & ~received & (1U << cfg)) || unsupported != 0) continue;
+      NXPLOG_NCIHAL_E("cmd_get_cfg failed for 0x%02x", get_cfg_arr[cfg]);
+      if (++retry_cnt[cfg] > GET_CFG_MAX_RETRY) {
+        pending &= ~(1U << cfg);
+        failed = true;
+      }
+    }
   }
-  return status;
+
+  mGetCfg_info->isGetcfg = false;
+  return failed ? NFCSTATUS_FAILED : NFCSTATUS_SUCCESS;
 }
 
 /*******************************************************************************
@@ -4105,6 +4438,7 @@ void phNxpNciHal_configFeatureList(uint8_t* init_rsp, uint16_t rsp_len) {
     tNFC_chipType chipType = nxpncihal_ctrl.chipType;
     NXPLOG_NCIHAL_D("phNxpNciHal_configFeatureList ()chipType = %d", chipType);
     CONFIGURE_FEATURELIST(chipType);
+    phNxpNciHal_ext_register_handlers();
 }
 
 /*******************************************************************************
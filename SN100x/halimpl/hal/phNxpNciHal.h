@@ -102,6 +102,16 @@ typedef struct nci_data {
   uint8_t p_data[NCI_MAX_DATA_LEN];
 } nci_data_t;
 
+/* Pool of TX descriptors used to stage libnfc-nci packets which a HAL
+ * extension may rewrite; all other packets are written from the caller's
+ * buffer */
+#define NXP_TX_DESC_POOL_SIZE 4
+typedef struct phNxpNciHal_TxDesc {
+  bool_t in_use;
+  uint16_t len;
+  uint8_t p_data[NCI_MAX_DATA_LEN];
+} phNxpNciHal_TxDesc_t;
+
 typedef enum {
   HAL_STATUS_CLOSE = 0,
   HAL_STATUS_OPEN,
@@ -138,6 +148,7 @@ typedef struct phNxpNciInfo {
   uint8_t   nci_version;
   bool_t    wait_for_ntf;
   uint8_t   lastResetNtfReason;
+  uint8_t   max_ctrl_payload; /* from CORE_INIT_RSP, 0 if not known */
 }phNxpNciInfo_t;
 /* NCI Control structure */
 typedef struct phNxpNciHal_Control {
@@ -173,6 +184,8 @@ typedef struct phNxpNciHal_Control {
 
   uint16_t cmd_len;
   uint8_t p_cmd_data[NCI_MAX_DATA_LEN];
+  /* Header of the last packet handed to TML, used to match its NTF */
+  uint8_t last_cmd_hdr[NCI_HEADER_SIZE];
   uint16_t rsp_len;
   uint8_t p_rsp_data[NCI_MAX_DATA_LEN];
 
@@ -235,6 +248,15 @@ void phNxpNciHal_deinitializeRegRfFwDnld();
  * array must be updated with defined config type*/
 static const uint8_t get_cfg_arr[] = {TOTAL_DURATION, ATR_REQ_GEN_BYTES_POLL,
                                       ATR_REQ_GEN_BYTES_LIS, LEN_WT};
+/* Parameters of get_cfg_arr are read with as few CORE_GET_CONFIG_CMD as the
+ * NFCC max control packet payload allows, each one retried alone on failure.
+ * A parameter the NFCC does not support is skipped */
+#define GET_CFG_MAX_RETRY 3
+/* Status of CORE_GET_CONFIG_RSP */
+#define GET_CFG_STATUS_OK 0x00
+#define GET_CFG_STATUS_INVALID_PARAM 0x09
+/* Max control packet payload every NFCC supports, used until CORE_INIT_RSP */
+#define NCI_MIN_CTRL_PAYLOAD 32
 
 //#define NXP_NFC_SET_CONFIG_PARAM_EXT 0xA0
 //#define NXP_NFC_PARAM_ID_SWP2        0xD4
@@ -271,6 +293,34 @@ typedef struct phNxpNci_EEPROM_info {
   uint8_t bufflen;
 } phNxpNci_EEPROM_info_t;
 
+/* Location of the information of a phNxpNci_EEPROM_request_type_t */
+typedef struct phNxpNci_EEPROM_field {
+  uint8_t addr[2];
+  uint8_t memIndex;   /* offset of the information within the field */
+  uint8_t fieldLen;   /* length of the field read and written */
+  uint8_t update_mode;
+  uint8_t b_position; /* bit of the information in BITWISE mode */
+} phNxpNci_EEPROM_field_t;
+
+/* EEPROM transaction, see phNxpNciHal_eeprom_txn_commit */
+#define NXP_EEPROM_TXN_MAX_ENTRIES 16
+#define NXP_EEPROM_TXN_MAX_FIELD_LEN 0x20
+#define NXP_EEPROM_TXN_MAX_RETRY 3
+
+typedef struct phNxpNci_EEPROM_txn_entry {
+  uint8_t request_mode;
+  phNxpNci_EEPROM_request_type_t request_type;
+  uint8_t* buffer; /* caller buffer, filled on commit for GET_EEPROM_DATA */
+  uint8_t bufflen;
+  uint8_t value[NXP_EEPROM_TXN_MAX_FIELD_LEN]; /* SET_EEPROM_DATA value */
+  NFCSTATUS status;
+} phNxpNci_EEPROM_txn_entry_t;
+
+typedef struct phNxpNci_EEPROM_txn {
+  uint8_t num_entries;
+  phNxpNci_EEPROM_txn_entry_t entries[NXP_EEPROM_TXN_MAX_ENTRIES];
+} phNxpNci_EEPROM_txn_t;
+
 typedef struct phNxpNci_getCfg_info {
   bool_t isGetcfg;
   uint8_t total_duration[4];
@@ -313,13 +363,21 @@ typedef struct phNxpNciProfile_Control {
 #define NCIHAL_CMD_CODE_BYTE_LEN (3U)
 
 /******************** NCI HAL exposed functions *******************************/
-int phNxpNciHal_check_ncicmd_write_window(uint16_t cmd_len, uint8_t* p_cmd);
+int phNxpNciHal_check_ncicmd_write_window(uint16_t cmd_len,
+                                          const uint8_t* p_cmd);
 void phNxpNciHal_request_control(void);
 void phNxpNciHal_release_control(void);
 NFCSTATUS phNxpNciHal_send_get_cfgs();
 int phNxpNciHal_write_unlocked(uint16_t data_len, const uint8_t *p_data,
                                int origin);
+bool phNxpNciHal_nfccHangRecovery(void);
 NFCSTATUS request_EEPROM(phNxpNci_EEPROM_info_t* mEEPROM_info);
+void phNxpNciHal_eeprom_txn_init(phNxpNci_EEPROM_txn_t* p_txn);
+NFCSTATUS phNxpNciHal_eeprom_txn_add(phNxpNci_EEPROM_txn_t* p_txn,
+                                     phNxpNci_EEPROM_info_t* mEEPROM_info);
+NFCSTATUS phNxpNciHal_eeprom_txn_commit(phNxpNci_EEPROM_txn_t* p_txn);
+NFCSTATUS phNxpNciHal_eeprom_txn_status(
+    phNxpNci_EEPROM_txn_t* p_txn, phNxpNci_EEPROM_request_type_t request_type);
 int phNxpNciHal_check_config_parameter();
 NFCSTATUS phNxpNciHal_fw_download(uint8_t seq_handler_offset = 0, bool bIsNfccDlState = false);
 NFCSTATUS phNxpNciHal_nfcc_core_reset_init(bool keep_config = false);
@@ -0,0 +1,280 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <eSEClientExtns.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal_BootTasks.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if (NXP_NFC_RECOVERY == TRUE)
+#include <phNxpNciHal_Recovery.h>
+#endif
+
+typedef struct {
+  const char* pName;
+  uint32_t dwDeps; /* steps to be done before this one */
+  void (*pRun)(void);
+} phNxpNciHal_BootStepDesc_t;
+
+static void phNxpNciHal_bootStepRecovery(void);
+
+/* Indexed by phNxpNciHal_BootStep_t */
+static const phNxpNciHal_BootStepDesc_t sBootSteps[PH_NXP_BOOT_STEP_MAX] = {
+    {"fw_recovery", 0, phNxpNciHal_bootStepRecovery},
+    {"ese_init", 0, initializeEseClient},
+    {"ese_check",
+     PH_NXP_BOOT_STEP_BIT(PH_NXP_BOOT_STEP_FW_RECOVERY) |
+         PH_NXP_BOOT_STEP_BIT(PH_NXP_BOOT_STEP_ESE_CLIENT_INIT),
+     checkEseClientUpdate},
+    {"ese_update", PH_NXP_BOOT_STEP_BIT(PH_NXP_BOOT_STEP_ESE_CLIENT_CHECK),
+     perform_eSEClientUpdate},
+};
+
+static pthread_mutex_t sBootLock = PTHREAD_MUTEX_INITIALIZER;
+/* CLOCK_MONOTONIC, set up by phNxpNciHal_bootTasksStart */
+static pthread_cond_t sBootCond;
+static bool sBootStarted = false;
+/* steps done or skipped */
+static uint32_t sBootDone = 0;
+static phNxpNciHal_BootTiming_t sBootTiming;
+/* set on the step threads, which must not wait for the steps */
+static thread_local bool sInBootTask = false;
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_bootStepRecovery
+**
+** Description      FW teardown recovery step, if supported by the build.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_bootStepRecovery(void) {
+#if (NXP_NFC_RECOVERY == TRUE)
+  phNxpNciHal_RecoverFWTearDown();
+#endif
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_bootTasksNow
+**
+** Description      Reads the boot time clock.
+**
+** Returns          Time since boot in ns
+**
+*******************************************************************************/
+static uint64_t phNxpNciHal_bootTasksNow(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_BOOTTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_bootTasksLog
+**
+** Description      Logs the timing of the steps, relative to the start.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_bootTasksLog(const phNxpNciHal_BootTiming_t* pTiming) {
+  for (int i = 0; i < PH_NXP_BOOT_STEP_MAX; i++) {
+    const phNxpNciHal_BootStepTiming_t* pStep = &pTiming->tStep[i];
+    if (pStep->dwState != PH_NXP_BOOT_STEP_DONE) {
+      NXPLOG_NCIHAL_D("boot step %s: skipped", sBootSteps[i].pName);
+      continue;
+    }
+    NXPLOG_NCIHAL_D(
+        "boot step %s: started +%llu ms, ran %llu ms", sBootSteps[i].pName,
+        (unsigned long long)((pStep->qwStartNs - pTiming->qwStartedNs) /
+                             1000000),
+        (unsigned long long)((pStep->qwEndNs - pStep->qwStartNs) / 1000000));
+  }
+  NXPLOG_NCIHAL_D("boot steps: %u waits, %llu ms waited", pTiming->dwWaits,
+                  (unsigned long long)(pTiming->qwWaitTotalNs / 1000000));
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_bootTaskThread
+**
+** Description      Runs one step once its dependencies are done.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phNxpNciHal_bootTaskThread(void* arg) {
+  int step = (int)(intptr_t)arg;
+  const phNxpNciHal_BootStepDesc_t* pDesc = &sBootSteps[step];
+  phNxpNciHal_BootStepTiming_t* pTiming = &sBootTiming.tStep[step];
+  phNxpNciHal_BootTiming_t tTiming;
+  bool bAllDone;
+
+  sInBootTask = true;
+  pthread_mutex_lock(&sBootLock);
+  while ((sBootDone & pDesc->dwDeps) != pDesc->dwDeps) {
+    pthread_cond_wait(&sBootCond, &sBootLock);
+  }
+  pTiming->qwStartNs = phNxpNciHal_bootTasksNow();
+  pTiming->dwState = PH_NXP_BOOT_STEP_RUNNING;
+  pthread_mutex_unlock(&sBootLock);
+
+  NXPLOG_NCIHAL_D("boot step %s: start", pDesc->pName);
+  pDesc->pRun();
+
+  pthread_mutex_lock(&sBootLock);
+  pTiming->qwEndNs = phNxpNciHal_bootTasksNow();
+  pTiming->dwState = PH_NXP_BOOT_STEP_DONE;
+  sBootDone |= PH_NXP_BOOT_STEP_BIT(step);
+  bAllDone = (sBootDone == PH_NXP_BOOT_STEPS_ALL);
+  tTiming = sBootTiming;
+  pthread_cond_broadcast(&sBootCond);
+  pthread_mutex_unlock(&sBootLock);
+
+  if (bAllDone) phNxpNciHal_bootTasksLog(&tTiming);
+  sInBootTask = false;
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_bootTasksStart
+**
+** Description      Starts the steps in dwSteps in the background, the other
+**                  ones are skipped. Called once by the service, before it
+**                  registers.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_bootTasksStart(uint32_t dwSteps) {
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  pthread_mutex_lock(&sBootLock);
+  if (sBootStarted) {
+    pthread_mutex_unlock(&sBootLock);
+    return;
+  }
+  pthread_condattr_t condAttr;
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&sBootCond, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+  sBootStarted = true;
+  memset(&sBootTiming, 0x00, sizeof(sBootTiming));
+  sBootTiming.dwNumSteps = PH_NXP_BOOT_STEP_MAX;
+  sBootTiming.qwStartedNs = phNxpNciHal_bootTasksNow();
+  for (int i = 0; i < PH_NXP_BOOT_STEP_MAX; i++) {
+    if (dwSteps & PH_NXP_BOOT_STEP_BIT(i)) {
+      sBootTiming.tStep[i].dwState = PH_NXP_BOOT_STEP_WAITING;
+    } else {
+      sBootTiming.tStep[i].dwState = PH_NXP_BOOT_STEP_SKIPPED;
+      sBootDone |= PH_NXP_BOOT_STEP_BIT(i);
+    }
+  }
+  pthread_mutex_unlock(&sBootLock);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  /* dependencies have a lower index, a step run in place never waits for
+   * one which is not started */
+  for (int i = 0; i < PH_NXP_BOOT_STEP_MAX; i++) {
+    if (!(dwSteps & PH_NXP_BOOT_STEP_BIT(i))) continue;
+    if (pthread_create(&thread, &attr, phNxpNciHal_bootTaskThread,
+                       (void*)(intptr_t)i) != 0) {
+      NXPLOG_NCIHAL_E("boot step %s: pthread_create failed, run in place",
+                      sBootSteps[i].pName);
+      phNxpNciHal_bootTaskThread((void*)(intptr_t)i);
+    }
+  }
+  pthread_attr_destroy(&attr);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_bootTasksWait
+**
+** Description      Waits until the steps in dwSteps are done, for at most
+**                  dwTimeoutMs, 0 waits without bound. Returns at once if the
+**                  steps were not started, e.g. outside of the service, or
+**                  when called from a step.
+**
+** Returns          true if the steps are done, false on timeout
+**
+*******************************************************************************/
+bool phNxpNciHal_bootTasksWait(uint32_t dwSteps, uint32_t dwTimeoutMs) {
+  struct timespec ts;
+  uint64_t qwStartNs;
+  bool bDone;
+
+  if (sInBootTask) return true;
+  pthread_mutex_lock(&sBootLock);
+  if (!sBootStarted || (sBootDone & dwSteps) == dwSteps) {
+    pthread_mutex_unlock(&sBootLock);
+    return true;
+  }
+  NXPLOG_NCIHAL_D("%s: waiting for boot steps 0x%x", __func__,
+                  dwSteps & ~sBootDone);
+  qwStartNs = phNxpNciHal_bootTasksNow();
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ts.tv_sec += dwTimeoutMs / 1000;
+  ts.tv_nsec += (long)(dwTimeoutMs % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  while ((sBootDone & dwSteps) != dwSteps) {
+    if (dwTimeoutMs == 0) {
+      pthread_cond_wait(&sBootCond, &sBootLock);
+    } else if (pthread_cond_timedwait(&sBootCond, &sBootLock, &ts) ==
+               ETIMEDOUT) {
+      break;
+    }
+  }
+  bDone = ((sBootDone & dwSteps) == dwSteps);
+  sBootTiming.dwWaits++;
+  sBootTiming.qwWaitTotalNs += phNxpNciHal_bootTasksNow() - qwStartNs;
+  if (!bDone) {
+    NXPLOG_NCIHAL_E("%s: boot steps 0x%x not done after %u ms", __func__,
+                    dwSteps & ~sBootDone, dwTimeoutMs);
+  }
+  pthread_mutex_unlock(&sBootLock);
+  return bDone;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_bootTasksGetTiming
+**
+** Description      Copies the timing of the steps.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_bootTasksGetTiming(phNxpNciHal_BootTiming_t* pTiming) {
+  pthread_mutex_lock(&sBootLock);
+  *pTiming = sBootTiming;
+  pthread_mutex_unlock(&sBootLock);
+}
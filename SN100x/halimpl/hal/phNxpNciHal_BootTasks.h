@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Background startup steps of the NFC HAL service.
+ *
+ * The FW teardown recovery and the eSE client load, check and update used
+ * to run in main before the HIDL services were registered. They now run on
+ * their own threads once their dependencies are done, so the service
+ * registers right away. HAL entry points which need the NFCC wait only for
+ * the steps they depend on, see PH_NXP_BOOT_STEPS_MIN_OPEN and
+ * PH_NXP_BOOT_STEPS_OPEN. An open during the eSE update thus blocks until
+ * the update is done, up to PH_NXP_BOOT_OPEN_WAIT_MS, instead of failing.
+ *
+ * The timing of each step, CLOCK_BOOTTIME based, is logged once all of them
+ * are done and returned by HAL_NFC_IOCTL_GET_BOOT_TIMING.
+ */
+
+#ifndef _PHNXPNCIHAL_BOOTTASKS_H_
+#define _PHNXPNCIHAL_BOOTTASKS_H_
+
+#include <stdint.h>
+
+typedef enum {
+  PH_NXP_BOOT_STEP_FW_RECOVERY = 0x00, /* phNxpNciHal_RecoverFWTearDown */
+  PH_NXP_BOOT_STEP_ESE_CLIENT_INIT,    /* initializeEseClient */
+  PH_NXP_BOOT_STEP_ESE_CLIENT_CHECK,   /* checkEseClientUpdate */
+  PH_NXP_BOOT_STEP_ESE_CLIENT_UPDATE,  /* perform_eSEClientUpdate */
+  PH_NXP_BOOT_STEP_MAX
+} phNxpNciHal_BootStep_t;
+
+#define PH_NXP_BOOT_STEP_BIT(step) (1U << (step))
+#define PH_NXP_BOOT_STEPS_ALL ((1U << PH_NXP_BOOT_STEP_MAX) - 1)
+/* NFCC must not be opened while the recovery uses it */
+#define PH_NXP_BOOT_STEPS_MIN_OPEN \
+  PH_NXP_BOOT_STEP_BIT(PH_NXP_BOOT_STEP_FW_RECOVERY)
+/* ese_update, checked by phNxpNciHal_open, is set by the check and cleared
+ * once the update is done */
+#define PH_NXP_BOOT_STEPS_OPEN                               \
+  (PH_NXP_BOOT_STEPS_MIN_OPEN |                              \
+   PH_NXP_BOOT_STEP_BIT(PH_NXP_BOOT_STEP_ESE_CLIENT_CHECK) | \
+   PH_NXP_BOOT_STEP_BIT(PH_NXP_BOOT_STEP_ESE_CLIENT_UPDATE))
+/* Longest wait of phNxpNciHal_open for PH_NXP_BOOT_STEPS_OPEN, open fails
+ * past it as it did while the update ran */
+#define PH_NXP_BOOT_OPEN_WAIT_MS 20000
+
+typedef enum {
+  PH_NXP_BOOT_STEP_IDLE = 0x00, /* not started */
+  PH_NXP_BOOT_STEP_WAITING,     /* waiting for its dependencies */
+  PH_NXP_BOOT_STEP_RUNNING,
+  PH_NXP_BOOT_STEP_DONE,
+  PH_NXP_BOOT_STEP_SKIPPED      /* not selected by the service */
+} phNxpNciHal_BootStepState_t;
+
+typedef struct {
+  uint32_t dwState;   /* phNxpNciHal_BootStepState_t */
+  uint64_t qwStartNs; /* dependencies done */
+  uint64_t qwEndNs;
+} phNxpNciHal_BootStepTiming_t;
+
+/* Returned by HAL_NFC_IOCTL_GET_BOOT_TIMING, times are CLOCK_BOOTTIME ns,
+ * 0 if not reached yet */
+typedef struct {
+  uint32_t dwNumSteps;     /* PH_NXP_BOOT_STEP_MAX */
+  uint64_t qwStartedNs;    /* phNxpNciHal_bootTasksStart */
+  uint32_t dwWaits;        /* HAL entry points which had to wait */
+  uint64_t qwWaitTotalNs;
+  phNxpNciHal_BootStepTiming_t tStep[PH_NXP_BOOT_STEP_MAX];
+} phNxpNciHal_BootTiming_t;
+
+void phNxpNciHal_bootTasksStart(uint32_t dwSteps);
+bool phNxpNciHal_bootTasksWait(uint32_t dwSteps, uint32_t dwTimeoutMs);
+void phNxpNciHal_bootTasksGetTiming(phNxpNciHal_BootTiming_t* pTiming);
+
+#endif /* _PHNXPNCIHAL_BOOTTASKS_H_ */
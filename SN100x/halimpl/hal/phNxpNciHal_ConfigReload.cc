@@ -0,0 +1,340 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Runtime reload of libnfc-nxp_RF.conf and libnfc-nxpTransit.conf.
+ *
+ * A thread watches the directories of both files with inotify. When one of
+ * them is written or removed, only that file is parsed again and the
+ * settings whose value changed are reported by reloadNxpConfigFile().
+ * Changed NXP_RF_CONF_BLK_x are kept pending and sent to the NFCC just
+ * before the next RF_DISCOVER_CMD, when the RF state machine is idle, so
+ * that no NFC off/on cycle is needed. Other settings are read from the
+ * config when they are used and take effect at that time.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <phNxpConfig.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal.h>
+#include <phNxpNciHal_ConfigReload.h>
+#include <phNxpNciHal_ExtCmdAsync.h>
+#include <phNxpNciHal_ext.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* Bit n set in sPendingRfBlks for NXP_RF_CONF_BLK_<n+1> */
+#define NXP_CONFIG_RELOAD_MAX_RF_BLK 32
+
+typedef struct {
+  int confFile;            /* NXP_CONF_FILE_RF/TRANSIT */
+  int wd;                  /* inotify watch of the directory */
+  char dir[PATH_MAX];
+  const char* pName;       /* file name within dir */
+} phNxpNciHal_ConfWatch_t;
+
+extern const char* rf_block_name;
+extern phNxpNciHal_Control_t nxpncihal_ctrl;
+
+static phNxpNciHal_ConfWatch_t sWatch[] = {
+    {NXP_CONF_FILE_RF, -1, {0}, NULL},
+    {NXP_CONF_FILE_TRANSIT, -1, {0}, NULL},
+};
+static int sInotifyFd = -1;
+static int sStopPipe[2] = {-1, -1};
+static pthread_t sWatchThread;
+static bool sWatchRunning = false;
+static pthread_mutex_t sPendingLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t sPendingRfBlks = 0;
+static bool sRfApplyFailed = false;
+/* RF file changes are all pending RF blocks, none needs the next init */
+static bool sRfFilePending = false;
+static bool sRfFileNeedsInit = false;
+/* conf file being reloaded, on the reload thread */
+static int sReloadingFile = 0;
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configReloadChanged
+**
+** Description      Called for each setting changed by a reload. RF blocks
+**                  are kept until RF is idle.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_configReloadChanged(const char* name) {
+  size_t prefixLen = strlen(rf_block_name);
+  int blk;
+
+  blk = (strncmp(name, rf_block_name, prefixLen) == 0)
+            ? atoi(name + prefixLen)
+            : 0;
+  if (blk < 1 || blk > NXP_CONFIG_RELOAD_MAX_RF_BLK) {
+    NXPLOG_NCIHAL_D("Config reload: %s updated", name);
+    /* taken by the next core init, which updates the timestamp */
+    pthread_mutex_lock(&sPendingLock);
+    if (sReloadingFile == NXP_CONF_FILE_RF) sRfFileNeedsInit = true;
+    pthread_mutex_unlock(&sPendingLock);
+    return;
+  }
+  pthread_mutex_lock(&sPendingLock);
+  sPendingRfBlks |= (1U << (blk - 1));
+  if (sReloadingFile == NXP_CONF_FILE_RF) sRfFilePending = true;
+  pthread_mutex_unlock(&sPendingLock);
+  NXPLOG_NCIHAL_D("Config reload: %s pending", name);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configReloadReadEvents
+**
+** Description      Drains the inotify events.
+**
+** Returns          Bit mask of the conf files (1 << NXP_CONF_FILE_x) which
+**                  were modified
+**
+*******************************************************************************/
+static uint32_t phNxpNciHal_configReloadReadEvents(void) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event* pEvt;
+  uint32_t changed = 0;
+  ssize_t len;
+
+  len = read(sInotifyFd, buf, sizeof(buf));
+  for (char* p = buf; len > 0 && p < buf + len;
+       p += sizeof(struct inotify_event) + pEvt->len) {
+    pEvt = (const struct inotify_event*)p;
+    if (pEvt->len == 0) continue;
+    for (size_t i = 0; i < sizeof(sWatch) / sizeof(sWatch[0]); i++) {
+      if (sWatch[i].wd == pEvt->wd && sWatch[i].pName != NULL &&
+          strcmp(sWatch[i].pName, pEvt->name) == 0) {
+        changed |= (1U << sWatch[i].confFile);
+      }
+    }
+  }
+  return changed;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configReloadThread
+**
+** Description      Waits for conf file updates and reloads them.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phNxpNciHal_configReloadThread(void* arg) {
+  struct pollfd fds[2] = {{sInotifyFd, POLLIN, 0}, {sStopPipe[0], POLLIN, 0}};
+  uint32_t changed;
+  UNUSED_PROP(arg);
+
+  NXPLOG_NCIHAL_D("Config reload thread started");
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      NXPLOG_NCIHAL_E("Config reload: poll failed, errno = %d", errno);
+      break;
+    }
+    if (fds[1].revents) break;
+    changed = phNxpNciHal_configReloadReadEvents();
+    /* writer may update the file in several steps, let it settle */
+    while (poll(fds, 2, NXP_CONFIG_RELOAD_SETTLE_MS) > 0 && !fds[1].revents) {
+      changed |= phNxpNciHal_configReloadReadEvents();
+    }
+    if (fds[1].revents) break;
+    for (size_t i = 0; i < sizeof(sWatch) / sizeof(sWatch[0]); i++) {
+      if (changed & (1U << sWatch[i].confFile)) {
+        sReloadingFile = sWatch[i].confFile;
+        reloadNxpConfigFile(sWatch[i].confFile,
+                            phNxpNciHal_configReloadChanged);
+        sReloadingFile = 0;
+      }
+    }
+  }
+  NXPLOG_NCIHAL_D("Config reload thread stopped");
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configReloadStart
+**
+** Description      Starts watching the RF and transit conf files. Called on
+**                  HAL open.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_configReloadStart(void) {
+  const char* pPath;
+  char* pSlash;
+
+  if (sWatchRunning) return;
+  sInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (sInotifyFd < 0) {
+    NXPLOG_NCIHAL_E("Config reload: inotify_init1 failed, errno = %d", errno);
+    return;
+  }
+  for (size_t i = 0; i < sizeof(sWatch) / sizeof(sWatch[0]); i++) {
+    pPath = getNxpConfigFilePath(sWatch[i].confFile);
+    sWatch[i].wd = -1;
+    sWatch[i].pName = NULL;
+    if (pPath == NULL) continue;
+    strlcpy(sWatch[i].dir, pPath, sizeof(sWatch[i].dir));
+    pSlash = strrchr(sWatch[i].dir, '/');
+    if (pSlash == NULL) continue;
+    *pSlash = '\0';
+    sWatch[i].pName = pPath + (pSlash - sWatch[i].dir) + 1;
+    /* same directory gives back the same watch */
+    sWatch[i].wd = inotify_add_watch(sInotifyFd, sWatch[i].dir,
+                                     IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE);
+    if (sWatch[i].wd < 0) {
+      NXPLOG_NCIHAL_E("Config reload: unable to watch %s", sWatch[i].dir);
+    }
+  }
+  if (pipe2(sStopPipe, O_CLOEXEC) != 0) {
+    NXPLOG_NCIHAL_E("Config reload: pipe2 failed, errno = %d", errno);
+    goto clean_and_return;
+  }
+  if (pthread_create(&sWatchThread, NULL, phNxpNciHal_configReloadThread,
+                     NULL) != 0) {
+    NXPLOG_NCIHAL_E("Config reload: pthread_create failed");
+    goto clean_and_return;
+  }
+  sWatchRunning = true;
+  return;
+
+clean_and_return:
+  if (sStopPipe[0] >= 0) close(sStopPipe[0]);
+  if (sStopPipe[1] >= 0) close(sStopPipe[1]);
+  sStopPipe[0] = sStopPipe[1] = -1;
+  close(sInotifyFd);
+  sInotifyFd = -1;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configReloadStop
+**
+** Description      Stops watching the conf files. Called on HAL close.
+**                  Pending RF blocks are dropped, the next core
+**                  initialization sends the whole RF configuration since
+**                  the RF config timestamp was not updated.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_configReloadStop(void) {
+  char stop = 0;
+
+  if (!sWatchRunning) return;
+  if (write(sStopPipe[1], &stop, sizeof(stop)) != sizeof(stop)) {
+    NXPLOG_NCIHAL_E("Config reload: unable to stop thread");
+  }
+  pthread_join(sWatchThread, NULL);
+  close(sStopPipe[0]);
+  close(sStopPipe[1]);
+  sStopPipe[0] = sStopPipe[1] = -1;
+  close(sInotifyFd);
+  sInotifyFd = -1;
+  sWatchRunning = false;
+
+  pthread_mutex_lock(&sPendingLock);
+  sPendingRfBlks = 0;
+  sRfApplyFailed = false;
+  sRfFilePending = false;
+  sRfFileNeedsInit = false;
+  pthread_mutex_unlock(&sPendingLock);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configReloadApply
+**
+** Description      Sends the RF blocks changed since the last call. Called
+**                  from the write path before RF_DISCOVER_CMD, RF is idle.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_configReloadApply(void) {
+  uint8_t buffer[NCI_MAX_DATA_LEN];
+  char name[32];
+  uint32_t blks;
+  bool rfFileApplied;
+  long retlen;
+  int num = 0;
+  phNxpNciHal_ExtCmdGroup_t group;
+  phNxpNciHal_ExtCmd_t* pCmds;
+
+  pthread_mutex_lock(&sPendingLock);
+  blks = sPendingRfBlks;
+  sPendingRfBlks = 0;
+  rfFileApplied = sRfFilePending && !sRfFileNeedsInit;
+  sRfFilePending = false;
+  pthread_mutex_unlock(&sPendingLock);
+  if (blks == 0) return;
+
+  pCmds = new phNxpNciHal_ExtCmd_t[__builtin_popcount(blks)];
+  /* blocks are independent, all of them are queued and waited for once */
+  phNxpNciHal_extCmdGroupInit(&group, false);
+  for (int i = 0; i < NXP_CONFIG_RELOAD_MAX_RF_BLK; i++) {
+    if (!(blks & (1U << i))) continue;
+    snprintf(name, sizeof(name), "%s%d", rf_block_name, i + 1);
+    retlen = 0;
+    if (!GetNxpByteArrayValue(name, (char*)buffer, sizeof(buffer), &retlen) ||
+        retlen <= 0) {
+      /* removed block, NFCC keeps the value until it is set again */
+      continue;
+    }
+    NXPLOG_NCIHAL_D("Config reload: Performing RF Settings %s", name);
+    if (phNxpNciHal_extCmdInit(&pCmds[num], retlen, buffer, 0) !=
+            NFCSTATUS_SUCCESS ||
+        phNxpNciHal_extCmdSubmit(&group, &pCmds[num]) != NFCSTATUS_PENDING) {
+      NXPLOG_NCIHAL_E("Config reload: %s failed", name);
+      sRfApplyFailed = true;
+      continue;
+    }
+    num++;
+  }
+  phNxpNciHal_extCmdGroupWait(&group);
+  for (int i = 0; i < num; i++) {
+    if (pCmds[i].wStatus != NFCSTATUS_SUCCESS ||
+        (pCmds[i].wRspLen > 3 && pCmds[i].aRsp[2] > 0 &&
+         pCmds[i].aRsp[3] != NFCSTATUS_SUCCESS)) {
+      NXPLOG_NCIHAL_E("Config reload: RF Settings 0x%02x 0x%02x failed",
+                      pCmds[i].aCmd[0], pCmds[i].aCmd[1]);
+      sRfApplyFailed = true;
+    }
+  }
+  delete[] pCmds;
+  /* on failure, the whole RF configuration is sent on next init. The
+   * transit file and the main one are left to the next init as well, their
+   * timestamps gate other init steps */
+  if (!sRfApplyFailed && rfFileApplied)
+    updateNxpConfigFileTimestamp(NXP_CONF_FILE_RF);
+}
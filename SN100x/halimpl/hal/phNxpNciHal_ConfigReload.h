@@ -0,0 +1,29 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef _PHNXPNCIHAL_CONFIGRELOAD_H_
+#define _PHNXPNCIHAL_CONFIGRELOAD_H_
+
+/* Time given to a writer to finish updating a conf file */
+#define NXP_CONFIG_RELOAD_SETTLE_MS 200
+
+void phNxpNciHal_configReloadStart(void);
+void phNxpNciHal_configReloadStop(void);
+void phNxpNciHal_configReloadApply(void);
+
+#endif /* _PHNXPNCIHAL_CONFIGRELOAD_H_ */
@@ -0,0 +1,195 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <phNxpConfig.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal_ConfigSnapshot.h>
+#include <pthread.h>
+#include <string.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+using android::hardware::nfc::V1_1::PresenceCheckAlgorithm;
+using android::hardware::nfc::V1_1::ProtocolDiscoveryConfig;
+
+/* Max rebuilds in a row while the settings keep changing under the build */
+#define NXP_CONFIG_SNAPSHOT_MAX_BUILDS 3
+
+/* Accessed with std::atomic_load/std::atomic_store only */
+static phNxpNciHal_ConfigSnapshotRef_t sSnapshot;
+/* Serializes rebuilds, never taken by readers of a current snapshot */
+static pthread_mutex_t sSnapshotLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configSnapshotFill
+**
+** Description      Reads the settings of the snapshot from the config.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_configSnapshotFill(
+    phNxpNciHal_ConfigSnapshot_t* pSnap) {
+  android::hardware::nfc::V1_1::NfcConfig& config = pSnap->tVendorConfig.v1_1;
+  std::array<uint8_t, NXP_MAX_CONFIG_STRING_LEN> buffer;
+  unsigned long num = 0;
+  long retlen = 0;
+
+  buffer.fill(0);
+  if (GetNxpNumValue(NAME_NXP_AUTONOMOUS_ENABLE, &num, sizeof(num))) {
+    pSnap->tConfigExt.autonomous_mode = (uint8_t)num;
+  }
+  if (GetNxpNumValue(NAME_NXP_GUARD_TIMER_VALUE, &num, sizeof(num))) {
+    pSnap->tConfigExt.guard_timer_value = (uint8_t)num;
+  }
+  if (GetNxpNumValue(NAME_NFA_POLL_BAIL_OUT_MODE, &num, sizeof(num))) {
+    config.nfaPollBailOutMode = (bool)num;
+  }
+  if (GetNxpNumValue(NAME_ISO_DEP_MAX_TRANSCEIVE, &num, sizeof(num))) {
+    config.maxIsoDepTransceiveLength = (uint32_t)num;
+  }
+  if (GetNxpNumValue(NAME_DEFAULT_OFFHOST_ROUTE, &num, sizeof(num))) {
+    config.defaultOffHostRoute = (uint8_t)num;
+  }
+  if (GetNxpNumValue(NAME_DEFAULT_NFCF_ROUTE, &num, sizeof(num))) {
+    config.defaultOffHostRouteFelica = (uint8_t)num;
+  }
+  if (GetNxpNumValue(NAME_DEFAULT_SYS_CODE_ROUTE, &num, sizeof(num))) {
+    config.defaultSystemCodeRoute = (uint8_t)num;
+  }
+  if (GetNxpNumValue(NAME_DEFAULT_SYS_CODE_PWR_STATE, &num, sizeof(num))) {
+    config.defaultSystemCodePowerState = (uint8_t)num;
+  }
+  if (GetNxpNumValue(NAME_DEFAULT_ROUTE, &num, sizeof(num))) {
+    config.defaultRoute = (uint8_t)num;
+  }
+  if (GetNxpByteArrayValue(NAME_DEVICE_HOST_WHITE_LIST, (char*)buffer.data(),
+                           buffer.size(), &retlen)) {
+    config.hostWhitelist.resize(retlen);
+    for (long i = 0; i < retlen; i++) config.hostWhitelist[i] = buffer[i];
+  }
+  if (GetNxpNumValue(NAME_OFF_HOST_ESE_PIPE_ID, &num, sizeof(num))) {
+    config.offHostESEPipeId = (uint8_t)num;
+  }
+  if (GetNxpNumValue(NAME_OFF_HOST_SIM_PIPE_ID, &num, sizeof(num))) {
+    config.offHostSIMPipeId = (uint8_t)num;
+  }
+  if ((GetNxpByteArrayValue(NAME_NFA_PROPRIETARY_CFG, (char*)buffer.data(),
+                            buffer.size(), &retlen)) &&
+      (retlen == 9)) {
+    config.nfaProprietaryCfg.protocol18092Active = (uint8_t)buffer[0];
+    config.nfaProprietaryCfg.protocolBPrime = (uint8_t)buffer[1];
+    config.nfaProprietaryCfg.protocolDual = (uint8_t)buffer[2];
+    config.nfaProprietaryCfg.protocol15693 = (uint8_t)buffer[3];
+    config.nfaProprietaryCfg.protocolKovio = (uint8_t)buffer[4];
+    config.nfaProprietaryCfg.protocolMifare = (uint8_t)buffer[5];
+    config.nfaProprietaryCfg.discoveryPollKovio = (uint8_t)buffer[6];
+    config.nfaProprietaryCfg.discoveryPollBPrime = (uint8_t)buffer[7];
+    config.nfaProprietaryCfg.discoveryListenBPrime = (uint8_t)buffer[8];
+  } else {
+    memset(&config.nfaProprietaryCfg, 0xFF, sizeof(ProtocolDiscoveryConfig));
+  }
+  if ((GetNxpNumValue(NAME_PRESENCE_CHECK_ALGORITHM, &num, sizeof(num))) &&
+      (num <= 2)) {
+    config.presenceCheckAlgorithm = (PresenceCheckAlgorithm)num;
+  }
+
+  if (GetNxpByteArrayValue(NAME_OFFHOST_ROUTE_UICC, (char*)buffer.data(),
+                           buffer.size(), &retlen)) {
+    pSnap->tVendorConfig.offHostRouteUicc.resize(retlen);
+    for (long i = 0; i < retlen; i++)
+      pSnap->tVendorConfig.offHostRouteUicc[i] = buffer[i];
+  }
+  if (GetNxpByteArrayValue(NAME_OFFHOST_ROUTE_ESE, (char*)buffer.data(),
+                           buffer.size(), &retlen)) {
+    pSnap->tVendorConfig.offHostRouteEse.resize(retlen);
+    for (long i = 0; i < retlen; i++)
+      pSnap->tVendorConfig.offHostRouteEse[i] = buffer[i];
+  }
+  if (GetNxpNumValue(NAME_DEFAULT_ISODEP_ROUTE, &num, sizeof(num))) {
+    pSnap->tVendorConfig.defaultIsoDepRoute = num;
+  }
+
+  num = 0;
+  if (GetNxpNumValue(NAME_MIFARE_READER_ENABLE, &num, sizeof(num))) {
+    pSnap->dwMifareReaderEnable = num;
+  }
+  retlen = 0;
+  GetNxpByteArrayValue(NAME_NXP_PROP_RESET_EMVCO_CMD,
+                       (char*)pSnap->aResetEmvcoCmd,
+                       sizeof(pSnap->aResetEmvcoCmd), &retlen);
+  pSnap->lResetEmvcoCmdLen = retlen;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configSnapshotBuild
+**
+** Description      Builds a snapshot of the current settings and publishes
+**                  it, unless another thread did it meanwhile. Called with
+**                  sSnapshotLock held.
+**
+** Returns          Current snapshot
+**
+*******************************************************************************/
+static phNxpNciHal_ConfigSnapshotRef_t phNxpNciHal_configSnapshotBuild(void) {
+  phNxpNciHal_ConfigSnapshotRef_t pCur = std::atomic_load(&sSnapshot);
+  std::shared_ptr<phNxpNciHal_ConfigSnapshot_t> pSnap;
+  unsigned int generation = getNxpConfigGeneration();
+
+  if (pCur != nullptr && pCur->dwGeneration == generation) return pCur;
+
+  for (int i = 0; i < NXP_CONFIG_SNAPSHOT_MAX_BUILDS; i++) {
+    pSnap = std::make_shared<phNxpNciHal_ConfigSnapshot_t>();
+    phNxpNciHal_configSnapshotFill(pSnap.get());
+    /* the first lookup may load the config, a reload may run meanwhile */
+    pSnap->dwGeneration = generation;
+    generation = getNxpConfigGeneration();
+    if (pSnap->dwGeneration == generation) break;
+    NXPLOG_NCIHAL_D("%s: settings changed while building, retry", __func__);
+  }
+
+  /* the replaced one is freed with its last reader */
+  std::atomic_store(&sSnapshot, phNxpNciHal_ConfigSnapshotRef_t(pSnap));
+  NXPLOG_NCIHAL_D("%s: generation %u", __func__, pSnap->dwGeneration);
+  return pSnap;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_configSnapshot
+**
+** Description      Gets the snapshot of the current settings, built again
+**                  first if the settings changed since the last one.
+**
+** Returns          Snapshot, valid as long as the caller holds it
+**
+*******************************************************************************/
+phNxpNciHal_ConfigSnapshotRef_t phNxpNciHal_configSnapshot(void) {
+  phNxpNciHal_ConfigSnapshotRef_t pSnap = std::atomic_load(&sSnapshot);
+
+  if (pSnap != nullptr && pSnap->dwGeneration == getNxpConfigGeneration()) {
+    return pSnap;
+  }
+  pthread_mutex_lock(&sSnapshotLock);
+  pSnap = phNxpNciHal_configSnapshotBuild();
+  pthread_mutex_unlock(&sSnapshotLock);
+  return pSnap;
+}
@@ -0,0 +1,62 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Typed snapshot of the settings read on the hot paths of the HAL.
+ *
+ * The snapshot is built from libnfc-nxp.conf and its RF and transit
+ * overlays the first time it is needed after the settings changed, see
+ * getNxpConfigGeneration(), and published with a single shared pointer
+ * swap. Readers get an immutable structure and use its fields directly,
+ * without name lookup nor lock.
+ *
+ * A snapshot is freed once the last reference to it is dropped, a reader
+ * holding one is never affected by a rebuild.
+ */
+
+#ifndef _PHNXPNCIHAL_CONFIGSNAPSHOT_H_
+#define _PHNXPNCIHAL_CONFIGSNAPSHOT_H_
+
+#include <phNxpNciHal_Adaptation.h>
+#include <phNxpNciHal_extOperations.h>
+#include <stdint.h>
+#include <memory>
+
+/* Length of the NXP_PROP_RESET_EMVCO_CMD command */
+#define NXP_CONFIG_SNAPSHOT_EMVCO_CMD_LEN 8
+
+typedef struct {
+  unsigned int dwGeneration; /* settings generation it was built from */
+  /* phNxpNciHal_getVendorConfig_1_2, defaultSystemCodePowerState as read
+   * from the settings, before autonomous mode is applied */
+  NfcConfig tVendorConfig;
+  nxp_nfc_config_ext_t tConfigExt;
+  /* MIFARE_READER_ENABLE, 0 if not set */
+  unsigned long dwMifareReaderEnable;
+  /* NXP_PROP_RESET_EMVCO_CMD, length as returned by GetNxpByteArrayValue,
+   * 0 if not set */
+  long lResetEmvcoCmdLen;
+  uint8_t aResetEmvcoCmd[NXP_CONFIG_SNAPSHOT_EMVCO_CMD_LEN];
+} phNxpNciHal_ConfigSnapshot_t;
+
+typedef std::shared_ptr<const phNxpNciHal_ConfigSnapshot_t>
+    phNxpNciHal_ConfigSnapshotRef_t;
+
+phNxpNciHal_ConfigSnapshotRef_t phNxpNciHal_configSnapshot(void);
+
+#endif /* _PHNXPNCIHAL_CONFIGSNAPSHOT_H_ */
@@ -0,0 +1,281 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <phNxpLog.h>
+#include <phNxpNciHal_ExtCmdAsync.h>
+#include <phNxpNciHal_ext.h>
+#include <string.h>
+#include <deque>
+
+static pthread_mutex_t sQueueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sQueueCond = PTHREAD_COND_INITIALIZER;
+static std::deque<phNxpNciHal_ExtCmd_t*> sQueue;
+static pthread_t sDispatchThread;
+static bool sRunning = false;
+static bool sStopping = false;
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdComplete
+**
+** Description      Completes the command with status, the command may be
+**                  released by its owner once its group is updated.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_extCmdComplete(phNxpNciHal_ExtCmd_t* pCmd,
+                                       NFCSTATUS status) {
+  phNxpNciHal_ExtCmdGroup_t* pGroup = pCmd->pGroup;
+
+  pCmd->wStatus = status;
+  if (pCmd->pCback != NULL) pCmd->pCback(pCmd);
+  if (pGroup == NULL) return;
+
+  pthread_mutex_lock(&pGroup->lock);
+  if (status != NFCSTATUS_SUCCESS && pGroup->wStatus == NFCSTATUS_SUCCESS) {
+    pGroup->wStatus = status;
+  }
+  if (--pGroup->dwPending == 0) pthread_cond_broadcast(&pGroup->cond);
+  pthread_mutex_unlock(&pGroup->lock);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdRun
+**
+** Description      Sends the command unless its chain failed, and completes
+**                  it. dwTimeoutMs bounds the wait for the response and then
+**                  the one for the notification, each counted once the
+**                  command is written.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_extCmdRun(phNxpNciHal_ExtCmd_t* pCmd) {
+  phNxpNciHal_ExtCmdGroup_t* pGroup = pCmd->pGroup;
+  NFCSTATUS status;
+
+  if (pGroup != NULL && pGroup->bChain) {
+    pthread_mutex_lock(&pGroup->lock);
+    status = pGroup->wStatus;
+    pthread_mutex_unlock(&pGroup->lock);
+    if (status != NFCSTATUS_SUCCESS) {
+      phNxpNciHal_extCmdComplete(pCmd, NFCSTATUS_ABORTED);
+      return;
+    }
+  }
+  status = phNxpNciHal_exec_ext_cmd(pCmd->wCmdLen, pCmd->aCmd,
+                                    pCmd->dwTimeoutMs, &pCmd->wRspLen,
+                                    pCmd->aRsp);
+  phNxpNciHal_extCmdComplete(pCmd, status);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdDispatch
+**
+** Description      Dispatcher thread, sends the queued commands in order.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phNxpNciHal_extCmdDispatch(void* arg) {
+  phNxpNciHal_ExtCmd_t* pCmd;
+
+  UNUSED_PROP(arg);
+  pthread_mutex_lock(&sQueueLock);
+  while (!sStopping) {
+    if (sQueue.empty()) {
+      pthread_cond_wait(&sQueueCond, &sQueueLock);
+      continue;
+    }
+    pCmd = sQueue.front();
+    sQueue.pop_front();
+    pthread_mutex_unlock(&sQueueLock);
+    phNxpNciHal_extCmdRun(pCmd);
+    pthread_mutex_lock(&sQueueLock);
+  }
+  pthread_mutex_unlock(&sQueueLock);
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdAsyncStart
+**
+** Description      Starts the dispatcher thread, called when the HAL is
+**                  opened.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_extCmdAsyncStart(void) {
+  pthread_mutex_lock(&sQueueLock);
+  if (!sRunning) {
+    sStopping = false;
+    if (pthread_create(&sDispatchThread, NULL, phNxpNciHal_extCmdDispatch,
+                       NULL) != 0) {
+      NXPLOG_NCIHAL_E("%s: pthread_create failed", __func__);
+    } else {
+      sRunning = true;
+    }
+  }
+  pthread_mutex_unlock(&sQueueLock);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdAsyncStop
+**
+** Description      Stops the dispatcher thread after the command being sent,
+**                  the queued commands complete with NFCSTATUS_SHUTDOWN.
+**                  Called when the HAL is closed.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_extCmdAsyncStop(void) {
+  std::deque<phNxpNciHal_ExtCmd_t*> pending;
+
+  pthread_mutex_lock(&sQueueLock);
+  if (!sRunning) {
+    pthread_mutex_unlock(&sQueueLock);
+    return;
+  }
+  sStopping = true;
+  pthread_cond_signal(&sQueueCond);
+  pthread_mutex_unlock(&sQueueLock);
+
+  if (pthread_join(sDispatchThread, NULL) != 0) {
+    NXPLOG_NCIHAL_E("%s: pthread_join failed", __func__);
+  }
+
+  pthread_mutex_lock(&sQueueLock);
+  sRunning = false;
+  pending.swap(sQueue);
+  pthread_mutex_unlock(&sQueueLock);
+  for (phNxpNciHal_ExtCmd_t* pCmd : pending) {
+    phNxpNciHal_extCmdComplete(pCmd, NFCSTATUS_SHUTDOWN);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdInit
+**
+** Description      Prepares a command to be submitted, with timeout_ms for
+**                  each of its response and notification, 0 for the
+**                  default timeout of phNxpNciHal_send_ext_cmd.
+**
+** Returns          NFCSTATUS_SUCCESS, NFCSTATUS_INVALID_PARAMETER if the
+**                  command is too long
+**
+*******************************************************************************/
+NFCSTATUS phNxpNciHal_extCmdInit(phNxpNciHal_ExtCmd_t* pCmd, uint16_t cmd_len,
+                                 const uint8_t* p_cmd, uint32_t timeout_ms) {
+  if (cmd_len > NCI_MAX_DATA_LEN) {
+    NXPLOG_NCIHAL_E("cmd_len exceeds limit NCI_MAX_DATA_LEN");
+    return NFCSTATUS_INVALID_PARAMETER;
+  }
+  memset(pCmd, 0x00, sizeof(*pCmd));
+  pCmd->wCmdLen = cmd_len;
+  memcpy(pCmd->aCmd, p_cmd, cmd_len);
+  pCmd->dwTimeoutMs = (timeout_ms != 0) ? timeout_ms
+                                        : HAL_EXTNS_WRITE_RSP_TIMEOUT;
+  pCmd->wStatus = NFCSTATUS_PENDING;
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdGroupInit
+**
+** Description      Prepares a group, again before each reuse.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_extCmdGroupInit(phNxpNciHal_ExtCmdGroup_t* pGroup,
+                                 bool bChain) {
+  pthread_mutex_init(&pGroup->lock, NULL);
+  pthread_cond_init(&pGroup->cond, NULL);
+  pGroup->dwPending = 0;
+  pGroup->bChain = bChain;
+  pGroup->wStatus = NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdSubmit
+**
+** Description      Queues the command, in pGroup if not NULL.
+**
+** Returns          NFCSTATUS_PENDING if queued, the command then completes
+**                  exactly once, NFCSTATUS_NOT_INITIALISED if the HAL is
+**                  closed
+**
+*******************************************************************************/
+NFCSTATUS phNxpNciHal_extCmdSubmit(phNxpNciHal_ExtCmdGroup_t* pGroup,
+                                   phNxpNciHal_ExtCmd_t* pCmd) {
+  pCmd->pGroup = pGroup;
+  pCmd->wStatus = NFCSTATUS_PENDING;
+  pCmd->wRspLen = 0;
+
+  pthread_mutex_lock(&sQueueLock);
+  if (!sRunning || sStopping) {
+    pthread_mutex_unlock(&sQueueLock);
+    NXPLOG_NCIHAL_E("%s: dispatcher not running", __func__);
+    return NFCSTATUS_NOT_INITIALISED;
+  }
+  if (pGroup != NULL) {
+    pthread_mutex_lock(&pGroup->lock);
+    pGroup->dwPending++;
+    pthread_mutex_unlock(&pGroup->lock);
+  }
+  sQueue.push_back(pCmd);
+  pthread_cond_signal(&sQueueCond);
+  pthread_mutex_unlock(&sQueueLock);
+  return NFCSTATUS_PENDING;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_extCmdGroupWait
+**
+** Description      Waits until all the commands submitted in the group
+**                  completed. Every command is bounded by twice its timeout
+**                  once written, so the wait is bounded.
+**
+** Returns          NFCSTATUS_SUCCESS if all of them succeeded, else the
+**                  status of the first one which failed
+**
+*******************************************************************************/
+NFCSTATUS phNxpNciHal_extCmdGroupWait(phNxpNciHal_ExtCmdGroup_t* pGroup) {
+  NFCSTATUS status;
+
+  pthread_mutex_lock(&pGroup->lock);
+  while (pGroup->dwPending != 0) {
+    pthread_cond_wait(&pGroup->cond, &pGroup->lock);
+  }
+  status = pGroup->wStatus;
+  pthread_mutex_unlock(&pGroup->lock);
+  pthread_cond_destroy(&pGroup->cond);
+  pthread_mutex_destroy(&pGroup->lock);
+  return status;
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Asynchronous submission of HAL extension commands.
+ *
+ * phNxpNciHal_extCmdSubmit queues a command and returns at once. A
+ * dispatcher thread sends the queued commands in order through the same
+ * path as phNxpNciHal_send_ext_cmd, NCI allows a single command pending at
+ * the NFCC, and completes each of them by storing its status and response
+ * in the command, calling its callback if any and then updating its group.
+ * A caller can queue a whole sequence and wait once for the group.
+ *
+ * Each command has its own timeout. As for phNxpNciHal_send_ext_cmd, it
+ * bounds the wait for the response and then the wait for the notification,
+ * each started once the command is written: the time a command spends
+ * queued behind others does not count.
+ *
+ * In a chained group, the commands queued after a failed one complete with
+ * NFCSTATUS_ABORTED without being sent.
+ *
+ * Commands and groups belong to the caller and must stay valid until the
+ * command completed, respectively until phNxpNciHal_extCmdGroupWait
+ * returned. Callbacks are called on the dispatcher thread and must not
+ * wait for other commands.
+ */
+
+#ifndef _PHNXPNCIHAL_EXTCMDASYNC_H_
+#define _PHNXPNCIHAL_EXTCMDASYNC_H_
+
+#include <phNxpNciHal.h>
+#include <pthread.h>
+#include <stdint.h>
+
+struct phNxpNciHal_ExtCmd;
+
+typedef void (*phNxpNciHal_ExtCmdCback_t)(struct phNxpNciHal_ExtCmd* pCmd);
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t dwPending; /* submitted commands not completed yet */
+  bool bChain;        /* abort the commands queued after a failure */
+  NFCSTATUS wStatus;  /* status of the first failed command */
+} phNxpNciHal_ExtCmdGroup_t;
+
+typedef struct phNxpNciHal_ExtCmd {
+  /* set by the caller */
+  uint16_t wCmdLen;
+  uint8_t aCmd[NCI_MAX_DATA_LEN];
+  uint32_t dwTimeoutMs; /* per response and notification wait */
+  phNxpNciHal_ExtCmdCback_t pCback; /* optional */
+  void* pContext;
+  /* set on completion, response or notification as for
+   * phNxpNciHal_send_ext_cmd */
+  NFCSTATUS wStatus;
+  uint16_t wRspLen;
+  uint8_t aRsp[NCI_MAX_DATA_LEN];
+  /* private */
+  phNxpNciHal_ExtCmdGroup_t* pGroup;
+} phNxpNciHal_ExtCmd_t;
+
+void phNxpNciHal_extCmdAsyncStart(void);
+void phNxpNciHal_extCmdAsyncStop(void);
+NFCSTATUS phNxpNciHal_extCmdInit(phNxpNciHal_ExtCmd_t* pCmd, uint16_t cmd_len,
+                                 const uint8_t* p_cmd, uint32_t timeout_ms);
+void phNxpNciHal_extCmdGroupInit(phNxpNciHal_ExtCmdGroup_t* pGroup,
+                                 bool bChain);
+NFCSTATUS phNxpNciHal_extCmdSubmit(phNxpNciHal_ExtCmdGroup_t* pGroup,
+                                   phNxpNciHal_ExtCmd_t* pCmd);
+NFCSTATUS phNxpNciHal_extCmdGroupWait(phNxpNciHal_ExtCmdGroup_t* pGroup);
+
+#endif /* _PHNXPNCIHAL_EXTCMDASYNC_H_ */
@@ -20,6 +20,11 @@
 #include <android-base/strings.h>
 #include <android-base/parseint.h>
 #include <cutils/properties.h>
+#include "phDal4Nfc_messageQueueLib.h"
+#include "phNxpNciHal_BootTasks.h"
+#include "phNxpNciHal_LatencyStats.h"
+#include "phNxpNciHal_Liveness.h"
+#include "phNxpNciHal_ThreadPolicy.h"
 #include "phNxpNciHal_ext.h"
 #include "phNxpNciHal_utils.h"
 #include "phDnldNfc_Internal.h"
@@ -220,14 +225,79 @@ std::set<string> gNciConfigs = {"NXP_SE_COLD_TEMP_ERROR_DELAY",
  **
  ** Returns          return 0 on success and -1 on fail,
  ******************************************************************************/
-int phNxpNciHal_ioctlIf(long /* arg */, void* /* p_data */) {
+int phNxpNciHal_ioctlIf(long arg, void* p_data) {
   int ret = -1;
-#ifdef ENABLE_ESE_CLIENT
   NXPLOG_NCIHAL_D("%s : enter - arg = %ld", __func__, arg);
-  ese_nxp_IoctlInOutData_t *pInpOutData = (ese_nxp_IoctlInOutData_t *)p_data;
 
   switch (arg) {
-  case HAL_ESE_IOCTL_NFC_JCOP_DWNLD:
+  case HAL_NFC_IOCTL_GET_LOCK_STATS:
+    if (p_data == NULL) {
+      NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
+      break;
+    }
+    phNxpNciHal_lockStatsGet((phNxpNciHal_LockStatsSnapshot_t*)p_data);
+    ret = 0;
+    break;
+  case HAL_NFC_IOCTL_RESET_LOCK_STATS:
+    phNxpNciHal_lockStatsReset();
+    ret = 0;
+    break;
+  case HAL_NFC_IOCTL_GET_BOOT_TIMING:
+    if (p_data == NULL) {
+      NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
+      break;
+    }
+    phNxpNciHal_bootTasksGetTiming((phNxpNciHal_BootTiming_t*)p_data);
+    ret = 0;
+    break;
+  case HAL_NFC_IOCTL_GET_MSGQ_STATS:
+    if (p_data == NULL) {
+      NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
+      break;
+    }
+    ret = phDal4Nfc_msgstats(nxpncihal_ctrl.gDrvCfg.nClientId,
+                             (phDal4Nfc_MsgQStats_t*)p_data);
+    break;
+  case HAL_NFC_IOCTL_RUN_JITTER_PROBE:
+    ret = phNxpNciHal_threadPolicyProbe((phNxpNciHal_JitterProbe_t*)p_data);
+    break;
+  case HAL_NFC_IOCTL_GET_WRITE_STATS:
+    if (p_data == NULL || gpTransportObj == nullptr) {
+      NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
+      break;
+    }
+    ret = gpTransportObj->GetWriteStats((NfccWriteStats_t*)p_data);
+    break;
+  case HAL_NFC_IOCTL_GET_READ_STATS:
+    if (p_data == NULL || gpTransportObj == nullptr) {
+      NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
+      break;
+    }
+    ret = gpTransportObj->GetReadStats((NfccReadStats_t*)p_data);
+    break;
+  case HAL_NFC_IOCTL_GET_LATENCY_STATS:
+    if (p_data == NULL) {
+      NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
+      break;
+    }
+    phNxpNciHal_latencyStatsGet((phNxpNciHal_LatencySnapshot_t*)p_data);
+    ret = 0;
+    break;
+  case HAL_NFC_IOCTL_RESET_LATENCY_STATS:
+    phNxpNciHal_latencyStatsReset();
+    ret = 0;
+    break;
+  case HAL_NFC_IOCTL_GET_LIVENESS_STATS:
+    if (p_data == NULL) {
+      NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
+      break;
+    }
+    phNxpNciHal_livenessStatsGet((phNxpNciHal_LivenessStats_t*)p_data);
+    ret = 0;
+    break;
+#ifdef ENABLE_ESE_CLIENT
+  case HAL_ESE_IOCTL_NFC_JCOP_DWNLD: {
+    ese_nxp_IoctlInOutData_t *pInpOutData = (ese_nxp_IoctlInOutData_t *)p_data;
     if (pInpOutData == NULL) {
       NXPLOG_NCIHAL_E("%s : received invalid param", __func__);
       break;
@@ -248,12 +318,13 @@ int phNxpNciHal_ioctlIf(long /* arg */, void* /* p_data */) {
     gpEseAdapt->HalIoctl(HAL_ESE_IOCTL_NFC_JCOP_DWNLD, pInpOutData);
     ret = 0;
     break;
+  }
+#endif
   default:
     NXPLOG_NCIHAL_E("%s : Wrong arg = %ld", __func__, arg);
     break;
   }
   NXPLOG_NCIHAL_D("%s : exit - ret = %d", __func__, ret);
-#endif
   return ret;
 }
 
@@ -19,6 +19,35 @@
 #include "phNxpLog.h"
 #include <hardware/nfc.h>
 
+/* HAL private ioctls, above the ioctls of libnfc-nci and the eSE clients.
+ * They are in-process only: neither the android.hardware.nfc services nor
+ * vendor.nxp.hardware.nfc@2.0 forward an ioctl, so only code linked with
+ * the HAL library reaches them, through phNxpNciHal_ioctl(). The lock,
+ * latency, liveness and message queue statistics are also logged at HAL
+ * close. Exposing them to other processes needs a new version of the
+ * vendor interface. */
+#define HAL_NFC_IOCTL_PRIV_BASE 0x1000
+/* p_data: phNxpNciHal_LockStatsSnapshot_t*, filled */
+#define HAL_NFC_IOCTL_GET_LOCK_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x01)
+/* p_data: unused */
+#define HAL_NFC_IOCTL_RESET_LOCK_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x02)
+/* p_data: phNxpNciHal_BootTiming_t*, filled */
+#define HAL_NFC_IOCTL_GET_BOOT_TIMING (HAL_NFC_IOCTL_PRIV_BASE + 0x03)
+/* p_data: phDal4Nfc_MsgQStats_t*, filled, of the client thread queue */
+#define HAL_NFC_IOCTL_GET_MSGQ_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x04)
+/* p_data: phNxpNciHal_JitterProbe_t*, in and out, blocks while it runs */
+#define HAL_NFC_IOCTL_RUN_JITTER_PROBE (HAL_NFC_IOCTL_PRIV_BASE + 0x05)
+/* p_data: NfccWriteStats_t*, filled, of the NFCC transport */
+#define HAL_NFC_IOCTL_GET_WRITE_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x06)
+/* p_data: NfccReadStats_t*, filled, of the NFCC transport */
+#define HAL_NFC_IOCTL_GET_READ_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x07)
+/* p_data: phNxpNciHal_LatencySnapshot_t*, filled */
+#define HAL_NFC_IOCTL_GET_LATENCY_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x08)
+/* p_data: unused */
+#define HAL_NFC_IOCTL_RESET_LATENCY_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x09)
+/* p_data: phNxpNciHal_LivenessStats_t*, filled */
+#define HAL_NFC_IOCTL_GET_LIVENESS_STATS (HAL_NFC_IOCTL_PRIV_BASE + 0x0A)
+
 /******************************************************************************
  ** Function         phNxpNciHal_ioctlIf
  **
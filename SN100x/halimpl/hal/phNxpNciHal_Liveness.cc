@@ -0,0 +1,528 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <phNxpConfig.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal.h>
+#include <phNxpNciHal_LatencyStats.h>
+#include <phNxpNciHal_Liveness.h>
+#include <phNxpNciHal_ext.h>
+#include <phTmlNfc.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+
+#define PH_NXP_LIVENESS_MAGIC 0x4E564C48 /* "HLVN" */
+/* text UUID, without the new line */
+#define PH_NXP_LIVENESS_BOOT_ID_LEN 36
+
+/* Hang detection kept across the process restart done by the recovery */
+typedef struct {
+  uint32_t dwMagic;
+  uint32_t dwDetectMs;
+  uint64_t qwDetectBootNs;
+  char boot_id[PH_NXP_LIVENESS_BOOT_ID_LEN]; /* boot of the detection */
+} phNxpNciHal_LivenessRecord_t;
+
+typedef enum {
+  PH_NXP_LIVENESS_PROBE_OK,
+  PH_NXP_LIVENESS_PROBE_MISSED,  /* no response in time */
+  PH_NXP_LIVENESS_PROBE_PENDING, /* a command waits for its response */
+  PH_NXP_LIVENESS_PROBE_BUSY,    /* another command is being sent */
+  PH_NXP_LIVENESS_PROBE_SKIPPED  /* HAL closed or FW download */
+} phNxpNciHal_LivenessProbe_t;
+
+extern phNxpNciHal_Control_t nxpncihal_ctrl;
+
+static_assert(PH_NXP_LIVENESS_MIN_STALL_MS > HAL_EXTNS_WRITE_RSP_TIMEOUT,
+              "a pending command must time out in the HAL first");
+
+/* CORE_GET_CONFIG_CMD of TOTAL_DURATION */
+static const uint8_t sProbeCmd[] = {0x20, 0x03, 0x02, 0x01, 0x00};
+
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sCond;
+static pthread_t sThread;
+static bool sRunning = false;
+static bool sStopping = false;
+static uint32_t sTimeoutMs = PH_NXP_LIVENESS_PROBE_TIMEOUT_MS_DEF;
+static uint32_t sMaxMisses = PH_NXP_LIVENESS_MAX_MISSES_DEF;
+static uint32_t sStallMs = PH_NXP_LIVENESS_MIN_STALL_MS;
+static std::atomic<uint64_t> sLastRxUs(0);
+/* under sLock */
+static phNxpNciHal_LivenessStats_t sStats;
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessBootNs
+**
+** Description      Returns CLOCK_BOOTTIME, which keeps counting across
+**                  process restarts and suspend.
+**
+** Returns          Time in ns
+**
+*******************************************************************************/
+static uint64_t phNxpNciHal_livenessBootNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_BOOTTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessBootId
+**
+** Description      Reads the id of the current boot.
+**
+** Returns          true if pBootId, PH_NXP_LIVENESS_BOOT_ID_LEN bytes, is set
+**
+*******************************************************************************/
+static bool phNxpNciHal_livenessBootId(char* pBootId) {
+  ssize_t len;
+  int fd;
+
+  fd = open(PH_NXP_LIVENESS_BOOT_ID_FILE, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  len = read(fd, pBootId, PH_NXP_LIVENESS_BOOT_ID_LEN);
+  close(fd);
+  return (len == PH_NXP_LIVENESS_BOOT_ID_LEN);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessLoadRecord
+**
+** Description      Takes back the hang left by the previous HAL session, if
+**                  any, and accounts for its recovery time. A record of an
+**                  earlier boot is dropped.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_livenessLoadRecord(void) {
+  phNxpNciHal_LivenessRecord_t record;
+  char boot_id[PH_NXP_LIVENESS_BOOT_ID_LEN];
+  uint64_t qwNowNs;
+  uint32_t dwRecoveryMs;
+  ssize_t len;
+  int fd;
+
+  fd = open(PH_NXP_LIVENESS_FILE, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  len = read(fd, &record, sizeof(record));
+  close(fd);
+  unlink(PH_NXP_LIVENESS_FILE);
+  qwNowNs = phNxpNciHal_livenessBootNs();
+  if (len != (ssize_t)sizeof(record) ||
+      record.dwMagic != PH_NXP_LIVENESS_MAGIC ||
+      !phNxpNciHal_livenessBootId(boot_id) ||
+      memcmp(record.boot_id, boot_id, sizeof(boot_id)) != 0 ||
+      record.qwDetectBootNs > qwNowNs) {
+    NXPLOG_NCIHAL_D("Liveness: record of another boot dropped");
+    return;
+  }
+  dwRecoveryMs = (uint32_t)((qwNowNs - record.qwDetectBootNs) / 1000000);
+  sStats.dwRecoveries++;
+  sStats.dwLastRecoveryMs = dwRecoveryMs;
+  sStats.dwMaxRecoveryMs = std::max(sStats.dwMaxRecoveryMs, dwRecoveryMs);
+  NXPLOG_NCIHAL_E("Liveness: NFCC hang detected in %u ms, recovered in %u ms",
+                  record.dwDetectMs, dwRecoveryMs);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessProbe
+**
+** Description      Sends the probe command, unless the link is busy. Holds
+**                  the concurrency lock while doing so, so that commands of
+**                  libnfc-nci wait for the probe, which is short unless the
+**                  NFCC is hung.
+**
+** Returns          phNxpNciHal_LivenessProbe_t, probe round trip time in
+**                  pRttUs
+**
+*******************************************************************************/
+static phNxpNciHal_LivenessProbe_t phNxpNciHal_livenessProbe(
+    uint32_t* pRttUs) {
+  phNxpNciHal_Monitor_t* pMonitor = phNxpNciHal_get_monitor();
+  uint8_t cmd[sizeof(sProbeCmd)];
+  uint8_t rsp[NCI_MAX_DATA_LEN];
+  uint16_t rspLen = 0;
+  uint64_t startUs;
+  NFCSTATUS status;
+  int sem_val = 0;
+
+  if (pMonitor == NULL || nxpncihal_ctrl.halStatus != HAL_STATUS_OPEN ||
+      nxpncihal_ctrl.fwdnld_mode_reqd || phTmlNfc_IsFwDnldModeEnabled()) {
+    return PH_NXP_LIVENESS_PROBE_SKIPPED;
+  }
+  if (pthread_mutex_trylock(&pMonitor->concurrency_mutex) != 0) {
+    return PH_NXP_LIVENESS_PROBE_BUSY;
+  }
+  sem_getvalue(&(nxpncihal_ctrl.syncSpiNfc), &sem_val);
+  if (sem_val == 0) {
+    pthread_mutex_unlock(&pMonitor->concurrency_mutex);
+    return PH_NXP_LIVENESS_PROBE_PENDING;
+  }
+  memcpy(cmd, sProbeCmd, sizeof(cmd));
+  startUs = phNxpNciHal_latencyNowUs();
+  status = phNxpNciHal_exec_ext_cmd(sizeof(cmd), cmd, sTimeoutMs, &rspLen, rsp);
+  *pRttUs = (uint32_t)(phNxpNciHal_latencyNowUs() - startUs);
+  pthread_mutex_unlock(&pMonitor->concurrency_mutex);
+
+  /* any response tells the NFCC is alive, whatever its status */
+  if (status == NFCSTATUS_SUCCESS && rspLen >= NCI_HEADER_SIZE &&
+      rsp[0] == 0x40 && rsp[1] == 0x03) {
+    return PH_NXP_LIVENESS_PROBE_OK;
+  }
+  NXPLOG_NCIHAL_E("Liveness: probe failed, status 0x%x after %u us", status,
+                  *pRttUs);
+  return PH_NXP_LIVENESS_PROBE_MISSED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessRecover
+**
+** Description      Hands the hang to the recovery under the concurrency lock,
+**                  as write_unlocked does, so that it does not run alongside
+**                  a command of libnfc-nci. Nothing is done if the HAL was
+**                  closed, or write_unlocked recovered, in the meantime.
+**
+** Parameters       hangs - hang count when the hang was detected
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_livenessRecover(uint32_t hangs) {
+  phNxpNciHal_Monitor_t* pMonitor = phNxpNciHal_get_monitor();
+  bool recovered;
+
+  if (pMonitor == NULL) return;
+  pthread_mutex_lock(&pMonitor->concurrency_mutex);
+  pthread_mutex_lock(&sLock);
+  recovered = (sStats.dwHangs != hangs);
+  pthread_mutex_unlock(&sLock);
+  if (!recovered && nxpncihal_ctrl.halStatus == HAL_STATUS_OPEN) {
+    phNxpNciHal_nfccHangRecovery();
+  }
+  pthread_mutex_unlock(&pMonitor->concurrency_mutex);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessWait
+**
+** Description      Waits until qwUntilUs or until the monitor is stopped.
+**                  Called with sLock held.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_livenessWait(uint64_t qwUntilUs) {
+  struct timespec ts;
+
+  ts.tv_sec = qwUntilUs / 1000000;
+  ts.tv_nsec = (qwUntilUs % 1000000) * 1000;
+  pthread_cond_timedwait(&sCond, &sLock, &ts);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessThread
+**
+** Description      Probes the NFCC once the link was idle for the configured
+**                  time and hands a hang to the recovery. Stops after a
+**                  hang, the next HAL session starts a new monitor.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phNxpNciHal_livenessThread(void* arg) {
+  phNxpNciHal_LivenessProbe_t result;
+  uint64_t qwIdleUs = (uint64_t)sStats.dwIdleMs * 1000;
+  uint64_t qwStallUs = (uint64_t)sStallMs * 1000;
+  uint64_t qwNextUs = 0;
+  uint64_t qwPendingUs = 0; /* pending command first seen */
+  uint64_t qwNowUs, qwLastRxUs;
+  uint32_t misses = 0;
+  uint32_t rttUs = 0;
+  uint32_t hangs;
+  bool hung = false;
+  bool recovered = false;
+  UNUSED_PROP(arg);
+
+  pthread_mutex_lock(&sLock);
+  while (!sStopping && !hung && !recovered) {
+    qwNowUs = phNxpNciHal_latencyNowUs();
+    if (qwNowUs < qwNextUs) {
+      phNxpNciHal_livenessWait(qwNextUs);
+      continue;
+    }
+    qwLastRxUs = sLastRxUs.load(std::memory_order_relaxed);
+    if (misses == 0 && qwNowUs < qwLastRxUs + qwIdleUs) {
+      qwNextUs = qwLastRxUs + qwIdleUs;
+      continue;
+    }
+    hangs = sStats.dwHangs;
+    pthread_mutex_unlock(&sLock);
+    result = phNxpNciHal_livenessProbe(&rttUs);
+    pthread_mutex_lock(&sLock);
+    qwNowUs = phNxpNciHal_latencyNowUs();
+    /* the probe could not be written, write_unlocked did the recovery */
+    recovered = (sStats.dwHangs != hangs);
+
+    if (result != PH_NXP_LIVENESS_PROBE_PENDING) qwPendingUs = 0;
+    switch (result) {
+      case PH_NXP_LIVENESS_PROBE_OK:
+        misses = 0;
+        sStats.dwProbes++;
+        sStats.dwProbeRttLastUs = rttUs;
+        sStats.dwProbeRttMaxUs = std::max(sStats.dwProbeRttMaxUs, rttUs);
+        qwNextUs = qwNowUs + qwIdleUs;
+        break;
+      case PH_NXP_LIVENESS_PROBE_MISSED:
+        sStats.dwProbes++;
+        sStats.dwProbeMisses++;
+        hung = (++misses >= sMaxMisses);
+        break;
+      case PH_NXP_LIVENESS_PROBE_PENDING:
+        /* the NFCC stayed silent since the command was seen pending */
+        if (qwPendingUs == 0 ||
+            sLastRxUs.load(std::memory_order_relaxed) >= qwPendingUs) {
+          qwPendingUs = qwNowUs;
+        }
+        hung = (qwNowUs - qwPendingUs >= qwStallUs);
+        qwNextUs = qwNowUs + PH_NXP_LIVENESS_BUSY_RETRY_MS * 1000;
+        break;
+      case PH_NXP_LIVENESS_PROBE_BUSY:
+        qwNextUs = qwNowUs + PH_NXP_LIVENESS_BUSY_RETRY_MS * 1000;
+        break;
+      default:
+        misses = 0;
+        qwNextUs = qwNowUs + qwIdleUs;
+        break;
+    }
+  }
+  pthread_mutex_unlock(&sLock);
+
+  if (hung) {
+    NXPLOG_NCIHAL_E("Liveness: NFCC hung, %u probes missed", misses);
+    phNxpNciHal_livenessRecover(hangs);
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessStart
+**
+** Description      Accounts for the recovery of a previous hang and starts
+**                  the monitor if NXP_LIVENESS_IDLE_MS is set. Called on HAL
+**                  open.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_livenessStart(void) {
+  pthread_condattr_t attr;
+  unsigned long num = 0;
+
+  pthread_mutex_lock(&sLock);
+  phNxpNciHal_livenessLoadRecord();
+  if (sRunning) goto clean_and_return;
+  sStats.dwIdleMs = 0;
+  if (!GetNxpNumValue(NAME_NXP_LIVENESS_IDLE_MS, &num, sizeof(num)) ||
+      num == 0) {
+    goto clean_and_return;
+  }
+  sStats.dwIdleMs = (uint32_t)num;
+  sTimeoutMs = PH_NXP_LIVENESS_PROBE_TIMEOUT_MS_DEF;
+  if (GetNxpNumValue(NAME_NXP_LIVENESS_PROBE_TIMEOUT_MS, &num, sizeof(num)) &&
+      num != 0) {
+    sTimeoutMs = (uint32_t)num;
+  }
+  sMaxMisses = PH_NXP_LIVENESS_MAX_MISSES_DEF;
+  if (GetNxpNumValue(NAME_NXP_LIVENESS_MAX_MISSES, &num, sizeof(num)) &&
+      num != 0) {
+    sMaxMisses = (uint32_t)num;
+  }
+  /* a pending command is left to the HAL and libnfc-nci timeouts first */
+  sStallMs = std::max(sMaxMisses * sTimeoutMs,
+                      (uint32_t)PH_NXP_LIVENESS_MIN_STALL_MS);
+  sStats.dwBoundMs =
+      sStats.dwIdleMs + std::max(sMaxMisses * sTimeoutMs,
+                                 sStallMs + PH_NXP_LIVENESS_BUSY_RETRY_MS);
+
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&sCond, &attr);
+  pthread_condattr_destroy(&attr);
+  /* idle time counts from the open */
+  sLastRxUs.store(phNxpNciHal_latencyNowUs(), std::memory_order_relaxed);
+  sStopping = false;
+  if (pthread_create(&sThread, NULL, phNxpNciHal_livenessThread, NULL) != 0) {
+    NXPLOG_NCIHAL_E("Liveness: pthread_create failed");
+    pthread_cond_destroy(&sCond);
+    sStats.dwIdleMs = 0;
+    goto clean_and_return;
+  }
+  sRunning = true;
+  NXPLOG_NCIHAL_D("Liveness: probe after %u ms idle, hang detected within %u ms",
+                  sStats.dwIdleMs, sStats.dwBoundMs);
+
+clean_and_return:
+  pthread_mutex_unlock(&sLock);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessStop
+**
+** Description      Stops the monitor. Called on HAL close, before the link
+**                  is torn down; waits for a probe in flight.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_livenessStop(void) {
+  pthread_mutex_lock(&sLock);
+  if (!sRunning) {
+    pthread_mutex_unlock(&sLock);
+    return;
+  }
+  sStopping = true;
+  pthread_cond_signal(&sCond);
+  pthread_mutex_unlock(&sLock);
+
+  pthread_join(sThread, NULL);
+  pthread_mutex_lock(&sLock);
+  pthread_cond_destroy(&sCond);
+  sRunning = false;
+  pthread_mutex_unlock(&sLock);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessOnRx
+**
+** Description      Records that the NFCC sent a packet at qwRxUs. Called for
+**                  each packet read.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_livenessOnRx(uint64_t qwRxUs) {
+  sLastRxUs.store(qwRxUs, std::memory_order_relaxed);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessOnHang
+**
+** Description      Accounts for a hang about to be recovered and keeps its
+**                  detection time in PH_NXP_LIVENESS_FILE for the next HAL
+**                  open. Called by phNxpNciHal_nfccHangRecovery, whatever
+**                  detected the hang.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_livenessOnHang(void) {
+  phNxpNciHal_LivenessRecord_t record;
+  uint64_t qwNowUs = phNxpNciHal_latencyNowUs();
+  uint64_t qwLastRxUs = sLastRxUs.load(std::memory_order_relaxed);
+  int fd;
+
+  memset(&record, 0x00, sizeof(record));
+  record.dwMagic = PH_NXP_LIVENESS_MAGIC;
+  record.dwDetectMs =
+      (qwLastRxUs != 0 && qwNowUs > qwLastRxUs)
+          ? (uint32_t)((qwNowUs - qwLastRxUs) / 1000)
+          : 0;
+  record.qwDetectBootNs = phNxpNciHal_livenessBootNs();
+
+  pthread_mutex_lock(&sLock);
+  sStats.dwHangs++;
+  sStats.dwLastDetectMs = record.dwDetectMs;
+  sStats.dwMaxDetectMs = std::max(sStats.dwMaxDetectMs, record.dwDetectMs);
+  pthread_mutex_unlock(&sLock);
+  NXPLOG_NCIHAL_E("Liveness: NFCC hang detected %u ms after its last packet",
+                  record.dwDetectMs);
+  if (!phNxpNciHal_livenessBootId(record.boot_id)) {
+    NXPLOG_NCIHAL_E("Liveness: boot id unknown, hang not kept");
+    return;
+  }
+
+  fd = open(PH_NXP_LIVENESS_FILE, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+            0600);
+  if (fd < 0) {
+    NXPLOG_NCIHAL_E("Liveness: unable to open %s, errno = %d",
+                    PH_NXP_LIVENESS_FILE, errno);
+    return;
+  }
+  if (write(fd, &record, sizeof(record)) != (ssize_t)sizeof(record)) {
+    NXPLOG_NCIHAL_E("Liveness: unable to write %s", PH_NXP_LIVENESS_FILE);
+  }
+  close(fd);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessStatsGet
+**
+** Description      Copies the liveness monitor counters to pStats.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_livenessStatsGet(phNxpNciHal_LivenessStats_t* pStats) {
+  pthread_mutex_lock(&sLock);
+  *pStats = sStats;
+  pthread_mutex_unlock(&sLock);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_livenessStatsLog
+**
+** Description      Logs the liveness monitor counters. Called on HAL close.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_livenessStatsLog(void) {
+  phNxpNciHal_LivenessStats_t stats;
+
+  phNxpNciHal_livenessStatsGet(&stats);
+  if (stats.dwProbes == 0 && stats.dwHangs == 0 && stats.dwRecoveries == 0)
+    return;
+  NXPLOG_NCIHAL_D(
+      "Liveness: %u probes, %u missed, rtt last %u max %u us; %u hangs, "
+      "detected in last %u max %u ms; %u recoveries, last %u max %u ms",
+      stats.dwProbes, stats.dwProbeMisses, stats.dwProbeRttLastUs,
+      stats.dwProbeRttMaxUs, stats.dwHangs, stats.dwLastDetectMs,
+      stats.dwMaxDetectMs, stats.dwRecoveries, stats.dwLastRecoveryMs,
+      stats.dwMaxRecoveryMs);
+}
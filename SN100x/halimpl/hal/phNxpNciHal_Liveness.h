@@ -0,0 +1,81 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * NFCC liveness monitor, enabled by NXP_LIVENESS_IDLE_MS.
+ *
+ * Once nothing was read from the NFCC for NXP_LIVENESS_IDLE_MS, a
+ * CORE_GET_CONFIG_CMD is sent as probe. A busy link is never probed and an
+ * idle one at most once per NXP_LIVENESS_IDLE_MS, so an NFCC in standby is
+ * woken up no more often than that. The NFCC is declared hung when
+ * NXP_LIVENESS_MAX_MISSES probes in a row got no response within
+ * NXP_LIVENESS_PROBE_TIMEOUT_MS, or when a command of libnfc-nci stays
+ * unanswered for as long. A hang is thus detected at most
+ * NXP_LIVENESS_IDLE_MS + NXP_LIVENESS_MAX_MISSES *
+ * NXP_LIVENESS_PROBE_TIMEOUT_MS after the last packet of the NFCC, and
+ * handed to phNxpNciHal_nfccHangRecovery under the concurrency lock.
+ *
+ * The detection time of a hang is kept in PH_NXP_LIVENESS_FILE, as recovery
+ * may restart the process; the next HAL open takes it back to measure the
+ * recovery time.
+ */
+
+#ifndef _PHNXPNCIHAL_LIVENESS_H_
+#define _PHNXPNCIHAL_LIVENESS_H_
+
+#include <stdint.h>
+
+#ifndef PH_NXP_LIVENESS_FILE
+#define PH_NXP_LIVENESS_FILE "/data/vendor/nfc/nxp_liveness.bin"
+#endif
+#define PH_NXP_LIVENESS_BOOT_ID_FILE "/proc/sys/kernel/random/boot_id"
+#define PH_NXP_LIVENESS_PROBE_TIMEOUT_MS_DEF 500
+#define PH_NXP_LIVENESS_MAX_MISSES_DEF 2
+/* Wait before checking again a link found busy */
+#define PH_NXP_LIVENESS_BUSY_RETRY_MS 100
+/* NFC_CMD_CMPL_TIMEOUT of libnfc-nci */
+#define PH_NXP_LIVENESS_LIBNFC_CMD_TIMEOUT_MS 2000
+/* A pending command is a hang only once both the HAL
+ * (HAL_EXTNS_WRITE_RSP_TIMEOUT) and libnfc-nci gave up on it */
+#define PH_NXP_LIVENESS_MIN_STALL_MS \
+  (PH_NXP_LIVENESS_LIBNFC_CMD_TIMEOUT_MS + 500)
+
+/* Snapshot returned by HAL_NFC_IOCTL_GET_LIVENESS_STATS */
+typedef struct {
+  uint32_t dwIdleMs; /* 0 when the monitor is disabled */
+  uint32_t dwBoundMs; /* worst case detection time */
+  uint32_t dwProbes;
+  uint32_t dwProbeMisses;
+  uint32_t dwProbeRttLastUs;
+  uint32_t dwProbeRttMaxUs;
+  uint32_t dwHangs; /* detected by this process */
+  uint32_t dwLastDetectMs; /* last packet of the NFCC to hang detection */
+  uint32_t dwMaxDetectMs;
+  uint32_t dwRecoveries; /* hangs recovered from, by HAL open */
+  uint32_t dwLastRecoveryMs; /* hang detection to HAL open */
+  uint32_t dwMaxRecoveryMs;
+} phNxpNciHal_LivenessStats_t;
+
+void phNxpNciHal_livenessStart(void);
+void phNxpNciHal_livenessStop(void);
+void phNxpNciHal_livenessOnRx(uint64_t qwRxUs);
+void phNxpNciHal_livenessOnHang(void);
+void phNxpNciHal_livenessStatsGet(phNxpNciHal_LivenessStats_t* pStats);
+void phNxpNciHal_livenessStatsLog(void);
+
+#endif /* _PHNXPNCIHAL_LIVENESS_H_ */
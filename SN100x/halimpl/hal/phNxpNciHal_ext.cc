@@ -19,6 +19,8 @@
 #include <phNxpLog.h>
 #include <phNxpNciHal.h>
 #include <phNxpNciHal_Adaptation.h>
+#include <phNxpNciHal_ConfigReload.h>
+#include <phNxpNciHal_ConfigSnapshot.h>
 #include <phNxpNciHal_NfcDepSWPrio.h>
 #include <phNxpNciHal_ext.h>
 #include <phTmlNfc.h>
@@ -28,8 +30,6 @@
 #include "phNxpNciHal_IoctlOperations.h"
 #include "phNxpNciHal_nciParser.h"
 #endif
-/* Timeout value to wait for response from PN548AD */
-#define HAL_EXTNS_WRITE_RSP_TIMEOUT (1000)
 #define NCI_NFC_DEP_RF_INTF 0x03
 #define NCI_STATUS_OK 0x00
 #define NCI_MODE_HEADER_LEN 3
@@ -66,6 +66,9 @@ static uint32_t bCoreInitRsp[40];
 static uint32_t iCoreInitRspLen;
 
 extern uint32_t timeoutTimerId;
+/* Serializes the extension commands, which share ext_cb_data, the response
+ * timer and p_cmd_data */
+static pthread_mutex_t sExtCmdLock = PTHREAD_MUTEX_INITIALIZER;
 
 /************** HAL extension functions ***************************************/
 static void hal_extns_write_rsp_timeout_cb(uint32_t TimerId, void* pContext);
@@ -81,6 +84,89 @@ static void hal_extns_write_rsp_timeout_cb(uint32_t TimerId, void* pContext);
 static uint8_t gFelicaReaderMode;
 static bool mfc_mode = false;
 
+/* NCI extension dispatch.
+ * Every extension is described by one row: the header bytes it applies to,
+ * the chip/configuration it is relevant for and its handler. The rows of each
+ * direction are compiled once into two 256 entry lookup masks indexed by the
+ * first and second header byte, so a packet only visits the handlers that
+ * can apply to it. Rows run in table order; rows that share a chain behave
+ * as an if/else-if chain, the first matching handler skips the rest. */
+#define NCI_EXT_HDR_KEYS 0x100
+#define NCI_EXT_MAX_ROWS 32
+#define NCI_EXT_NO_CHAIN 0
+#define NCI_EXT_CHAIN_1 1
+#define NCI_EXT_CHAIN_2 2
+#define NCI_EXT_MAX_CHAINS 3
+/* header byte value and mask pairs of a row */
+#define NCI_EXT_KEY(b0, b1) (b0), 0xFF, (b1), 0xFF
+#define NCI_EXT_KEY_OID(b0, oid) (b0), 0xFF, (oid), NCI_OID_MASK
+#define NCI_EXT_KEY_B0(b0) (b0), 0xFF, 0x00, 0x00
+#define NCI_EXT_KEY_B1(b1) 0x00, 0x00, (b1), 0xFF
+#define NCI_EXT_KEY_ANY 0x00, 0x00, 0x00, 0x00
+/* data packet of a connection, either PBF value */
+#define NCI_EXT_KEY_CONN(conn) (conn), 0xEF, 0x00, 0x00
+/* static HCI connection of NCI 2.0 */
+#define NCI_EXT_STATIC_HCI_CONN 0x01
+
+typedef enum {
+  NCI_EXT_NOT_MATCHED = 0, /* continue with the next row */
+  NCI_EXT_MATCHED,         /* skip the remaining rows of the chain */
+  NCI_EXT_DONE             /* stop processing of the packet */
+} phNxpNciHal_ExtResult_t;
+
+/* Feature classes; the ones from NCI_EXT_FL_FIRST_GATED on are further
+ * gated per packet by a runtime state, so that the rows matching any header
+ * only run while their feature is active */
+enum {
+  NCI_EXT_FL_ALL = 0,
+  NCI_EXT_FL_PRE_SN100U,
+  NCI_EXT_FL_MFC_EXTNS,
+  NCI_EXT_FL_MFC_READER,
+  NCI_EXT_FL_DTA,              /* DTA mode enabled */
+  NCI_EXT_FL_ICODE,            /* ISO 15693 tag activated */
+  NCI_EXT_FL_PRE_SN100U_ICODE, /* same, chip older than SN100U */
+  NCI_EXT_FL_P2P_PRIO,         /* P2P priority logic enabled */
+  NCI_EXT_FL_MAX
+};
+#define NCI_EXT_FL_FIRST_GATED NCI_EXT_FL_DTA
+
+typedef struct {
+  uint8_t* p_data;
+  uint16_t* p_len;
+  uint16_t* p_rsp_len;
+  uint8_t* p_rsp_data;
+  NFCSTATUS status;
+} phNxpNciHal_ExtPkt_t;
+
+typedef phNxpNciHal_ExtResult_t (*phNxpNciHal_ExtHandler_t)(
+    phNxpNciHal_ExtPkt_t* pkt);
+
+typedef struct {
+  uint8_t hdr0;
+  uint8_t hdr0_mask;
+  uint8_t hdr1;
+  uint8_t hdr1_mask;
+  uint8_t chain;
+  uint8_t feature;
+  phNxpNciHal_ExtHandler_t handler;
+} phNxpNciHal_ExtRow_t;
+
+typedef struct {
+  const phNxpNciHal_ExtRow_t* p_rows;
+  uint8_t num_rows;
+  uint32_t hdr0[NCI_EXT_HDR_KEYS];
+  uint32_t hdr1[NCI_EXT_HDR_KEYS];
+  uint32_t chain[NCI_EXT_MAX_CHAINS];
+  uint32_t feature[NCI_EXT_FL_MAX];
+  uint32_t gated;
+  uint32_t enabled;
+} phNxpNciHal_ExtTable_t;
+
+static phNxpNciHal_ExtTable_t sExtRspTable;
+static phNxpNciHal_ExtTable_t sExtCmdTable;
+static pthread_once_t sExtDispatchOnce = PTHREAD_ONCE_INIT;
+static void phNxpNciHal_ext_build_dispatch(void);
+
 static NFCSTATUS phNxpNciHal_ext_process_nfc_init_rsp(uint8_t* p_ntf,
                                                       uint16_t* p_len);
 static void RemoveNfcDepIntfFromInitResp(uint8_t* coreInitResp,
@@ -99,6 +185,7 @@ void phNxpNciHal_ext_init(void) {
   }
   setEEModeDone = 0x00;
   EnableP2P_PrioLogic = false;
+  phNxpNciHal_ext_register_handlers();
 }
 
 /*******************************************************************************
@@ -121,24 +208,197 @@ NFCSTATUS phNxpNciHal_ext_send_sram_config_to_flash() {
 }
 /*******************************************************************************
 **
-** Function         phNxpNciHal_process_ext_rsp
+** Function         phNxpNciHal_ext_active_rows
 **
-** Description      Process extension function response
+** Description      Collects the gated rows whose runtime state is active.
 **
-** Returns          NFCSTATUS_SUCCESS if success
+** Returns          Mask of the active gated rows
 **
 *******************************************************************************/
-NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len) {
-  NFCSTATUS status = NFCSTATUS_SUCCESS;
+static uint32_t phNxpNciHal_ext_active_rows(
+    const phNxpNciHal_ExtTable_t* p_table) {
+  uint32_t active = 0;
+  if (phNxpDta_IsEnable() == true) active |= p_table->feature[NCI_EXT_FL_DTA];
+  if (icode_detected == 1)
+    active |= p_table->feature[NCI_EXT_FL_ICODE] |
+              p_table->feature[NCI_EXT_FL_PRE_SN100U_ICODE];
+  if (EnableP2P_PrioLogic == true)
+    active |= p_table->feature[NCI_EXT_FL_P2P_PRIO];
+  return active;
+}
 
-#if(NXP_EXTNS == TRUE)
-  /*parse and decode LxDebug Notifications*/
-  if(p_ntf[0] == 0x6F && (p_ntf[1] == 0x35 || p_ntf[1] == 0x36))
-  {
-    if(gParserCreated)
-      phNxpNciHal_parsePacket(p_ntf,*p_len);
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_candidates
+**
+** Description      Finds the rows that apply to a packet with one lookup on
+**                  each of the two header bytes (MT/PBF/GID and OID); rows
+**                  disabled for the current chip or configuration and gated
+**                  rows whose feature is not active are left out.
+**
+** Returns          Mask of the rows to run
+**
+*******************************************************************************/
+static uint32_t phNxpNciHal_ext_candidates(
+    const phNxpNciHal_ExtTable_t* p_table, const uint8_t* p_data) {
+  uint32_t rows = p_table->hdr0[p_data[0]] & p_table->hdr1[p_data[1]] &
+                  p_table->enabled;
+  if ((rows & p_table->gated) != 0)
+    rows &= ~p_table->gated | phNxpNciHal_ext_active_rows(p_table);
+  return rows;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_dispatch
+**
+** Description      Runs the extension rows that apply to the packet described
+**                  by pkt, see phNxpNciHal_ext_candidates.
+**
+** Returns          Status set by the handlers, NFCSTATUS_SUCCESS if none
+**
+*******************************************************************************/
+static NFCSTATUS phNxpNciHal_ext_dispatch(phNxpNciHal_ExtTable_t* p_table,
+                                          phNxpNciHal_ExtPkt_t* pkt) {
+  uint32_t rows;
+  uint8_t index;
+
+  pthread_once(&sExtDispatchOnce, phNxpNciHal_ext_build_dispatch);
+  rows = phNxpNciHal_ext_candidates(p_table, pkt->p_data);
+  while (rows != 0) {
+    index = __builtin_ctz(rows);
+    rows &= (rows - 1);
+    switch (p_table->p_rows[index].handler(pkt)) {
+      case NCI_EXT_MATCHED:
+        rows &= ~p_table->chain[p_table->p_rows[index].chain];
+        break;
+      case NCI_EXT_DONE:
+        return pkt->status;
+      default:
+        break;
+    }
+  }
+  return pkt->status;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_build_table
+**
+** Description      Compiles the rows of one direction into the per header
+**                  byte lookup masks, the chain masks and the feature masks.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_ext_build_table(phNxpNciHal_ExtTable_t* p_table,
+                                        const phNxpNciHal_ExtRow_t* p_rows,
+                                        uint8_t num_rows) {
+  memset(p_table, 0x00, sizeof(phNxpNciHal_ExtTable_t));
+  p_table->p_rows = p_rows;
+  p_table->num_rows = num_rows;
+  for (uint8_t i = 0; i < num_rows; i++) {
+    uint32_t bit = (1U << i);
+    for (uint16_t val = 0; val < NCI_EXT_HDR_KEYS; val++) {
+      if ((val & p_rows[i].hdr0_mask) == p_rows[i].hdr0)
+        p_table->hdr0[val] |= bit;
+      if ((val & p_rows[i].hdr1_mask) == p_rows[i].hdr1)
+        p_table->hdr1[val] |= bit;
+    }
+    if (p_rows[i].chain != NCI_EXT_NO_CHAIN) p_table->chain[p_rows[i].chain] |= bit;
+    p_table->feature[p_rows[i].feature] |= bit;
+    if (p_rows[i].feature >= NCI_EXT_FL_FIRST_GATED) p_table->gated |= bit;
+  }
+  p_table->enabled = (num_rows < NCI_EXT_MAX_ROWS) ? ((1U << num_rows) - 1)
+                                                   : 0xFFFFFFFF;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_feature_enabled
+**
+** Description      Tells whether rows of the given feature class apply to the
+**                  current chip and configuration.
+**
+** Returns          true if the rows shall be dispatched
+**
+*******************************************************************************/
+static bool phNxpNciHal_ext_feature_enabled(uint8_t feature) {
+  switch (feature) {
+    case NCI_EXT_FL_PRE_SN100U:
+    case NCI_EXT_FL_PRE_SN100U_ICODE:
+      return (nfcFL.chipType < sn100u);
+    case NCI_EXT_FL_MFC_EXTNS:
+      return bDisableLegacyMfcExtns;
+    case NCI_EXT_FL_MFC_READER:
+      return bEnableMfcReader;
+    default:
+      return true;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_register_table
+**
+** Description      Enables the rows of one direction according to their
+**                  feature class.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_ext_register_table(phNxpNciHal_ExtTable_t* p_table) {
+  uint32_t enabled = 0;
+  for (uint8_t i = 0; i < p_table->num_rows; i++) {
+    if (phNxpNciHal_ext_feature_enabled(p_table->p_rows[i].feature))
+      enabled |= (1U << i);
   }
+  p_table->enabled = enabled;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_register_handlers
+**
+** Description      Registers the extensions which apply to the detected chip
+**                  and to the MIFARE configuration. Called on HAL open and
+**                  each time the feature list is configured.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_ext_register_handlers(void) {
+  pthread_once(&sExtDispatchOnce, phNxpNciHal_ext_build_dispatch);
+  phNxpNciHal_ext_register_table(&sExtRspTable);
+  phNxpNciHal_ext_register_table(&sExtCmdTable);
+}
+
+#if(NXP_EXTNS == TRUE)
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_lx_debug
+**
+** Description      Parses and decodes LxDebug notifications.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_lx_debug(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (gParserCreated) phNxpNciHal_parsePacket(pkt->p_data, *pkt->p_len);
+  return NCI_EXT_MATCHED;
+}
+
 #if(NXP_SRD == TRUE)
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_srd_profile
+**
+** Description      Tracks SRD profile switches reported on the static HCI
+**                  connection and through CORE_GENERIC_ERROR_NTF.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_srd_profile(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
   if (p_ntf[0] == 0x01 && p_ntf[1] == 0x00 && p_ntf[5] == 0x81 &&
       p_ntf[23] == 0x82 && p_ntf[26] == 0xA0 && p_ntf[27] == 0xFE) {
     if (p_ntf[29] == 0x01) {
@@ -150,273 +410,564 @@ NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len) {
             p_ntf[3] == 0xE2){
       nxpprofile_ctrl.profile_type = NFC_FORUM_PROFILE;
   }
+  return NCI_EXT_NOT_MATCHED;
+}
 #endif
 #endif
 
-  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && *p_len < 14) {
-    if(*p_len <= 6) {
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_intf_act_len
+**
+** Description      Drops RF_INTF_ACTIVATED_NTF shorter than its fixed part.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_intf_act_len(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (*pkt->p_len < 14) {
+    if(*pkt->p_len <= 6) {
       android_errorWriteLog(0x534e4554, "118152591");
     }
     NXPLOG_NCIHAL_E("RF_INTF_ACTIVATED_NTF length error!");
-    status = NFCSTATUS_FAILED;
-    return status;
+    pkt->status = NFCSTATUS_FAILED;
+    return NCI_EXT_DONE;
   }
+  return NCI_EXT_NOT_MATCHED;
+}
 
-  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && p_ntf[4] == 0x03 &&
-      p_ntf[5] == 0x05 && nxpprofile_ctrl.profile_type == EMV_CO_PROFILE) {
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_emvco_nfcdep
+**
+** Description      Restarts polling on NFC-DEP activation in EMVCo profile.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_emvco_nfcdep(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (p_ntf[4] == 0x03 && p_ntf[5] == 0x05 &&
+      nxpprofile_ctrl.profile_type == EMV_CO_PROFILE) {
     p_ntf[4] = 0xFF;
     p_ntf[5] = 0xFF;
     p_ntf[6] = 0xFF;
     NXPLOG_NCIHAL_D("Nfc-Dep Detect in EmvCo profile - Restart polling");
   }
+  return NCI_EXT_NOT_MATCHED;
+}
 
-  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && p_ntf[4] == 0x01 &&
-      p_ntf[5] == 0x05 && p_ntf[6] == 0x02 && gFelicaReaderMode) {
-    /*If FelicaReaderMode is enabled,Change Protocol to T3T from NFC-DEP
-         * when FrameRF interface is selected*/
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_felica_reader
+**
+** Description      If FelicaReaderMode is enabled, changes protocol to T3T
+**                  from NFC-DEP when FrameRF interface is selected.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_felica_reader(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (p_ntf[4] == 0x01 && p_ntf[5] == 0x05 && p_ntf[6] == 0x02 &&
+      gFelicaReaderMode) {
     p_ntf[5] = 0x03;
     NXPLOG_NCIHAL_D("FelicaReaderMode:Activity 1.1");
   }
+  return NCI_EXT_NOT_MATCHED;
+}
 
 #ifdef P2P_PRIO_LOGIC_HAL_IMP
-  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && p_ntf[4] == 0x02 &&
-      p_ntf[5] == 0x04 && nxpprofile_ctrl.profile_type == NFC_FORUM_PROFILE) {
-    EnableP2P_PrioLogic = true;
-  }
-
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_p2p_prio
+**
+** Description      P2P priority logic, run while it is enabled.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_p2p_prio(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
   NXPLOG_NCIHAL_D("Is EnableP2P_PrioLogic: 0x0%X", EnableP2P_PrioLogic);
   if (phNxpDta_IsEnable() == false) {
     if ((icode_detected != 1) && (EnableP2P_PrioLogic == true)) {
-      if (phNxpNciHal_NfcDep_comapre_ntf(p_ntf, *p_len) == NFCSTATUS_FAILED) {
-        status = phNxpNciHal_NfcDep_rsp_ext(p_ntf, p_len);
-        if (status != NFCSTATUS_INVALID_PARAMETER) {
-          return status;
+      if (phNxpNciHal_NfcDep_comapre_ntf(p_ntf, *pkt->p_len) == NFCSTATUS_FAILED) {
+        pkt->status = phNxpNciHal_NfcDep_rsp_ext(p_ntf, pkt->p_len);
+        if (pkt->status != NFCSTATUS_INVALID_PARAMETER) {
+          return NCI_EXT_DONE;
         }
       }
     }
   }
-#endif
+  pkt->status = NFCSTATUS_SUCCESS;
+  return NCI_EXT_NOT_MATCHED;
+}
 
-  status = NFCSTATUS_SUCCESS;
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_p2p_detect
+**
+** Description      Enables the P2P priority logic on NFC-DEP activation in
+**                  NFC Forum profile. The gated P2P row was left out of this
+**                  packet, its logic is run from here.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_p2p_detect(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (EnableP2P_PrioLogic == true || p_ntf[4] != 0x02 || p_ntf[5] != 0x04 ||
+      nxpprofile_ctrl.profile_type != NFC_FORUM_PROFILE)
+    return NCI_EXT_NOT_MATCHED;
+  EnableP2P_PrioLogic = true;
+  return phNxpNciHal_ext_rsp_p2p_prio(pkt);
+}
+#endif
 
-  if (bDisableLegacyMfcExtns && bEnableMfcExtns && p_ntf[0] == 0) {
-    if (*p_len < NCI_HEADER_SIZE) {
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_mfc_data
+**
+** Description      Converts MIFARE Classic data received on the static RF
+**                  connection when HAL MFC extensions are in use.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_mfc_data(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (bDisableLegacyMfcExtns && bEnableMfcExtns) {
+    if (*pkt->p_len < NCI_HEADER_SIZE) {
       android_errorWriteLog(0x534e4554, "169258743");
-      return NFCSTATUS_FAILED;
+      pkt->status = NFCSTATUS_FAILED;
+      return NCI_EXT_DONE;
     }
     uint16_t extlen;
-    extlen = *p_len - NCI_HEADER_SIZE;
+    extlen = *pkt->p_len - NCI_HEADER_SIZE;
     NxpMfcReaderInstance.AnalyzeMfcResp(&p_ntf[3], &extlen);
     p_ntf[2] = extlen;
-    *p_len = extlen + NCI_HEADER_SIZE;
+    *pkt->p_len = extlen + NCI_HEADER_SIZE;
   }
+  return NCI_EXT_NOT_MATCHED;
+}
 
-  if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05) {
-    bEnableMfcExtns = false;
-    if (bDisableLegacyMfcExtns && p_ntf[4] == 0x80 && p_ntf[5] == 0x80) {
-      bEnableMfcExtns = true;
-      NXPLOG_NCIHAL_D("NxpNci: RF Interface = Mifare Enable MifareExtns");
-    }
-    switch (p_ntf[4]) {
-      case 0x00:
-        NXPLOG_NCIHAL_D("NxpNci: RF Interface = NFCEE Direct RF");
-        break;
-      case 0x01:
-        NXPLOG_NCIHAL_D("NxpNci: RF Interface = Frame RF");
-        break;
-      case 0x02:
-        NXPLOG_NCIHAL_D("NxpNci: RF Interface = ISO-DEP");
-        break;
-      case 0x03:
-        NXPLOG_NCIHAL_D("NxpNci: RF Interface = NFC-DEP");
-        break;
-      case 0x80:
-        NXPLOG_NCIHAL_D("NxpNci: RF Interface = MIFARE");
-        break;
-      default:
-        NXPLOG_NCIHAL_D("NxpNci: RF Interface = Unknown");
-        break;
-    }
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_mfc_credits
+**
+** Description      Hides from libnfc-nci the credits of MIFARE Classic
+**                  exchanges made by the HAL on its behalf.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_mfc_credits(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (*pkt->p_len >= 6 &&
+      NxpMfcReaderInstance.DropInternalCredits(pkt->p_data)) {
+    pkt->status = NFCSTATUS_FAILED;
+    return NCI_EXT_DONE;
+  }
+  return NCI_EXT_NOT_MATCHED;
+}
 
-    switch (p_ntf[5]) {
-      case 0x01:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = T1T");
-        phNxpDta_T1TEnable();
-        break;
-      case 0x02:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = T2T");
-        break;
-      case 0x03:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = T3T");
-        break;
-      case 0x04:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = ISO-DEP");
-        break;
-      case 0x05:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = NFC-DEP");
-        break;
-      case 0x06:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = 15693");
-        break;
-      case 0x80:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = MIFARE");
-        break;
-      case 0x81:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = Kovio");
-        break;
-      default:
-        NXPLOG_NCIHAL_D("NxpNci: Protocol = Unknown");
-        break;
-    }
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_intf_activated
+**
+** Description      Logs the activated interface, protocol and mode and
+**                  enables MIFARE Classic extensions when applicable.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_intf_activated(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  bEnableMfcExtns = false;
+  NxpMfcReaderInstance.ResetAuthState();
+  if (bDisableLegacyMfcExtns && p_ntf[4] == 0x80 && p_ntf[5] == 0x80) {
+    bEnableMfcExtns = true;
+    NXPLOG_NCIHAL_D("NxpNci: RF Interface = Mifare Enable MifareExtns");
+  }
+  switch (p_ntf[4]) {
+    case 0x00:
+      NXPLOG_NCIHAL_D("NxpNci: RF Interface = NFCEE Direct RF");
+      break;
+    case 0x01:
+      NXPLOG_NCIHAL_D("NxpNci: RF Interface = Frame RF");
+      break;
+    case 0x02:
+      NXPLOG_NCIHAL_D("NxpNci: RF Interface = ISO-DEP");
+      break;
+    case 0x03:
+      NXPLOG_NCIHAL_D("NxpNci: RF Interface = NFC-DEP");
+      break;
+    case 0x80:
+      NXPLOG_NCIHAL_D("NxpNci: RF Interface = MIFARE");
+      break;
+    default:
+      NXPLOG_NCIHAL_D("NxpNci: RF Interface = Unknown");
+      break;
+  }
 
-    switch (p_ntf[6]) {
-      case 0x00:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = A Passive Poll");
-        break;
-      case 0x01:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = B Passive Poll");
-        break;
-      case 0x02:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = F Passive Poll");
-        break;
-      case 0x03:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = A Active Poll");
-        break;
-      case 0x05:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = F Active Poll");
-        break;
-      case 0x06:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = 15693 Passive Poll");
-        break;
-      case 0x70:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = Kovio");
-        break;
-      case 0x80:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = A Passive Listen");
-        break;
-      case 0x81:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = B Passive Listen");
-        break;
-      case 0x82:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = F Passive Listen");
-        break;
-      case 0x83:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = A Active Listen");
-        break;
-      case 0x85:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = F Active Listen");
-        break;
-      case 0x86:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = 15693 Passive Listen");
-        break;
-      default:
-        NXPLOG_NCIHAL_D("NxpNci: Mode = Unknown");
-        break;
-    }
+  switch (p_ntf[5]) {
+    case 0x01:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = T1T");
+      phNxpDta_T1TEnable();
+      break;
+    case 0x02:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = T2T");
+      break;
+    case 0x03:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = T3T");
+      break;
+    case 0x04:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = ISO-DEP");
+      break;
+    case 0x05:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = NFC-DEP");
+      break;
+    case 0x06:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = 15693");
+      break;
+    case 0x80:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = MIFARE");
+      break;
+    case 0x81:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = Kovio");
+      break;
+    default:
+      NXPLOG_NCIHAL_D("NxpNci: Protocol = Unknown");
+      break;
   }
-  phNxpNciHal_ext_process_nfc_init_rsp(p_ntf, p_len);
-  if (p_ntf[0] == NCI_MT_NTF && ((p_ntf[1] & NCI_OID_MASK) == NCI_MSG_CORE_RESET) &&
-    p_ntf[3] == CORE_RESET_TRIGGER_TYPE_POWERED_ON) {
-    status = NFCSTATUS_FAILED;
+
+  switch (p_ntf[6]) {
+    case 0x00:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = A Passive Poll");
+      break;
+    case 0x01:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = B Passive Poll");
+      break;
+    case 0x02:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = F Passive Poll");
+      break;
+    case 0x03:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = A Active Poll");
+      break;
+    case 0x05:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = F Active Poll");
+      break;
+    case 0x06:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = 15693 Passive Poll");
+      break;
+    case 0x70:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = Kovio");
+      break;
+    case 0x80:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = A Passive Listen");
+      break;
+    case 0x81:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = B Passive Listen");
+      break;
+    case 0x82:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = F Passive Listen");
+      break;
+    case 0x83:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = A Active Listen");
+      break;
+    case 0x85:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = F Active Listen");
+      break;
+    case 0x86:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = 15693 Passive Listen");
+      break;
+    default:
+      NXPLOG_NCIHAL_D("NxpNci: Mode = Unknown");
+      break;
+  }
+  return NCI_EXT_NOT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_nfc_init
+**
+** Description      Processes CORE_RESET_RSP/NTF and CORE_INIT_RSP, see
+**                  phNxpNciHal_ext_process_nfc_init_rsp.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_nfc_init(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  phNxpNciHal_ext_process_nfc_init_rsp(pkt->p_data, pkt->p_len);
+  return NCI_EXT_NOT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_power_on_reset
+**
+** Description      Skips CORE_RESET_NTF with power on trigger.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_power_on_reset(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (pkt->p_data[3] == CORE_RESET_TRIGGER_TYPE_POWERED_ON) {
+    pkt->status = NFCSTATUS_FAILED;
     NXPLOG_NCIHAL_D("Skipping power on reset notification!!:");
-    return status;
+    return NCI_EXT_DONE;
   }
-  if(p_ntf[0] == 0x42 && p_ntf[1] == 0x01 && p_ntf[2] == 0x01 && p_ntf[3] == 0x00) {
-    if(nxpncihal_ctrl.hal_ext_enabled == TRUE && nfcFL.chipType >= sn100u) {
-      nxpncihal_ctrl.nci_info.wait_for_ntf = TRUE;
-      NXPLOG_NCIHAL_D(" Mode set received");
-    }
-  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x05 && p_ntf[2] == 0x15
-          && p_ntf[4] == 0x01 && p_ntf[5] == 0x06 && p_ntf[6] == 0x06) {
-    NXPLOG_NCIHAL_D("> Going through workaround - notification of ISO 15693");
-    icode_detected = 0x01;
-    p_ntf[21] = 0x01;
-    p_ntf[22] = 0x01;
-  } else if (nfcFL.chipType < sn100u && icode_detected == 1 && icode_send_eof == 2) {
+  return NCI_EXT_NOT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_mode_set
+**
+** Description      Waits for NFCEE_MODE_SET_NTF after a successful
+**                  NFCEE_MODE_SET_RSP sent by HAL.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_mode_set(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (p_ntf[2] != 0x01 || p_ntf[3] != 0x00) return NCI_EXT_NOT_MATCHED;
+  if(nxpncihal_ctrl.hal_ext_enabled == TRUE && nfcFL.chipType >= sn100u) {
+    nxpncihal_ctrl.nci_info.wait_for_ntf = TRUE;
+    NXPLOG_NCIHAL_D(" Mode set received");
+  }
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_icode_activated
+**
+** Description      Workaround for activation notification of ISO 15693.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_icode_activated(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (p_ntf[2] != 0x15 || p_ntf[4] != 0x01 || p_ntf[5] != 0x06 ||
+      p_ntf[6] != 0x06)
+    return NCI_EXT_NOT_MATCHED;
+  NXPLOG_NCIHAL_D("> Going through workaround - notification of ISO 15693");
+  icode_detected = 0x01;
+  p_ntf[21] = 0x01;
+  p_ntf[22] = 0x01;
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_icode_eof_sent
+**
+** Description      Marks the first packet received after ICODE EOF command.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_icode_eof_sent(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  UNUSED_PROP(pkt);
+  if (nfcFL.chipType < sn100u && icode_detected == 1 && icode_send_eof == 2) {
     icode_send_eof = 3;
-  } else if (nfcFL.chipType < sn100u && p_ntf[0] == 0x00 && p_ntf[1] == 0x00 &&
-          icode_detected == 1) {
-    if (icode_send_eof == 3) {
-      icode_send_eof = 0;
+    return NCI_EXT_MATCHED;
+  }
+  return NCI_EXT_NOT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_icode_data
+**
+** Description      Workaround for data of ISO 15693 received in NCI 1.0.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_icode_data(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  uint16_t* p_len = pkt->p_len;
+  if (nfcFL.chipType >= sn100u || icode_detected != 1)
+    return NCI_EXT_NOT_MATCHED;
+  if (icode_send_eof == 3) {
+    icode_send_eof = 0;
+  }
+  if (nxpncihal_ctrl.nci_info.nci_version != NCI_VERSION_2_0) {
+    if (*p_len <= (p_ntf[2] + 2)) {
+      android_errorWriteLog(0x534e4554, "181660091");
+      NXPLOG_NCIHAL_E("length error!");
+      pkt->status = NFCSTATUS_FAILED;
+      return NCI_EXT_DONE;
     }
-    if (nxpncihal_ctrl.nci_info.nci_version != NCI_VERSION_2_0) {
-      if (*p_len <= (p_ntf[2] + 2)) {
-        android_errorWriteLog(0x534e4554, "181660091");
-        NXPLOG_NCIHAL_E("length error!");
-        return NFCSTATUS_FAILED;
-      }
-      if (p_ntf[p_ntf[2] + 2] == 0x00) {
-        NXPLOG_NCIHAL_D("> Going through workaround - data of ISO 15693");
-        p_ntf[2]--;
-        (*p_len)--;
-      } else {
-        p_ntf[p_ntf[2] + 2] |= 0x01;
-      }
+    if (p_ntf[p_ntf[2] + 2] == 0x00) {
+      NXPLOG_NCIHAL_D("> Going through workaround - data of ISO 15693");
+      p_ntf[2]--;
+      (*p_len)--;
+    } else {
+      p_ntf[p_ntf[2] + 2] |= 0x01;
     }
-  } else if (nfcFL.chipType < sn100u && p_ntf[2] == 0x02 &&
-          p_ntf[1] == 0x00 && icode_detected == 1) {
+  }
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_icode_eof_rsp
+**
+** Description      Response to ICODE EOF command is not sent to upper layer.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_icode_eof_rsp(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (nfcFL.chipType < sn100u && pkt->p_data[2] == 0x02 &&
+      icode_detected == 1) {
     NXPLOG_NCIHAL_D("> ICODE EOF response do not send to upper layer");
-  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x06 && icode_detected == 1) {
-    NXPLOG_NCIHAL_D("> Polling Loop Re-Started");
-    icode_detected = 0;
-    if (nfcFL.chipType < sn100u)
-      icode_send_eof = 0;
-  } else if (*p_len == 4 && p_ntf[0] == 0x40 && p_ntf[1] == 0x02 &&
-             p_ntf[2] == 0x01 && p_ntf[3] == 0x06) {
-    /*NXPLOG_NCIHAL_D("> Deinit workaround for LLCP set_config 0x%x 0x%x 0x%x",
-                    p_ntf[21], p_ntf[22], p_ntf[23]);*/
-    p_ntf[0] = 0x40;
-    p_ntf[1] = 0x02;
-    p_ntf[2] = 0x02;
-    p_ntf[3] = 0x00;
-    p_ntf[4] = 0x00;
-    *p_len = 5;
-  }
-
-  if (p_ntf[0] == 0x60 && p_ntf[1] == 0x07 && p_ntf[2] == 0x01) {
-    if (p_ntf[3] == 0xEA) {
-      gsIsFwRecoveryRequired = true;
-      NXPLOG_NCIHAL_D("FW update required");
-      status = NFCSTATUS_FAILED;
-    } else if ((p_ntf[3] == 0xE5) || (p_ntf[3] == 0x60)) {
-      NXPLOG_NCIHAL_D("ignore core generic error");
-      status = NFCSTATUS_FAILED;
-    }
-    return status;
-  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x21 && p_ntf[2] == 0x00) {
-    status = NFCSTATUS_FAILED;
+    return NCI_EXT_MATCHED;
+  }
+  return NCI_EXT_NOT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_poll_restart
+**
+** Description      Clears ISO 15693 state on RF_DEACTIVATE_NTF.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_poll_restart(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  UNUSED_PROP(pkt);
+  if (icode_detected != 1) return NCI_EXT_NOT_MATCHED;
+  NXPLOG_NCIHAL_D("> Polling Loop Re-Started");
+  icode_detected = 0;
+  if (nfcFL.chipType < sn100u)
+    icode_send_eof = 0;
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_llcp_deinit
+**
+** Description      Deinit workaround for LLCP set_config.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_llcp_deinit(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (*pkt->p_len != 4 || p_ntf[2] != 0x01 || p_ntf[3] != 0x06)
+    return NCI_EXT_NOT_MATCHED;
+  p_ntf[0] = 0x40;
+  p_ntf[1] = 0x02;
+  p_ntf[2] = 0x02;
+  p_ntf[3] = 0x00;
+  p_ntf[4] = 0x00;
+  *pkt->p_len = 5;
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_generic_error
+**
+** Description      Handles CORE_GENERIC_ERROR_NTF, FW recovery request and
+**                  errors to be ignored.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_generic_error(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (p_ntf[2] != 0x01) return NCI_EXT_NOT_MATCHED;
+  if (p_ntf[3] == 0xEA) {
+    gsIsFwRecoveryRequired = true;
+    NXPLOG_NCIHAL_D("FW update required");
+    pkt->status = NFCSTATUS_FAILED;
+  } else if ((p_ntf[3] == 0xE5) || (p_ntf[3] == 0x60)) {
     NXPLOG_NCIHAL_D("ignore core generic error");
-    return status;
+    pkt->status = NFCSTATUS_FAILED;
   }
-  // 4200 02 00 01
-  else if (p_ntf[0] == 0x42 && p_ntf[1] == 0x00 && ee_disc_done == 0x01) {
-    NXPLOG_NCIHAL_D("Going through workaround - NFCEE_DISCOVER_RSP");
-    if (p_ntf[4] == 0x01) {
-      p_ntf[4] = 0x00;
+  return NCI_EXT_DONE;
+}
 
-      ee_disc_done = 0x00;
-    }
-    NXPLOG_NCIHAL_D("Going through workaround - NFCEE_DISCOVER_RSP - END");
-
-  } else if (p_ntf[0] == 0x61 && p_ntf[1] == 0x03 /*&& cleanup_timer!=0*/) {
-    if (cleanup_timer != 0) {
-      /* if RF Notification Type of RF_DISCOVER_NTF is Last Notification */
-      if (0 == (*(p_ntf + 2 + (*(p_ntf + 2))))) {
-        phNxpNciHal_select_RF_Discovery(RfDiscID, RfProtocolType);
-        status = NFCSTATUS_FAILED;
-        return status;
-      } else {
-        RfDiscID = p_ntf[3];
-        RfProtocolType = p_ntf[4];
-      }
-      status = NFCSTATUS_FAILED;
-      return status;
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_rf_generic_error
+**
+** Description      Ignores empty RF 0x21 notification.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_rf_generic_error(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (pkt->p_data[2] != 0x00) return NCI_EXT_NOT_MATCHED;
+  pkt->status = NFCSTATUS_FAILED;
+  NXPLOG_NCIHAL_D("ignore core generic error");
+  return NCI_EXT_DONE;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_ee_discover
+**
+** Description      Workaround for NFCEE_DISCOVER_RSP.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_ee_discover(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (ee_disc_done != 0x01) return NCI_EXT_NOT_MATCHED;
+  NXPLOG_NCIHAL_D("Going through workaround - NFCEE_DISCOVER_RSP");
+  if (pkt->p_data[4] == 0x01) {
+    pkt->p_data[4] = 0x00;
+
+    ee_disc_done = 0x00;
+  }
+  NXPLOG_NCIHAL_D("Going through workaround - NFCEE_DISCOVER_RSP - END");
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_rf_discover
+**
+** Description      Selects the remembered RF discovery id on the last
+**                  RF_DISCOVER_NTF while cleanup timer is running.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_rf_discover(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (cleanup_timer != 0) {
+    /* if RF Notification Type of RF_DISCOVER_NTF is Last Notification */
+    if (0 == (*(p_ntf + 2 + (*(p_ntf + 2))))) {
+      phNxpNciHal_select_RF_Discovery(RfDiscID, RfProtocolType);
+    } else {
+      RfDiscID = p_ntf[3];
+      RfProtocolType = p_ntf[4];
     }
-  } else if (p_ntf[0] == 0x41 && p_ntf[1] == 0x04 && cleanup_timer != 0) {
-    status = NFCSTATUS_FAILED;
-    return status;
-  } else if (*p_len == 4 && p_ntf[0] == 0x4F && p_ntf[1] == 0x11 &&
-             p_ntf[2] == 0x01) {
+    pkt->status = NFCSTATUS_FAILED;
+    return NCI_EXT_DONE;
+  }
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_discover_select
+**
+** Description      Drops RF_DISCOVER_SELECT_RSP while cleanup timer is
+**                  running.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_discover_select(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  if (cleanup_timer == 0) return NCI_EXT_NOT_MATCHED;
+  pkt->status = NFCSTATUS_FAILED;
+  return NCI_EXT_DONE;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_rsp_presence_check
+**
+** Description      Workaround for ISO-DEP presence check response and
+**                  notification.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_rsp_presence_check(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_ntf = pkt->p_data;
+  if (*pkt->p_len != 4 || p_ntf[2] != 0x01) return NCI_EXT_NOT_MATCHED;
+  if (p_ntf[0] == 0x4F) {
     if (p_ntf[3] == 0x00) {
       NXPLOG_NCIHAL_D(
           ">  Workaround for ISO-DEP Presence Check, ignore response and wait "
@@ -427,7 +978,7 @@ NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len) {
       p_ntf[3] = 0x01;
       p_ntf[4] = 0x00;
       p_ntf[5] = 0x01;
-      *p_len = 6;
+      *pkt->p_len = 6;
     } else {
       NXPLOG_NCIHAL_D(
           ">  Workaround for ISO-DEP Presence Check, presence check return "
@@ -437,10 +988,9 @@ NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len) {
       p_ntf[2] = 0x02;
       p_ntf[3] = 0xB2;
       p_ntf[4] = 0x00;
-      *p_len = 5;
+      *pkt->p_len = 5;
     }
-  } else if (*p_len == 4 && p_ntf[0] == 0x6F && p_ntf[1] == 0x11 &&
-             p_ntf[2] == 0x01) {
+  } else if (p_ntf[0] == 0x6F) {
     if (p_ntf[3] == 0x01) {
       NXPLOG_NCIHAL_D(
           ">  Workaround for ISO-DEP Presence Check - Card still in field");
@@ -456,13 +1006,100 @@ NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len) {
       p_ntf[2] = 0x02;
       p_ntf[3] = 0xB2;
       p_ntf[4] = 0x00;
-      *p_len = 5;
+      *pkt->p_len = 5;
     }
+  } else {
+    return NCI_EXT_NOT_MATCHED;
   }
+  return NCI_EXT_MATCHED;
+}
 
-  return status;
+/* Extensions applied to packets received from NFCC, in processing order */
+static const phNxpNciHal_ExtRow_t sExtRspRows[] = {
+#if(NXP_EXTNS == TRUE)
+    {NCI_EXT_KEY(0x6F, 0x35), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_lx_debug},
+    {NCI_EXT_KEY(0x6F, 0x36), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_lx_debug},
+#if(NXP_SRD == TRUE)
+    {NCI_EXT_KEY(0x01, 0x00), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_srd_profile},
+    {NCI_EXT_KEY(0x60, 0x07), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_srd_profile},
+#endif
+#endif
+    {NCI_EXT_KEY(0x61, 0x05), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_intf_act_len},
+    {NCI_EXT_KEY(0x61, 0x05), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_emvco_nfcdep},
+    {NCI_EXT_KEY(0x61, 0x05), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_felica_reader},
+#ifdef P2P_PRIO_LOGIC_HAL_IMP
+    {NCI_EXT_KEY(0x61, 0x05), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_p2p_detect},
+    {NCI_EXT_KEY_ANY, NCI_EXT_NO_CHAIN, NCI_EXT_FL_P2P_PRIO,
+     phNxpNciHal_ext_rsp_p2p_prio},
+#endif
+    {NCI_EXT_KEY_B0(0x00), NCI_EXT_NO_CHAIN, NCI_EXT_FL_MFC_EXTNS,
+     phNxpNciHal_ext_rsp_mfc_data},
+    {NCI_EXT_KEY(0x60, 0x06), NCI_EXT_NO_CHAIN, NCI_EXT_FL_MFC_EXTNS,
+     phNxpNciHal_ext_rsp_mfc_credits},
+    {NCI_EXT_KEY(0x61, 0x05), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_intf_activated},
+    {NCI_EXT_KEY_OID(NCI_MT_RSP, NCI_MSG_CORE_RESET), NCI_EXT_NO_CHAIN,
+     NCI_EXT_FL_ALL, phNxpNciHal_ext_rsp_nfc_init},
+    {NCI_EXT_KEY_OID(NCI_MT_NTF, NCI_MSG_CORE_RESET), NCI_EXT_NO_CHAIN,
+     NCI_EXT_FL_ALL, phNxpNciHal_ext_rsp_nfc_init},
+    {NCI_EXT_KEY_OID(NCI_MT_RSP, NCI_MSG_CORE_INIT), NCI_EXT_NO_CHAIN,
+     NCI_EXT_FL_ALL, phNxpNciHal_ext_rsp_nfc_init},
+    {NCI_EXT_KEY_OID(NCI_MT_NTF, NCI_MSG_CORE_RESET), NCI_EXT_NO_CHAIN,
+     NCI_EXT_FL_ALL, phNxpNciHal_ext_rsp_power_on_reset},
+    {NCI_EXT_KEY(0x42, 0x01), NCI_EXT_CHAIN_1, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_mode_set},
+    {NCI_EXT_KEY(0x61, 0x05), NCI_EXT_CHAIN_1, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_icode_activated},
+    {NCI_EXT_KEY_ANY, NCI_EXT_CHAIN_1, NCI_EXT_FL_PRE_SN100U_ICODE,
+     phNxpNciHal_ext_rsp_icode_eof_sent},
+    {NCI_EXT_KEY(0x00, 0x00), NCI_EXT_CHAIN_1, NCI_EXT_FL_PRE_SN100U_ICODE,
+     phNxpNciHal_ext_rsp_icode_data},
+    {NCI_EXT_KEY_B1(0x00), NCI_EXT_CHAIN_1, NCI_EXT_FL_PRE_SN100U_ICODE,
+     phNxpNciHal_ext_rsp_icode_eof_rsp},
+    {NCI_EXT_KEY(0x61, 0x06), NCI_EXT_CHAIN_1, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_poll_restart},
+    {NCI_EXT_KEY(0x40, 0x02), NCI_EXT_CHAIN_1, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_llcp_deinit},
+    {NCI_EXT_KEY(0x60, 0x07), NCI_EXT_CHAIN_2, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_generic_error},
+    {NCI_EXT_KEY(0x61, 0x21), NCI_EXT_CHAIN_2, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_rf_generic_error},
+    {NCI_EXT_KEY(0x42, 0x00), NCI_EXT_CHAIN_2, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_ee_discover},
+    {NCI_EXT_KEY(0x61, 0x03), NCI_EXT_CHAIN_2, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_rf_discover},
+    {NCI_EXT_KEY(0x41, 0x04), NCI_EXT_CHAIN_2, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_discover_select},
+    {NCI_EXT_KEY(0x4F, 0x11), NCI_EXT_CHAIN_2, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_presence_check},
+    {NCI_EXT_KEY(0x6F, 0x11), NCI_EXT_CHAIN_2, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_rsp_presence_check},
+};
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_process_ext_rsp
+**
+** Description      Process extension function response
+**
+** Returns          NFCSTATUS_SUCCESS if success
+**
+*******************************************************************************/
+NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len) {
+  phNxpNciHal_ExtPkt_t pkt = {p_ntf, p_len, NULL, NULL, NFCSTATUS_SUCCESS};
+
+  return phNxpNciHal_ext_dispatch(&sExtRspTable, &pkt);
 }
 
+
 /******************************************************************************
  * Function         phNxpNciHal_ext_process_nfc_init_rsp
  *
@@ -569,6 +1206,14 @@ static NFCSTATUS phNxpNciHal_ext_process_nfc_init_rsp(uint8_t* p_ntf, uint16_t*
         NXPLOG_NCIHAL_D("NxpNci> FW Version: %x.%x.%x", p_ntf[len - 2],
                         p_ntf[len - 1], p_ntf[len]);
       }
+      /* Max control packet payload follows the RF interfaces in NCI 1.0 */
+      uint16_t ctrl_payload_idx =
+          (nxpncihal_ctrl.nci_info.nci_version == NCI_VERSION_2_0)
+              ? 11
+              : ((*p_len > 8) ? (12 + p_ntf[8]) : *p_len);
+      if (ctrl_payload_idx < *p_len && p_ntf[3] == NCI_STATUS_OK) {
+        nxpncihal_ctrl.nci_info.max_ctrl_payload = p_ntf[ctrl_payload_idx];
+      }
     }
   return status;
 }
@@ -578,13 +1223,16 @@ static NFCSTATUS phNxpNciHal_ext_process_nfc_init_rsp(uint8_t* p_ntf, uint16_t*
  *
  * Description      This function process the extension command response. It
  *                  also checks the received response to expected response.
+ *                  The response, and the notification if one is expected,
+ *                  are each waited for at most timeout_ms.
  *
  * Returns          returns NFCSTATUS_SUCCESS if response is as expected else
  *                  returns failure.
  *
  ******************************************************************************/
 static NFCSTATUS phNxpNciHal_process_ext_cmd_rsp(uint16_t cmd_len,
-                                                 uint8_t* p_cmd) {
+                                                 uint8_t* p_cmd,
+                                                 uint32_t timeout_ms) {
   NFCSTATUS status = NFCSTATUS_FAILED;
   uint16_t data_written = 0;
 
@@ -612,7 +1260,7 @@ static NFCSTATUS phNxpNciHal_process_ext_cmd_rsp(uint16_t cmd_len,
   }
 
   /* Start timer */
-  status = phOsalNfc_Timer_Start(timeoutTimerId, HAL_EXTNS_WRITE_RSP_TIMEOUT,
+  status = phOsalNfc_Timer_Start(timeoutTimerId, timeout_ms,
                                  &hal_extns_write_rsp_timeout_cb, NULL);
   if (NFCSTATUS_SUCCESS == status) {
     NXPLOG_NCIHAL_D("Response timer started");
@@ -644,7 +1292,7 @@ static NFCSTATUS phNxpNciHal_process_ext_cmd_rsp(uint16_t cmd_len,
   }
   /* Start timer to wait for NTF*/
   if (nxpncihal_ctrl.nci_info.wait_for_ntf == TRUE) {
-    status = phOsalNfc_Timer_Start(timeoutTimerId, HAL_EXTNS_WRITE_RSP_TIMEOUT,
+    status = phOsalNfc_Timer_Start(timeoutTimerId, timeout_ms,
                                    &hal_extns_write_rsp_timeout_cb, NULL);
     if (NFCSTATUS_SUCCESS == status) {
       NXPLOG_NCIHAL_D("Response timer started");
@@ -701,187 +1349,310 @@ clean_and_return:
 }
 
 /******************************************************************************
- * Function         phNxpNciHal_write_ext
+ * Function         phNxpNciHal_write_ext_is_passthrough
  *
- * Description      This function inform the status of phNxpNciHal_open
- *                  function to libnfc-nci.
+ * Description      This function tells whether phNxpNciHal_write_ext would
+ *                  leave the packet untouched, i.e. no enabled and active
+ *                  row of the command table applies to its header, so that
+ *                  the caller can send it without staging a private copy.
  *
- * Returns          It return NFCSTATUS_SUCCESS then continue with send else
- *                  sends NFCSTATUS_FAILED direct response is prepared and
- *                  do not send anything to NFCC.
+ * Returns          true if the packet can be sent as is, false otherwise.
  *
  ******************************************************************************/
-NFCSTATUS phNxpNciHal_write_ext(uint16_t* cmd_len, uint8_t* p_cmd_data,
-                                uint16_t* rsp_len, uint8_t* p_rsp_data) {
-  NFCSTATUS status = NFCSTATUS_SUCCESS;
+bool phNxpNciHal_write_ext_is_passthrough(uint16_t cmd_len,
+                                          const uint8_t* p_cmd_data) {
+  if (cmd_len < 2) return false;
+  pthread_once(&sExtDispatchOnce, phNxpNciHal_ext_build_dispatch);
+  return phNxpNciHal_ext_candidates(&sExtCmdTable, p_cmd_data) == 0;
+}
 
-  phNxpNciHal_NfcDep_cmd_ext(p_cmd_data, cmd_len);
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_nfcdep
+**
+** Description      Stores the polling loop configuration.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_nfcdep(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  phNxpNciHal_NfcDep_cmd_ext(pkt->p_data, pkt->p_len);
+  return NCI_EXT_NOT_MATCHED;
+}
 
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_dta
+**
+** Description      Applies DTA specific updates when DTA mode is enabled.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_dta(
+    phNxpNciHal_ExtPkt_t* pkt) {
   if (phNxpDta_IsEnable() == true) {
-    status = phNxpNHal_DtaUpdate(cmd_len, p_cmd_data, rsp_len, p_rsp_data);
-  }
-
-  if (p_cmd_data[0] == PROPRIETARY_CMD_FELICA_READER_MODE &&
-      p_cmd_data[1] == PROPRIETARY_CMD_FELICA_READER_MODE &&
-      p_cmd_data[2] == PROPRIETARY_CMD_FELICA_READER_MODE) {
-    NXPLOG_NCIHAL_D("Received proprietary command to set Felica Reader mode:%d",
-                    p_cmd_data[3]);
-    gFelicaReaderMode = p_cmd_data[3];
-    /* frame the dummy response */
-    *rsp_len = 4;
-    p_rsp_data[0] = 0x00;
-    p_rsp_data[1] = 0x00;
-    p_rsp_data[2] = 0x00;
-    p_rsp_data[3] = 0x00;
-    status = NFCSTATUS_FAILED;
-  } else if (p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02 &&
-          (p_cmd_data[2] == 0x05 || p_cmd_data[2] == 0x32) &&
-          (p_cmd_data[3] == 0x01 || p_cmd_data[3] == 0x02) &&
-          p_cmd_data[4] == 0xA0 && p_cmd_data[5] == 0x44 &&
-          p_cmd_data[6] == 0x01 && p_cmd_data[7] == 0x01) {
+    pkt->status = phNxpNHal_DtaUpdate(pkt->p_len, pkt->p_data, pkt->p_rsp_len,
+                                      pkt->p_rsp_data);
+  }
+  return NCI_EXT_NOT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_felica_reader
+**
+** Description      Proprietary command to set Felica reader mode, answered
+**                  by HAL with a dummy response.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_felica_reader(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_rsp_data = pkt->p_rsp_data;
+  if (pkt->p_data[2] != PROPRIETARY_CMD_FELICA_READER_MODE)
+    return NCI_EXT_NOT_MATCHED;
+  NXPLOG_NCIHAL_D("Received proprietary command to set Felica Reader mode:%d",
+                  pkt->p_data[3]);
+  gFelicaReaderMode = pkt->p_data[3];
+  /* frame the dummy response */
+  *pkt->p_rsp_len = 4;
+  p_rsp_data[0] = 0x00;
+  p_rsp_data[1] = 0x00;
+  p_rsp_data[2] = 0x00;
+  p_rsp_data[3] = 0x00;
+  pkt->status = NFCSTATUS_FAILED;
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_poll_profile
+**
+** Description      Tracks EMVCo/NFC Forum poll profile selection.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_poll_profile(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_cmd_data = pkt->p_data;
+  if (!((p_cmd_data[2] == 0x05 || p_cmd_data[2] == 0x32) &&
+        (p_cmd_data[3] == 0x01 || p_cmd_data[3] == 0x02) &&
+        p_cmd_data[4] == 0xA0 && p_cmd_data[5] == 0x44 &&
+        p_cmd_data[6] == 0x01))
+    return NCI_EXT_NOT_MATCHED;
+  if (p_cmd_data[7] == 0x01) {
     nxpprofile_ctrl.profile_type = EMV_CO_PROFILE;
     NXPLOG_NCIHAL_D("EMV_CO_PROFILE mode - Enabled");
-    status = NFCSTATUS_SUCCESS;
-  } else if (p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02 &&
-          (p_cmd_data[2] == 0x05 || p_cmd_data[2] == 0x32) &&
-          (p_cmd_data[3] == 0x01 || p_cmd_data[3] == 0x02) &&
-          p_cmd_data[4] == 0xA0 && p_cmd_data[5] == 0x44 &&
-          p_cmd_data[6] == 0x01 && p_cmd_data[7] == 0x00) {
+  } else if (p_cmd_data[7] == 0x00) {
     NXPLOG_NCIHAL_D("NFC_FORUM_PROFILE mode - Enabled");
     nxpprofile_ctrl.profile_type = NFC_FORUM_PROFILE;
-    status = NFCSTATUS_SUCCESS;
-  }
-
-  if (nxpprofile_ctrl.profile_type == EMV_CO_PROFILE) {
-    if (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x06 &&
-        p_cmd_data[2] == 0x01 && p_cmd_data[3] == 0x03) {
-#if 0
-            //Needs clarification whether to keep it or not
-            NXPLOG_NCIHAL_D ("EmvCo Poll mode - RF Deactivate discard");
-            phNxpNciHal_print_packet("SEND", p_cmd_data, *cmd_len);
-            *rsp_len = 4;
-            p_rsp_data[0] = 0x41;
-            p_rsp_data[1] = 0x06;
-            p_rsp_data[2] = 0x01;
-            p_rsp_data[3] = 0x00;
-            phNxpNciHal_print_packet("RECV", p_rsp_data, 4);
-            status = NFCSTATUS_FAILED;
-#endif
-    } else if (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x03) {
-      NXPLOG_NCIHAL_D("EmvCo Poll mode - Discover map only for A and B");
-      p_cmd_data[2] = 0x05;
-      p_cmd_data[3] = 0x02;
-      p_cmd_data[4] = 0x00;
-      p_cmd_data[5] = 0x01;
-      p_cmd_data[6] = 0x01;
-      p_cmd_data[7] = 0x01;
-      *cmd_len = 8;
-    }
+  } else {
+    return NCI_EXT_NOT_MATCHED;
   }
+  pkt->status = NFCSTATUS_SUCCESS;
+  return NCI_EXT_MATCHED;
+}
 
-  if (mfc_mode == true && p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x03) {
-    NXPLOG_NCIHAL_D("EmvCo Poll mode - Discover map only for A and B");
-    p_cmd_data[2] = 0x03;
-    p_cmd_data[3] = 0x01;
-    p_cmd_data[4] = 0x00;
-    p_cmd_data[5] = 0x01;
-    *cmd_len = 6;
-    mfc_mode = false;
-  }
-
-  if (*cmd_len <= (NCI_MAX_DATA_LEN - 3) && bEnableMfcReader &&
-      (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x00) &&
-      (nxpprofile_ctrl.profile_type == NFC_FORUM_PROFILE)) {
-    unsigned long retval = 0;
-    if (p_cmd_data[2] == 0x04 && p_cmd_data[3] == 0x01 &&
-        p_cmd_data[4] == 0x80 && p_cmd_data[5] == 0x01 &&
-        p_cmd_data[6] == 0x83) {
-      mfc_mode = true;
-    } else {
-      if (!GetNxpNumValue(NAME_MIFARE_READER_ENABLE, &retval,
-                          sizeof(unsigned long))) {
-        NXPLOG_NCIHAL_E(
-            "Reading of MIFARE_READER_ENABLE failed. Default retval = %lu",
-            retval);
-      }
-      if (retval == 0x01) {
-        NXPLOG_NCIHAL_D("Going through extns - Adding Mifare in RF Discovery");
-        p_cmd_data[2] += 3;
-        p_cmd_data[3] += 1;
-        p_cmd_data[*cmd_len] = 0x80;
-        p_cmd_data[*cmd_len + 1] = 0x01;
-        p_cmd_data[*cmd_len + 2] = 0x80;
-        *cmd_len += 3;
-        status = NFCSTATUS_SUCCESS;
-        NXPLOG_NCIHAL_D(
-            "Going through extns - Adding Mifare in RF Discovery - END");
-      }
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_emvco_disc_map
+**
+** Description      Restricts discover map to A and B in EMVCo profile.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_emvco_disc_map(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_cmd_data = pkt->p_data;
+  if (nxpprofile_ctrl.profile_type != EMV_CO_PROFILE)
+    return NCI_EXT_NOT_MATCHED;
+  NXPLOG_NCIHAL_D("EmvCo Poll mode - Discover map only for A and B");
+  p_cmd_data[2] = 0x05;
+  p_cmd_data[3] = 0x02;
+  p_cmd_data[4] = 0x00;
+  p_cmd_data[5] = 0x01;
+  p_cmd_data[6] = 0x01;
+  p_cmd_data[7] = 0x01;
+  *pkt->p_len = 8;
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_mfc_disc_map
+**
+** Description      Restricts discover map to A when the previous discover
+**                  command selected MIFARE Classic only.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_mfc_disc_map(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_cmd_data = pkt->p_data;
+  if (mfc_mode != true) return NCI_EXT_NOT_MATCHED;
+  NXPLOG_NCIHAL_D("EmvCo Poll mode - Discover map only for A and B");
+  p_cmd_data[2] = 0x03;
+  p_cmd_data[3] = 0x01;
+  p_cmd_data[4] = 0x00;
+  p_cmd_data[5] = 0x01;
+  *pkt->p_len = 6;
+  mfc_mode = false;
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_mfc_discover
+**
+** Description      Adds MIFARE Classic to RF discovery in NFC Forum profile.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_mfc_discover(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_cmd_data = pkt->p_data;
+  uint16_t* cmd_len = pkt->p_len;
+  if (!(*cmd_len <= (NCI_MAX_DATA_LEN - 3) && bEnableMfcReader &&
+        (nxpprofile_ctrl.profile_type == NFC_FORUM_PROFILE)))
+    return NCI_EXT_NOT_MATCHED;
+  if (p_cmd_data[2] == 0x04 && p_cmd_data[3] == 0x01 &&
+      p_cmd_data[4] == 0x80 && p_cmd_data[5] == 0x01 &&
+      p_cmd_data[6] == 0x83) {
+    mfc_mode = true;
+  } else {
+    if (phNxpNciHal_configSnapshot()->dwMifareReaderEnable == 0x01) {
+      NXPLOG_NCIHAL_D("Going through extns - Adding Mifare in RF Discovery");
+      p_cmd_data[2] += 3;
+      p_cmd_data[3] += 1;
+      p_cmd_data[*cmd_len] = 0x80;
+      p_cmd_data[*cmd_len + 1] = 0x01;
+      p_cmd_data[*cmd_len + 2] = 0x80;
+      *cmd_len += 3;
+      pkt->status = NFCSTATUS_SUCCESS;
+      NXPLOG_NCIHAL_D(
+          "Going through extns - Adding Mifare in RF Discovery - END");
     }
-  } else if ((*cmd_len >= 6) &&
-             (p_cmd_data[3] == 0x81 && p_cmd_data[4] == 0x01 &&
-              p_cmd_data[5] == 0x03)) {
-    NXPLOG_NCIHAL_D("> Going through the set host list");
-        if(nfcFL.chipType >= sn100u)
-        {
-            *cmd_len = 10;
-
-            p_cmd_data[2] = 0x07;
-
-            p_cmd_data[6] = 0x02;
-            p_cmd_data[7] = 0x80;
-            p_cmd_data[8] = 0x81;
-            p_cmd_data[9] = 0xC0;
-        }
-        else
-        {
-            *cmd_len = 8;
+  }
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_host_list
+**
+** Description      Rewrites the host list set config, an ANY_SET_PARAMETER
+**                  of the WHITELIST on the HCI admin pipe.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_host_list(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_cmd_data = pkt->p_data;
+  uint16_t* cmd_len = pkt->p_len;
+  if (!((*cmd_len >= 6) && (p_cmd_data[3] == 0x81 && p_cmd_data[4] == 0x01 &&
+                            p_cmd_data[5] == 0x03)))
+    return NCI_EXT_NOT_MATCHED;
+  NXPLOG_NCIHAL_D("> Going through the set host list");
+  if(nfcFL.chipType >= sn100u)
+  {
+      *cmd_len = 10;
+
+      p_cmd_data[2] = 0x07;
+
+      p_cmd_data[6] = 0x02;
+      p_cmd_data[7] = 0x80;
+      p_cmd_data[8] = 0x81;
+      p_cmd_data[9] = 0xC0;
+  }
+  else
+  {
+      *cmd_len = 8;
 
-            p_cmd_data[2] = 0x05;
-            p_cmd_data[6] = 0x02;
-            p_cmd_data[7] = 0xC0;
-        }
-    status = NFCSTATUS_SUCCESS;
-  } else if (icode_detected) {
-    if (nfcFL.chipType < sn100u && (p_cmd_data[3] & 0x40) == 0x40 &&
-        (p_cmd_data[4] == 0x21 || p_cmd_data[4] == 0x22 ||
-         p_cmd_data[4] == 0x24 || p_cmd_data[4] == 0x27 ||
-         p_cmd_data[4] == 0x28 || p_cmd_data[4] == 0x29 ||
-         p_cmd_data[4] == 0x2a)) {
-      NXPLOG_NCIHAL_D("> Send EOF set");
-      icode_send_eof = 1;
-    }
+      p_cmd_data[2] = 0x05;
+      p_cmd_data[6] = 0x02;
+      p_cmd_data[7] = 0xC0;
+  }
+  pkt->status = NFCSTATUS_SUCCESS;
+  return NCI_EXT_MATCHED;
+}
 
-    if (p_cmd_data[3] == 0x20 || p_cmd_data[3] == 0x24 ||
-        p_cmd_data[3] == 0x60) {
-      NXPLOG_NCIHAL_D("> NFC ISO_15693 Proprietary CMD ");
-      p_cmd_data[3] += 0x02;
-    }
-  } else if (p_cmd_data[0] == 0x21 && p_cmd_data[1] == 0x03) {
-    NXPLOG_NCIHAL_D("> Polling Loop Started");
-    icode_detected = 0;
-    if(nfcFL.chipType < sn100u){
-      icode_send_eof = 0;
-    }
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_icode
+**
+** Description      ISO 15693 proprietary command handling while a tag is
+**                  activated.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_icode(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_cmd_data = pkt->p_data;
+  if (!icode_detected) return NCI_EXT_NOT_MATCHED;
+  if (nfcFL.chipType < sn100u && (p_cmd_data[3] & 0x40) == 0x40 &&
+      (p_cmd_data[4] == 0x21 || p_cmd_data[4] == 0x22 ||
+       p_cmd_data[4] == 0x24 || p_cmd_data[4] == 0x27 ||
+       p_cmd_data[4] == 0x28 || p_cmd_data[4] == 0x29 ||
+       p_cmd_data[4] == 0x2a)) {
+    NXPLOG_NCIHAL_D("> Send EOF set");
+    icode_send_eof = 1;
   }
-  // 22000100
-  else if (p_cmd_data[0] == 0x22 && p_cmd_data[1] == 0x00 &&
-           p_cmd_data[2] == 0x01 && p_cmd_data[3] == 0x00) {
-    // ee_disc_done = 0x01;//Reader Over SWP event getting
-    *rsp_len = 0x05;
-    p_rsp_data[0] = 0x42;
-    p_rsp_data[1] = 0x00;
-    p_rsp_data[2] = 0x02;
-    p_rsp_data[3] = 0x00;
-    p_rsp_data[4] = 0x00;
-    phNxpNciHal_print_packet("RECV", p_rsp_data, 5);
-    status = NFCSTATUS_FAILED;
+
+  if (p_cmd_data[3] == 0x20 || p_cmd_data[3] == 0x24 ||
+      p_cmd_data[3] == 0x60) {
+    NXPLOG_NCIHAL_D("> NFC ISO_15693 Proprietary CMD ");
+    p_cmd_data[3] += 0x02;
+  }
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_poll_start
+**
+** Description      Clears ISO 15693 state when polling loop is started.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_poll_start(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  UNUSED_PROP(pkt);
+  NXPLOG_NCIHAL_D("> Polling Loop Started");
+  icode_detected = 0;
+  if(nfcFL.chipType < sn100u){
+    icode_send_eof = 0;
   }
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_ee_discover
+**
+** Description      Answers NFCEE_DISCOVER_CMD (22000100) from HAL.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_ee_discover(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_rsp_data = pkt->p_rsp_data;
+  if (pkt->p_data[2] != 0x01 || pkt->p_data[3] != 0x00)
+    return NCI_EXT_NOT_MATCHED;
+  // ee_disc_done = 0x01;//Reader Over SWP event getting
+  *pkt->p_rsp_len = 0x05;
+  p_rsp_data[0] = 0x42;
+  p_rsp_data[1] = 0x00;
+  p_rsp_data[2] = 0x02;
+  p_rsp_data[3] = 0x00;
+  p_rsp_data[4] = 0x00;
+  phNxpNciHal_print_packet("RECV", p_rsp_data, 5);
+  pkt->status = NFCSTATUS_FAILED;
+  return NCI_EXT_MATCHED;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_dirty_set_config
+**
+** Description      Set config workarounds for legacy parameters.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_dirty_set_config(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  uint8_t* p_cmd_data = pkt->p_data;
+  uint8_t* p_rsp_data = pkt->p_rsp_data;
   // 2002 0904 3000 3100 3200 5000
-  else if ((p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02) &&
-           ((p_cmd_data[2] == 0x09 && p_cmd_data[3] == 0x04) /*||
-            (p_cmd_data[2] == 0x0D && p_cmd_data[3] == 0x04)*/
-            )) {
-    *cmd_len += 0x01;
+  if (p_cmd_data[2] == 0x09 && p_cmd_data[3] == 0x04) {
+    *pkt->p_len += 0x01;
     p_cmd_data[2] += 0x01;
     p_cmd_data[9] = 0x01;
     p_cmd_data[10] = 0x40;
@@ -889,18 +1660,16 @@ NFCSTATUS phNxpNciHal_write_ext(uint16_t* cmd_len, uint8_t* p_cmd_data,
     p_cmd_data[12] = 0x00;
 
     NXPLOG_NCIHAL_D("> Going through workaround - Dirty Set Config ");
-    //        phNxpNciHal_print_packet("SEND", p_cmd_data, *cmd_len);
     NXPLOG_NCIHAL_D("> Going through workaround - Dirty Set Config - End ");
   }
   //    20020703300031003200
   //    2002 0301 3200
-  else if ((p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02) &&
-           ((p_cmd_data[2] == 0x07 && p_cmd_data[3] == 0x03) ||
-            (p_cmd_data[2] == 0x03 && p_cmd_data[3] == 0x01 &&
-             p_cmd_data[4] == 0x32))) {
+  else if ((p_cmd_data[2] == 0x07 && p_cmd_data[3] == 0x03) ||
+           (p_cmd_data[2] == 0x03 && p_cmd_data[3] == 0x01 &&
+            p_cmd_data[4] == 0x32)) {
     NXPLOG_NCIHAL_D("> Going through workaround - Dirty Set Config ");
-    phNxpNciHal_print_packet("SEND", p_cmd_data, *cmd_len);
-    *rsp_len = 5;
+    phNxpNciHal_print_packet("SEND", p_cmd_data, *pkt->p_len);
+    *pkt->p_rsp_len = 5;
     p_rsp_data[0] = 0x40;
     p_rsp_data[1] = 0x02;
     p_rsp_data[2] = 0x02;
@@ -908,100 +1677,107 @@ NFCSTATUS phNxpNciHal_write_ext(uint16_t* cmd_len, uint8_t* p_cmd_data,
     p_rsp_data[4] = 0x00;
 
     phNxpNciHal_print_packet("RECV", p_rsp_data, 5);
-    status = NFCSTATUS_FAILED;
+    pkt->status = NFCSTATUS_FAILED;
     NXPLOG_NCIHAL_D("> Going through workaround - Dirty Set Config - End ");
   }
-
-  // 2002 0D04 300104 310100 320100 500100
   // 2002 0401 320100
-  else if ((p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02) &&
-           (
-               /*(p_cmd_data[2] == 0x0D && p_cmd_data[3] == 0x04)*/
-               (p_cmd_data[2] == 0x04 && p_cmd_data[3] == 0x01 &&
-                p_cmd_data[4] == 0x32 && p_cmd_data[5] == 0x00))) {
-    //        p_cmd_data[12] = 0x40;
-
+  else if (p_cmd_data[2] == 0x04 && p_cmd_data[3] == 0x01 &&
+           p_cmd_data[4] == 0x32 && p_cmd_data[5] == 0x00) {
     NXPLOG_NCIHAL_D("> Going through workaround - Dirty Set Config ");
-    phNxpNciHal_print_packet("SEND", p_cmd_data, *cmd_len);
+    phNxpNciHal_print_packet("SEND", p_cmd_data, *pkt->p_len);
     p_cmd_data[6] = 0x60;
 
     phNxpNciHal_print_packet("RECV", p_rsp_data, 5);
-    //        status = NFCSTATUS_FAILED;
     NXPLOG_NCIHAL_D("> Going through workaround - Dirty Set Config - End ");
+  } else {
+    return NCI_EXT_NOT_MATCHED;
   }
-#if 0
-    else if ( (p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02 ) &&
-                 ((p_cmd_data[2] == 0x09 && p_cmd_data[3] == 0x04) ||
-                     (p_cmd_data[2] == 0x0B && p_cmd_data[3] == 0x05) ||
-                     (p_cmd_data[2] == 0x07 && p_cmd_data[3] == 0x02) ||
-                     (p_cmd_data[2] == 0x0A && p_cmd_data[3] == 0x03) ||
-                     (p_cmd_data[2] == 0x0A && p_cmd_data[3] == 0x04) ||
-                     (p_cmd_data[2] == 0x05 && p_cmd_data[3] == 0x02))
-             )
-    {
-        NXPLOG_NCIHAL_D ("> Going through workaround - Dirty Set Config ");
-        phNxpNciHal_print_packet("SEND", p_cmd_data, *cmd_len);
-        *rsp_len = 5;
-        p_rsp_data[0] = 0x40;
-        p_rsp_data[1] = 0x02;
-        p_rsp_data[2] = 0x02;
-        p_rsp_data[3] = 0x00;
-        p_rsp_data[4] = 0x00;
-
-        phNxpNciHal_print_packet("RECV", p_rsp_data, 5);
-        status = NFCSTATUS_FAILED;
-        NXPLOG_NCIHAL_D ("> Going through workaround - Dirty Set Config - End ");
-    }
+  return NCI_EXT_MATCHED;
+}
 
-    else if((p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x02) &&
-           ((p_cmd_data[3] == 0x00) ||
-           ((*cmd_len >= 0x06) && (p_cmd_data[5] == 0x00)))) /*If the length of the first param id is zero don't allow*/
-    {
-        NXPLOG_NCIHAL_D ("> Going through workaround - Dirty Set Config ");
-        phNxpNciHal_print_packet("SEND", p_cmd_data, *cmd_len);
-        *rsp_len = 5;
-        p_rsp_data[0] = 0x40;
-        p_rsp_data[1] = 0x02;
-        p_rsp_data[2] = 0x02;
-        p_rsp_data[3] = 0x00;
-        p_rsp_data[4] = 0x00;
-
-        phNxpNciHal_print_packet("RECV", p_rsp_data, 5);
-        status = NFCSTATUS_FAILED;
-        NXPLOG_NCIHAL_D ("> Going through workaround - Dirty Set Config - End ");
-    }
-#endif
-  else if ((wFwVerRsp & 0x0000FFFF) == wFwVer) {
-    /* skip CORE_RESET and CORE_INIT from Brcm */
-    if (p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x00 &&
-        p_cmd_data[2] == 0x01 && p_cmd_data[3] == 0x01) {
-      //            *rsp_len = 6;
-      //
-      //            NXPLOG_NCIHAL_D("> Going - core reset optimization");
-      //
-      //            p_rsp_data[0] = 0x40;
-      //            p_rsp_data[1] = 0x00;
-      //            p_rsp_data[2] = 0x03;
-      //            p_rsp_data[3] = 0x00;
-      //            p_rsp_data[4] = 0x10;
-      //            p_rsp_data[5] = 0x01;
-      //
-      //            status = NFCSTATUS_FAILED;
-      //            NXPLOG_NCIHAL_D("> Going - core reset optimization - END");
-    }
-    /* CORE_INIT */
-    else if (p_cmd_data[0] == 0x20 && p_cmd_data[1] == 0x01 &&
-             p_cmd_data[2] == 0x00) {
-      //            NXPLOG_NCIHAL_D("> Going - core init optimization");
-      //            *rsp_len = iCoreInitRspLen;
-      //            memcpy(p_rsp_data, bCoreInitRsp, iCoreInitRspLen);
-      //            status = NFCSTATUS_FAILED;
-      //            NXPLOG_NCIHAL_D("> Going - core init optimization - END");
-    }
-  }
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_cmd_config_reload
+**
+** Description      Sends RF settings reloaded at runtime while RF is idle,
+**                  before discovery is started.
+**
+*******************************************************************************/
+static phNxpNciHal_ExtResult_t phNxpNciHal_ext_cmd_config_reload(
+    phNxpNciHal_ExtPkt_t* pkt) {
+  UNUSED_PROP(pkt);
+  phNxpNciHal_configReloadApply();
+  return NCI_EXT_NOT_MATCHED;
+}
 
+/* Extensions applied to packets sent by libnfc-nci, in processing order */
+static const phNxpNciHal_ExtRow_t sExtCmdRows[] = {
+    {NCI_EXT_KEY(0x21, 0x03), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_config_reload},
+    {NCI_EXT_KEY(0x21, 0x03), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_nfcdep},
+    {NCI_EXT_KEY_ANY, NCI_EXT_NO_CHAIN, NCI_EXT_FL_DTA,
+     phNxpNciHal_ext_cmd_dta},
+    {NCI_EXT_KEY(PROPRIETARY_CMD_FELICA_READER_MODE,
+                 PROPRIETARY_CMD_FELICA_READER_MODE),
+     NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL, phNxpNciHal_ext_cmd_felica_reader},
+    {NCI_EXT_KEY(0x20, 0x02), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_poll_profile},
+    {NCI_EXT_KEY(0x21, 0x03), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_emvco_disc_map},
+    {NCI_EXT_KEY(0x21, 0x03), NCI_EXT_NO_CHAIN, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_mfc_disc_map},
+    {NCI_EXT_KEY(0x21, 0x00), NCI_EXT_CHAIN_1, NCI_EXT_FL_MFC_READER,
+     phNxpNciHal_ext_cmd_mfc_discover},
+    {NCI_EXT_KEY_CONN(NCI_EXT_STATIC_HCI_CONN), NCI_EXT_CHAIN_1,
+     NCI_EXT_FL_ALL, phNxpNciHal_ext_cmd_host_list},
+    {NCI_EXT_KEY_ANY, NCI_EXT_CHAIN_1, NCI_EXT_FL_ICODE,
+     phNxpNciHal_ext_cmd_icode},
+    {NCI_EXT_KEY(0x21, 0x03), NCI_EXT_CHAIN_1, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_poll_start},
+    {NCI_EXT_KEY(0x22, 0x00), NCI_EXT_CHAIN_1, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_ee_discover},
+    {NCI_EXT_KEY(0x20, 0x02), NCI_EXT_CHAIN_1, NCI_EXT_FL_ALL,
+     phNxpNciHal_ext_cmd_dirty_set_config},
+};
 
-  return status;
+/*******************************************************************************
+**
+** Function         phNxpNciHal_ext_build_dispatch
+**
+** Description      Compiles the extension dispatch tables, run once.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_ext_build_dispatch(void) {
+  static_assert(sizeof(sExtRspRows) / sizeof(sExtRspRows[0]) <= NCI_EXT_MAX_ROWS,
+                "too many NCI extension rows");
+  static_assert(sizeof(sExtCmdRows) / sizeof(sExtCmdRows[0]) <= NCI_EXT_MAX_ROWS,
+                "too many NCI extension rows");
+  phNxpNciHal_ext_build_table(&sExtRspTable, sExtRspRows,
+                              sizeof(sExtRspRows) / sizeof(sExtRspRows[0]));
+  phNxpNciHal_ext_build_table(&sExtCmdTable, sExtCmdRows,
+                              sizeof(sExtCmdRows) / sizeof(sExtCmdRows[0]));
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_write_ext
+ *
+ * Description      This function inform the status of phNxpNciHal_open
+ *                  function to libnfc-nci.
+ *
+ * Returns          It return NFCSTATUS_SUCCESS then continue with send else
+ *                  sends NFCSTATUS_FAILED direct response is prepared and
+ *                  do not send anything to NFCC.
+ *
+ ******************************************************************************/
+NFCSTATUS phNxpNciHal_write_ext(uint16_t* cmd_len, uint8_t* p_cmd_data,
+                                uint16_t* rsp_len, uint8_t* p_rsp_data) {
+  phNxpNciHal_ExtPkt_t pkt = {p_cmd_data, cmd_len, rsp_len, p_rsp_data,
+                              NFCSTATUS_SUCCESS};
+
+  return phNxpNciHal_ext_dispatch(&sExtCmdTable, &pkt);
 }
 
 /******************************************************************************
@@ -1017,10 +1793,13 @@ NFCSTATUS phNxpNciHal_write_ext(uint16_t* cmd_len, uint8_t* p_cmd_data,
  ******************************************************************************/
 NFCSTATUS phNxpNciHal_send_ext_cmd(uint16_t cmd_len, uint8_t* p_cmd) {
   NFCSTATUS status = NFCSTATUS_FAILED;
+  phNxpNciHal_lockStatsMutexLock(PH_NXP_LOCK_SITE_EXT_CMD, &sExtCmdLock);
   nxpncihal_ctrl.cmd_len = cmd_len;
   memcpy(nxpncihal_ctrl.p_cmd_data, p_cmd, cmd_len);
   status = phNxpNciHal_process_ext_cmd_rsp(nxpncihal_ctrl.cmd_len,
-                                           nxpncihal_ctrl.p_cmd_data);
+                                           nxpncihal_ctrl.p_cmd_data,
+                                           HAL_EXTNS_WRITE_RSP_TIMEOUT);
+  phNxpNciHal_lockStatsMutexUnlock(PH_NXP_LOCK_SITE_EXT_CMD, &sExtCmdLock);
 
   return status;
 }
@@ -1042,10 +1821,48 @@ NFCSTATUS phNxpNciHal_send_ese_hal_cmd(uint16_t cmd_len, uint8_t* p_cmd) {
     NXPLOG_NCIHAL_E("cmd_len exceeds limit NCI_MAX_DATA_LEN");
     return status;
   }
+  phNxpNciHal_lockStatsMutexLock(PH_NXP_LOCK_SITE_EXT_CMD, &sExtCmdLock);
   nxpncihal_ctrl.cmd_len = cmd_len;
   memcpy(nxpncihal_ctrl.p_cmd_data, p_cmd, cmd_len);
   status = phNxpNciHal_process_ext_cmd_rsp(nxpncihal_ctrl.cmd_len,
-                                              nxpncihal_ctrl.p_cmd_data);
+                                           nxpncihal_ctrl.p_cmd_data,
+                                           HAL_EXTNS_WRITE_RSP_TIMEOUT);
+  phNxpNciHal_lockStatsMutexUnlock(PH_NXP_LOCK_SITE_EXT_CMD, &sExtCmdLock);
+  return status;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_exec_ext_cmd
+ *
+ * Description      This function sends the extension command from the
+ *                  caller's buffer, waiting at most timeout_ms for its
+ *                  response and for its notification if one is expected,
+ *                  and copies the last packet received for it to p_rsp,
+ *                  which holds NCI_MAX_DATA_LEN bytes.
+ *
+ * Returns          Same as phNxpNciHal_send_ext_cmd, *p_rsp_len is 0 if
+ *                  nothing was received.
+ *
+ ******************************************************************************/
+NFCSTATUS phNxpNciHal_exec_ext_cmd(uint16_t cmd_len, uint8_t* p_cmd,
+                                   uint32_t timeout_ms, uint16_t* p_rsp_len,
+                                   uint8_t* p_rsp) {
+  NFCSTATUS status = NFCSTATUS_FAILED;
+
+  *p_rsp_len = 0;
+  if (cmd_len > NCI_MAX_DATA_LEN) {
+    NXPLOG_NCIHAL_E("cmd_len exceeds limit NCI_MAX_DATA_LEN");
+    return status;
+  }
+  phNxpNciHal_lockStatsMutexLock(PH_NXP_LOCK_SITE_EXT_CMD, &sExtCmdLock);
+  status = phNxpNciHal_process_ext_cmd_rsp(cmd_len, p_cmd, timeout_ms);
+  if (status != NFCSTATUS_FAILED && nxpncihal_ctrl.p_rx_data != NULL) {
+    *p_rsp_len = (nxpncihal_ctrl.rx_data_len < NCI_MAX_DATA_LEN)
+                     ? nxpncihal_ctrl.rx_data_len
+                     : NCI_MAX_DATA_LEN;
+    memcpy(p_rsp, nxpncihal_ctrl.p_rx_data, *p_rsp_len);
+  }
+  phNxpNciHal_lockStatsMutexUnlock(PH_NXP_LOCK_SITE_EXT_CMD, &sExtCmdLock);
   return status;
 }
 
@@ -1071,200 +1888,219 @@ static void hal_extns_write_rsp_timeout_cb(uint32_t timerId, void* pContext) {
 
 /*******************************************************************************
  **
- ** Function:        request_EEPROM()
+ ** Function:        phNxpNciHal_get_eeprom_field()
  **
- ** Description:     get and set EEPROM data
- **                  In case of request_modes GET_EEPROM_DATA or
- *SET_EEPROM_DATA,
- **                   1.caller has to pass the buffer and the length of data
- *required
- **                     to be read/written.
- **                   2.Type of information required to be read/written
- **                     (Example - EEPROM_RF_CFG)
+ ** Description:     Gives the EEPROM address and the location within it of
+ **                  the information of request_type
  **
- ** Returns:         Returns NFCSTATUS_SUCCESS if sending cmd is successful and
- **                  status failed if not succesful
+ ** Returns:         true if request_type is valid
  **
  *******************************************************************************/
-NFCSTATUS request_EEPROM(phNxpNci_EEPROM_info_t* mEEPROM_info) {
-  NXPLOG_NCIHAL_D(
-      "%s Enter  request_type : 0x%02x,  request_mode : 0x%02x,  bufflen : "
-      "0x%02x",
-      __func__, mEEPROM_info->request_type, mEEPROM_info->request_mode,
-      mEEPROM_info->bufflen);
-  NFCSTATUS status = NFCSTATUS_FAILED;
-  uint8_t retry_cnt = 0;
-  uint8_t getCfgStartIndex = 0x08;
-  uint8_t setCfgStartIndex = 0x07;
-  uint8_t memIndex = 0x00;
-  uint8_t fieldLen = 0x01;  // Memory field len 1bytes
-  char addr[2] = {0};
-  uint8_t cur_value = 0, len = 5;
-  uint8_t b_position = 0;
-  bool_t update_req = false;
-  uint16_t set_cfg_cmd_len = 0;
-  uint8_t* set_cfg_eeprom, *base_addr;
-
-  mEEPROM_info->update_mode = BITWISE;
-
-  switch (mEEPROM_info->request_type) {
+static bool phNxpNciHal_get_eeprom_field(
+    phNxpNci_EEPROM_request_type_t request_type, uint8_t bufflen,
+    phNxpNci_EEPROM_field_t* p_field) {
+  p_field->memIndex = 0x00;
+  p_field->fieldLen = 0x01;  // Memory field len 1bytes
+  p_field->b_position = 0;
+  p_field->update_mode = BITWISE;
+
+  switch (request_type) {
     case EEPROM_RF_CFG:
-      memIndex = 0x00;
-      fieldLen = 0x20;
-      len = fieldLen + 4;  // 4 - numParam+2add+val
-      addr[0] = 0xA0;
-      addr[1] = 0x14;
-      mEEPROM_info->update_mode = BYTEWISE;
+      p_field->memIndex = 0x00;
+      p_field->fieldLen = 0x20;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x14;
+      p_field->update_mode = BYTEWISE;
       break;
 
     case EEPROM_FW_DWNLD:
-      fieldLen = 0x20;
-      memIndex = 0x0C;
-      len = fieldLen + 4;
-      addr[0] = 0xA0;
-      addr[1] = 0x0F;
-      mEEPROM_info->update_mode = BYTEWISE;
+      p_field->fieldLen = 0x20;
+      p_field->memIndex = 0x0C;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x0F;
+      p_field->update_mode = BYTEWISE;
       break;
 
     case EEPROM_WIREDMODE_RESUME_TIMEOUT:
-      mEEPROM_info->update_mode = BYTEWISE;
-      memIndex = 0x00;
-      fieldLen = 0x04;
-      len = fieldLen + 4;
-      addr[0] = 0xA0;
-      addr[1] = 0xFC;
+      p_field->update_mode = BYTEWISE;
+      p_field->memIndex = 0x00;
+      p_field->fieldLen = 0x04;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xFC;
       break;
 
     case EEPROM_ESE_SVDD_POWER:
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xF2;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xF2;
       break;
     case EEPROM_ESE_POWER_EXT_PMU:
-      mEEPROM_info->update_mode = BYTEWISE;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xD7;
+      p_field->update_mode = BYTEWISE;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xD7;
       break;
 
     case EEPROM_PROP_ROUTING:
-      b_position = 7;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0x98;
+      p_field->b_position = 7;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x98;
       break;
 
     case EEPROM_ESE_SESSION_ID:
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xEB;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xEB;
       break;
 
     case EEPROM_SWP1_INTF:
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xEC;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xEC;
       break;
 
     case EEPROM_SWP1A_INTF:
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xD4;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xD4;
       break;
     case EEPROM_SWP2_INTF:
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xED;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xED;
       break;
     case EEPROM_FLASH_UPDATE:
       /* This flag is no more used in MW */
-      fieldLen = 0x20;
-      memIndex = 0x00;
-      len = fieldLen + 4;
-      addr[0] = 0xA0;
-      addr[1] = 0x0F;
+      p_field->fieldLen = 0x20;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x0F;
       break;
     case EEPROM_AUTH_CMD_TIMEOUT:
-      mEEPROM_info->update_mode = BYTEWISE;
-      memIndex = 0x00;
-      fieldLen = 0x05;
-      len = fieldLen + 4;
-      addr[0] = 0xA0;
-      addr[1] = 0xF7;
+      p_field->update_mode = BYTEWISE;
+      p_field->memIndex = 0x00;
+      p_field->fieldLen = 0x05;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xF7;
       break;
     case EEPROM_GUARD_TIMER:
-      mEEPROM_info->update_mode = BYTEWISE;
-      memIndex = 0x00;
-      addr[0] = 0xA1;
-      addr[1] = 0x0B;
+      p_field->update_mode = BYTEWISE;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA1;
+      p_field->addr[1] = 0x0B;
       break;
     case EEPROM_AUTONOMOUS_MODE:
-      mEEPROM_info->update_mode = BYTEWISE;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0x15;
+      p_field->update_mode = BYTEWISE;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x15;
       break;
     case EEPROM_T4T_NFCEE_ENABLE:
-     mEEPROM_info->update_mode = BYTEWISE;
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0x95;
+     p_field->update_mode = BYTEWISE;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x95;
       break;
     case EEPROM_CE_PHONE_OFF_CFG:
-      mEEPROM_info->update_mode = BYTEWISE;
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0x8E;
+      p_field->update_mode = BYTEWISE;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x8E;
       break;
     case EEPROM_ENABLE_VEN_CFG:
-      mEEPROM_info->update_mode = BYTEWISE;
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0x07;
+      p_field->update_mode = BYTEWISE;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0x07;
       break;
     case EEPROM_ISODEP_MERGE_SAK:
-      mEEPROM_info->update_mode = BYTEWISE;
-      b_position = 0;
-      memIndex = 0x00;
-      addr[0] = 0xA1;
-      addr[1] = 0x1B;
+      p_field->update_mode = BYTEWISE;
+      p_field->b_position = 0;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA1;
+      p_field->addr[1] = 0x1B;
       break;
     case EEPROM_SRD_TIMEOUT:
-      mEEPROM_info->update_mode = BYTEWISE;
-      memIndex = 0x00;
-      fieldLen = 0x02;
-      len = fieldLen + 4;
-      addr[0] = 0xA1;
-      addr[1] = 0x17;
+      p_field->update_mode = BYTEWISE;
+      p_field->memIndex = 0x00;
+      p_field->fieldLen = 0x02;
+      p_field->addr[0] = 0xA1;
+      p_field->addr[1] = 0x17;
       break;
     case EEPROM_UICC1_SESSION_ID:
-      fieldLen = mEEPROM_info->bufflen;
-      len = fieldLen + 4;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xE4;
-      mEEPROM_info->update_mode = BYTEWISE;
+      p_field->fieldLen = bufflen;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xE4;
+      p_field->update_mode = BYTEWISE;
       break;
     case EEPROM_UICC2_SESSION_ID:
-      fieldLen = mEEPROM_info->bufflen;
-      len = fieldLen + 4;
-      memIndex = 0x00;
-      addr[0] = 0xA0;
-      addr[1] = 0xE5;
-      mEEPROM_info->update_mode = BYTEWISE;
+      p_field->fieldLen = bufflen;
+      p_field->memIndex = 0x00;
+      p_field->addr[0] = 0xA0;
+      p_field->addr[1] = 0xE5;
+      p_field->update_mode = BYTEWISE;
       break;
     default:
       ALOGE("No valid request information found");
-      break;
+      return false;
+  }
+  return true;
+}
+
+
+/*******************************************************************************
+ **
+ ** Function:        request_EEPROM()
+ **
+ ** Description:     get and set EEPROM data
+ **                  In case of request_modes GET_EEPROM_DATA or
+ *SET_EEPROM_DATA,
+ **                   1.caller has to pass the buffer and the length of data
+ *required
+ **                     to be read/written.
+ **                   2.Type of information required to be read/written
+ **                     (Example - EEPROM_RF_CFG)
+ **
+ ** Returns:         Returns NFCSTATUS_SUCCESS if sending cmd is successful and
+ **                  status failed if not succesful
+ **
+ *******************************************************************************/
+NFCSTATUS request_EEPROM(phNxpNci_EEPROM_info_t* mEEPROM_info) {
+  NXPLOG_NCIHAL_D(
+      "%s Enter  request_type : 0x%02x,  request_mode : 0x%02x,  bufflen : "
+      "0x%02x",
+      __func__, mEEPROM_info->request_type, mEEPROM_info->request_mode,
+      mEEPROM_info->bufflen);
+  NFCSTATUS status = NFCSTATUS_FAILED;
+  uint8_t retry_cnt = 0;
+  uint8_t getCfgStartIndex = 0x08;
+  uint8_t setCfgStartIndex = 0x07;
+  phNxpNci_EEPROM_field_t field;
+  uint8_t cur_value = 0;
+  bool_t update_req = false;
+  uint16_t set_cfg_cmd_len = 0;
+  uint8_t* set_cfg_eeprom, *base_addr;
+
+  if (!phNxpNciHal_get_eeprom_field(mEEPROM_info->request_type,
+                                    mEEPROM_info->bufflen, &field)) {
+    return status;
   }
+  mEEPROM_info->update_mode = field.update_mode;
+  uint8_t memIndex = field.memIndex;
+  uint8_t fieldLen = field.fieldLen;
+  uint8_t b_position = field.b_position;
+  uint8_t* addr = field.addr;
+  uint8_t len = fieldLen + 4;  // 4 - numParam+2add+val
 
   uint8_t get_cfg_eeprom[6] = {
       0x20,    0x03,  // get_cfg header
@@ -1366,6 +2202,311 @@ retryget:
   return status;
 }
 
+/* EEPROM field shared by the entries of a transaction */
+typedef struct {
+  phNxpNci_EEPROM_field_t field;
+  bool_t is_read;
+  uint8_t rsp_len;
+  uint8_t orig[NXP_EEPROM_TXN_MAX_FIELD_LEN];
+  uint8_t value[NXP_EEPROM_TXN_MAX_FIELD_LEN];
+} phNxpNci_EEPROM_txn_slot_t;
+
+/*******************************************************************************
+ **
+ ** Function:        phNxpNciHal_eeprom_txn_init()
+ **
+ ** Description:     Starts an EEPROM transaction. Requests are staged with
+ **                  phNxpNciHal_eeprom_txn_add() and done together by
+ **                  phNxpNciHal_eeprom_txn_commit().
+ **
+ ** Returns:         None
+ **
+ *******************************************************************************/
+void phNxpNciHal_eeprom_txn_init(phNxpNci_EEPROM_txn_t* p_txn) {
+  p_txn->num_entries = 0;
+}
+
+/*******************************************************************************
+ **
+ ** Function:        phNxpNciHal_eeprom_txn_add()
+ **
+ ** Description:     Stages a request_EEPROM() request. Value of a
+ **                  SET_EEPROM_DATA request is copied, buffer of a
+ **                  GET_EEPROM_DATA request is filled on commit and must
+ **                  remain valid until then.
+ **                  If p_txn is NULL, the request is done at once.
+ **
+ ** Returns:         NFCSTATUS_SUCCESS if staged, or status of request_EEPROM
+ **
+ *******************************************************************************/
+NFCSTATUS phNxpNciHal_eeprom_txn_add(phNxpNci_EEPROM_txn_t* p_txn,
+                                     phNxpNci_EEPROM_info_t* mEEPROM_info) {
+  phNxpNci_EEPROM_txn_entry_t* p_entry;
+
+  if (p_txn == NULL) {
+    return request_EEPROM(mEEPROM_info);
+  }
+  if (p_txn->num_entries >= NXP_EEPROM_TXN_MAX_ENTRIES ||
+      mEEPROM_info->bufflen > NXP_EEPROM_TXN_MAX_FIELD_LEN) {
+    NXPLOG_NCIHAL_E("%s: unable to stage request_type 0x%02x", __func__,
+                    mEEPROM_info->request_type);
+    return NFCSTATUS_INVALID_PARAMETER;
+  }
+  p_entry = &p_txn->entries[p_txn->num_entries++];
+  p_entry->request_mode = mEEPROM_info->request_mode;
+  p_entry->request_type = mEEPROM_info->request_type;
+  p_entry->buffer = mEEPROM_info->buffer;
+  p_entry->bufflen = mEEPROM_info->bufflen;
+  if (p_entry->request_mode == SET_EEPROM_DATA) {
+    memcpy(p_entry->value, mEEPROM_info->buffer, mEEPROM_info->bufflen);
+  }
+  p_entry->status = NFCSTATUS_PENDING;
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+ **
+ ** Function:        phNxpNciHal_eeprom_txn_send()
+ **
+ ** Description:     Sends a GET_CONFIG/SET_CONFIG of the fields in slot_mask
+ **                  and stores the values of the GET_CONFIG response.
+ **                  A field which does not fit in the max control packet
+ **                  payload along the previous ones is left to the next
+ **                  call, slot_mask is updated with the fields sent.
+ **
+ ** Returns:         Status of the command
+ **
+ *******************************************************************************/
+static NFCSTATUS phNxpNciHal_eeprom_txn_send(
+    uint8_t request_mode, phNxpNci_EEPROM_txn_slot_t* p_slots,
+    uint8_t num_slots, uint32_t* p_slot_mask) {
+  uint8_t cmd[NCI_HEADER_SIZE + 255];
+  uint16_t max_payload = nxpncihal_ctrl.nci_info.max_ctrl_payload;
+  uint16_t cmd_len = NCI_HEADER_SIZE + 1, rsp_len = 2, param_len;
+  uint32_t sent = 0;
+  uint8_t retry_cnt = 0;
+  NFCSTATUS status;
+
+  if (max_payload < NCI_MIN_CTRL_PAYLOAD) {
+    max_payload = NCI_MIN_CTRL_PAYLOAD;
+  }
+  cmd[0] = 0x20;
+  cmd[1] = (request_mode == GET_EEPROM_DATA) ? 0x03 : 0x02;
+  cmd[3] = 0;
+  for (uint8_t i = 0; i < num_slots; i++) {
+    if (!(*p_slot_mask & (1U << i))) continue;
+    param_len = 3 + p_slots[i].field.fieldLen;
+    /* A GET_CONFIG response carries the values, a SET_CONFIG command too */
+    if (sent != 0 && ((request_mode == GET_EEPROM_DATA)
+                          ? (rsp_len + param_len > max_payload)
+                          : (cmd_len + param_len - NCI_HEADER_SIZE >
+                             max_payload))) {
+      continue;
+    }
+    cmd[cmd_len++] = p_slots[i].field.addr[0];
+    cmd[cmd_len++] = p_slots[i].field.addr[1];
+    if (request_mode == SET_EEPROM_DATA) {
+      cmd[cmd_len++] = p_slots[i].field.fieldLen;
+      memcpy(&cmd[cmd_len], p_slots[i].value, p_slots[i].field.fieldLen);
+      cmd_len += p_slots[i].field.fieldLen;
+    }
+    rsp_len += param_len;
+    cmd[3]++;
+    sent |= (1U << i);
+  }
+  cmd[2] = cmd_len - NCI_HEADER_SIZE;
+  *p_slot_mask = sent;
+
+  do {
+    status = phNxpNciHal_send_ext_cmd(cmd_len, cmd);
+  } while (status != NFCSTATUS_SUCCESS && retry_cnt++ < NXP_EEPROM_TXN_MAX_RETRY);
+  if (status != NFCSTATUS_SUCCESS || request_mode != GET_EEPROM_DATA) {
+    return status;
+  }
+  if (nxpncihal_ctrl.p_rx_data[3] != NFCSTATUS_SUCCESS) {
+    ALOGE("failed to get requested memory address");
+    return nxpncihal_ctrl.p_rx_data[3];
+  }
+
+  /* 40 03 len status num_params {addr[2] len value}... */
+  uint16_t idx = 5, total = nxpncihal_ctrl.rx_data_len;
+  for (uint8_t param = 0;
+       param < nxpncihal_ctrl.p_rx_data[4] && idx + 3 <= total; param++) {
+    uint8_t* p_param = &nxpncihal_ctrl.p_rx_data[idx];
+    idx += 3 + p_param[2];
+    if (idx > total) break;
+    for (uint8_t i = 0; i < num_slots; i++) {
+      if (!(sent & (1U << i)) || p_slots[i].field.addr[0] != p_param[0] ||
+          p_slots[i].field.addr[1] != p_param[1]) {
+        continue;
+      }
+      p_slots[i].rsp_len = p_param[2];
+      memcpy(p_slots[i].orig, &p_param[3],
+             (p_param[2] < NXP_EEPROM_TXN_MAX_FIELD_LEN)
+                 ? p_param[2]
+                 : NXP_EEPROM_TXN_MAX_FIELD_LEN);
+      memcpy(p_slots[i].value, p_slots[i].orig, NXP_EEPROM_TXN_MAX_FIELD_LEN);
+      p_slots[i].is_read = true;
+    }
+  }
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+ **
+ ** Function:        phNxpNciHal_eeprom_txn_commit()
+ **
+ ** Description:     Does the staged requests. All the fields are read with
+ **                  as few GET_CONFIG as possible, bit and byte updates are
+ **                  merged locally and only the fields whose value changed
+ **                  are written back, with as few SET_CONFIG as possible.
+ **                  A request whose field could not be read is done alone
+ **                  through request_EEPROM().
+ **
+ ** Returns:         NFCSTATUS_SUCCESS if all the requests succeeded
+ **
+ *******************************************************************************/
+NFCSTATUS phNxpNciHal_eeprom_txn_commit(phNxpNci_EEPROM_txn_t* p_txn) {
+  phNxpNci_EEPROM_txn_slot_t slots[NXP_EEPROM_TXN_MAX_ENTRIES];
+  uint8_t entry_slot[NXP_EEPROM_TXN_MAX_ENTRIES];
+  phNxpNci_EEPROM_field_t field;
+  phNxpNci_EEPROM_info_t info;
+  uint8_t num_slots = 0, slot;
+  uint32_t pending, sent;
+  NFCSTATUS status = NFCSTATUS_SUCCESS;
+
+  NXPLOG_NCIHAL_D("%s Enter num_entries : %d", __func__, p_txn->num_entries);
+  memset(slots, 0x00, sizeof(slots));
+  for (uint8_t i = 0; i < p_txn->num_entries; i++) {
+    phNxpNci_EEPROM_txn_entry_t* p_entry = &p_txn->entries[i];
+    entry_slot[i] = NXP_EEPROM_TXN_MAX_ENTRIES;
+    if (!phNxpNciHal_get_eeprom_field(p_entry->request_type, p_entry->bufflen,
+                                      &field) ||
+        field.fieldLen > NXP_EEPROM_TXN_MAX_FIELD_LEN) {
+      p_entry->status = NFCSTATUS_FAILED;
+      continue;
+    }
+    for (slot = 0; slot < num_slots; slot++) {
+      if (slots[slot].field.addr[0] == field.addr[0] &&
+          slots[slot].field.addr[1] == field.addr[1]) {
+        break;
+      }
+    }
+    if (slot == num_slots) {
+      slots[num_slots++].field = field;
+    } else if (field.fieldLen > slots[slot].field.fieldLen) {
+      slots[slot].field.fieldLen = field.fieldLen;
+    }
+    entry_slot[i] = slot;
+  }
+
+  /* Read all the fields */
+  pending = (1U << num_slots) - 1;
+  while (pending != 0) {
+    sent = pending;
+    phNxpNciHal_eeprom_txn_send(GET_EEPROM_DATA, slots, num_slots, &sent);
+    pending &= ~sent;
+  }
+
+  /* Serve the reads and merge the updates in the order of staging */
+  for (uint8_t i = 0; i < p_txn->num_entries; i++) {
+    phNxpNci_EEPROM_txn_entry_t* p_entry = &p_txn->entries[i];
+    if (entry_slot[i] == NXP_EEPROM_TXN_MAX_ENTRIES) continue;
+    phNxpNci_EEPROM_txn_slot_t* p_slot = &slots[entry_slot[i]];
+    phNxpNciHal_get_eeprom_field(p_entry->request_type, p_entry->bufflen,
+                                 &field);
+    if (!p_slot->is_read ||
+        field.memIndex + p_entry->bufflen > p_slot->field.fieldLen) {
+      continue;
+    }
+    if (p_entry->request_mode == GET_EEPROM_DATA) {
+      memcpy(p_entry->buffer, &p_slot->orig[field.memIndex],
+             p_entry->bufflen);
+      p_entry->status = NFCSTATUS_SUCCESS;
+    } else if (p_entry->request_mode == SET_EEPROM_DATA) {
+      if (field.update_mode == BITWISE) {
+        if (p_entry->value[0] == 1) {
+          p_slot->value[field.memIndex] |= (1 << field.b_position);
+        } else if (p_entry->value[0] == 0) {
+          p_slot->value[field.memIndex] &= (~(1 << field.b_position));
+        }
+      } else {
+        memcpy(&p_slot->value[field.memIndex], p_entry->value,
+               p_entry->bufflen);
+      }
+      p_entry->status = NFCSTATUS_PENDING;
+    }
+  }
+
+  /* Write back the fields which changed */
+  pending = 0;
+  for (slot = 0; slot < num_slots; slot++) {
+    if (slots[slot].is_read &&
+        memcmp(slots[slot].orig, slots[slot].value, slots[slot].field.fieldLen)) {
+      pending |= (1U << slot);
+    }
+  }
+  if (pending == 0) {
+    NXPLOG_NCIHAL_D("%s: values are same no update required", __func__);
+  }
+  while (pending != 0) {
+    sent = pending;
+    status = phNxpNciHal_eeprom_txn_send(SET_EEPROM_DATA, slots, num_slots,
+                                         &sent);
+    for (uint8_t i = 0; i < p_txn->num_entries; i++) {
+      if (entry_slot[i] != NXP_EEPROM_TXN_MAX_ENTRIES &&
+          (sent & (1U << entry_slot[i])) &&
+          p_txn->entries[i].status == NFCSTATUS_PENDING) {
+        p_txn->entries[i].status = status;
+      }
+    }
+    pending &= ~sent;
+  }
+
+  status = NFCSTATUS_SUCCESS;
+  for (uint8_t i = 0; i < p_txn->num_entries; i++) {
+    phNxpNci_EEPROM_txn_entry_t* p_entry = &p_txn->entries[i];
+    if (p_entry->status == NFCSTATUS_PENDING) {
+      if (entry_slot[i] != NXP_EEPROM_TXN_MAX_ENTRIES &&
+          slots[entry_slot[i]].is_read) {
+        /* Field unchanged */
+        p_entry->status = NFCSTATUS_SUCCESS;
+      } else {
+        info.request_mode = p_entry->request_mode;
+        info.request_type = p_entry->request_type;
+        info.buffer = (p_entry->request_mode == SET_EEPROM_DATA)
+                          ? p_entry->value
+                          : p_entry->buffer;
+        info.bufflen = p_entry->bufflen;
+        p_entry->status = request_EEPROM(&info);
+      }
+    }
+    if (p_entry->status != NFCSTATUS_SUCCESS) {
+      status = NFCSTATUS_FAILED;
+    }
+  }
+  return status;
+}
+
+/*******************************************************************************
+ **
+ ** Function:        phNxpNciHal_eeprom_txn_status()
+ **
+ ** Description:     Status of the last committed request of request_type
+ **
+ ** Returns:         Status of the request, NFCSTATUS_SUCCESS if not staged
+ **
+ *******************************************************************************/
+NFCSTATUS phNxpNciHal_eeprom_txn_status(
+    phNxpNci_EEPROM_txn_t* p_txn, phNxpNci_EEPROM_request_type_t request_type) {
+  for (int i = p_txn->num_entries - 1; i >= 0; i--) {
+    if (p_txn->entries[i].request_type == request_type) {
+      return p_txn->entries[i].status;
+    }
+  }
+  return NFCSTATUS_SUCCESS;
+}
+
 /*******************************************************************************
  **
  ** Function:        phNxpNciHal_enableDefaultUICC2SWPline()
@@ -1455,18 +2596,15 @@ void phNxpNciHal_prop_conf_lpcd(bool enableLPCD) {
  *
  ******************************************************************************/
 void phNxpNciHal_conf_nfc_forum_mode() {
+  phNxpNciHal_ConfigSnapshotRef_t pSnap = phNxpNciHal_configSnapshot();
   uint8_t cmd_get_emvcocfg[] = {0x20, 0x03, 0x03, 0x01, 0xA0, 0x44};
-  uint8_t cmd_reset_emvcocfg[8];
-  long cmdlen = 8;
-  long retlen = 0;
+  uint8_t cmd_reset_emvcocfg[NXP_CONFIG_SNAPSHOT_EMVCO_CMD_LEN];
 
-  if (GetNxpByteArrayValue(NAME_NXP_PROP_RESET_EMVCO_CMD, (char *)cmd_reset_emvcocfg,
-          cmdlen, &retlen)) {
-  }
-  if(retlen != 0x08) {
+  if(pSnap->lResetEmvcoCmdLen != 0x08) {
     NXPLOG_NCIHAL_E("%s: command is not provided", __func__);
     return;
   }
+  memcpy(cmd_reset_emvcocfg, pSnap->aResetEmvcoCmd, sizeof(cmd_reset_emvcocfg));
   /* Update the flag address from the Nxp config file */
   cmd_get_emvcocfg[4] = cmd_reset_emvcocfg[4];
   cmd_get_emvcocfg[5] = cmd_reset_emvcocfg[5];
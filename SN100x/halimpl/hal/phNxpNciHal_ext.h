@@ -24,17 +24,25 @@
 #define NCI_MT_NTF 0x60
 #define NCI_MSG_CORE_RESET           0x00
 #define NCI_MSG_CORE_INIT            0x01
+/* Timeout value to wait for response from PN548AD */
+#define HAL_EXTNS_WRITE_RSP_TIMEOUT (1000)
 
 #define NXP_NFC_SET_CONFIG_PARAM_EXT 0xA0
 #define NXP_NFC_PARAM_ID_SWP2        0xD4
 #define NXP_NFC_PARAM_ID_SWPUICC3    0xDC
 
 void phNxpNciHal_ext_init(void);
+void phNxpNciHal_ext_register_handlers(void);
 NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len);
 NFCSTATUS phNxpNciHal_send_ext_cmd(uint16_t cmd_len, uint8_t* p_cmd);
 NFCSTATUS phNxpNciHal_send_ese_hal_cmd(uint16_t cmd_len, uint8_t* p_cmd);
+NFCSTATUS phNxpNciHal_exec_ext_cmd(uint16_t cmd_len, uint8_t* p_cmd,
+                                   uint32_t timeout_ms, uint16_t* p_rsp_len,
+                                   uint8_t* p_rsp);
 NFCSTATUS phNxpNciHal_write_ext(uint16_t* cmd_len, uint8_t* p_cmd_data,
                                 uint16_t* rsp_len, uint8_t* p_rsp_data);
+bool phNxpNciHal_write_ext_is_passthrough(uint16_t cmd_len,
+                                          const uint8_t* p_cmd_data);
 
 extern bool_t wFwUpdateReq;
 extern bool_t wRfUpdateReq;
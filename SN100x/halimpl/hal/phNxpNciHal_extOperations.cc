@@ -43,12 +43,13 @@ uint8_t phNxpNciHal_updateAutonomousPwrState(uint8_t num) {
  * Function         phNxpNciHal_setAutonomousMode
  *
  * Description      This function can be used to set NFCC in autonomous mode
+ *                  p_txn: EEPROM transaction to stage the update in, if any
  *
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS
  *                  or NFCSTATUS_FEATURE_NOT_SUPPORTED
  *
  ******************************************************************************/
-NFCSTATUS phNxpNciHal_setAutonomousMode() {
+NFCSTATUS phNxpNciHal_setAutonomousMode(phNxpNci_EEPROM_txn_t* p_txn) {
   if (nfcFL.chipType < sn100u) {
     NXPLOG_NCIHAL_D("%s : Not applicable for chipType %d",
                                   __func__, nfcFL.chipType);
@@ -64,17 +65,18 @@ NFCSTATUS phNxpNciHal_setAutonomousMode() {
   mEEPROM_info.bufflen = sizeof(autonomous_mode_value);
   mEEPROM_info.request_type = EEPROM_AUTONOMOUS_MODE;
 
-  return request_EEPROM(&mEEPROM_info);
+  return phNxpNciHal_eeprom_txn_add(p_txn, &mEEPROM_info);
 }
 /******************************************************************************
  * Function         phNxpNciHal_setGuardTimer
  *
  * Description      This function can be used to set nfcc Guard timer
+ *                  p_txn: EEPROM transaction to stage the update in, if any
  *
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS
  *
  ******************************************************************************/
-NFCSTATUS phNxpNciHal_setGuardTimer() {
+NFCSTATUS phNxpNciHal_setGuardTimer(phNxpNci_EEPROM_txn_t* p_txn) {
 
   phNxpNci_EEPROM_info_t mEEPROM_info = {.request_mode = 0};
 
@@ -86,7 +88,7 @@ NFCSTATUS phNxpNciHal_setGuardTimer() {
   mEEPROM_info.bufflen = sizeof(config_ext.guard_timer_value);
   mEEPROM_info.request_type = EEPROM_GUARD_TIMER;
 
-  return request_EEPROM(&mEEPROM_info);
+  return phNxpNciHal_eeprom_txn_add(p_txn, &mEEPROM_info);
 }
 
 /******************************************************************************
@@ -345,12 +347,12 @@ NFCSTATUS phNxpNciHal_send_get_cfg(const uint8_t *cmd_get_cfg, long cmd_len) {
  * Description      This function is called to apply iso_dep sak merge settings
  *                  as per the config option NAME_NXP_ISO_DEP_MERGE_SAK
  *
- * Params           None
+ * Params           p_txn, EEPROM transaction to stage the update in, if any
 
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS
  *
  *****************************************************************************/
-NFCSTATUS phNxpNciHal_configure_merge_sak() {
+NFCSTATUS phNxpNciHal_configure_merge_sak(phNxpNci_EEPROM_txn_t* p_txn) {
   if (nfcFL.chipType < sn100u) {
     NXPLOG_NCIHAL_D("%s : Not applicable for chipType %d",
                                   __func__, nfcFL.chipType);
@@ -373,19 +375,20 @@ NFCSTATUS phNxpNciHal_configure_merge_sak() {
   mEEPROM_info.bufflen = sizeof(val);
   mEEPROM_info.request_type = EEPROM_ISODEP_MERGE_SAK;
   mEEPROM_info.request_mode = SET_EEPROM_DATA;
-  return request_EEPROM(&mEEPROM_info);
+  return phNxpNciHal_eeprom_txn_add(p_txn, &mEEPROM_info);
 }
 #if(NXP_EXTNS== TRUE && NXP_SRD == TRUE)
 /******************************************************************************
  * Function         phNxpNciHal_setSrdtimeout
  *
  * Description      This function can be used to set srd SRD Timeout.
+ *                  p_txn: EEPROM transaction to stage the update in, if any
  *
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS or
  *                  NFCSTATUS_FEATURE_NOT_SUPPORTED
  *
  ******************************************************************************/
-NFCSTATUS phNxpNciHal_setSrdtimeout() {
+NFCSTATUS phNxpNciHal_setSrdtimeout(phNxpNci_EEPROM_txn_t* p_txn) {
   long retlen = 0;
   uint8_t *buffer = nullptr;
   long bufflen = 260;
@@ -420,7 +423,7 @@ NFCSTATUS phNxpNciHal_setSrdtimeout() {
       mEEPROM_info.bufflen = sizeof(timeout_buffer);
       mEEPROM_info.request_type = EEPROM_SRD_TIMEOUT;
       mEEPROM_info.request_mode = SET_EEPROM_DATA;
-      status = request_EEPROM(&mEEPROM_info);
+      status = phNxpNciHal_eeprom_txn_add(p_txn, &mEEPROM_info);
     }
   }
   if (buffer != NULL) {
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "phNfcStatus.h"
+#include "phNxpNciHal.h"
 
 #define AUTONOMOUS_SCREEN_OFF_LOCK_MASK 0x20
 #define SWITCH_OFF_MASK 0x02
@@ -42,21 +43,23 @@ uint8_t phNxpNciHal_updateAutonomousPwrState(uint8_t num);
  * Function         phNxpNciHal_setAutonomousMode
  *
  * Description      This function can be used to set NFCC in autonomous mode
+ *                  p_txn: EEPROM transaction to stage the update in, if any
  *
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS
  *
  ******************************************************************************/
-NFCSTATUS phNxpNciHal_setAutonomousMode();
+NFCSTATUS phNxpNciHal_setAutonomousMode(phNxpNci_EEPROM_txn_t* p_txn = NULL);
 
 /******************************************************************************
  * Function         phNxpNciHal_setGuardTimer
  *
  * Description      This function can be used to set Guard timer
+ *                  p_txn: EEPROM transaction to stage the update in, if any
  *
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS
  *
  ******************************************************************************/
-NFCSTATUS phNxpNciHal_setGuardTimer();
+NFCSTATUS phNxpNciHal_setGuardTimer(phNxpNci_EEPROM_txn_t* p_txn = NULL);
 
 /*****************************************************************************
  * Function         phNxpNciHal_send_get_cfg
@@ -78,19 +81,20 @@ NFCSTATUS phNxpNciHal_send_get_cfg(const uint8_t *cmd_get_cfg, long cmd_len);
  * Description      This function is called to apply iso_dep sak merge settings
  *                  as per the config option NAME_NXP_ISO_DEP_MERGE_SAK
  *
- * Params           None
+ * Params           p_txn, EEPROM transaction to stage the update in, if any
 
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS
  *
  *****************************************************************************/
-NFCSTATUS phNxpNciHal_configure_merge_sak();
+NFCSTATUS phNxpNciHal_configure_merge_sak(phNxpNci_EEPROM_txn_t* p_txn = NULL);
 /******************************************************************************
  * Function         phNxpNciHal_setSrdtimeout
  *
  * Description      This function can be used to set srd SRD Timeout.
+ *                  p_txn: EEPROM transaction to stage the update in, if any
  *
  * Returns          NFCSTATUS_FAILED or NFCSTATUS_SUCCESS or
  *                  NFCSTATUS_FEATURE_NOT_SUPPORTED
  *
  ******************************************************************************/
-NFCSTATUS phNxpNciHal_setSrdtimeout();
+NFCSTATUS phNxpNciHal_setSrdtimeout(phNxpNci_EEPROM_txn_t* p_txn = NULL);
@@ -208,6 +208,32 @@ static void phNxpLog_SetNciTxLogLevel(uint8_t level) {
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         phNxpLog_SetAsyncMode
+ *
+ * Description      Routes the NXPLOG_* macros through the asynchronous log
+ *                  sink if NXPLOG_ASYNC or nfc.nxp_log_async is set to 1.
+ *                  Once started, the sink stays in use for the process.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpLog_SetAsyncMode(void) {
+  unsigned long num = 0;
+  char valueStr[PROPERTY_VALUE_MAX] = {0};
+
+  GetNxpNumValue(NAME_NXPLOG_ASYNC, &num, sizeof(num));
+  int len = property_get(PROP_NAME_NXPLOG_ASYNC, valueStr, "");
+  if (len > 0) {
+    /* let Android property override .conf variable */
+    sscanf(valueStr, "%lu", &num);
+  }
+  if (num == 1 && !gLog_async_enabled) {
+    phNxpLog_AsyncStart();
+  }
+}
+
 /******************************************************************************
  * Function         phNxpLog_InitializeLogLevel
  *
@@ -229,6 +255,8 @@ static void phNxpLog_SetNciTxLogLevel(uint8_t level) {
  *log
  *                      nfc.nxp_log_level_tml       * TML module log
  *                      nfc.nxp_log_level_nci       * NCI transaction log
+ *                      nfc.nxp_log_async           * 1 to format and write
+ *logs on a background thread
  *
  *                  Log Level values:
  *                      NXPLOG_LOG_SILENT_LOGLEVEL  0        * No trace to show
@@ -248,6 +276,7 @@ void phNxpLog_InitializeLogLevel(void) {
   phNxpLog_SetTmlLogLevel(level);
   phNxpLog_SetDnldLogLevel(level);
   phNxpLog_SetNciTxLogLevel(level);
+  phNxpLog_SetAsyncMode();
 
   ALOGD_IF(nfc_debug_enabled,
       "%s: global =%u, Fwdnld =%u, extns =%u, \
@@ -18,6 +18,7 @@
 #define NXPLOG__H_INCLUDED
 #include <log/log.h>
 #include <phNfcStatus.h>
+#include "phNxpLog_Async.h"
 
 typedef struct nci_log_level {
   uint8_t global_log_level;
@@ -109,22 +110,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
  */
 /* Logging APIs used by NxpExtns module */
 #if (ENABLE_EXTNS_TRACES == TRUE)
-#define NXPLOG_EXTNS_D(...)                                       \
-  {                                                               \
-     if ((nfc_debug_enabled) ||                                   \
-      (gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
+#define NXPLOG_EXTNS_D(...)                                          \
+  {                                                                  \
+     if ((nfc_debug_enabled) ||                                      \
+      (gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
   }
-#define NXPLOG_EXTNS_W(...)                                      \
-  {                                                              \
-     if ((nfc_debug_enabled) ||                                  \
-      (gLog_level.extns_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
+#define NXPLOG_EXTNS_W(...)                                         \
+  {                                                                 \
+     if ((nfc_debug_enabled) ||                                     \
+      (gLog_level.extns_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
   }
-#define NXPLOG_EXTNS_E(...)                                       \
-  {                                                               \
-    if (gLog_level.extns_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
+#define NXPLOG_EXTNS_E(...)                                          \
+  {                                                                  \
+    if (gLog_level.extns_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_EXTNS_D(...)
@@ -134,22 +135,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpNciHal module */
 #if (ENABLE_HAL_TRACES == TRUE)
-#define NXPLOG_NCIHAL_D(...)                                       \
-  {                                                                \
-    if ((nfc_debug_enabled) ||                                     \
-      (gLog_level.hal_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))     \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
+#define NXPLOG_NCIHAL_D(...)                                          \
+  {                                                                   \
+    if ((nfc_debug_enabled) ||                                        \
+      (gLog_level.hal_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))        \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
   }
-#define NXPLOG_NCIHAL_W(...)                                      \
-  {                                                               \
-    if ((nfc_debug_enabled) ||                                    \
-      (gLog_level.hal_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))     \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
+#define NXPLOG_NCIHAL_W(...)                                         \
+  {                                                                  \
+    if ((nfc_debug_enabled) ||                                       \
+      (gLog_level.hal_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))        \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
   }
-#define NXPLOG_NCIHAL_E(...)                                       \
-  {                                                                \
-    if (gLog_level.hal_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
+#define NXPLOG_NCIHAL_E(...)                                          \
+  {                                                                   \
+    if (gLog_level.hal_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)        \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_NCIHAL_D(...)
@@ -159,22 +160,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpNciX module */
 #if (ENABLE_NCIX_TRACES == TRUE)
-#define NXPLOG_NCIX_D(...)                                       \
-  {                                                              \
-    if ((nfc_debug_enabled) ||                                   \
-      (gLog_level.ncix_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
+#define NXPLOG_NCIX_D(...)                                          \
+  {                                                                 \
+    if ((nfc_debug_enabled) ||                                      \
+      (gLog_level.ncix_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
   }
-#define NXPLOG_NCIX_W(...)                                      \
-  {                                                             \
-     if ((nfc_debug_enabled) ||                                 \
-      (gLog_level.ncix_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
+#define NXPLOG_NCIX_W(...)                                         \
+  {                                                                \
+     if ((nfc_debug_enabled) ||                                    \
+      (gLog_level.ncix_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
   }
-#define NXPLOG_NCIX_E(...)                                       \
-  {                                                              \
-    if (gLog_level.ncix_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
+#define NXPLOG_NCIX_E(...)                                          \
+  {                                                                 \
+    if (gLog_level.ncix_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_NCIX_D(...)
@@ -184,22 +185,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpNciR module */
 #if (ENABLE_NCIR_TRACES == TRUE)
-#define NXPLOG_NCIR_D(...)                                       \
-  {                                                              \
-     if ((nfc_debug_enabled) ||                                  \
-      (gLog_level.ncir_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
+#define NXPLOG_NCIR_D(...)                                          \
+  {                                                                 \
+     if ((nfc_debug_enabled) ||                                     \
+      (gLog_level.ncir_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
   }
-#define NXPLOG_NCIR_W(...)                                      \
-  {                                                             \
-     if ((nfc_debug_enabled) ||                                 \
-      (gLog_level.ncir_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
+#define NXPLOG_NCIR_W(...)                                         \
+  {                                                                \
+     if ((nfc_debug_enabled) ||                                    \
+      (gLog_level.ncir_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
   }
-#define NXPLOG_NCIR_E(...)                                       \
-  {                                                              \
-    if (gLog_level.ncir_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
+#define NXPLOG_NCIR_E(...)                                          \
+  {                                                                 \
+    if (gLog_level.ncir_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_NCIR_D(...)
@@ -209,22 +210,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpFwDnld module */
 #if (ENABLE_FWDNLD_TRACES == TRUE)
-#define NXPLOG_FWDNLD_D(...)                                       \
-  {                                                                \
-     if ((nfc_debug_enabled) ||                                    \
-      (gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))    \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_FWDNLD_D(...)                                          \
+  {                                                                   \
+     if ((nfc_debug_enabled) ||                                       \
+      (gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))       \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_FWDNLD_W(...)                                      \
-  {                                                               \
-     if ((nfc_debug_enabled) ||                                   \
-      (gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))    \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_FWDNLD_W(...)                                         \
+  {                                                                  \
+     if ((nfc_debug_enabled) ||                                      \
+      (gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))       \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_FWDNLD_E(...)                                       \
-  {                                                                \
-    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_FWDNLD_E(...)                                          \
+  {                                                                   \
+    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_FWDNLD_D(...)
@@ -234,22 +235,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpTml module */
 #if (ENABLE_TML_TRACES == TRUE)
-#define NXPLOG_TML_D(...)                                       \
-  {                                                             \
-     if ((nfc_debug_enabled) ||                                 \
-      (gLog_level.tml_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_TML, __VA_ARGS__); \
+#define NXPLOG_TML_D(...)                                          \
+  {                                                                \
+     if ((nfc_debug_enabled) ||                                    \
+      (gLog_level.tml_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_TML, __VA_ARGS__); \
   }
-#define NXPLOG_TML_W(...)                                      \
-  {                                                            \
-     if ((nfc_debug_enabled) ||                                \
-      (gLog_level.tml_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))  \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_TML, __VA_ARGS__); \
+#define NXPLOG_TML_W(...)                                         \
+  {                                                               \
+     if ((nfc_debug_enabled) ||                                   \
+      (gLog_level.tml_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))     \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_TML, __VA_ARGS__); \
   }
-#define NXPLOG_TML_E(...)                                       \
-  {                                                             \
-    if (gLog_level.tml_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_TML, __VA_ARGS__); \
+#define NXPLOG_TML_E(...)                                          \
+  {                                                                \
+    if (gLog_level.tml_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_TML, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_TML_D(...)
@@ -260,22 +261,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 #ifdef NXP_HCI_REQ
 /* Logging APIs used by NxpHcpX module */
 #if (ENABLE_HCPX_TRACES == TRUE)
-#define NXPLOG_HCPX_D(...)                                         \
-  {                                                                \
-     if ((nfc_debug_enabled) ||                                    \
-      (gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))    \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPX_D(...)                                            \
+  {                                                                   \
+     if ((nfc_debug_enabled) ||                                       \
+      (gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))       \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPX_W(...)                                        \
-  {                                                               \
-     if ((nfc_debug_enabled) ||                                   \
-      (gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))    \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPX_W(...)                                           \
+  {                                                                  \
+     if ((nfc_debug_enabled) ||                                      \
+      (gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))       \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPX_E(...)                                         \
-  {                                                                \
-    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPX_E(...)                                            \
+  {                                                                   \
+    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_HCPX_D(...)
@@ -285,22 +286,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpHcpR module */
 #if (ENABLE_HCPR_TRACES == TRUE)
-#define NXPLOG_HCPR_D(...)                                         \
-  {                                                                \
-     if ((nfc_debug_enabled) ||                                    \
-      (gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))    \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPR_D(...)                                            \
+  {                                                                   \
+     if ((nfc_debug_enabled) ||                                       \
+      (gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL))       \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPR_W(...)                                        \
-  {                                                               \
-     if ((nfc_debug_enabled) ||                                   \
-      (gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))    \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPR_W(...)                                           \
+  {                                                                  \
+     if ((nfc_debug_enabled) ||                                      \
+      (gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL))       \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPR_E(...)                                         \
-  {                                                                \
-    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPR_E(...)                                            \
+  {                                                                   \
+    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_HCPR_D(...)
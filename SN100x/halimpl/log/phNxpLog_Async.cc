@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) 2021 NXP Semiconductors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <log/log.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+
+#include "phNxpLog_Async.h"
+
+#define NXPLOG_ASYNC_TAG "NxpLog"
+#define NXPLOG_ASYNC_LINE_SIZE 1024
+#define NXPLOG_ASYNC_RING_MASK (NXPLOG_ASYNC_RING_SIZE - 1)
+
+/* Ownership of a ring */
+typedef enum {
+  NXPLOG_ASYNC_RING_FREE = 0x00,
+  NXPLOG_ASYNC_RING_OWNED,   /* thread alive */
+  NXPLOG_ASYNC_RING_ORPHANED /* thread exited, records left to drain */
+} phNxpLog_AsyncRingState_t;
+
+/* Single producer single consumer ring of a thread */
+typedef struct {
+  std::atomic<uint32_t> head; /* written by the owner thread */
+  std::atomic<uint32_t> tail; /* written by the drainer */
+  std::atomic<uint32_t> state;
+  std::atomic<uint64_t> posted;
+  std::atomic<uint64_t> dropped;
+  uint64_t reported_drops; /* drainer only */
+  pid_t tid;
+  phNxpLog_AsyncRec_t* recs;
+} phNxpLog_AsyncRing_t;
+
+/* Releases the ring of a thread when it exits */
+typedef struct phNxpLog_AsyncOwner {
+  phNxpLog_AsyncRing_t* ring;
+  bool no_ring;
+  ~phNxpLog_AsyncOwner() {
+    if (ring != NULL) ring->state.store(NXPLOG_ASYNC_RING_ORPHANED);
+  }
+} phNxpLog_AsyncOwner_t;
+
+bool gLog_async_enabled = false;
+
+static phNxpLog_AsyncRing_t sRings[NXPLOG_ASYNC_MAX_RINGS];
+static std::atomic<uint64_t> sSeq(0);
+static std::atomic<uint64_t> sSyncCount(0);
+static thread_local phNxpLog_AsyncOwner_t tOwner = {NULL, false};
+
+static pthread_mutex_t sDrainMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sDrainCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sFlushCond = PTHREAD_COND_INITIALIZER;
+static bool sDrainerStarted = false;
+static uint32_t sFlushReq = 0;
+static uint32_t sFlushDone = 0;
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncClaimRing
+ *
+ * Description      Gives a free ring to the calling thread.
+ *
+ * Returns          The ring, NULL if none is free
+ *
+ ******************************************************************************/
+static phNxpLog_AsyncRing_t* phNxpLog_AsyncClaimRing(void) {
+  for (int i = 0; i < NXPLOG_ASYNC_MAX_RINGS; i++) {
+    phNxpLog_AsyncRing_t* pRing = &sRings[i];
+    uint32_t state = NXPLOG_ASYNC_RING_FREE;
+    if (!pRing->state.compare_exchange_strong(state,
+                                              NXPLOG_ASYNC_RING_OWNED)) {
+      continue;
+    }
+    if (pRing->recs == NULL) {
+      pRing->recs = (phNxpLog_AsyncRec_t*)calloc(NXPLOG_ASYNC_RING_SIZE,
+                                                 sizeof(phNxpLog_AsyncRec_t));
+      if (pRing->recs == NULL) {
+        pRing->state.store(NXPLOG_ASYNC_RING_FREE);
+        return NULL;
+      }
+    }
+    pRing->tid = (pid_t)syscall(SYS_gettid);
+    return pRing;
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncAcquire
+ *
+ * Description      Reserves the next record of the calling thread ring.
+ *                  The record is queued by phNxpLog_AsyncCommit.
+ *
+ * Returns          0 with *ppRec set, 1 if the ring is full and the log is
+ *                  dropped, -1 if the log has to be written synchronously
+ *
+ ******************************************************************************/
+int phNxpLog_AsyncAcquire(phNxpLog_AsyncRec_t** ppRec) {
+  phNxpLog_AsyncRing_t* pRing = tOwner.ring;
+
+  if (pRing == NULL) {
+    if (!tOwner.no_ring) {
+      pRing = tOwner.ring = phNxpLog_AsyncClaimRing();
+      tOwner.no_ring = (pRing == NULL);
+    }
+    if (pRing == NULL) {
+      sSyncCount.fetch_add(1, std::memory_order_relaxed);
+      return -1;
+    }
+  }
+  uint32_t head = pRing->head.load(std::memory_order_relaxed);
+  if (head - pRing->tail.load(std::memory_order_acquire) >=
+      NXPLOG_ASYNC_RING_SIZE) {
+    pRing->dropped.fetch_add(1, std::memory_order_relaxed);
+    return 1;
+  }
+  *ppRec = &pRing->recs[head & NXPLOG_ASYNC_RING_MASK];
+  (*ppRec)->seq = sSeq.fetch_add(1, std::memory_order_relaxed);
+  return 0;
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncCommit
+ *
+ * Description      Queues the record reserved by phNxpLog_AsyncAcquire.
+ *                  Errors wake up the drainer at once.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void phNxpLog_AsyncCommit(phNxpLog_AsyncRec_t* pRec) {
+  phNxpLog_AsyncRing_t* pRing = tOwner.ring;
+
+  pRing->head.store(pRing->head.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+  pRing->posted.store(pRing->posted.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+  if (pRec->prio >= ANDROID_LOG_ERROR) {
+    pthread_cond_signal(&sDrainCond);
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncFormatArg
+ *
+ * Description      Formats one conversion of the record format with the
+ *                  type given by its length modifier.
+ *
+ * Returns          Number of characters written
+ *
+ ******************************************************************************/
+static int phNxpLog_AsyncFormatArg(char* pOut, size_t outLen,
+                                   const char* pSpec, char conv,
+                                   const char* pMod,
+                                   const phNxpLog_AsyncRec_t* pRec,
+                                   uint8_t idx) {
+  const phNxpLog_AsyncArg_t* pArg = &pRec->arg[idx];
+  uint8_t type = pRec->arg_type[idx];
+
+  switch (conv) {
+    case 's':
+      if (type == NXPLOG_ASYNC_ARG_STR) {
+        return snprintf(pOut, outLen, pSpec,
+                        &pRec->str[pRec->str_offset[idx]]);
+      } else if (pArg->p == NULL) {
+        return snprintf(pOut, outLen, pSpec, "(null)");
+      }
+      /* not copied, the pointer may not be valid anymore */
+      return snprintf(pOut, outLen, "(%p)", pArg->p);
+    case 'p':
+      return snprintf(pOut, outLen, pSpec, pArg->p);
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      if (type != NXPLOG_ASYNC_ARG_DOUBLE) break;
+      if (pMod[0] == 'L') {
+        return snprintf(pOut, outLen, pSpec, (long double)pArg->d);
+      }
+      return snprintf(pOut, outLen, pSpec, pArg->d);
+    case 'd':
+    case 'i':
+    case 'c':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      if (type == NXPLOG_ASYNC_ARG_DOUBLE || type == NXPLOG_ASYNC_ARG_STR) {
+        break;
+      }
+      /* both signed and unsigned values are stored on 64 bits, the length
+       * modifier gives the width printf expects */
+      if (pMod[0] == 'l' && pMod[1] == 'l') {
+        return snprintf(pOut, outLen, pSpec, (long long)pArg->i);
+      } else if (pMod[0] == 'l' || pMod[0] == 'z' || pMod[0] == 't') {
+        return snprintf(pOut, outLen, pSpec, (long)pArg->i);
+      } else if (pMod[0] == 'j' || pMod[0] == 'q') {
+        return snprintf(pOut, outLen, pSpec, (intmax_t)pArg->i);
+      }
+      return snprintf(pOut, outLen, pSpec, (int)pArg->i);
+    default:
+      break;
+  }
+  return snprintf(pOut, outLen, "<%s?>", pSpec);
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncFormat
+ *
+ * Description      Formats a record as printf would have done on the
+ *                  logging thread.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpLog_AsyncFormat(const phNxpLog_AsyncRec_t* pRec, char* pLine,
+                                 size_t lineLen) {
+  const char* pFmt = pRec->fmt;
+  size_t pos = 0;
+  uint8_t idx = 0;
+  char spec[32];
+  char mod[3];
+
+  while (*pFmt != '\0' && pos < lineLen - 1) {
+    if (*pFmt != '%') {
+      pLine[pos++] = *pFmt++;
+      continue;
+    }
+    if (pFmt[1] == '%') {
+      pLine[pos++] = '%';
+      pFmt += 2;
+      continue;
+    }
+    /* %[flags][width][.precision][length]conversion */
+    size_t len = 1;
+    while (pFmt[len] != '\0' && strchr("-+ #0", pFmt[len]) != NULL) len++;
+    bool star = false;
+    while (pFmt[len] != '\0' &&
+           (pFmt[len] == '.' || pFmt[len] == '*' ||
+            (pFmt[len] >= '0' && pFmt[len] <= '9'))) {
+      star |= (pFmt[len] == '*');
+      len++;
+    }
+    size_t mod_len = 0;
+    while (pFmt[len] != '\0' && strchr("hlLqjzt", pFmt[len]) != NULL) {
+      if (mod_len < sizeof(mod) - 1) mod[mod_len++] = pFmt[len];
+      len++;
+    }
+    mod[mod_len] = '\0';
+    char conv = pFmt[len];
+    if (conv == '\0' || star || len + 2 > sizeof(spec)) {
+      /* not supported, print the rest of the format as is */
+      pos += snprintf(&pLine[pos], lineLen - pos, "%s", pFmt);
+      break;
+    }
+    memcpy(spec, pFmt, len + 1);
+    spec[len + 1] = '\0';
+    pFmt += len + 1;
+    if (idx >= pRec->num_args) {
+      pos += snprintf(&pLine[pos], lineLen - pos, "<%s?>", spec);
+    } else {
+      pos += phNxpLog_AsyncFormatArg(&pLine[pos], lineLen - pos, spec, conv,
+                                     mod, pRec, idx++);
+    }
+  }
+  if (pos > lineLen - 1) pos = lineLen - 1;
+  pLine[pos] = '\0';
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncDrain
+ *
+ * Description      Writes all the queued records, oldest first across the
+ *                  rings, and reports the records dropped since last call.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpLog_AsyncDrain(void) {
+  char line[NXPLOG_ASYNC_LINE_SIZE];
+
+  for (;;) {
+    phNxpLog_AsyncRing_t* pNext = NULL;
+    uint64_t next_seq = 0;
+    for (int i = 0; i < NXPLOG_ASYNC_MAX_RINGS; i++) {
+      phNxpLog_AsyncRing_t* pRing = &sRings[i];
+      uint32_t tail = pRing->tail.load(std::memory_order_relaxed);
+      if (pRing->recs == NULL ||
+          tail == pRing->head.load(std::memory_order_acquire)) {
+        continue;
+      }
+      uint64_t seq = pRing->recs[tail & NXPLOG_ASYNC_RING_MASK].seq;
+      if (pNext == NULL || seq < next_seq) {
+        pNext = pRing;
+        next_seq = seq;
+      }
+    }
+    if (pNext == NULL) break;
+    uint32_t tail = pNext->tail.load(std::memory_order_relaxed);
+    const phNxpLog_AsyncRec_t* pRec =
+        &pNext->recs[tail & NXPLOG_ASYNC_RING_MASK];
+    phNxpLog_AsyncFormat(pRec, line, sizeof(line));
+    __android_log_write(pRec->prio, pRec->tag, line);
+    pNext->tail.store(tail + 1, std::memory_order_release);
+  }
+
+  for (int i = 0; i < NXPLOG_ASYNC_MAX_RINGS; i++) {
+    phNxpLog_AsyncRing_t* pRing = &sRings[i];
+    uint64_t dropped = pRing->dropped.load(std::memory_order_relaxed);
+    if (dropped != pRing->reported_drops) {
+      __android_log_print(ANDROID_LOG_WARN, NXPLOG_ASYNC_TAG,
+                          "%llu logs dropped by tid %d, ring full",
+                          (unsigned long long)(dropped - pRing->reported_drops),
+                          pRing->tid);
+      pRing->reported_drops = dropped;
+    }
+    /* a ring left by an exited thread is reused once drained */
+    uint32_t state = NXPLOG_ASYNC_RING_ORPHANED;
+    if (pRing->tail.load(std::memory_order_relaxed) ==
+        pRing->head.load(std::memory_order_acquire)) {
+      pRing->state.compare_exchange_strong(state, NXPLOG_ASYNC_RING_FREE);
+    }
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncDrainThread
+ *
+ * Description      Drains the rings every NXPLOG_ASYNC_DRAIN_INTERVAL_MS,
+ *                  on error logs and on flush requests.
+ *
+ * Returns          never
+ *
+ ******************************************************************************/
+static void* phNxpLog_AsyncDrainThread(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&sDrainMutex);
+  for (;;) {
+    if (sFlushDone == sFlushReq) {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += NXPLOG_ASYNC_DRAIN_INTERVAL_MS * 1000000L;
+      ts.tv_sec += ts.tv_nsec / 1000000000L;
+      ts.tv_nsec %= 1000000000L;
+      pthread_cond_timedwait(&sDrainCond, &sDrainMutex, &ts);
+    }
+    uint32_t flush_req = sFlushReq;
+    pthread_mutex_unlock(&sDrainMutex);
+    phNxpLog_AsyncDrain();
+    pthread_mutex_lock(&sDrainMutex);
+    if (sFlushDone != flush_req) {
+      sFlushDone = flush_req;
+      pthread_cond_broadcast(&sFlushCond);
+    }
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncStart
+ *
+ * Description      Starts the drainer thread, once per process, and routes
+ *                  the NXPLOG_* macros through the rings.
+ *
+ * Returns          true if the asynchronous logging is enabled
+ *
+ ******************************************************************************/
+bool phNxpLog_AsyncStart(void) {
+  pthread_mutex_lock(&sDrainMutex);
+  if (!sDrainerStarted) {
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    sDrainerStarted =
+        (pthread_create(&thread, &attr, phNxpLog_AsyncDrainThread, NULL) == 0);
+    pthread_attr_destroy(&attr);
+    if (sDrainerStarted) {
+      pthread_setname_np(thread, "nxp_log_drain");
+    } else {
+      __android_log_print(ANDROID_LOG_ERROR, NXPLOG_ASYNC_TAG,
+                          "drainer thread creation failed, logging inline");
+    }
+  }
+  gLog_async_enabled = sDrainerStarted;
+  pthread_mutex_unlock(&sDrainMutex);
+  return gLog_async_enabled;
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncFlush
+ *
+ * Description      Waits until the records queued so far are written, for
+ *                  at most NXPLOG_ASYNC_FLUSH_TIMEOUT_MS.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void phNxpLog_AsyncFlush(void) {
+  struct timespec ts;
+
+  pthread_mutex_lock(&sDrainMutex);
+  if (sDrainerStarted) {
+    uint32_t req = ++sFlushReq;
+    pthread_cond_signal(&sDrainCond);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += NXPLOG_ASYNC_FLUSH_TIMEOUT_MS * 1000000L;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+    while ((int32_t)(sFlushDone - req) < 0) {
+      if (pthread_cond_timedwait(&sFlushCond, &sDrainMutex, &ts) ==
+          ETIMEDOUT) {
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&sDrainMutex);
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncGetStats
+ *
+ * Description      Gets the counters of the asynchronous logging.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void phNxpLog_AsyncGetStats(phNxpLog_AsyncStats_t* pStats) {
+  memset(pStats, 0x00, sizeof(phNxpLog_AsyncStats_t));
+  for (int i = 0; i < NXPLOG_ASYNC_MAX_RINGS; i++) {
+    phNxpLog_AsyncRing_t* pRing = &sRings[i];
+    pStats->posted += pRing->posted.load(std::memory_order_relaxed);
+    pStats->dropped += pRing->dropped.load(std::memory_order_relaxed);
+    if (pRing->state.load() == NXPLOG_ASYNC_RING_OWNED) pStats->threads++;
+  }
+  pStats->sync = sSyncCount.load(std::memory_order_relaxed);
+}
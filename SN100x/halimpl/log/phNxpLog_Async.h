@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2021 NXP Semiconductors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Asynchronous backend of the NXPLOG_* macros.
+ *
+ * When enabled with NXPLOG_ASYNC in libnfc-nxp.conf or the Android property
+ * nfc.nxp_log_async, the logging thread only copies the format string
+ * pointer and the raw arguments into a record of its own single producer
+ * ring. A drainer thread formats the records, in the order they were
+ * posted, and writes them to logcat.
+ *
+ * The format must be a string literal, only its address is kept. String
+ * arguments are copied into the record, truncated to what is left of
+ * NXPLOG_ASYNC_STR_SIZE. Records posted while the ring is full are dropped
+ * and counted. A thread which cannot get a ring logs synchronously.
+ */
+
+#if !defined(NXPLOG_ASYNC__H_INCLUDED)
+#define NXPLOG_ASYNC__H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#define NAME_NXPLOG_ASYNC "NXPLOG_ASYNC"
+#define PROP_NAME_NXPLOG_ASYNC "nfc.nxp_log_async"
+
+/* Max arguments of one log and room for their strings */
+#define NXPLOG_ASYNC_MAX_ARGS 12
+#define NXPLOG_ASYNC_STR_SIZE 384
+/* Records of a ring, power of 2 */
+#define NXPLOG_ASYNC_RING_SIZE 256
+/* Max threads logging at the same time through the rings */
+#define NXPLOG_ASYNC_MAX_RINGS 16
+/* Drainer period, errors wake it up at once */
+#define NXPLOG_ASYNC_DRAIN_INTERVAL_MS 20
+/* Max wait of phNxpLog_AsyncFlush */
+#define NXPLOG_ASYNC_FLUSH_TIMEOUT_MS 200
+
+typedef enum {
+  NXPLOG_ASYNC_ARG_INT = 0x00,
+  NXPLOG_ASYNC_ARG_UINT,
+  NXPLOG_ASYNC_ARG_DOUBLE,
+  NXPLOG_ASYNC_ARG_PTR,
+  NXPLOG_ASYNC_ARG_STR /* also copied into str, at str_offset */
+} phNxpLog_AsyncArgType_t;
+
+typedef union {
+  int64_t i;
+  uint64_t u;
+  double d;
+  const void* p;
+} phNxpLog_AsyncArg_t;
+
+typedef struct {
+  uint64_t seq;    /* posting order across all the rings */
+  const char* tag;
+  const char* fmt; /* string literal */
+  uint8_t prio;
+  uint8_t num_args;
+  uint16_t str_len;
+  uint8_t arg_type[NXPLOG_ASYNC_MAX_ARGS];
+  uint16_t str_offset[NXPLOG_ASYNC_MAX_ARGS];
+  phNxpLog_AsyncArg_t arg[NXPLOG_ASYNC_MAX_ARGS];
+  char str[NXPLOG_ASYNC_STR_SIZE];
+} phNxpLog_AsyncRec_t;
+
+typedef struct {
+  uint64_t posted;   /* records queued to the rings */
+  uint64_t dropped;  /* records lost on full ring */
+  uint64_t sync;     /* logs written inline by threads without ring */
+  uint32_t threads;  /* rings in use */
+} phNxpLog_AsyncStats_t;
+
+extern bool gLog_async_enabled;
+
+bool phNxpLog_AsyncStart(void);
+void phNxpLog_AsyncFlush(void);
+void phNxpLog_AsyncGetStats(phNxpLog_AsyncStats_t* pStats);
+/* Returns 0 with a record to fill, 1 if the ring is full, -1 if the
+ * caller has to log synchronously */
+int phNxpLog_AsyncAcquire(phNxpLog_AsyncRec_t** ppRec);
+void phNxpLog_AsyncCommit(phNxpLog_AsyncRec_t* pRec);
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncPut
+ *
+ * Description      Stores one log argument in the record.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+template <typename T>
+inline void phNxpLog_AsyncPut(phNxpLog_AsyncRec_t* pRec, T value) {
+  uint8_t idx = pRec->num_args++;
+  if constexpr (std::is_pointer<T>::value &&
+                std::is_same<typename std::remove_cv<
+                                 typename std::remove_pointer<T>::type>::type,
+                             char>::value) {
+    uint16_t avail = NXPLOG_ASYNC_STR_SIZE - pRec->str_len;
+    pRec->arg[idx].p = value;
+    if (value == NULL || avail == 0) {
+      pRec->arg_type[idx] = NXPLOG_ASYNC_ARG_PTR;
+      return;
+    }
+    size_t len = strnlen(value, avail - 1);
+    memcpy(&pRec->str[pRec->str_len], value, len);
+    pRec->str[pRec->str_len + len] = '\0';
+    pRec->arg_type[idx] = NXPLOG_ASYNC_ARG_STR;
+    pRec->str_offset[idx] = pRec->str_len;
+    pRec->str_len += len + 1;
+  } else if constexpr (std::is_pointer<T>::value ||
+                       std::is_null_pointer<T>::value) {
+    pRec->arg_type[idx] = NXPLOG_ASYNC_ARG_PTR;
+    pRec->arg[idx].p = (const void*)value;
+  } else if constexpr (std::is_floating_point<T>::value) {
+    pRec->arg_type[idx] = NXPLOG_ASYNC_ARG_DOUBLE;
+    pRec->arg[idx].d = (double)value;
+  } else if constexpr (std::is_enum<T>::value) {
+    pRec->arg_type[idx] = NXPLOG_ASYNC_ARG_INT;
+    pRec->arg[idx].i = (int64_t)value;
+  } else {
+    static_assert(std::is_integral<T>::value,
+                  "NXPLOG_* argument must be a scalar");
+    if (std::is_signed<T>::value) {
+      pRec->arg_type[idx] = NXPLOG_ASYNC_ARG_INT;
+      pRec->arg[idx].i = (int64_t)value;
+    } else {
+      pRec->arg_type[idx] = NXPLOG_ASYNC_ARG_UINT;
+      pRec->arg[idx].u = (uint64_t)value;
+    }
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         phNxpLog_AsyncPost
+ *
+ * Description      Queues a log to the ring of the calling thread.
+ *
+ * Returns          false if the log has to be written synchronously
+ *
+ ******************************************************************************/
+template <typename... Args>
+inline bool phNxpLog_AsyncPost(int prio, const char* tag, const char* fmt,
+                               Args... args) {
+  static_assert(sizeof...(Args) <= NXPLOG_ASYNC_MAX_ARGS,
+                "too many NXPLOG_* arguments");
+  phNxpLog_AsyncRec_t* pRec;
+  int status = phNxpLog_AsyncAcquire(&pRec);
+  if (status != 0) {
+    /* dropped records are accounted by the ring */
+    return (status > 0);
+  }
+  pRec->prio = (uint8_t)prio;
+  pRec->tag = tag;
+  pRec->fmt = fmt;
+  pRec->num_args = 0;
+  pRec->str_len = 0;
+  (phNxpLog_AsyncPut(pRec, args), ...);
+  phNxpLog_AsyncCommit(pRec);
+  return true;
+}
+
+/* Writes through the ring when enabled, inline otherwise */
+#define NXPLOG_PRI(prio, tag, ...)                        \
+  do {                                                    \
+    if (!gLog_async_enabled ||                            \
+        !phNxpLog_AsyncPost((prio), (tag), __VA_ARGS__))  \
+      LOG_PRI((prio), (tag), __VA_ARGS__);                \
+  } while (0)
+
+#endif /* NXPLOG_ASYNC__H_INCLUDED */
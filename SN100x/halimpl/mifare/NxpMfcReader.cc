@@ -22,10 +22,21 @@
 #include <phNxpLog.h>
 #include <phNxpNciHal_Adaptation.h>
 #include <phNxpNciHal_ext.h>
+#include <phTmlNfc.h>
 
 extern bool sendRspToUpperLayer;
 extern bool bEnableMfcExtns;
 extern bool bDisableLegacyMfcExtns;
+extern phNxpNciHal_Control_t nxpncihal_ctrl;
+extern phTmlNfc_Context_t* gpphTmlNfc_Context;
+
+/* Response and CORE_CONN_CREDITS_NTF delivered without reaching the NFCC */
+static uint8_t sLocalRsp[NCI_HEADER_SIZE + MFC_SECTOR_SIZE];
+static uint16_t sLocalRspLen;
+static uint8_t sLocalCreditsNtf[] = {0x60, 0x06, 0x03, 0x01, 0x00, 0x01};
+static phLibNfc_DeferredCall_t sLocalRspCall;
+/* Guards the credits of HAL internal exchanges, dropped on the reader thread */
+static pthread_mutex_t sCreditsLock = PTHREAD_MUTEX_INITIALIZER;
 
 NxpMfcReader &NxpMfcReader::getInstance() {
   static NxpMfcReader msNxpMfcReader;
@@ -45,6 +56,28 @@ NxpMfcReader &NxpMfcReader::getInstance() {
 int NxpMfcReader::Write(uint16_t mfcDataLen, const uint8_t *pMfcData) {
   uint16_t mfcTagCmdBuffLen = 0;
   uint8_t mfcTagCmdBuff[MAX_MFC_BUFF_SIZE] = {0};
+  MfcAuthState_t auth;
+
+  if (mfcDataLen > NCI_HEADER_SIZE) {
+    /* Sector commands are served block by block by the HAL */
+    if (pMfcData[3] == eMifareReadSector) {
+      return ReadSector(mfcDataLen, pMfcData);
+    } else if (pMfcData[3] == eMifareWriteSector) {
+      return WriteSector(mfcDataLen, pMfcData);
+    }
+    if (ParseAuthCmd(&pMfcData[3], mfcDataLen - NCI_HEADER_SIZE, &auth) &&
+        mAuthState.isValid &&
+        memcmp(&auth, &mAuthState, sizeof(MfcAuthState_t)) == 0) {
+      /* Sector is still authenticated with the same key, reply as the
+       * NFCC would for a successful authentication */
+      uint8_t authRsp[] = {0x00, 0x00, 0x01, NFCSTATUS_SUCCESS};
+      NXPLOG_NCIHAL_D("%s: sector %d already authenticated", __func__,
+                      auth.bySector);
+      SendLocalRsp(authRsp, sizeof(authRsp));
+      return mfcDataLen;
+    }
+    UpdateAuthState(&pMfcData[3], mfcDataLen - NCI_HEADER_SIZE);
+  }
 
   if (mfcDataLen > MAX_MFC_BUFF_SIZE) {
     android_errorWriteLog(0x534e4554, "169259605");
@@ -171,16 +204,44 @@ void NxpMfcReader::BuildAuthCmd() {
 **
 *******************************************************************************/
 void NxpMfcReader::CalcSectorAddress() {
-  uint8_t BlockNumber = mMfcTagCmdIntfData.sendBuf[1];
-  if (BlockNumber >= MFC_4K_BLK128) {
-    mMfcTagCmdIntfData.byAddr =
-        (uint8_t)(MFC_SECTOR_NO32 +
-                  ((BlockNumber - MFC_4K_BLK128) / MFC_BYTES_PER_BLOCK));
-  } else {
-    mMfcTagCmdIntfData.byAddr = BlockNumber / MFC_BLKS_PER_SECTOR;
+  mMfcTagCmdIntfData.byAddr = BlockToSector(mMfcTagCmdIntfData.sendBuf[1]);
+  return;
+}
+
+/*******************************************************************************
+**
+** Function         BlockToSector
+**
+** Description      Gives the sector of a block, sectors 32 and above of the
+**                  4K have 16 blocks.
+**
+** Returns          Sector number
+**
+*******************************************************************************/
+uint8_t NxpMfcReader::BlockToSector(uint8_t blockNumber) {
+  if (blockNumber >= MFC_4K_BLK128) {
+    return (uint8_t)(MFC_SECTOR_NO32 +
+                     ((blockNumber - MFC_4K_BLK128) / MFC_BYTES_PER_BLOCK));
   }
+  return blockNumber / MFC_BLKS_PER_SECTOR;
+}
 
-  return;
+/*******************************************************************************
+**
+** Function         IsSectorTrailer
+**
+** Description      Checks if a block is the last one of its sector, which
+**                  holds the keys and access bits.
+**
+** Returns          True/False
+**
+*******************************************************************************/
+bool NxpMfcReader::IsSectorTrailer(uint8_t blockNumber) {
+  if (blockNumber >= MFC_4K_BLK128) {
+    return ((blockNumber - MFC_4K_BLK128) % MFC_BYTES_PER_BLOCK) ==
+           MFC_BYTES_PER_BLOCK - 1;
+  }
+  return (blockNumber % MFC_BLKS_PER_SECTOR) == MFC_BLKS_PER_SECTOR - 1;
 }
 
 /*******************************************************************************
@@ -319,6 +380,258 @@ void NxpMfcReader::SendIncDecRestoreCmdPart2(const uint8_t *mfcData) {
   return;
 }
 
+/*******************************************************************************
+**
+** Function         ParseAuthCmd
+**
+** Description      Extracts sector, key type, UID and key of a Mifare Auth
+**                  command as received from libnfc-nci.
+**
+** Returns          true if pCmd is a complete Auth command
+**
+*******************************************************************************/
+bool NxpMfcReader::ParseAuthCmd(const uint8_t *pCmd, uint16_t cmdLen,
+                                MfcAuthState_t *pAuth) {
+  uint8_t blockNumber;
+
+  if ((pCmd[0] != eMifareAuthentA && pCmd[0] != eMifareAuthentB) ||
+      cmdLen < MFC_CMD_HDR_SIZE + MFC_UID_LEN + MFC_AUTHKEYLEN) {
+    return false;
+  }
+  memset(pAuth, 0, sizeof(MfcAuthState_t));
+  pAuth->isValid = true;
+  pAuth->byAuthCmd = pCmd[0];
+  blockNumber = pCmd[1];
+  pAuth->bySector = BlockToSector(blockNumber);
+  memcpy(pAuth->aUid, &pCmd[MFC_CMD_HDR_SIZE], MFC_UID_LEN);
+  memcpy(pAuth->aKey, &pCmd[MFC_CMD_HDR_SIZE + MFC_UID_LEN], MFC_AUTHKEYLEN);
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         UpdateAuthState
+**
+** Description      Tracks the authentication state of the tag for a command
+**                  about to be sent to the NFCC. A new Auth is kept pending
+**                  until its response, commands which may leave the
+**                  authenticated state (Halt, raw frames) drop it, and so
+**                  does a sector trailer write, which may change the keys.
+**
+** Returns          None
+**
+*******************************************************************************/
+void NxpMfcReader::UpdateAuthState(const uint8_t *pCmd, uint16_t cmdLen) {
+  mPendingAuth.isValid = false;
+  if (ParseAuthCmd(pCmd, cmdLen, &mPendingAuth)) {
+    mAuthState.isValid = false;
+    return;
+  }
+  switch (pCmd[0]) {
+  case eMifareWrite16:
+    if (cmdLen < MFC_CMD_HDR_SIZE || IsSectorTrailer(pCmd[1])) {
+      mAuthState.isValid = false;
+    }
+    break;
+  case eMifareRead16:
+  case eMifareInc:
+  case eMifareDec:
+  case eMifareRestore:
+  case eMifareTransfer:
+    break;
+  default:
+    mAuthState.isValid = false;
+    break;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         ResetAuthState
+**
+** Description      Forgets the authentication state, called on each RF
+**                  interface activation.
+**
+** Returns          None
+**
+*******************************************************************************/
+void NxpMfcReader::ResetAuthState() {
+  mAuthState.isValid = false;
+  mPendingAuth.isValid = false;
+  pthread_mutex_lock(&sCreditsLock);
+  mCreditsToDrop = 0;
+  pthread_mutex_unlock(&sCreditsLock);
+}
+
+/*******************************************************************************
+**
+** Function         SendLocalRspCb
+**
+** Description      Delivers the local response and the credit of the packet
+**                  libnfc-nci sent, on the client thread.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void SendLocalRspCb(void *pInfo) {
+  UNUSED_PROP(pInfo);
+  if (nxpncihal_ctrl.p_nfc_stack_data_cback == NULL) return;
+  (*nxpncihal_ctrl.p_nfc_stack_data_cback)(sLocalRspLen, sLocalRsp);
+  (*nxpncihal_ctrl.p_nfc_stack_data_cback)(sizeof(sLocalCreditsNtf),
+                                           sLocalCreditsNtf);
+}
+
+/*******************************************************************************
+**
+** Function         SendLocalRsp
+**
+** Description      Sends a data response to libnfc-nci for a command which
+**                  was served by the HAL, followed by CORE_CONN_CREDITS_NTF.
+**
+** Returns          None
+**
+*******************************************************************************/
+void NxpMfcReader::SendLocalRsp(const uint8_t *pRsp, uint16_t rspLen) {
+  phLibNfc_Message_t msg;
+
+  memcpy(sLocalRsp, pRsp, rspLen);
+  sLocalRspLen = rspLen;
+  sLocalRspCall.pCallback = SendLocalRspCb;
+  sLocalRspCall.pParameter = NULL;
+  msg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
+  msg.pMsgData = &sLocalRspCall;
+  msg.Size = sizeof(sLocalRspCall);
+  phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId, &msg);
+}
+
+/*******************************************************************************
+**
+** Function         SendInternalCmd
+**
+** Description      Exchanges one TAG_CMD with the tag on behalf of the HAL.
+**                  Response payload is copied to mRspBuf, its credit
+**                  notification is not forwarded to libnfc-nci.
+**
+** Returns          NFCSTATUS_SUCCESS if a response was received
+**
+*******************************************************************************/
+NFCSTATUS NxpMfcReader::SendInternalCmd(uint8_t *pCmd, uint16_t cmdLen) {
+  NFCSTATUS status;
+
+  mRspLen = 0;
+  pthread_mutex_lock(&sCreditsLock);
+  mInternalCmdPending = true;
+  mInternalCreditSeen = false;
+  pthread_mutex_unlock(&sCreditsLock);
+  sendRspToUpperLayer = false;
+  status = phNxpNciHal_send_ext_cmd(cmdLen, pCmd);
+  if (status != NFCSTATUS_SUCCESS) {
+    /* no response, next data packet is for libnfc-nci again */
+    sendRspToUpperLayer = true;
+  }
+  pthread_mutex_lock(&sCreditsLock);
+  mInternalCmdPending = false;
+  /* only a command which was answered has a credit left to drop, one
+   * counted for a failed exchange would be taken from libnfc-nci */
+  if (status == NFCSTATUS_SUCCESS && !mInternalCreditSeen) mCreditsToDrop++;
+  pthread_mutex_unlock(&sCreditsLock);
+  return status;
+}
+
+/*******************************************************************************
+**
+** Function         ReadSector
+**
+** Description      Serves Mifare Read Sector: reads all the blocks of the
+**                  sector and returns them in a single response.
+**
+** Returns          It returns number of bytes consumed.
+**
+*******************************************************************************/
+int NxpMfcReader::ReadSector(uint16_t mfcDataLen, const uint8_t *pMfcData) {
+  uint8_t readCmd[] = {0x00, 0x00, 0x03, (uint8_t)eMfRawDataXchgHdr,
+                       (uint8_t)eMifareRead16, 0x00};
+  uint8_t failRsp[] = {0x00, 0x00, 0x01, (uint8_t)NFCSTATUS_FAILED};
+  uint8_t rsp[NCI_HEADER_SIZE + MFC_SECTOR_SIZE] = {0x00, 0x00,
+                                                   MFC_SECTOR_SIZE};
+  uint8_t sector, block;
+
+  if (mfcDataLen != NCI_HEADER_SIZE + MFC_CMD_HDR_SIZE ||
+      pMfcData[4] >= MFC_SECTOR_NO32) {
+    NXPLOG_NCIHAL_E("%s: invalid sector command", __func__);
+    SendLocalRsp(failRsp, sizeof(failRsp));
+    return mfcDataLen;
+  }
+  sector = pMfcData[4];
+  for (block = 0; block < MFC_BLKS_PER_SECTOR; block++) {
+    readCmd[5] = sector * MFC_BLKS_PER_SECTOR + block;
+    if (SendInternalCmd(readCmd, sizeof(readCmd)) != NFCSTATUS_SUCCESS ||
+        mRspLen != MFC_BYTES_PER_BLOCK) {
+      NXPLOG_NCIHAL_E("%s: read of block %d failed", __func__, readCmd[5]);
+      mAuthState.isValid = false;
+      if (mRspLen == 1) failRsp[3] = mRspBuf[0];
+      SendLocalRsp(failRsp, sizeof(failRsp));
+      return mfcDataLen;
+    }
+    memcpy(&rsp[NCI_HEADER_SIZE + block * MFC_BYTES_PER_BLOCK], mRspBuf,
+           MFC_BYTES_PER_BLOCK);
+  }
+  SendLocalRsp(rsp, sizeof(rsp));
+  return mfcDataLen;
+}
+
+/*******************************************************************************
+**
+** Function         WriteSector
+**
+** Description      Serves Mifare Write Sector: writes the data blocks of the
+**                  sector, the sector trailer is never written. Each block
+**                  is sent as Write part 1 and part 2.
+**
+** Returns          It returns number of bytes consumed.
+**
+*******************************************************************************/
+int NxpMfcReader::WriteSector(uint16_t mfcDataLen, const uint8_t *pMfcData) {
+  uint8_t writePart1[] = {0x00, 0x00, 0x03, (uint8_t)eMfRawDataXchgHdr,
+                          (uint8_t)eMifareWrite16, 0x00};
+  uint8_t writePart2[NCI_HEADER_SIZE + 1 + MFC_BYTES_PER_BLOCK] = {
+      0x00, 0x00, 1 + MFC_BYTES_PER_BLOCK, (uint8_t)eMfRawDataXchgHdr};
+  uint8_t failRsp[] = {0x00, 0x00, 0x01, (uint8_t)NFCSTATUS_FAILED};
+  uint8_t rsp[NCI_HEADER_SIZE + MFC_SECTOR_SIZE] = {0x00};
+  const uint8_t *pData = &pMfcData[NCI_HEADER_SIZE + MFC_CMD_HDR_SIZE];
+  uint8_t sector, block;
+
+  /* block 0 holds the manufacturer data, sector 0 is not written */
+  if (mfcDataLen !=
+          NCI_HEADER_SIZE + MFC_CMD_HDR_SIZE + MFC_SECTOR_DATA_SIZE ||
+      pMfcData[4] == 0 || pMfcData[4] >= MFC_SECTOR_NO32) {
+    NXPLOG_NCIHAL_E("%s: invalid sector command", __func__);
+    SendLocalRsp(failRsp, sizeof(failRsp));
+    return mfcDataLen;
+  }
+  sector = pMfcData[4];
+  for (block = 0; block < MFC_BLKS_PER_SECTOR - 1; block++) {
+    writePart1[5] = sector * MFC_BLKS_PER_SECTOR + block;
+    memcpy(&writePart2[NCI_HEADER_SIZE + 1],
+           &pData[block * MFC_BYTES_PER_BLOCK], MFC_BYTES_PER_BLOCK);
+    if (SendInternalCmd(writePart1, sizeof(writePart1)) != NFCSTATUS_SUCCESS ||
+        mRspLen == 1 ||
+        SendInternalCmd(writePart2, sizeof(writePart2)) != NFCSTATUS_SUCCESS ||
+        mRspLen == 1) {
+      NXPLOG_NCIHAL_E("%s: write of block %d failed", __func__, writePart1[5]);
+      mAuthState.isValid = false;
+      if (mRspLen == 1) failRsp[3] = mRspBuf[0];
+      SendLocalRsp(failRsp, sizeof(failRsp));
+      return mfcDataLen;
+    }
+  }
+  /* Reply with the response to the last block written */
+  rsp[2] = mRspLen;
+  memcpy(&rsp[NCI_HEADER_SIZE], mRspBuf, mRspLen);
+  SendLocalRsp(rsp, NCI_HEADER_SIZE + mRspLen);
+  return mfcDataLen;
+}
+
 /*******************************************************************************
 **
 ** Function          AnalyzeMfcResp
@@ -347,6 +660,8 @@ NFCSTATUS NxpMfcReader::AnalyzeMfcResp(uint8_t *pBuff, uint16_t *pBufflen) {
       if (*pBufflen == 3) {
         if ((pBuff[0] == 0x10) && (pBuff[1] != 0x0A)) {
           NXPLOG_NCIHAL_E("Mifare Error in payload response");
+          /* NACK, tag is no longer authenticated */
+          mAuthState.isValid = false;
           *pBufflen = 0x1;
           pBuff[0] = NFCSTATUS_FAILED;
           return NFCSTATUS_FAILED;
@@ -375,6 +690,7 @@ NFCSTATUS NxpMfcReader::AnalyzeMfcResp(uint8_t *pBuff, uint16_t *pBufflen) {
           status = NFCSTATUS_FAILED;
         }
       } else {
+        mAuthState.isValid = false;
         status = NFCSTATUS_FAILED;
       }
     } break;
@@ -392,7 +708,11 @@ NFCSTATUS NxpMfcReader::AnalyzeMfcResp(uint8_t *pBuff, uint16_t *pBufflen) {
         /* update the number of bytes received from lower layer,excluding
          * the status byte */
         *pBufflen = wPldDataSize + 1;
+        mAuthState = mPendingAuth;
+        mPendingAuth.isValid = false;
       } else {
+        mAuthState.isValid = false;
+        mPendingAuth.isValid = false;
         pBuff[0] = pBuff[1];
         *pBufflen = 1;
         status = NFCSTATUS_FAILED;
@@ -409,7 +729,8 @@ NFCSTATUS NxpMfcReader::AnalyzeMfcResp(uint8_t *pBuff, uint16_t *pBufflen) {
 ** Function         CheckMfcResponse
 **
 ** Description      This function is called to check if it's a valid Mfc
-**                  response data
+**                  response data. Payload of the response to a HAL internal
+**                  exchange is kept in mRspBuf.
 **
 ** Returns          NFCSTATUS_SUCCESS
 **                  NFCSTATUS_FAILED
@@ -419,6 +740,13 @@ NFCSTATUS NxpMfcReader::CheckMfcResponse(uint8_t *pTransceiveData,
                                          uint16_t transceiveDataLen) {
   NFCSTATUS status = NFCSTATUS_SUCCESS;
 
+  mRspLen = 0;
+  if (transceiveDataLen > NCI_HEADER_SIZE) {
+    mRspLen = transceiveDataLen - NCI_HEADER_SIZE;
+    if (mRspLen > sizeof(mRspBuf)) mRspLen = sizeof(mRspBuf);
+    memcpy(mRspBuf, &pTransceiveData[NCI_HEADER_SIZE], mRspLen);
+  }
+
   if (transceiveDataLen == 3) {
     if ((pTransceiveData)[0] == 0x10 && (pTransceiveData)[1] != 0x0A) {
       NXPLOG_NCIHAL_E("Mifare Error in payload response");
@@ -487,12 +815,42 @@ NFCSTATUS NxpMfcReader::MfcWaitForAck() {
   isAck = false;
   clock_gettime(CLOCK_REALTIME, &ts);
   ts.tv_sec += sem_timedout;
-  while ((s = sem_timedwait(&mNacksem, &ts)) == -1 &&
-         errno == EINTR){
-    continue; /* Restart if interrupted by handler */
-  }
+  s = phNxpNciHal_lockStatsSemTimedWait(PH_NXP_LOCK_SITE_MFC_ACK, &mNacksem,
+                                        &ts);
   if (s != -1) {
      status = NFCSTATUS_SUCCESS;
   }
   return status;
 }
+
+/*******************************************************************************
+**
+** Function         DropInternalCredits
+**
+** Description      Removes from CORE_CONN_CREDITS_NTF the credits given back
+**                  for HAL internal exchanges on the static RF connection,
+**                  libnfc-nci already got a credit with the local response.
+**
+** Returns          true if nothing is left to forward to libnfc-nci
+**
+*******************************************************************************/
+bool NxpMfcReader::DropInternalCredits(uint8_t *pNtf) {
+  const uint8_t NCI_RF_CONN_ID = 0;
+  uint8_t credits;
+
+  /* single entry for the static RF connection */
+  if (pNtf[2] != 0x03 || pNtf[3] != 0x01 || pNtf[4] != NCI_RF_CONN_ID) {
+    return false;
+  }
+  pthread_mutex_lock(&sCreditsLock);
+  if (mInternalCmdPending && !mInternalCreditSeen && pNtf[5] > 0) {
+    /* credit of the exchange in progress, given back before its response */
+    mInternalCreditSeen = true;
+    pNtf[5]--;
+  }
+  credits = (pNtf[5] < mCreditsToDrop) ? pNtf[5] : mCreditsToDrop;
+  mCreditsToDrop -= credits;
+  pNtf[5] -= credits;
+  pthread_mutex_unlock(&sCreditsLock);
+  return (pNtf[5] == 0);
+}
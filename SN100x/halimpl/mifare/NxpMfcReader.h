@@ -30,6 +30,12 @@
 #define MFC_SECTOR_NO32 32 /* Sector 32 for Mifare 4K*/
 #define MFC_BYTES_PER_BLOCK 16
 #define MFC_BLKS_PER_SECTOR (0x04)
+/* Sector read returns all the blocks, sector write covers the data blocks */
+#define MFC_SECTOR_SIZE (MFC_BLKS_PER_SECTOR * MFC_BYTES_PER_BLOCK)
+#define MFC_SECTOR_DATA_SIZE ((MFC_BLKS_PER_SECTOR - 1) * MFC_BYTES_PER_BLOCK)
+#define MFC_UID_LEN 0x04
+/* MFC command header: cmd + block/sector number */
+#define MFC_CMD_HDR_SIZE 0x02
 
 #define MFC_EXTN_ID_SIZE (0x01U)     /* Size of Mfc Req/Rsp Id */
 #define MFC_EXTN_STATUS_SIZE (0x01U) /* Size of Mfc Resp Status Byte */
@@ -99,11 +105,29 @@ typedef struct MfcTagCmdIntfData {
   uint8_t sendBuf[MAX_MFC_BUFF_SIZE]; /*Holds the ack of some initial commands*/
 } MfcTagCmdIntfData_t;
 
+/*
+ * Sector authenticated on the activated tag
+ */
+typedef struct MfcAuthState {
+  bool isValid;
+  uint8_t bySector;
+  uint8_t byAuthCmd; /* eMifareAuthentA or eMifareAuthentB */
+  uint8_t aUid[MFC_UID_LEN];
+  uint8_t aKey[MFC_AUTHKEYLEN];
+} MfcAuthState_t;
+
 class NxpMfcReader {
 private:
   MfcTagCmdIntfData_t mMfcTagCmdIntfData;
   sem_t mNacksem;
   bool isAck;
+  MfcAuthState_t mAuthState;    /* sector currently authenticated */
+  MfcAuthState_t mPendingAuth;  /* authentication waiting for response */
+  uint8_t mCreditsToDrop;       /* credits of HAL internal exchanges */
+  uint8_t mRspBuf[MFC_SECTOR_SIZE]; /* response of HAL internal exchange */
+  uint16_t mRspLen;
+  bool mInternalCmdPending;     /* HAL internal exchange in progress */
+  bool mInternalCreditSeen;     /* its credit was already given back */
   void BuildMfcCmd(uint8_t *pData, uint16_t *pLength);
   void BuildAuthCmd();
   void BuildReadCmd();
@@ -111,8 +135,17 @@ private:
   void BuildRawCmd();
   void BuildIncDecCmd();
   void CalcSectorAddress();
+  static uint8_t BlockToSector(uint8_t blockNumber);
+  static bool IsSectorTrailer(uint8_t blockNumber);
   void AuthForWrite();
   void SendIncDecRestoreCmdPart2(const uint8_t *mfcData);
+  bool ParseAuthCmd(const uint8_t *pCmd, uint16_t cmdLen,
+                    MfcAuthState_t *pAuth);
+  void UpdateAuthState(const uint8_t *pCmd, uint16_t cmdLen);
+  NFCSTATUS SendInternalCmd(uint8_t *pCmd, uint16_t cmdLen);
+  void SendLocalRsp(const uint8_t *pRsp, uint16_t rspLen);
+  int ReadSector(uint16_t mfcDataLen, const uint8_t *pMfcData);
+  int WriteSector(uint16_t mfcDataLen, const uint8_t *pMfcData);
 
 public:
   int Write(uint16_t mfcDataLen, const uint8_t *pMfcData);
@@ -123,4 +156,6 @@ public:
   NFCSTATUS MfcWaitForAck();
   static NxpMfcReader &getInstance();
   bool checkIsMFCIncDecRestore(uint8_t cmd);
+  void ResetAuthState();
+  bool DropInternalCredits(uint8_t *pNtf);
 };
@@ -0,0 +1,169 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Replays a NCI capture recorded with NXP_NCI_TRACE_CAPTURE=1 into the HAL.
+ *
+ *   nxp_nci_replay [-r] <capture file>
+ *
+ *   -r   keep the captured timing, default is to replay as fast as possible
+ *
+ * The NFCC is emulated by NfccReplayTransport, HAL API calls recorded from
+ * libnfc-nci are issued again by this tool. At the end, the packets written
+ * by the HAL are compared against the capture and the throughput of the read
+ * path and the latency from TML read to the libnfc-nci data callback are
+ * reported.
+ */
+
+#include <NfccReplayTransport.h>
+#include <NfccTransportFactory.h>
+#include <phNxpNciHal_Adaptation.h>
+#include <phTmlNfc_Trace.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#define NXP_REPLAY_OPEN_TIMEOUT_SEC 5
+
+static std::shared_ptr<NfccReplayTransport> sReplayTransport;
+static pthread_mutex_t sReplayLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<uint64_t> sCbLatency;
+static uint32_t sDataCbCount;
+static uint32_t sEvtCbCount;
+static sem_t sOpenCpltSem;
+
+static void nxp_replay_stack_cback(nfc_event_t event, nfc_status_t status) {
+  pthread_mutex_lock(&sReplayLock);
+  sEvtCbCount++;
+  pthread_mutex_unlock(&sReplayLock);
+  if (event == HAL_NFC_OPEN_CPLT_EVT) {
+    if (status != HAL_NFC_STATUS_OK) printf("HAL open failed: %d\n", status);
+    sem_post(&sOpenCpltSem);
+  }
+}
+
+static void nxp_replay_data_cback(uint16_t data_len, uint8_t* p_data) {
+  uint64_t readTime;
+  uint64_t now = NfccReplayTransport::Now();
+
+  pthread_mutex_lock(&sReplayLock);
+  sDataCbCount++;
+  if (sReplayTransport->PopReadTime(p_data, data_len, &readTime))
+    sCbLatency.push_back(now - readTime);
+  pthread_mutex_unlock(&sReplayLock);
+}
+
+static bool nxp_replay_open(void) {
+  struct timespec ts;
+
+  /* TML drops the transport on close, hand the replay one again */
+  gpTransportObj = sReplayTransport;
+  if (phNxpNciHal_open(nxp_replay_stack_cback, nxp_replay_data_cback) !=
+      NFCSTATUS_SUCCESS) {
+    return false;
+  }
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += NXP_REPLAY_OPEN_TIMEOUT_SEC;
+  return (sem_timedwait(&sOpenCpltSem, &ts) == 0);
+}
+
+static void nxp_replay_report(uint64_t elapsed) {
+  NfccReplayStats_t stats = sReplayTransport->GetStats();
+  double seconds = (double)elapsed / 1000000000.0;
+  uint64_t sum = 0;
+
+  printf("replay time          : %.3f s\n", seconds);
+  printf("NFCC packets read    : %u (%.1f pkt/s, %.1f kB/s)\n", stats.dwRxPkts,
+         stats.dwRxPkts / seconds, stats.qwRxBytes / seconds / 1024.0);
+  printf("HAL packets written  : %u matched, %u mismatched, %u unexpected, "
+         "%u missing\n",
+         stats.dwTxMatched, stats.dwTxMismatched, stats.dwTxUnexpected,
+         stats.dwTxMissing);
+  printf("libnfc callbacks     : %u data, %u event\n", sDataCbCount,
+         sEvtCbCount);
+  if (sCbLatency.empty()) return;
+  std::sort(sCbLatency.begin(), sCbLatency.end());
+  for (uint64_t latency : sCbLatency) sum += latency;
+  printf("read to data callback: min %.1f us, avg %.1f us, p50 %.1f us, "
+         "p99 %.1f us, max %.1f us\n",
+         sCbLatency.front() / 1000.0, sum / 1000.0 / sCbLatency.size(),
+         sCbLatency[sCbLatency.size() / 2] / 1000.0,
+         sCbLatency[(sCbLatency.size() * 99) / 100] / 1000.0,
+         sCbLatency.back() / 1000.0);
+}
+
+int main(int argc, char** argv) {
+  const NfccReplayRecord_t* pRecord = NULL;
+  std::vector<uint8_t> args;
+  bool realTime = false;
+  bool halOpen = false;
+  bool failed = false;
+  uint64_t start;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r")) != -1) {
+    if (opt == 'r') realTime = true;
+  }
+  if (optind >= argc) {
+    printf("usage: %s [-r] <capture file>\n", argv[0]);
+    return 1;
+  }
+  sem_init(&sOpenCpltSem, 0, 0);
+  phTmlNfc_TraceDisable();
+  sReplayTransport = std::make_shared<NfccReplayTransport>(realTime);
+  if (!sReplayTransport->Load(argv[optind])) {
+    printf("%s: no HAL open found in capture\n", argv[optind]);
+    return 1;
+  }
+
+  start = NfccReplayTransport::Now();
+  while (!failed && sReplayTransport->GetNextHostRecord(&pRecord)) {
+    if (pRecord->bDir == PH_TMLNFC_TRACE_HOST_TX) {
+      phNxpNciHal_write(pRecord->data.size(), pRecord->data.data());
+      continue;
+    }
+    args.assign(pRecord->data.begin() + 1, pRecord->data.end());
+    switch (pRecord->data[0]) {
+      case PH_TMLNFC_TRACE_EVT_OPEN:
+        halOpen = nxp_replay_open();
+        failed = !halOpen;
+        break;
+      case PH_TMLNFC_TRACE_EVT_CORE_INITIALIZED:
+        phNxpNciHal_core_initialized(args.size(), args.data());
+        break;
+      case PH_TMLNFC_TRACE_EVT_PRE_DISCOVER:
+        phNxpNciHal_pre_discover();
+        break;
+      case PH_TMLNFC_TRACE_EVT_CLOSE:
+        phNxpNciHal_close(!args.empty() && args[0]);
+        halOpen = false;
+        break;
+      case PH_TMLNFC_TRACE_EVT_POWER_CYCLE:
+        phNxpNciHal_power_cycle();
+        break;
+      default:
+        break;
+    }
+  }
+  if (halOpen) phNxpNciHal_close(false);
+
+  nxp_replay_report(NfccReplayTransport::Now() - start);
+  return failed ? 1 : 0;
+}
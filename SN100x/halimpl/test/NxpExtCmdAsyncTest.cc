@@ -0,0 +1,203 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Tests of the asynchronous HAL extension commands, without NFCC.
+ *
+ *   nxp_ext_cmd_async_test
+ *
+ * phNxpNciHal_ExtCmdAsync.cc is built into the test and
+ * phNxpNciHal_exec_ext_cmd is stubbed: the last payload byte of a command
+ * tells how long its response takes and whether it comes at all, a missing
+ * response costs the timeout of the response wait and the one of the
+ * notification wait, as in the HAL. Each test runs its own dispatcher.
+ */
+
+#include <gtest/gtest.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal_ExtCmdAsync.h>
+#include <phNxpNciHal_ext.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+
+#define NXP_EXT_CMD_TEST_MAX_CMDS 8
+/* last payload byte of a command without response */
+#define NXP_EXT_CMD_TEST_NO_RSP 0xFF
+/* slack for the scheduling of the dispatcher thread */
+#define NXP_EXT_CMD_TEST_SLACK_MS 50
+
+/* Commands seen by the stub, in order */
+static uint8_t sSent[NXP_EXT_CMD_TEST_MAX_CMDS];
+static uint32_t sSentTimeoutMs[NXP_EXT_CMD_TEST_MAX_CMDS];
+static std::atomic<uint32_t> sNumSent(0);
+/* Completion order seen by the callback */
+static uint8_t sCompleted[NXP_EXT_CMD_TEST_MAX_CMDS];
+static std::atomic<uint32_t> sNumCompleted(0);
+
+NFCSTATUS phNxpNciHal_exec_ext_cmd(uint16_t cmd_len, uint8_t* p_cmd,
+                                   uint32_t timeout_ms, uint16_t* p_rsp_len,
+                                   uint8_t* p_rsp) {
+  uint8_t delay = p_cmd[cmd_len - 1];
+  uint32_t n = sNumSent.load();
+
+  if (n < NXP_EXT_CMD_TEST_MAX_CMDS) {
+    sSent[n] = p_cmd[3];
+    sSentTimeoutMs[n] = timeout_ms;
+  }
+  sNumSent = n + 1;
+  if (delay == NXP_EXT_CMD_TEST_NO_RSP) {
+    /* response then notification wait, each one times out */
+    usleep(2 * timeout_ms * 1000);
+    *p_rsp_len = 0;
+    return NFCSTATUS_FAILED;
+  }
+  usleep(delay * 1000);
+  p_rsp[0] = 0x40 | (p_cmd[0] & 0x0F);
+  p_rsp[1] = p_cmd[1];
+  p_rsp[2] = 0x01;
+  p_rsp[3] = 0x00;
+  *p_rsp_len = 4;
+  return NFCSTATUS_SUCCESS;
+}
+
+static uint64_t nxp_ext_cmd_test_now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void nxp_ext_cmd_test_cback(phNxpNciHal_ExtCmd_t* pCmd) {
+  uint32_t n = sNumCompleted.load();
+
+  if (n < NXP_EXT_CMD_TEST_MAX_CMDS) sCompleted[n] = pCmd->aCmd[3];
+  sNumCompleted = n + 1;
+}
+
+/* CORE_SET_CONFIG_CMD of one 1 byte param, id then stub delay as value */
+static void nxp_ext_cmd_test_init(phNxpNciHal_ExtCmd_t* pCmd, uint8_t id,
+                                  uint8_t delay, uint32_t timeout_ms) {
+  const uint8_t cmd[] = {0x20, 0x02, 0x04, id, 0x00, 0x01, delay};
+
+  phNxpNciHal_extCmdInit(pCmd, sizeof(cmd), cmd, timeout_ms);
+  pCmd->pCback = nxp_ext_cmd_test_cback;
+}
+
+class NxpExtCmdAsyncTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    sNumSent = 0;
+    sNumCompleted = 0;
+    memset(sSent, 0x00, sizeof(sSent));
+    memset(sSentTimeoutMs, 0x00, sizeof(sSentTimeoutMs));
+    memset(sCompleted, 0x00, sizeof(sCompleted));
+    phNxpNciHal_extCmdAsyncStart();
+  }
+
+  void TearDown() override { phNxpNciHal_extCmdAsyncStop(); }
+};
+
+TEST_F(NxpExtCmdAsyncTest, SentAndCompletedInSubmissionOrder) {
+  phNxpNciHal_ExtCmd_t cmds[5];
+  phNxpNciHal_ExtCmdGroup_t group;
+
+  phNxpNciHal_extCmdGroupInit(&group, false);
+  for (uint8_t i = 0; i < 5; i++) {
+    /* later commands are faster, they must still wait for their turn */
+    nxp_ext_cmd_test_init(&cmds[i], i, 10 - 2 * i, 0);
+    phNxpNciHal_extCmdSubmit(&group, &cmds[i]);
+  }
+  EXPECT_EQ(phNxpNciHal_extCmdGroupWait(&group), NFCSTATUS_SUCCESS);
+  ASSERT_EQ(sNumSent.load(), 5u);
+  ASSERT_EQ(sNumCompleted.load(), 5u);
+  for (uint8_t i = 0; i < 5; i++) {
+    EXPECT_EQ(sSent[i], i);
+    EXPECT_EQ(sCompleted[i], i);
+    EXPECT_EQ(cmds[i].wStatus, NFCSTATUS_SUCCESS);
+    EXPECT_EQ(cmds[i].wRspLen, 4);
+  }
+  /* timeout 0 is the default one */
+  EXPECT_EQ(sSentTimeoutMs[0], (uint32_t)HAL_EXTNS_WRITE_RSP_TIMEOUT);
+}
+
+TEST_F(NxpExtCmdAsyncTest, TimeQueuedNotCountedInTimeout) {
+  phNxpNciHal_ExtCmd_t cmds[2];
+  phNxpNciHal_ExtCmdGroup_t group;
+
+  /* queued behind a slow command for longer than its own timeout */
+  phNxpNciHal_extCmdGroupInit(&group, false);
+  nxp_ext_cmd_test_init(&cmds[0], 0, 100, 0);
+  nxp_ext_cmd_test_init(&cmds[1], 1, 1, 20);
+  phNxpNciHal_extCmdSubmit(&group, &cmds[0]);
+  phNxpNciHal_extCmdSubmit(&group, &cmds[1]);
+  EXPECT_EQ(phNxpNciHal_extCmdGroupWait(&group), NFCSTATUS_SUCCESS);
+  EXPECT_EQ(sNumSent.load(), 2u);
+  EXPECT_EQ(sSentTimeoutMs[1], 20u);
+}
+
+TEST_F(NxpExtCmdAsyncTest, NoResponseAbortsTheChain) {
+  phNxpNciHal_ExtCmd_t cmds[3];
+  phNxpNciHal_ExtCmdGroup_t group;
+
+  /* no response: both waits time out, the chain is aborted */
+  phNxpNciHal_extCmdGroupInit(&group, true);
+  nxp_ext_cmd_test_init(&cmds[0], 0, 1, 0);
+  nxp_ext_cmd_test_init(&cmds[1], 1, NXP_EXT_CMD_TEST_NO_RSP, 30);
+  nxp_ext_cmd_test_init(&cmds[2], 2, 1, 0);
+  uint64_t startMs = nxp_ext_cmd_test_now_ms();
+  for (int i = 0; i < 3; i++) phNxpNciHal_extCmdSubmit(&group, &cmds[i]);
+  NFCSTATUS status = phNxpNciHal_extCmdGroupWait(&group);
+  uint64_t elapsedMs = nxp_ext_cmd_test_now_ms() - startMs;
+  /* the timeout applies to the response and the notification each */
+  EXPECT_EQ(sSentTimeoutMs[1], 30u);
+  EXPECT_GE(elapsedMs, 60u);
+  EXPECT_LT(elapsedMs, 60u + NXP_EXT_CMD_TEST_SLACK_MS);
+  EXPECT_EQ(status, NFCSTATUS_FAILED);
+  EXPECT_EQ(sNumSent.load(), 2u);
+  EXPECT_EQ(cmds[1].wStatus, NFCSTATUS_FAILED);
+  EXPECT_EQ(cmds[2].wStatus, NFCSTATUS_ABORTED);
+}
+
+TEST_F(NxpExtCmdAsyncTest, CloseShutsTheQueuedCommandsDown) {
+  phNxpNciHal_ExtCmd_t cmds[3];
+  phNxpNciHal_ExtCmdGroup_t group;
+  phNxpNciHal_ExtCmd_t late;
+
+  phNxpNciHal_extCmdGroupInit(&group, false);
+  nxp_ext_cmd_test_init(&cmds[0], 0, 50, 0);
+  nxp_ext_cmd_test_init(&cmds[1], 1, 1, 0);
+  nxp_ext_cmd_test_init(&cmds[2], 2, 1, 0);
+  for (int i = 0; i < 3; i++) phNxpNciHal_extCmdSubmit(&group, &cmds[i]);
+  /* let the first one be sent */
+  while (sNumSent == 0) usleep(1000);
+  phNxpNciHal_extCmdAsyncStop();
+  NFCSTATUS status = phNxpNciHal_extCmdGroupWait(&group);
+  /* the command in flight completes, the queued ones are shut down */
+  EXPECT_EQ(cmds[0].wStatus, NFCSTATUS_SUCCESS);
+  EXPECT_EQ(cmds[1].wStatus, NFCSTATUS_SHUTDOWN);
+  EXPECT_EQ(cmds[2].wStatus, NFCSTATUS_SHUTDOWN);
+  EXPECT_EQ(status, NFCSTATUS_SHUTDOWN);
+  EXPECT_EQ(sNumSent.load(), 1u);
+  EXPECT_EQ(sNumCompleted.load(), 3u);
+
+  nxp_ext_cmd_test_init(&late, 3, 1, 0);
+  EXPECT_EQ(phNxpNciHal_extCmdSubmit(NULL, &late), NFCSTATUS_NOT_INITIALISED)
+      << "submit after close accepted";
+}
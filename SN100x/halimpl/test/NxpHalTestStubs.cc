@@ -0,0 +1,38 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Logging globals and stubs shared by the tests and benches that build HAL
+ * sources in without libnfc-nci or phNxpLog.cc. Logs are off and the
+ * asynchronous sink is never used.
+ */
+
+#include <phNxpLog.h>
+
+nci_log_level_t gLog_level;
+bool nfc_debug_enabled = false;
+bool gLog_async_enabled = false;
+const char* NXPLOG_ITEM_NCIHAL = "NxpNciHal";
+const char* NXPLOG_ITEM_TML = "NxpTml";
+
+int phNxpLog_AsyncAcquire(phNxpLog_AsyncRec_t** ppRec) {
+  (void)ppRec;
+  return -1;
+}
+
+void phNxpLog_AsyncCommit(phNxpLog_AsyncRec_t* pRec) { (void)pRec; }
@@ -0,0 +1,272 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Tests of the NFCC liveness monitor, without NFCC.
+ *
+ *   nxp_liveness_test
+ *
+ * phNxpNciHal_Liveness.cc is built into the test, the HAL calls it makes
+ * are stubbed: the probe command is answered, times out, or a command of
+ * libnfc-nci stays pending, and the hang recovery only records the hang.
+ * The liveness record goes to PH_NXP_LIVENESS_FILE, set by the build. Each
+ * test starts from a fresh HAL state and no record; only lower bounds are
+ * checked on the times, so that the tests hold under TSan as well.
+ */
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <phNxpConfig.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal.h>
+#include <phNxpNciHal_LatencyStats.h>
+#include <phNxpNciHal_Liveness.h>
+#include <phNxpNciHal_ext.h>
+#include <phTmlNfc.h>
+#include <semaphore.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+
+#define NXP_LIVENESS_TEST_IDLE_MS 200
+#define NXP_LIVENESS_TEST_TIMEOUT_MS 100
+#define NXP_LIVENESS_TEST_MISSES 2
+/* slack for the scheduling of the monitor thread, on the waits only */
+#define NXP_LIVENESS_TEST_SLACK_MS 2000
+/* probes of a healthy NFCC looked at */
+#define NXP_LIVENESS_TEST_PROBES 3
+/* offset of the boot id in the liveness record */
+#define NXP_LIVENESS_TEST_BOOT_ID_OFFSET 16
+
+typedef enum {
+  NXP_LIVENESS_TEST_HEALTHY = 0x00, /* probes are answered */
+  NXP_LIVENESS_TEST_DEAD,           /* probes time out */
+  NXP_LIVENESS_TEST_PENDING         /* a command waits for its response */
+} nxp_liveness_test_mode_t;
+
+phNxpNciHal_Control_t nxpncihal_ctrl;
+
+static phNxpNciHal_Monitor_t sMonitor;
+static std::atomic<int> sMode(NXP_LIVENESS_TEST_HEALTHY);
+static std::atomic<uint32_t> sProbes(0);
+/* time each probe was sent, for the first NXP_LIVENESS_TEST_PROBES ones */
+static uint64_t sProbeUs[NXP_LIVENESS_TEST_PROBES];
+static sem_t sHangSem;
+
+extern "C" int GetNxpNumValue(const char* name, void* pValue,
+                              unsigned long len) {
+  unsigned long num;
+
+  if (len != sizeof(unsigned long)) return 0;
+  if (strcmp(name, NAME_NXP_LIVENESS_IDLE_MS) == 0) {
+    num = NXP_LIVENESS_TEST_IDLE_MS;
+  } else if (strcmp(name, NAME_NXP_LIVENESS_PROBE_TIMEOUT_MS) == 0) {
+    num = NXP_LIVENESS_TEST_TIMEOUT_MS;
+  } else if (strcmp(name, NAME_NXP_LIVENESS_MAX_MISSES) == 0) {
+    num = NXP_LIVENESS_TEST_MISSES;
+  } else {
+    return 0;
+  }
+  *(unsigned long*)pValue = num;
+  return 1;
+}
+
+uint64_t phNxpNciHal_latencyNowUs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+phNxpNciHal_Monitor_t* phNxpNciHal_get_monitor(void) { return &sMonitor; }
+
+bool phTmlNfc_IsFwDnldModeEnabled(void) { return false; }
+
+NFCSTATUS phNxpNciHal_exec_ext_cmd(uint16_t cmd_len, uint8_t* p_cmd,
+                                   uint32_t timeout_ms, uint16_t* p_rsp_len,
+                                   uint8_t* p_rsp) {
+  static const uint8_t rsp[] = {0x40, 0x03, 0x05, 0x00, 0x01, 0x00, 0x01,
+                                0x00};
+  uint32_t n = sProbes.load();
+  (void)cmd_len;
+  (void)p_cmd;
+
+  if (n < NXP_LIVENESS_TEST_PROBES) sProbeUs[n] = phNxpNciHal_latencyNowUs();
+  sProbes = n + 1;
+  if (sMode == NXP_LIVENESS_TEST_DEAD) {
+    usleep(timeout_ms * 1000);
+    return NFCSTATUS_RESPONSE_TIMEOUT;
+  }
+  usleep(1000);
+  memcpy(p_rsp, rsp, sizeof(rsp));
+  *p_rsp_len = sizeof(rsp);
+  phNxpNciHal_livenessOnRx(phNxpNciHal_latencyNowUs());
+  return NFCSTATUS_SUCCESS;
+}
+
+bool phNxpNciHal_nfccHangRecovery(void) {
+  phNxpNciHal_livenessOnHang();
+  sem_post(&sHangSem);
+  return true;
+}
+
+class NxpLivenessTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    memset(&nxpncihal_ctrl, 0x00, sizeof(nxpncihal_ctrl));
+    nxpncihal_ctrl.halStatus = HAL_STATUS_OPEN;
+    sem_init(&nxpncihal_ctrl.syncSpiNfc, 0, 1);
+    pthread_mutex_init(&sMonitor.concurrency_mutex, NULL);
+    sem_init(&sHangSem, 0, 0);
+    sMode = NXP_LIVENESS_TEST_HEALTHY;
+    sProbes = 0;
+    memset(sProbeUs, 0x00, sizeof(sProbeUs));
+    unlink(PH_NXP_LIVENESS_FILE);
+  }
+
+  void TearDown() override {
+    phNxpNciHal_livenessStop();
+    unlink(PH_NXP_LIVENESS_FILE);
+    sem_destroy(&sHangSem);
+    pthread_mutex_destroy(&sMonitor.concurrency_mutex);
+    sem_destroy(&nxpncihal_ctrl.syncSpiNfc);
+  }
+
+  /* Starts the monitor with the NFCC in mode, returns the start time */
+  uint64_t Start(nxp_liveness_test_mode_t mode) {
+    sMode = mode;
+    /* the command of libnfc-nci holds the write semaphore */
+    if (mode == NXP_LIVENESS_TEST_PENDING) {
+      sem_wait(&nxpncihal_ctrl.syncSpiNfc);
+    }
+    uint64_t startUs = phNxpNciHal_latencyNowUs();
+    phNxpNciHal_livenessStart();
+    return startUs;
+  }
+
+  /* Waits for a hang, returns its time since startUs in ms, -1 if none */
+  int WaitHang(uint64_t startUs, uint32_t dwMaxMs) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += dwMaxMs / 1000;
+    ts.tv_nsec += (long)(dwMaxMs % 1000) * 1000000;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+    if (sem_timedwait(&sHangSem, &ts) != 0) return -1;
+    return (int)((phNxpNciHal_latencyNowUs() - startUs) / 1000);
+  }
+
+  /* Leaves a record of a hang, as a previous HAL session would */
+  void RecordHang(void) {
+    phNxpNciHal_livenessOnHang();
+    ASSERT_EQ(access(PH_NXP_LIVENESS_FILE, F_OK), 0);
+  }
+};
+
+TEST_F(NxpLivenessTest, HealthyProbedAtMostOncePerIdlePeriod) {
+  phNxpNciHal_LivenessStats_t before, after;
+  uint64_t idleUs = (uint64_t)NXP_LIVENESS_TEST_IDLE_MS * 1000;
+  uint64_t deadlineUs;
+
+  phNxpNciHal_livenessStatsGet(&before);
+  uint64_t startUs = Start(NXP_LIVENESS_TEST_HEALTHY);
+  deadlineUs = startUs + (NXP_LIVENESS_TEST_PROBES * NXP_LIVENESS_TEST_IDLE_MS +
+                          NXP_LIVENESS_TEST_SLACK_MS) *
+                             1000ULL;
+  while (sProbes < NXP_LIVENESS_TEST_PROBES &&
+         phNxpNciHal_latencyNowUs() < deadlineUs) {
+    usleep(10 * 1000);
+  }
+  phNxpNciHal_livenessStop();
+  phNxpNciHal_livenessStatsGet(&after);
+
+  ASSERT_GE(sProbes.load(), (uint32_t)NXP_LIVENESS_TEST_PROBES);
+  EXPECT_NE(sem_trywait(&sHangSem), 0) << "healthy NFCC declared hung";
+  EXPECT_EQ(after.dwProbeMisses, before.dwProbeMisses);
+  /* idle time counts from the start, then from the previous response */
+  EXPECT_GE(sProbeUs[0], startUs + idleUs);
+  for (int i = 1; i < NXP_LIVENESS_TEST_PROBES; i++) {
+    EXPECT_GE(sProbeUs[i], sProbeUs[i - 1] + idleUs) << "probe " << i;
+  }
+}
+
+TEST_F(NxpLivenessTest, DeadDetectedAfterTheMissedProbesOnly) {
+  phNxpNciHal_LivenessStats_t stats;
+
+  uint64_t startUs = Start(NXP_LIVENESS_TEST_DEAD);
+  phNxpNciHal_livenessStatsGet(&stats);
+  int ms = WaitHang(startUs, stats.dwBoundMs + NXP_LIVENESS_TEST_SLACK_MS);
+  ASSERT_GE(ms, 0) << "no hang detected";
+  EXPECT_GE(ms, NXP_LIVENESS_TEST_IDLE_MS +
+                    NXP_LIVENESS_TEST_MISSES * NXP_LIVENESS_TEST_TIMEOUT_MS);
+  EXPECT_GE(sProbes.load(), (uint32_t)NXP_LIVENESS_TEST_MISSES);
+}
+
+TEST_F(NxpLivenessTest, PendingDetectedAfterTheCommandTimeoutsOnly) {
+  phNxpNciHal_LivenessStats_t stats;
+
+  uint64_t startUs = Start(NXP_LIVENESS_TEST_PENDING);
+  phNxpNciHal_livenessStatsGet(&stats);
+  int ms = WaitHang(startUs, stats.dwBoundMs + NXP_LIVENESS_TEST_SLACK_MS);
+  ASSERT_GE(ms, 0) << "no hang detected";
+  EXPECT_GE(ms, NXP_LIVENESS_TEST_IDLE_MS + PH_NXP_LIVENESS_MIN_STALL_MS);
+  EXPECT_EQ(sProbes.load(), 0u) << "pending command probed";
+}
+
+TEST_F(NxpLivenessTest, RecordOfThisBootTakenBack) {
+  phNxpNciHal_LivenessStats_t before, after;
+
+  ASSERT_NO_FATAL_FAILURE(RecordHang());
+  phNxpNciHal_livenessStatsGet(&before);
+  Start(NXP_LIVENESS_TEST_HEALTHY);
+  phNxpNciHal_livenessStop();
+  phNxpNciHal_livenessStatsGet(&after);
+  EXPECT_EQ(after.dwRecoveries, before.dwRecoveries + 1);
+  EXPECT_NE(access(PH_NXP_LIVENESS_FILE, F_OK), 0)
+      << "record kept once taken back";
+}
+
+TEST_F(NxpLivenessTest, RecordOfAnotherBootDropped) {
+  static const char other_boot[] = "00000000-0000-0000-0000-000000000000";
+  phNxpNciHal_LivenessStats_t before, after;
+  int fd;
+
+  ASSERT_NO_FATAL_FAILURE(RecordHang());
+  fd = open(PH_NXP_LIVENESS_FILE, O_WRONLY | O_CLOEXEC);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(pwrite(fd, other_boot, strlen(other_boot),
+                   NXP_LIVENESS_TEST_BOOT_ID_OFFSET),
+            (ssize_t)strlen(other_boot));
+  close(fd);
+  phNxpNciHal_livenessStatsGet(&before);
+  Start(NXP_LIVENESS_TEST_HEALTHY);
+  phNxpNciHal_livenessStop();
+  phNxpNciHal_livenessStatsGet(&after);
+  EXPECT_EQ(after.dwRecoveries, before.dwRecoveries);
+}
+
+TEST_F(NxpLivenessTest, BoundCoversTheCommandTimeouts) {
+  phNxpNciHal_LivenessStats_t stats;
+
+  Start(NXP_LIVENESS_TEST_HEALTHY);
+  phNxpNciHal_livenessStatsGet(&stats);
+  EXPECT_GE(stats.dwBoundMs, (uint32_t)(NXP_LIVENESS_TEST_IDLE_MS +
+                                        PH_NXP_LIVENESS_MIN_STALL_MS));
+}
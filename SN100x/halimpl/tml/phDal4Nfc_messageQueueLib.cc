@@ -25,20 +25,77 @@
 #include <phNxpLog.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <time.h>
 
 typedef struct phDal4Nfc_message_queue_item {
   phLibNfc_Message_t nMsg;
+  uint64_t qwQueuedNs;
   struct phDal4Nfc_message_queue_item* pPrev;
   struct phDal4Nfc_message_queue_item* pNext;
 } phDal4Nfc_message_queue_item_t;
 
-typedef struct phDal4Nfc_message_queue {
+typedef struct phDal4Nfc_message_queue_lane {
   phDal4Nfc_message_queue_item_t* pItems;
+  phDal4Nfc_message_queue_item_t* pLast;
+} phDal4Nfc_message_queue_lane_t;
+
+typedef struct phDal4Nfc_message_queue {
+  phDal4Nfc_message_queue_lane_t tLanes[PH_DAL4NFC_MSGQ_LANE_MAX];
   pthread_mutex_t nCriticalSectionMutex;
   sem_t nProcessSemaphore;
-
+  /* high lane messages received in a row while the low lane was not empty */
+  uint32_t dwHighBurst;
+  phDal4Nfc_MsgQStats_t tStats;
 } phDal4Nfc_message_queue_t;
 
+/*******************************************************************************
+**
+** Function         phDal4Nfc_msgNow
+**
+** Description      Reads the monotonic clock
+**
+** Returns          Time in ns
+**
+*******************************************************************************/
+static uint64_t phDal4Nfc_msgNow(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*******************************************************************************
+**
+** Function         phDal4Nfc_msgPickLane
+**
+** Description      Selects the lane of the next message: the high lane
+**                  first, unless the oldest low lane message waited too long
+**                  or too many high lane messages were received ahead of it.
+**                  Called with the queue locked.
+**
+** Returns          Lane, PH_DAL4NFC_MSGQ_LANE_MAX if the queue is empty
+**
+*******************************************************************************/
+static int phDal4Nfc_msgPickLane(phDal4Nfc_message_queue_t* pQueue,
+                                 uint64_t qwNowNs) {
+  phDal4Nfc_message_queue_item_t* pLow =
+      pQueue->tLanes[PH_DAL4NFC_MSGQ_LANE_LOW].pItems;
+
+  if (pQueue->tLanes[PH_DAL4NFC_MSGQ_LANE_HIGH].pItems == NULL) {
+    return (pLow != NULL) ? PH_DAL4NFC_MSGQ_LANE_LOW
+                          : PH_DAL4NFC_MSGQ_LANE_MAX;
+  }
+  if (pLow == NULL) return PH_DAL4NFC_MSGQ_LANE_HIGH;
+  if ((pQueue->dwHighBurst >= PH_DAL4NFC_MSGQ_HIGH_BURST) ||
+      (qwNowNs - pLow->qwQueuedNs >=
+       PH_DAL4NFC_MSGQ_LOW_MAX_WAIT_MS * 1000000ULL)) {
+    pQueue->tStats.tLane[PH_DAL4NFC_MSGQ_LANE_LOW].dwAged++;
+    return PH_DAL4NFC_MSGQ_LANE_LOW;
+  }
+  pQueue->dwHighBurst++;
+  return PH_DAL4NFC_MSGQ_LANE_HIGH;
+}
+
 /*******************************************************************************
 **
 ** Function         phDal4Nfc_msgget
@@ -122,19 +179,14 @@ int phDal4Nfc_msgctl(intptr_t msqid, int cmd, void* buf) {
 
   pQueue = (phDal4Nfc_message_queue_t*)msqid;
   pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
-  if (pQueue->pItems != NULL) {
-    p = pQueue->pItems;
-    while (p->pNext != NULL) {
-      p = p->pNext;
+  for (int lane = 0; lane < PH_DAL4NFC_MSGQ_LANE_MAX; lane++) {
+    while (pQueue->tLanes[lane].pItems != NULL) {
+      p = pQueue->tLanes[lane].pItems;
+      pQueue->tLanes[lane].pItems = p->pNext;
+      free(p);
     }
-    while (p->pPrev != NULL) {
-      p = p->pPrev;
-      free(p->pNext);
-      p->pNext = NULL;
-    }
-    free(p);
+    pQueue->tLanes[lane].pLast = NULL;
   }
-  pQueue->pItems = NULL;
   pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
   pthread_mutex_destroy(&pQueue->nCriticalSectionMutex);
   free(pQueue);
@@ -147,12 +199,12 @@ int phDal4Nfc_msgctl(intptr_t msqid, int cmd, void* buf) {
 ** Function         phDal4Nfc_msgsnd
 **
 ** Description      Sends a message to the queue. The message will be added at
-**                  the end of the queue as appropriate for FIFO policy
+**                  the end of its lane as appropriate for FIFO policy
 **
 ** Parameters       msqid  - message queue handle
 **                  msgp   - message to be sent
 **                  msgsz  - message size
-**                  msgflg - ignored
+**                  msgflg - PH_DAL4NFC_MSG_PRIO_HIGH for the high lane
 **
 ** Returns          0,  if successful
 **                  -1, if invalid parameter passed or failed to allocate memory
@@ -160,28 +212,34 @@ int phDal4Nfc_msgctl(intptr_t msqid, int cmd, void* buf) {
 *******************************************************************************/
 intptr_t phDal4Nfc_msgsnd(intptr_t msqid, phLibNfc_Message_t* msg, int msgflg) {
   phDal4Nfc_message_queue_t* pQueue;
-  phDal4Nfc_message_queue_item_t* p;
+  phDal4Nfc_message_queue_lane_t* pLane;
+  phDal4Nfc_MsgQLaneStats_t* pStats;
   phDal4Nfc_message_queue_item_t* pNew;
-  UNUSED_PROP(msgflg);
+  int lane;
   if ((msqid == 0) || (msg == NULL)) return -1;
 
   pQueue = (phDal4Nfc_message_queue_t*)msqid;
+  lane = (msgflg & PH_DAL4NFC_MSG_PRIO_HIGH) ? PH_DAL4NFC_MSGQ_LANE_HIGH
+                                             : PH_DAL4NFC_MSGQ_LANE_LOW;
   pNew = (phDal4Nfc_message_queue_item_t*)malloc(
       sizeof(phDal4Nfc_message_queue_item_t));
   if (pNew == NULL) return -1;
   memset(pNew, 0, sizeof(phDal4Nfc_message_queue_item_t));
   memcpy(&pNew->nMsg, msg, sizeof(phLibNfc_Message_t));
+  pNew->qwQueuedNs = phDal4Nfc_msgNow();
   pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
 
-  if (pQueue->pItems != NULL) {
-    p = pQueue->pItems;
-    while (p->pNext != NULL) {
-      p = p->pNext;
-    }
-    p->pNext = pNew;
-    pNew->pPrev = p;
+  pLane = &pQueue->tLanes[lane];
+  if (pLane->pLast != NULL) {
+    pLane->pLast->pNext = pNew;
+    pNew->pPrev = pLane->pLast;
   } else {
-    pQueue->pItems = pNew;
+    pLane->pItems = pNew;
+  }
+  pLane->pLast = pNew;
+  pStats = &pQueue->tStats.tLane[lane];
+  if (++pStats->dwDepth > pStats->dwMaxDepth) {
+    pStats->dwMaxDepth = pStats->dwDepth;
   }
   pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
 
@@ -194,7 +252,8 @@ intptr_t phDal4Nfc_msgsnd(intptr_t msqid, phLibNfc_Message_t* msg, int msgflg) {
 **
 ** Function         phDal4Nfc_msgrcv
 **
-** Description      Gets the oldest message from the queue.
+** Description      Gets the oldest message of the high lane, else of the low
+**                  lane, see phDal4Nfc_msgPickLane.
 **                  If the queue is empty the function waits (blocks on a mutex)
 **                  until a message is posted to the queue with phDal4Nfc_msgsnd
 **
@@ -211,7 +270,11 @@ intptr_t phDal4Nfc_msgsnd(intptr_t msqid, phLibNfc_Message_t* msg, int msgflg) {
 int phDal4Nfc_msgrcv(intptr_t msqid, phLibNfc_Message_t* msg, long msgtyp,
                      int msgflg) {
   phDal4Nfc_message_queue_t* pQueue;
+  phDal4Nfc_message_queue_lane_t* pLane;
+  phDal4Nfc_MsgQLaneStats_t* pStats;
   phDal4Nfc_message_queue_item_t* p;
+  uint64_t qwNowNs, qwWaitNs;
+  int lane;
   UNUSED_PROP(msgflg);
   UNUSED_PROP(msgtyp);
   if ((msqid == 0) || (msg == NULL)) return -1;
@@ -224,13 +287,56 @@ int phDal4Nfc_msgrcv(intptr_t msqid, phLibNfc_Message_t* msg, long msgtyp,
 
   pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
 
-  if (pQueue->pItems != NULL) {
-    memcpy(msg, &(pQueue->pItems)->nMsg, sizeof(phLibNfc_Message_t));
-    p = pQueue->pItems->pNext;
-    free(pQueue->pItems);
-    pQueue->pItems = p;
+  qwNowNs = phDal4Nfc_msgNow();
+  lane = phDal4Nfc_msgPickLane(pQueue, qwNowNs);
+  if (lane != PH_DAL4NFC_MSGQ_LANE_MAX) {
+    pLane = &pQueue->tLanes[lane];
+    p = pLane->pItems;
+    memcpy(msg, &p->nMsg, sizeof(phLibNfc_Message_t));
+    pLane->pItems = p->pNext;
+    if (pLane->pItems != NULL) {
+      pLane->pItems->pPrev = NULL;
+    } else {
+      pLane->pLast = NULL;
+    }
+    if ((lane == PH_DAL4NFC_MSGQ_LANE_LOW) ||
+        (pQueue->tLanes[PH_DAL4NFC_MSGQ_LANE_LOW].pItems == NULL)) {
+      pQueue->dwHighBurst = 0;
+    }
+    qwWaitNs = qwNowNs - p->qwQueuedNs;
+    pStats = &pQueue->tStats.tLane[lane];
+    pStats->dwDepth--;
+    pStats->dwCount++;
+    pStats->qwWaitTotalNs += qwWaitNs;
+    if (qwWaitNs > pStats->qwWaitMaxNs) pStats->qwWaitMaxNs = qwWaitNs;
+    free(p);
   }
   pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
 
   return 0;
 }
+
+/*******************************************************************************
+**
+** Function         phDal4Nfc_msgstats
+**
+** Description      Copies the depth and wait time statistics of the lanes
+**
+** Parameters       msqid  - message queue handle
+**                  pStats - filled
+**
+** Returns          0,  if successful
+**                  -1, if invalid parameter passed
+**
+*******************************************************************************/
+int phDal4Nfc_msgstats(intptr_t msqid, phDal4Nfc_MsgQStats_t* pStats) {
+  phDal4Nfc_message_queue_t* pQueue;
+  if ((msqid == 0) || (pStats == NULL)) return -1;
+
+  pQueue = (phDal4Nfc_message_queue_t*)msqid;
+  pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
+  *pStats = pQueue->tStats;
+  pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
+
+  return 0;
+}
@@ -24,11 +24,43 @@
 #include <linux/ipc.h>
 #include <phNfcTypes.h>
 
+/* msgflg of phDal4Nfc_msgsnd: RF critical message, received ahead of the
+ * other ones */
+#define PH_DAL4NFC_MSG_PRIO_HIGH 0x01
+
+/* Lanes of the queue, in receive order */
+typedef enum {
+  PH_DAL4NFC_MSGQ_LANE_HIGH = 0x00,
+  PH_DAL4NFC_MSGQ_LANE_LOW,
+  PH_DAL4NFC_MSGQ_LANE_MAX
+} phDal4Nfc_MsgQLane_t;
+
+/* A low lane message is received after at most this many high lane ones
+ * received in a row while it waited, */
+#define PH_DAL4NFC_MSGQ_HIGH_BURST 8
+/* or once it waited this long */
+#define PH_DAL4NFC_MSGQ_LOW_MAX_WAIT_MS 20
+
+typedef struct {
+  uint32_t dwDepth;    /* queued now */
+  uint32_t dwMaxDepth;
+  uint32_t dwCount;    /* received */
+  uint32_t dwAged;     /* low lane: received ahead of high lane ones */
+  uint64_t qwWaitTotalNs;
+  uint64_t qwWaitMaxNs;
+} phDal4Nfc_MsgQLaneStats_t;
+
+/* Returned by HAL_NFC_IOCTL_GET_MSGQ_STATS */
+typedef struct {
+  phDal4Nfc_MsgQLaneStats_t tLane[PH_DAL4NFC_MSGQ_LANE_MAX];
+} phDal4Nfc_MsgQStats_t;
+
 intptr_t phDal4Nfc_msgget(key_t key, int msgflg);
 void phDal4Nfc_msgrelease(intptr_t msqid);
 int phDal4Nfc_msgctl(intptr_t msqid, int cmd, void* buf);
 intptr_t phDal4Nfc_msgsnd(intptr_t msqid, phLibNfc_Message_t* msg, int msgflg);
 int phDal4Nfc_msgrcv(intptr_t msqid, phLibNfc_Message_t* msg, long msgtyp,
                      int msgflg);
+int phDal4Nfc_msgstats(intptr_t msqid, phDal4Nfc_MsgQStats_t* pStats);
 
 #endif /*  PHDAL4NFC_MESSAGEQUEUE_H  */
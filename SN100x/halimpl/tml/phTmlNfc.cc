@@ -24,19 +24,36 @@
 #include "NfccTransportFactory.h"
 #include <phDal4Nfc_messageQueueLib.h>
 #include <phNxpLog.h>
+#include <phNxpNciHal_LatencyStats.h>
+#include <phNxpNciHal_ThreadPolicy.h>
 #include <phNxpNciHal_utils.h>
 #include <phOsalNfc_Timer.h>
 #include <phTmlNfc.h>
+#include <phTmlNfc_Rtt.h>
+#include <phTmlNfc_Trace.h>
 #include "phNxpConfig.h"
+#include <atomic>
 
 /*
- * Duration of Timer to wait after sending an Nci packet
+ * Duration of Timer to wait after sending an Nci packet is derived from the
+ * measured response time, see phTmlNfc_Rtt.h
  */
-#define PHTMLNFC_MAXTIME_RETRANSMIT (200U)
 #define MAX_WRITE_RETRY_COUNT 0x03
-#define MAX_READ_RETRY_DELAY_IN_MILLISEC (150U)
-/* Retry Count = Standby Recovery time of NFCC / Retransmission time + 1 */
-static uint8_t bCurrentRetryCount = (2000 / PHTMLNFC_MAXTIME_RETRANSMIT) + 1;
+/* Retry Count = Standby Recovery time of NFCC / Min Retransmission time + 1,
+ * retransmission also stops once the recovery time is elapsed */
+#define PHTMLNFC_DEFAULT_RETRY_COUNT \
+  ((PH_TMLNFC_RTT_STANDBY_RECOVERY_MS / PH_TMLNFC_RTT_MIN_RTO_MS) + 1)
+static uint8_t bCurrentRetryCount = PHTMLNFC_DEFAULT_RETRY_COUNT;
+
+/* Time VEN is kept low for the NFCC to power off on a device reset */
+#define PHTMLNFC_VEN_LOW_HOLD_MS (100U)
+/* Time VEN is kept low when leaving download mode */
+#define PHTMLNFC_VEN_LOW_HOLD_DNLD_MS (10U)
+/* Worst case time for the NFCC to be ready once VEN is high */
+#define PHTMLNFC_VEN_READY_MAX_MS (100U)
+/* Interval at which readiness is checked when the transport cannot wait for
+ * the NFCC IRQ */
+#define PHTMLNFC_VEN_READY_POLL_MS (5U)
 
 /* Value to reset variables of TML  */
 #define PH_TMLNFC_RESET_VALUE (0x00)
@@ -47,12 +64,24 @@ static uint8_t bCurrentRetryCount = (2000 / PHTMLNFC_MAXTIME_RETRANSMIT) + 1;
 spTransport gpTransportObj;
 extern bool_t gsIsFirstHalMinOpen;
 
+/* Packets read from the NFCC, used to confirm it is up after VEN toggle */
+static std::atomic<uint32_t> sRxPktCount(0);
+/* Last VEN transition done by TML */
+static bool sVenHigh = false;
+static uint64_t sVenHighTimeUs = 0;
+static uint32_t sVenHighRxPktCount = 0;
+static phTmlNfc_PowerTiming_t sPowerTiming[phTmlNfc_e_PwrMax];
+static pthread_mutex_t sPowerTimingLock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Initialize Context structure pointer used to access context structure */
 phTmlNfc_Context_t* gpphTmlNfc_Context = NULL;
 /* Local Function prototypes */
 static NFCSTATUS phTmlNfc_StartThread(void);
 static void phTmlNfc_ReadDeferredCb(void* pParams);
 static void phTmlNfc_WriteDeferredCb(void* pParams);
+static void phTmlNfc_PostMsg(phLibNfc_Message_t* ptWorkerMsg, int msgflg);
+static int phTmlNfc_RxMsgFlag(const uint8_t* pBuff, uint16_t wLength);
+static int phTmlNfc_TxMsgFlag(void);
 static void * phTmlNfc_TmlThread(void* pParam);
 static void * phTmlNfc_TmlWriterThread(void* pParam);
 static void phTmlNfc_ReTxTimerCb(uint32_t dwTimerId, void* pContext);
@@ -60,6 +89,11 @@ static NFCSTATUS phTmlNfc_InitiateTimer(void);
 static void phTmlNfc_WaitWriteComplete(void);
 static void phTmlNfc_SignalWriteComplete(void);
 static int phTmlNfc_WaitReadInit(void);
+static uint64_t phTmlNfc_GetTimeUs(void);
+static void phTmlNfc_SetVen(NfccResetType eType);
+static bool phTmlNfc_WaitVenReady(void);
+static void phTmlNfc_RecordPowerTiming(phTmlNfc_PowerTransition_t eTransition,
+                                       uint64_t qwStartUs, bool bConfirmed);
 
 /* Function definitions */
 
@@ -127,6 +161,10 @@ NFCSTATUS phTmlNfc_Init(pphTmlNfc_Config_t pConfig) {
         wInitStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_INVALID_DEVICE);
         gpphTmlNfc_Context->pDevHandle = NULL;
       } else {
+        /* Transport leaves VEN high once the device is opened */
+        sVenHigh = true;
+        sVenHighTimeUs = phTmlNfc_GetTimeUs();
+        sVenHighRxPktCount = sRxPktCount;
         gpphTmlNfc_Context->tReadInfo.bEnable = 0;
         gpphTmlNfc_Context->tWriteInfo.bEnable = 0;
         gpphTmlNfc_Context->tReadInfo.bThreadBusy = false;
@@ -155,10 +193,7 @@ NFCSTATUS phTmlNfc_Init(pphTmlNfc_Config_t pConfig) {
               /* Enable retransmission of Nci packet & set retry count to
                * default */
               gpphTmlNfc_Context->eConfig = phTmlNfc_e_DisableRetrans;
-              /* Retry Count = Standby Recovery time of NFCC / Retransmission
-               * time + 1 */
-              gpphTmlNfc_Context->bRetryCount =
-                  (2000 / PHTMLNFC_MAXTIME_RETRANSMIT) + 1;
+              gpphTmlNfc_Context->bRetryCount = PHTMLNFC_DEFAULT_RETRY_COUNT;
               gpphTmlNfc_Context->bWriteCbInvoked = false;
             } else {
               wInitStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_FAILED);
@@ -230,16 +265,33 @@ void phTmlNfc_ConfigNciPktReTx(phTmlNfc_ConfigRetrans_t eConfiguration,
     }
     /* Set retry counter to its default value */
     else {
-      /* Retry Count = Standby Recovery time of NFCC / Retransmission time + 1
-       */
-      gpphTmlNfc_Context->bRetryCount =
-          (2000 / PHTMLNFC_MAXTIME_RETRANSMIT) + 1;
+      gpphTmlNfc_Context->bRetryCount = PHTMLNFC_DEFAULT_RETRY_COUNT;
     }
   }
 
   return;
 }
 
+/*******************************************************************************
+**
+** Function         phTmlNfc_MayRetransmit
+**
+** Description      Tells whether TML may send the packet again after its write
+**                  has completed, i.e. retransmission is enabled and the packet
+**                  is an NCI control packet. Such a buffer must stay valid
+**                  until the next phTmlNfc_Write.
+**
+** Parameters       pBuffer - packet to be written
+**
+** Returns          true if TML may reuse pBuffer after the write completes
+**
+*******************************************************************************/
+bool phTmlNfc_MayRetransmit(const uint8_t* pBuffer) {
+  return (NULL != gpphTmlNfc_Context) &&
+         (phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) &&
+         (0x00 != (pBuffer[0] & 0xE0));
+}
+
 /*******************************************************************************
 **
 ** Function         phTmlNfc_StartThread
@@ -293,9 +345,10 @@ static void phTmlNfc_ReTxTimerCb(uint32_t dwTimerId, void* pContext) {
   if ((gpphTmlNfc_Context->dwTimerId == dwTimerId) && (NULL == pContext)) {
     /* If Retry Count has reached its limit,Retransmit Nci
        packet */
-    if (0 == bCurrentRetryCount) {
+    if ((0 == bCurrentRetryCount) || phTmlNfc_RttIsRecoveryElapsed()) {
       /* Since the count has reached its limit,return from timer callback
          Upper layer Timeout would have happened */
+      bCurrentRetryCount = 0;
     } else {
       bCurrentRetryCount--;
       gpphTmlNfc_Context->tWriteInfo.bThreadBusy = true;
@@ -323,7 +376,7 @@ static NFCSTATUS phTmlNfc_InitiateTimer(void) {
 
   /* Start Timer once Nci packet is sent */
   wStatus = phOsalNfc_Timer_Start(gpphTmlNfc_Context->dwTimerId,
-                                  (uint32_t)PHTMLNFC_MAXTIME_RETRANSMIT,
+                                  phTmlNfc_RttGetRetransTimeout(),
                                   phTmlNfc_ReTxTimerCb, NULL);
 
   return wStatus;
@@ -344,7 +397,7 @@ static void * phTmlNfc_TmlThread(void* pParam) {
   NFCSTATUS wStatus = NFCSTATUS_SUCCESS;
   int32_t dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
   uint8_t temp[260];
-  uint8_t readRetryDelay = 0;
+  uint32_t readRetryDelay = 0;
   /* Transaction info buffer to be passed to Callback Thread */
   static phTmlNfc_TransactInfo_t tTransactionInfo;
   /* Structure containing Tml callback function and parameters to be invoked
@@ -354,13 +407,15 @@ static void * phTmlNfc_TmlThread(void* pParam) {
   static phLibNfc_Message_t tMsg;
   UNUSED_PROP(pParam);
   NXPLOG_TML_D("PN54X - Tml Reader Thread Started................\n");
+  phNxpNciHal_threadPolicyApply(PH_NXP_THREAD_TML_READ);
 
   /* Writer thread loop shall be running till shutdown is invoked */
   while (gpphTmlNfc_Context->bThreadDone) {
     /* If Tml write is requested */
     /* Set the variable to success initially */
     wStatus = NFCSTATUS_SUCCESS;
-    if (-1 == sem_wait(&gpphTmlNfc_Context->rxSemaphore)) {
+    if (-1 == phNxpNciHal_lockStatsSemWait(PH_NXP_LOCK_SITE_TML_RX_SEM,
+                                           &gpphTmlNfc_Context->rxSemaphore)) {
       NXPLOG_TML_E("sem_wait didn't return success \n");
     }
 
@@ -381,10 +436,8 @@ static void * phTmlNfc_TmlThread(void* pParam) {
 
         if (-1 == dwNoBytesWrRd) {
           NXPLOG_TML_E("PN54X - Error in I2C Read.....\n");
-          if (readRetryDelay < MAX_READ_RETRY_DELAY_IN_MILLISEC) {
-            /*sleep for 30/60/90/120/150 msec between each read trial incase of read error*/
-            readRetryDelay += 30 ;
-          }
+          /* back off from the NFCC response time, doubled on each error */
+          readRetryDelay = phTmlNfc_RttGetReadBackoff(readRetryDelay);
           usleep(readRetryDelay * 1000);
           sem_post(&gpphTmlNfc_Context->rxSemaphore);
         } else if (dwNoBytesWrRd > 260) {
@@ -392,10 +445,15 @@ static void * phTmlNfc_TmlThread(void* pParam) {
           readRetryDelay = 0;
           sem_post(&gpphTmlNfc_Context->rxSemaphore);
         } else {
+          tTransactionInfo.qwRxTimeUs = phNxpNciHal_latencyNowUs();
           memcpy(gpphTmlNfc_Context->tReadInfo.pBuffer, temp, dwNoBytesWrRd);
           readRetryDelay =0;
 
           NXPLOG_TML_D("PN54X - I2C Read successful.....\n");
+          sRxPktCount++;
+          if (!gpTransportObj->IsFwDnldModeEnabled()) {
+            phTmlNfc_RttOnRx(temp, (uint16_t)dwNoBytesWrRd);
+          }
           /* This has to be reset only after a successful read */
           gpphTmlNfc_Context->tReadInfo.bEnable = 0;
           if ((phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) &&
@@ -419,6 +477,9 @@ static void * phTmlNfc_TmlThread(void* pParam) {
           phNxpNciHal_print_packet("RECV",
                                    gpphTmlNfc_Context->tReadInfo.pBuffer,
                                    gpphTmlNfc_Context->tReadInfo.wLength);
+          phTmlNfc_TraceRecord(PH_TMLNFC_TRACE_RX,
+                               gpphTmlNfc_Context->tReadInfo.pBuffer,
+                               gpphTmlNfc_Context->tReadInfo.wLength);
 
           dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
 
@@ -440,7 +501,8 @@ static void * phTmlNfc_TmlThread(void* pParam) {
           /*Don't wait for posting notifications. Only wait for posting
            * responses*/
           /*TML reader writer callback syncronization-- START*/
-          pthread_mutex_lock(&gpphTmlNfc_Context->wait_busy_lock);
+          phNxpNciHal_lockStatsMutexLock(PH_NXP_LOCK_SITE_TML_BUSY_LOCK,
+                                         &gpphTmlNfc_Context->wait_busy_lock);
           if ((gpphTmlNfc_Context->gWriterCbflag == false) &&
               ((gpphTmlNfc_Context->tReadInfo.pBuffer[0] & 0x60) != 0x60)) {
             phTmlNfc_WaitWriteComplete();
@@ -448,7 +510,9 @@ static void * phTmlNfc_TmlThread(void* pParam) {
           /*TML reader writer callback syncronization-- END*/
           pthread_mutex_unlock(&gpphTmlNfc_Context->wait_busy_lock);
           NXPLOG_TML_D("PN54X - Posting read message.....\n");
-          phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId, &tMsg);
+          phTmlNfc_PostMsg(&tMsg,
+                           phTmlNfc_RxMsgFlag(tTransactionInfo.pBuff,
+                                              tTransactionInfo.wLength));
         }
       } else {
         NXPLOG_TML_D("PN54X -gpphTmlNfc_Context->pDevHandle is NULL");
@@ -487,11 +551,13 @@ static void * phTmlNfc_TmlWriterThread(void* pParam) {
   static uint16_t retry_cnt;
   UNUSED_PROP(pParam);
   NXPLOG_TML_D("PN54X - Tml Writer Thread Started................\n");
+  phNxpNciHal_threadPolicyApply(PH_NXP_THREAD_TML_WRITE);
 
   /* Writer thread loop shall be running till shutdown is invoked */
   while (gpphTmlNfc_Context->bThreadDone) {
     NXPLOG_TML_D("PN54X - Tml Writer Thread Running................\n");
-    if (-1 == sem_wait(&gpphTmlNfc_Context->txSemaphore)) {
+    if (-1 == phNxpNciHal_lockStatsSemWait(PH_NXP_LOCK_SITE_TML_TX_SEM,
+                                           &gpphTmlNfc_Context->txSemaphore)) {
       NXPLOG_TML_E("sem_wait didn't return success \n");
     }
     /* If Tml write is requested */
@@ -507,7 +573,8 @@ static void * phTmlNfc_TmlWriterThread(void* pParam) {
         /* Write the data in the buffer onto the file */
         NXPLOG_TML_D("PN54X - Invoking I2C Write.....\n");
         /* TML reader writer callback synchronization mutex lock --- START */
-        pthread_mutex_lock(&gpphTmlNfc_Context->wait_busy_lock);
+        phNxpNciHal_lockStatsMutexLock(PH_NXP_LOCK_SITE_TML_BUSY_LOCK,
+                                       &gpphTmlNfc_Context->wait_busy_lock);
         gpphTmlNfc_Context->gWriterCbflag = false;
         dwNoBytesWrRd = gpTransportObj->Write(gpphTmlNfc_Context->pDevHandle,
                                         gpphTmlNfc_Context->tWriteInfo.pBuffer,
@@ -532,6 +599,13 @@ static void * phTmlNfc_TmlWriterThread(void* pParam) {
           phNxpNciHal_print_packet("SEND",
                                    gpphTmlNfc_Context->tWriteInfo.pBuffer,
                                    gpphTmlNfc_Context->tWriteInfo.wLength);
+          phTmlNfc_TraceRecord(PH_TMLNFC_TRACE_TX,
+                               gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                               gpphTmlNfc_Context->tWriteInfo.wLength);
+          if (!gpTransportObj->IsFwDnldModeEnabled()) {
+            phTmlNfc_RttOnTx(gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                             gpphTmlNfc_Context->tWriteInfo.wLength);
+          }
         }
         retry_cnt = 0;
         if (NFCSTATUS_SUCCESS == wStatus) {
@@ -541,7 +615,8 @@ static void * phTmlNfc_TmlWriterThread(void* pParam) {
         /* Fill the Transaction info structure to be passed to Callback Function
          */
         tTransactionInfo.wStatus = wStatus;
-        tTransactionInfo.pBuff = gpphTmlNfc_Context->tWriteInfo.pBuffer;
+        /* Write completions carry no buffer, it stays owned by the caller */
+        tTransactionInfo.pBuff = NULL;
         /* Actual number of bytes written is filled in the structure */
         tTransactionInfo.wLength = (uint16_t)dwNoBytesWrRd;
 
@@ -565,17 +640,17 @@ static void * phTmlNfc_TmlWriterThread(void* pParam) {
           if (false == gpphTmlNfc_Context->bWriteCbInvoked) {
             if ((NFCSTATUS_SUCCESS == wStatus) || (bCurrentRetryCount == 0)) {
               NXPLOG_TML_D("PN54X - Posting Write message.....\n");
-              phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId,
-                                    &tMsg);
+              phTmlNfc_PostMsg(&tMsg, phTmlNfc_TxMsgFlag());
               gpphTmlNfc_Context->bWriteCbInvoked = true;
             }
           }
         } else {
           NXPLOG_TML_D("PN54X - Posting Fresh Write message.....\n");
-          phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId, &tMsg);
+          phTmlNfc_PostMsg(&tMsg, phTmlNfc_TxMsgFlag());
           if (NFCSTATUS_SUCCESS == wStatus) {
             /*TML reader writer thread callback syncronization---START*/
-            pthread_mutex_lock(&gpphTmlNfc_Context->wait_busy_lock);
+            phNxpNciHal_lockStatsMutexLock(PH_NXP_LOCK_SITE_TML_BUSY_LOCK,
+                                           &gpphTmlNfc_Context->wait_busy_lock);
             gpphTmlNfc_Context->gWriterCbflag = true;
             phTmlNfc_SignalWriteComplete();
             /*TML reader writer thread callback syncronization---END*/
@@ -659,18 +734,15 @@ NFCSTATUS phTmlNfc_Shutdown(void) {
 
   /* Check whether TML is Initialized */
   if (NULL != gpphTmlNfc_Context) {
+    uint64_t qwStartUs = phTmlNfc_GetTimeUs();
     /* Reset thread variable to terminate the thread */
     gpphTmlNfc_Context->bThreadDone = 0;
-    usleep(1000);
-    /* Clear All the resources allocated during initialization */
+    /* Clear All the resources allocated during initialization, threads exit
+     * is confirmed by joining them below */
     sem_post(&gpphTmlNfc_Context->rxSemaphore);
-    usleep(1000);
     sem_post(&gpphTmlNfc_Context->txSemaphore);
-    usleep(1000);
     sem_post(&gpphTmlNfc_Context->postMsgSemaphore);
-    usleep(1000);
     sem_post(&gpphTmlNfc_Context->postMsgSemaphore);
-    usleep(1000);
 
     if (NULL != gpphTmlNfc_Context->pDevHandle) {
       if (GetNxpNumValue(NAME_ENABLE_VEN_TOGGLE, &num, sizeof(num))) {
@@ -690,6 +762,9 @@ NFCSTATUS phTmlNfc_Shutdown(void) {
       NXPLOG_TML_E("Fail to kill writer thread!");
     }
     NXPLOG_TML_D("bThreadDone == 0");
+    sVenHigh = false;
+    phTmlNfc_RecordPowerTiming(phTmlNfc_e_PwrShutdown, qwStartUs, true);
+    phTmlNfc_RttLogStats();
 
   } else {
     wShutdownStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_NOT_INITIALISED);
@@ -729,7 +804,7 @@ NFCSTATUS phTmlNfc_Shutdown(void) {
 **                  NFCSTATUS_BUSY - write request is already in progress
 **
 *******************************************************************************/
-NFCSTATUS phTmlNfc_Write(uint8_t* pBuffer, uint16_t wLength,
+NFCSTATUS phTmlNfc_Write(const uint8_t* pBuffer, uint16_t wLength,
                          pphTmlNfc_TransactCompletionCb_t pTmlWriteComplete,
                          void* pContext) {
   NFCSTATUS wWriteStatus;
@@ -749,6 +824,7 @@ NFCSTATUS phTmlNfc_Write(uint8_t* pBuffer, uint16_t wLength,
         gpphTmlNfc_Context->tWriteInfo.wLength = wLength;
         gpphTmlNfc_Context->tWriteInfo.pThread_Callback = pTmlWriteComplete;
         gpphTmlNfc_Context->tWriteInfo.pContext = pContext;
+        phTmlNfc_RttOnCmdQueued();
 
         wWriteStatus = NFCSTATUS_PENDING;
         // FIXME: If retry is going on. Stop the retry thread/timer
@@ -943,11 +1019,15 @@ NFCSTATUS phTmlNfc_IoCtl(phTmlNfc_ControlCode_t eControlCode) {
         if(nfcFL.chipType < sn100u) {
 #endif
            /*Reset PN54X*/
-           gpTransportObj->NfccReset(gpphTmlNfc_Context->pDevHandle, MODE_POWER_ON);
-           usleep(100 * 1000);
-           gpTransportObj->NfccReset(gpphTmlNfc_Context->pDevHandle, MODE_POWER_OFF);
-           usleep(100 * 1000);
-           gpTransportObj->NfccReset(gpphTmlNfc_Context->pDevHandle, MODE_POWER_ON);
+           uint64_t qwStartUs = phTmlNfc_GetTimeUs();
+           bool bReady;
+           phTmlNfc_SetVen(MODE_POWER_ON);
+           bReady = phTmlNfc_WaitVenReady();
+           phTmlNfc_SetVen(MODE_POWER_OFF);
+           usleep(PHTMLNFC_VEN_LOW_HOLD_MS * 1000);
+           phTmlNfc_SetVen(MODE_POWER_ON);
+           phTmlNfc_RecordPowerTiming(phTmlNfc_e_PwrResetDevice, qwStartUs,
+                                      bReady);
 #if(NXP_EXTNS == TRUE)
         }
 #endif
@@ -964,10 +1044,12 @@ NFCSTATUS phTmlNfc_IoCtl(phTmlNfc_ControlCode_t eControlCode) {
         if(nfcFL.nfccFL._NFCC_DWNLD_MODE == NFCC_DWNLD_WITH_VEN_RESET) {
           NXPLOG_TML_D(" phTmlNfc_e_EnableNormalMode complete with VEN RESET ");
           if(nfcFL.chipType < sn100u ){
-            gpTransportObj->NfccReset(gpphTmlNfc_Context->pDevHandle, MODE_POWER_OFF);
-            usleep(10 * 1000);
-            gpTransportObj->NfccReset(gpphTmlNfc_Context->pDevHandle, MODE_POWER_ON);
-            usleep(100 * 1000);
+            uint64_t qwStartUs = phTmlNfc_GetTimeUs();
+            phTmlNfc_SetVen(MODE_POWER_OFF);
+            usleep(PHTMLNFC_VEN_LOW_HOLD_DNLD_MS * 1000);
+            phTmlNfc_SetVen(MODE_POWER_ON);
+            phTmlNfc_RecordPowerTiming(phTmlNfc_e_PwrNormalMode, qwStartUs,
+                                       phTmlNfc_WaitVenReady());
           }else{
             gpTransportObj->NfccReset(gpphTmlNfc_Context->pDevHandle, MODE_FW_GPIO_LOW);
           }
@@ -1037,17 +1119,82 @@ NFCSTATUS phTmlNfc_IoCtl(phTmlNfc_ControlCode_t eControlCode) {
 *******************************************************************************/
 void phTmlNfc_DeferredCall(uintptr_t dwThreadId,
                            phLibNfc_Message_t* ptWorkerMsg) {
-  intptr_t bPostStatus;
   UNUSED_PROP(dwThreadId);
+  phTmlNfc_PostMsg(ptWorkerMsg, 0);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_PostMsg
+**
+** Description      Posts message on upper layer thread, in the lane selected
+**                  by msgflg
+**
+** Parameters       ptWorkerMsg - message to be posted
+**                  msgflg      - flags of phDal4Nfc_msgsnd
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_PostMsg(phLibNfc_Message_t* ptWorkerMsg, int msgflg) {
+  intptr_t bPostStatus;
   /* Post message on the user thread to invoke the callback function */
   if (-1 == sem_wait(&gpphTmlNfc_Context->postMsgSemaphore)) {
     NXPLOG_TML_E("sem_wait didn't return success \n");
   }
-  bPostStatus =
-      phDal4Nfc_msgsnd(gpphTmlNfc_Context->dwCallbackThreadId, ptWorkerMsg, 0);
+  bPostStatus = phDal4Nfc_msgsnd(gpphTmlNfc_Context->dwCallbackThreadId,
+                                 ptWorkerMsg, msgflg);
   sem_post(&gpphTmlNfc_Context->postMsgSemaphore);
 }
 
+/*******************************************************************************
+**
+** Function         phTmlNfc_RxMsgFlag
+**
+** Description      Selects the lane of a received packet: data packets and
+**                  RF_INTF_ACTIVATED / RF_DEACTIVATE notifications go ahead
+**                  of the other messages of the client thread. Reads are
+**                  one at a time, so received packets keep their order.
+**                  Write completions use the same lane, see
+**                  phTmlNfc_TxMsgFlag.
+**
+** Parameters       pBuff   - received packet
+**                  wLength - its length
+**
+** Returns          flags of phDal4Nfc_msgsnd
+**
+*******************************************************************************/
+static int phTmlNfc_RxMsgFlag(const uint8_t* pBuff, uint16_t wLength) {
+  uint8_t oid;
+
+  if ((wLength < 2) || gpTransportObj->IsFwDnldModeEnabled()) return 0;
+  /* MT data */
+  if ((pBuff[0] & 0xE0) == 0x00) return PH_DAL4NFC_MSG_PRIO_HIGH;
+  /* MT notification, GID RF management, any PBF */
+  if ((pBuff[0] & 0xEF) == 0x61) {
+    oid = pBuff[1] & 0x3F;
+    if ((oid == 0x05) || (oid == 0x06)) return PH_DAL4NFC_MSG_PRIO_HIGH;
+  }
+  return 0;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TxMsgFlag
+**
+** Description      Selects the lane of a write completion. A response or data
+**                  packet is posted once the completion of the write before
+**                  it is, see phTmlNfc_WaitWriteComplete; both go in the high
+**                  lane so that a data packet can not overtake it.
+**
+** Returns          flags of phDal4Nfc_msgsnd
+**
+*******************************************************************************/
+static int phTmlNfc_TxMsgFlag(void) {
+  if (gpTransportObj->IsFwDnldModeEnabled()) return 0;
+  return PH_DAL4NFC_MSG_PRIO_HIGH;
+}
+
 /*******************************************************************************
 **
 ** Function         phTmlNfc_ReadDeferredCb
@@ -1115,6 +1262,7 @@ phTmlNfc_i2cfragmentation_t phTmlNfc_get_fragmentation_enabled() {
 *******************************************************************************/
 static void phTmlNfc_WaitWriteComplete(void) {
   int ret = -1;
+  uint64_t qwStart;
   struct timespec absTimeout;
   if (clock_gettime(CLOCK_MONOTONIC, &absTimeout) == -1) {
     NXPLOG_TML_E("Reader Thread clock_gettime failed");
@@ -1122,9 +1270,12 @@ static void phTmlNfc_WaitWriteComplete(void) {
     absTimeout.tv_sec += 1; /*1 second timeout*/
     gpphTmlNfc_Context->wait_busy_flag = true;
     NXPLOG_TML_D("phTmlNfc_WaitWriteComplete - enter");
+    qwStart = phNxpNciHal_lockStatsNow();
     ret = pthread_cond_timedwait(&gpphTmlNfc_Context->wait_busy_condition,
                                  &gpphTmlNfc_Context->wait_busy_lock,
                                  &absTimeout);
+    phNxpNciHal_lockStatsRecordWait(PH_NXP_LOCK_SITE_TML_WRITE_COMPLETE,
+                                    qwStart, (ret == ETIMEDOUT));
     if ((ret != 0) && (ret != ETIMEDOUT)) {
       NXPLOG_TML_E("Reader Thread wait failed");
     }
@@ -1225,3 +1376,147 @@ NFCSTATUS phTmlNfc_Shutdown_CleanUp() {
   phTmlNfc_CleanUp();
   return wShutdownStatus;
 }
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_GetTimeUs
+**
+** Description      CLOCK_MONOTONIC time
+**
+** Returns          time in micro seconds
+**
+*******************************************************************************/
+static uint64_t phTmlNfc_GetTimeUs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_SetVen
+**
+** Description      Drives VEN and keeps track of the time it went high
+**
+** Parameters       eType - MODE_POWER_ON or MODE_POWER_OFF
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_SetVen(NfccResetType eType) {
+  gpTransportObj->NfccReset(gpphTmlNfc_Context->pDevHandle, eType);
+  if (MODE_POWER_OFF == eType) {
+    sVenHigh = false;
+  } else if (!sVenHigh) {
+    sVenHigh = true;
+    sVenHighTimeUs = phTmlNfc_GetTimeUs();
+    sVenHighRxPktCount = sRxPktCount;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_WaitVenReady
+**
+** Description      Waits until the NFCC is up after VEN went high. The NFCC
+**                  is up once it signals data (CORE_RESET_NTF or download
+**                  mode response) or once PHTMLNFC_VEN_READY_MAX_MS is
+**                  elapsed since VEN went high, which returns at once when
+**                  VEN was already high.
+**                  The IRQ is only trusted once a poll timed out: a driver
+**                  without poll support reports the device readable at once,
+**                  as does an IRQ left asserted from before the toggle. The
+**                  full delay is then waited, unless a packet is read.
+**
+** Parameters       None
+**
+** Returns          true if the NFCC signalled data, false if the worst case
+**                  delay was waited
+**
+*******************************************************************************/
+static bool phTmlNfc_WaitVenReady(void) {
+  uint64_t qwDeadlineUs =
+      sVenHighTimeUs + (uint64_t)PHTMLNFC_VEN_READY_MAX_MS * 1000;
+  uint64_t qwNowUs = phTmlNfc_GetTimeUs();
+  uint32_t dwWaitMs;
+  bool bPollBlocked = false;
+  bool bPollUsable = true;
+  int ret;
+
+  while (qwNowUs < qwDeadlineUs) {
+    /* Reader thread may have consumed the data already */
+    if (sRxPktCount != sVenHighRxPktCount) {
+      return true;
+    }
+    dwWaitMs = (uint32_t)((qwDeadlineUs - qwNowUs + 999) / 1000);
+    if (dwWaitMs > PHTMLNFC_VEN_READY_POLL_MS) {
+      dwWaitMs = PHTMLNFC_VEN_READY_POLL_MS;
+    }
+    ret = bPollUsable ? gpTransportObj->WaitForData(
+                            gpphTmlNfc_Context->pDevHandle, (int)dwWaitMs)
+                      : -1;
+    if (ret == 0) {
+      bPollBlocked = true;
+    } else if ((ret > 0) && bPollBlocked) {
+      return true;
+    } else {
+      if (ret > 0) {
+        NXPLOG_TML_D("%s: device readable at once, wait full delay",
+                     __func__);
+      }
+      bPollUsable = false;
+      usleep(dwWaitMs * 1000);
+    }
+    qwNowUs = phTmlNfc_GetTimeUs();
+  }
+  return false;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RecordPowerTiming
+**
+** Description      Accounts the duration of a NFCC power transition
+**
+** Parameters       eTransition - phTmlNfc_PowerTransition_t
+**                  qwStartUs   - start of the transition
+**                  bConfirmed  - false if the worst case delay was waited
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_RecordPowerTiming(phTmlNfc_PowerTransition_t eTransition,
+                                       uint64_t qwStartUs, bool bConfirmed) {
+  uint32_t dwDurationUs = (uint32_t)(phTmlNfc_GetTimeUs() - qwStartUs);
+  phTmlNfc_PowerTiming_t* pTiming = &sPowerTiming[eTransition];
+
+  pthread_mutex_lock(&sPowerTimingLock);
+  pTiming->dwCount++;
+  if (!bConfirmed) pTiming->dwTimeouts++;
+  pTiming->dwLastUs = dwDurationUs;
+  if (dwDurationUs > pTiming->dwMaxUs) pTiming->dwMaxUs = dwDurationUs;
+  pthread_mutex_unlock(&sPowerTimingLock);
+  NXPLOG_TML_D("Power transition %d done in %u us%s", eTransition,
+               dwDurationUs, bConfirmed ? "" : " (not confirmed)");
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_GetPowerTiming
+**
+** Description      Returns the timing of a NFCC power transition
+**
+** Parameters       eTransition - phTmlNfc_PowerTransition_t
+**                  pTiming     - filled with the timing
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_GetPowerTiming(phTmlNfc_PowerTransition_t eTransition,
+                             phTmlNfc_PowerTiming_t* pTiming) {
+  if ((eTransition >= phTmlNfc_e_PwrMax) || (NULL == pTiming)) return;
+  pthread_mutex_lock(&sPowerTimingLock);
+  *pTiming = sPowerTiming[eTransition];
+  pthread_mutex_unlock(&sPowerTimingLock);
+}
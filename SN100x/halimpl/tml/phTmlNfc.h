@@ -74,6 +74,7 @@ typedef struct phTmlNfc_TransactInfo {
   NFCSTATUS wStatus;       /* Status of the Transaction Completion*/
   uint8_t* pBuff;          /* Response Data of the Transaction*/
   uint16_t wLength;        /* Data size of the Transaction*/
+  uint64_t qwRxTimeUs;     /* Time the packet was read, reads only */
 } phTmlNfc_TransactInfo_t; /* Instance of Transaction structure */
 
 /*
@@ -139,6 +140,23 @@ typedef struct phTmlNfc_ReadWriteInfo {
   NFCSTATUS wWorkStatus; /*Status of the transaction performed */
 } phTmlNfc_ReadWriteInfo_t;
 
+/*
+ * Structure containing details related to write operations, the buffer is
+ * owned by the caller and only read until the write completes or is no
+ * longer retransmitted
+ */
+typedef struct phTmlNfc_WriteInfo {
+  volatile uint8_t bEnable; /*This flag shall decide whether to perform
+                               Write operation */
+  uint8_t bThreadBusy; /*Flag to indicate thread is busy on write operation */
+  /* Transaction completion Callback function */
+  pphTmlNfc_TransactCompletionCb_t pThread_Callback;
+  void* pContext;          /*Context passed while invocation of operation */
+  const uint8_t* pBuffer;  /*Buffer passed while invocation of operation */
+  uint16_t wLength;        /*Length of data written */
+  NFCSTATUS wWorkStatus;   /*Status of the transaction performed */
+} phTmlNfc_WriteInfo_t;
+
 /*
  *Base Context Structure containing members required for entire session
  */
@@ -155,7 +173,7 @@ typedef struct phTmlNfc_Context {
                               retransmission */
   uint32_t dwTimerId;      /* Timer used to retransmit nci packet */
   phTmlNfc_ReadWriteInfo_t tReadInfo;  /*Pointer to Reader Thread Structure */
-  phTmlNfc_ReadWriteInfo_t tWriteInfo; /*Pointer to Writer Thread Structure */
+  phTmlNfc_WriteInfo_t tWriteInfo;     /*Pointer to Writer Thread Structure */
   void* pDevHandle;                    /* Pointer to Device Handle */
   uintptr_t dwCallbackThreadId; /* Thread ID to which message to be posted */
   uint8_t bEnableCrc;           /*Flag to validate/not CRC for input buffer */
@@ -211,6 +229,27 @@ typedef struct {
   void* pParams;
 } phTmlNfc_DeferMsg_t; /* DeferMsg structure passed to User Thread */
 
+/*
+ * NFCC power transitions timed by TML
+ */
+typedef enum {
+  phTmlNfc_e_PwrResetDevice = 0x00, /* VEN toggle of phTmlNfc_e_ResetDevice */
+  phTmlNfc_e_PwrNormalMode,         /* VEN toggle leaving download mode */
+  phTmlNfc_e_PwrShutdown,           /* phTmlNfc_Shutdown */
+  phTmlNfc_e_PwrMax
+} phTmlNfc_PowerTransition_t;
+
+/*
+ * Timing of a NFCC power transition, readiness is confirmed by the NFCC
+ * signalling data or by the end of the worst case delay of the transition
+ */
+typedef struct phTmlNfc_PowerTiming {
+  uint32_t dwCount;    /* Number of transitions */
+  uint32_t dwTimeouts; /* Transitions which ended at the worst case delay */
+  uint32_t dwLastUs;   /* Duration of the last transition */
+  uint32_t dwMaxUs;    /* Longest transition */
+} phTmlNfc_PowerTiming_t;
+
 typedef enum {
   I2C_FRAGMENATATION_DISABLED, /*i2c fragmentation_disabled           */
   I2C_FRAGMENTATION_ENABLED    /*i2c_fragmentation_enabled          */
@@ -220,7 +259,7 @@ NFCSTATUS phTmlNfc_Init(pphTmlNfc_Config_t pConfig);
 NFCSTATUS phTmlNfc_Shutdown(void);
 NFCSTATUS phTmlNfc_Shutdown_CleanUp();
 void phTmlNfc_CleanUp(void);
-NFCSTATUS phTmlNfc_Write(uint8_t* pBuffer, uint16_t wLength,
+NFCSTATUS phTmlNfc_Write(const uint8_t* pBuffer, uint16_t wLength,
                          pphTmlNfc_TransactCompletionCb_t pTmlWriteComplete,
                          void* pContext);
 NFCSTATUS phTmlNfc_Read(uint8_t* pBuffer, uint16_t wLength,
@@ -233,9 +272,12 @@ void phTmlNfc_DeferredCall(uintptr_t dwThreadId,
                            phLibNfc_Message_t* ptWorkerMsg);
 void phTmlNfc_ConfigNciPktReTx(phTmlNfc_ConfigRetrans_t eConfig,
                                uint8_t bRetryCount);
+bool phTmlNfc_MayRetransmit(const uint8_t* pBuffer);
 void phTmlNfc_set_fragmentation_enabled(phTmlNfc_i2cfragmentation_t enable);
 phTmlNfc_i2cfragmentation_t phTmlNfc_get_fragmentation_enabled();
 NFCSTATUS phTmlNfc_ConfigTransport();
 void phTmlNfc_EnableFwDnldMode(bool mode);
 bool phTmlNfc_IsFwDnldModeEnabled(void);
+void phTmlNfc_GetPowerTiming(phTmlNfc_PowerTransition_t eTransition,
+                             phTmlNfc_PowerTiming_t* pTiming);
 #endif /*  PHTMLNFC_H  */
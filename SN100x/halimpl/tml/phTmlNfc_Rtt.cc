@@ -0,0 +1,312 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <phNxpLog.h>
+#include <phTmlNfc_Rtt.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/* NCI message type of the first header byte */
+#define PH_TMLNFC_RTT_MT_MASK 0xE0
+#define PH_TMLNFC_RTT_MT_CMD 0x20
+#define PH_TMLNFC_RTT_MT_RSP 0x40
+
+/* Read error backoff used until the first response is measured */
+#define PH_TMLNFC_RTT_INITIAL_READ_BACKOFF_MS (30U)
+
+typedef struct {
+  bool bCmdQueued;     /* next command written is a new one */
+  bool bPending;       /* command written, response not received */
+  bool bRetransmitted; /* pending command was written more than once */
+  uint8_t bBackoff;    /* number of retransmissions of pending command */
+  phTmlNfc_RttClass_t eClass; /* estimator of the pending command */
+  uint64_t qwTxTimeUs;        /* first transmission of pending command */
+  uint64_t qwLastActivityUs;  /* last packet on the bus */
+} phTmlNfc_RttState_t;
+
+/* Kept across HAL sessions, the latency is a property of the NFCC */
+static phTmlNfc_RttStats_t sRttStats = {
+    {{0, 0, PH_TMLNFC_RTT_INITIAL_RTO_MS, 0, 0},
+     {0, 0, PH_TMLNFC_RTT_INITIAL_RTO_MS, 0, 0}},
+    0,
+    0};
+static phTmlNfc_RttState_t sRttState;
+static pthread_mutex_t sRttLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttNow
+**
+** Description      CLOCK_MONOTONIC time
+**
+** Returns          time in micro seconds
+**
+*******************************************************************************/
+static uint64_t phTmlNfc_RttNow(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttUpdate
+**
+** Description      Adds a round trip time sample to an estimator and derives
+**                  the retransmission timeout, RFC 6298 section 2.
+**                  Called with sRttLock held.
+**
+** Parameters       pEst   - estimator
+**                  dwRtt  - round trip time, in micro seconds
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_RttUpdate(phTmlNfc_RttEstimate_t* pEst, uint32_t dwRtt) {
+  uint32_t dwDelta;
+  uint32_t dwRto;
+
+  if (pEst->dwSamples == 0) {
+    pEst->dwSrttUs = dwRtt;
+    pEst->dwRttVarUs = dwRtt / 2;
+  } else {
+    dwDelta = (pEst->dwSrttUs > dwRtt) ? (pEst->dwSrttUs - dwRtt)
+                                       : (dwRtt - pEst->dwSrttUs);
+    pEst->dwRttVarUs = (3 * pEst->dwRttVarUs + dwDelta) / 4;
+    pEst->dwSrttUs = (7 * pEst->dwSrttUs + dwRtt) / 8;
+  }
+  pEst->dwSamples++;
+  if (dwRtt > pEst->dwMaxRttUs) pEst->dwMaxRttUs = dwRtt;
+
+  dwRto = (pEst->dwSrttUs + 4 * pEst->dwRttVarUs + 999) / 1000;
+  if (dwRto < PH_TMLNFC_RTT_MIN_RTO_MS) dwRto = PH_TMLNFC_RTT_MIN_RTO_MS;
+  if (dwRto > PH_TMLNFC_RTT_MAX_RTO_MS) dwRto = PH_TMLNFC_RTT_MAX_RTO_MS;
+  pEst->dwRtoMs = dwRto;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttOnCmdQueued
+**
+** Description      Called when upper layer requests a write, the next
+**                  command written to the NFCC is not a retransmission.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_RttOnCmdQueued(void) {
+  pthread_mutex_lock(&sRttLock);
+  sRttState.bCmdQueued = true;
+  pthread_mutex_unlock(&sRttLock);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttOnTx
+**
+** Description      Called after a NCI packet is written to the NFCC.
+**                  Starts the measurement of a new command or accounts a
+**                  retransmission.
+**
+** Parameters       pBuffer  - packet written
+**                  wLength  - packet length
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_RttOnTx(const uint8_t* pBuffer, uint16_t wLength) {
+  uint64_t qwNow = phTmlNfc_RttNow();
+
+  pthread_mutex_lock(&sRttLock);
+  if (wLength > 0 &&
+      (pBuffer[0] & PH_TMLNFC_RTT_MT_MASK) == PH_TMLNFC_RTT_MT_CMD) {
+    if (sRttState.bCmdQueued) {
+      sRttState.bCmdQueued = false;
+      sRttState.bPending = true;
+      sRttState.bRetransmitted = false;
+      sRttState.bBackoff = 0;
+      sRttState.qwTxTimeUs = qwNow;
+      sRttState.eClass = (qwNow - sRttState.qwLastActivityUs >
+                          PH_TMLNFC_RTT_STANDBY_IDLE_MS * 1000ULL)
+                             ? PH_TMLNFC_RTT_WAKEUP
+                             : PH_TMLNFC_RTT_NORMAL;
+    } else if (sRttState.bPending) {
+      sRttState.bRetransmitted = true;
+      if (sRttState.bBackoff < 8) sRttState.bBackoff++;
+      sRttStats.dwRetransmits++;
+    }
+  }
+  sRttState.qwLastActivityUs = qwNow;
+  pthread_mutex_unlock(&sRttLock);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttOnRx
+**
+** Description      Called after a NCI packet is read from the NFCC. A
+**                  response completes the measurement of the pending
+**                  command.
+**
+** Parameters       pBuffer  - packet read
+**                  wLength  - packet length
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_RttOnRx(const uint8_t* pBuffer, uint16_t wLength) {
+  uint64_t qwNow = phTmlNfc_RttNow();
+  uint64_t qwRtt;
+
+  pthread_mutex_lock(&sRttLock);
+  if (wLength > 0 && sRttState.bPending &&
+      (pBuffer[0] & PH_TMLNFC_RTT_MT_MASK) == PH_TMLNFC_RTT_MT_RSP) {
+    sRttState.bPending = false;
+    /* Karn's rule, response may belong to any of the transmissions */
+    if (!sRttState.bRetransmitted) {
+      qwRtt = qwNow - sRttState.qwTxTimeUs;
+      phTmlNfc_RttUpdate(&sRttStats.tEstimate[sRttState.eClass],
+                         (qwRtt > UINT32_MAX) ? UINT32_MAX : (uint32_t)qwRtt);
+    }
+  }
+  sRttState.qwLastActivityUs = qwNow;
+  pthread_mutex_unlock(&sRttLock);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttGetRetransTimeout
+**
+** Description      Time to wait for the response of the command just written
+**                  before writing it again. Doubled on each retransmission
+**                  of the same command.
+**
+** Returns          timeout in milli seconds
+**
+*******************************************************************************/
+uint32_t phTmlNfc_RttGetRetransTimeout(void) {
+  uint32_t dwRto;
+
+  pthread_mutex_lock(&sRttLock);
+  dwRto = sRttStats.tEstimate[sRttState.eClass].dwRtoMs << sRttState.bBackoff;
+  pthread_mutex_unlock(&sRttLock);
+  return (dwRto > PH_TMLNFC_RTT_MAX_RTO_MS) ? PH_TMLNFC_RTT_MAX_RTO_MS : dwRto;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttIsRecoveryElapsed
+**
+** Description      Checks whether the NFCC had the time to recover from
+**                  standby since the first transmission of the pending
+**                  command, in which case retransmitting is useless.
+**
+** Returns          true if PH_TMLNFC_RTT_STANDBY_RECOVERY_MS is elapsed
+**
+*******************************************************************************/
+bool phTmlNfc_RttIsRecoveryElapsed(void) {
+  bool bElapsed;
+
+  pthread_mutex_lock(&sRttLock);
+  bElapsed = sRttState.bPending &&
+             (phTmlNfc_RttNow() - sRttState.qwTxTimeUs >=
+              PH_TMLNFC_RTT_STANDBY_RECOVERY_MS * 1000ULL);
+  pthread_mutex_unlock(&sRttLock);
+  return bElapsed;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttGetReadBackoff
+**
+** Description      Delay before reading again after a read error. The first
+**                  delay is the smoothed response time of the active NFCC,
+**                  next ones are doubled.
+**
+** Parameters       dwPrevBackoff - previous delay, 0 after a successful read
+**
+** Returns          delay in milli seconds
+**
+*******************************************************************************/
+uint32_t phTmlNfc_RttGetReadBackoff(uint32_t dwPrevBackoff) {
+  uint32_t dwBackoff;
+
+  pthread_mutex_lock(&sRttLock);
+  sRttStats.dwReadErrors++;
+  if (dwPrevBackoff != 0) {
+    dwBackoff = dwPrevBackoff * 2;
+  } else if (sRttStats.tEstimate[PH_TMLNFC_RTT_NORMAL].dwSamples == 0) {
+    dwBackoff = PH_TMLNFC_RTT_INITIAL_READ_BACKOFF_MS;
+  } else {
+    dwBackoff = sRttStats.tEstimate[PH_TMLNFC_RTT_NORMAL].dwSrttUs / 1000;
+  }
+  pthread_mutex_unlock(&sRttLock);
+
+  if (dwBackoff < PH_TMLNFC_RTT_MIN_READ_BACKOFF_MS)
+    dwBackoff = PH_TMLNFC_RTT_MIN_READ_BACKOFF_MS;
+  if (dwBackoff > PH_TMLNFC_RTT_MAX_READ_BACKOFF_MS)
+    dwBackoff = PH_TMLNFC_RTT_MAX_READ_BACKOFF_MS;
+  return dwBackoff;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttGetStats
+**
+** Description      Returns the state of the estimators
+**
+** Parameters       pStats - filled with the statistics
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_RttGetStats(phTmlNfc_RttStats_t* pStats) {
+  if (pStats == NULL) return;
+  pthread_mutex_lock(&sRttLock);
+  memcpy(pStats, &sRttStats, sizeof(*pStats));
+  pthread_mutex_unlock(&sRttLock);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_RttLogStats
+**
+** Description      Logs the state of the estimators. Called on TML shutdown.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_RttLogStats(void) {
+  static const char* const sClassName[PH_TMLNFC_RTT_MAX] = {"normal",
+                                                            "wakeup"};
+  phTmlNfc_RttStats_t tStats;
+
+  phTmlNfc_RttGetStats(&tStats);
+  for (int i = 0; i < PH_TMLNFC_RTT_MAX; i++) {
+    NXPLOG_TML_D(
+        "NCI rtt %s: srtt %u us, rttvar %u us, rto %u ms, max %u us, "
+        "samples %u",
+        sClassName[i], tStats.tEstimate[i].dwSrttUs,
+        tStats.tEstimate[i].dwRttVarUs, tStats.tEstimate[i].dwRtoMs,
+        tStats.tEstimate[i].dwMaxRttUs, tStats.tEstimate[i].dwSamples);
+  }
+  NXPLOG_TML_D("NCI rtt: %u retransmissions, %u read errors",
+               tStats.dwRetransmits, tStats.dwReadErrors);
+}
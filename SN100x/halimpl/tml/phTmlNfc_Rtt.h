@@ -0,0 +1,86 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * NCI command to response latency estimation used by the TML
+ * retransmission.
+ *
+ * The smoothed round trip time (SRTT) and its variation (RTTVAR) are updated
+ * on each response as in RFC 6298. Commands sent after the bus was idle for
+ * PH_TMLNFC_RTT_STANDBY_IDLE_MS find the NFCC in standby and are tracked by
+ * a separate estimator, the NFCC wake up time being much longer than its
+ * processing time. Responses to retransmitted commands are not sampled since
+ * they cannot be matched to one transmission.
+ *
+ * The retransmission timeout is dormant: the HAL only configures TML with
+ * phTmlNfc_e_DisableRetrans, so phTmlNfc_RttGetRetransTimeout is not reached.
+ * The estimates are still collected for the statistics, and the read error
+ * backoff is in use.
+ */
+
+#ifndef PHTMLNFC_RTT_H
+#define PHTMLNFC_RTT_H
+
+#include <phNfcTypes.h>
+
+/* Bus idle time after which the NFCC is considered in standby */
+#define PH_TMLNFC_RTT_STANDBY_IDLE_MS (100U)
+/* Bounds of the retransmission timeout. The estimate is one for all commands,
+ * it is not allowed below the former fixed timeout so that a slow command
+ * following fast ones is not retransmitted early */
+#define PH_TMLNFC_RTT_MIN_RTO_MS (200U)
+#define PH_TMLNFC_RTT_MAX_RTO_MS (500U)
+/* Timeout used until the first response is measured */
+#define PH_TMLNFC_RTT_INITIAL_RTO_MS (200U)
+/* Time given to the NFCC to recover from standby, retransmission stops once
+ * it is elapsed since the first transmission */
+#define PH_TMLNFC_RTT_STANDBY_RECOVERY_MS (2000U)
+/* Bounds of the read error backoff */
+#define PH_TMLNFC_RTT_MIN_READ_BACKOFF_MS (5U)
+#define PH_TMLNFC_RTT_MAX_READ_BACKOFF_MS (150U)
+
+typedef enum {
+  PH_TMLNFC_RTT_NORMAL = 0x00, /* NFCC active */
+  PH_TMLNFC_RTT_WAKEUP = 0x01, /* NFCC woken up by the command */
+  PH_TMLNFC_RTT_MAX
+} phTmlNfc_RttClass_t;
+
+typedef struct {
+  uint32_t dwSrttUs;   /* smoothed round trip time */
+  uint32_t dwRttVarUs; /* round trip time variation */
+  uint32_t dwRtoMs;    /* retransmission timeout derived from both */
+  uint32_t dwMaxRttUs; /* highest round trip time measured */
+  uint32_t dwSamples;  /* number of responses measured */
+} phTmlNfc_RttEstimate_t;
+
+typedef struct {
+  phTmlNfc_RttEstimate_t tEstimate[PH_TMLNFC_RTT_MAX];
+  uint32_t dwRetransmits;  /* commands written again on timeout */
+  uint32_t dwReadErrors;   /* failed reads, each followed by a backoff */
+} phTmlNfc_RttStats_t;
+
+void phTmlNfc_RttOnCmdQueued(void);
+void phTmlNfc_RttOnTx(const uint8_t* pBuffer, uint16_t wLength);
+void phTmlNfc_RttOnRx(const uint8_t* pBuffer, uint16_t wLength);
+uint32_t phTmlNfc_RttGetRetransTimeout(void);
+bool phTmlNfc_RttIsRecoveryElapsed(void);
+uint32_t phTmlNfc_RttGetReadBackoff(uint32_t dwPrevBackoff);
+void phTmlNfc_RttGetStats(phTmlNfc_RttStats_t* pStats);
+void phTmlNfc_RttLogStats(void);
+
+#endif /* PHTMLNFC_RTT_H */
@@ -0,0 +1,354 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <errno.h>
+#include <phNxpConfig.h>
+#include <phNxpLog.h>
+#include <phTmlNfc_Trace.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+
+typedef enum {
+  PH_TMLNFC_TRACE_DISABLED = 0,
+  PH_TMLNFC_TRACE_ENABLED
+} phTmlNfc_TraceState_t;
+
+/* phTmlNfc_TraceState_t, read without sTraceLock on the TML threads */
+static std::atomic<int> sTraceState(PH_TMLNFC_TRACE_DISABLED);
+/* Set by phTmlNfc_TraceDisable, phTmlNfc_TraceOpen does nothing then */
+static bool sTraceForcedOff = false;
+static pthread_t sTraceThread;
+static bool sTraceThreadStarted = false;
+/* Records are queued in sTraceBuf[sTraceBufIdx] under sTraceLock, the
+ * flusher thread swaps the buffers and writes the full one to the file */
+static uint8_t sTraceBuf[2][PH_TMLNFC_TRACE_BUF_SIZE];
+static uint32_t sTraceBufIdx = 0;
+static uint32_t sTraceBufLen = 0;
+static uint32_t sTraceDropped = 0;
+static pthread_mutex_t sTraceLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sTraceCond = PTHREAD_COND_INITIALIZER;
+/* File side, used by the flusher thread and phTmlNfc_TraceDisable only */
+static FILE* spTraceFile = NULL;
+static long sTraceFileSize = 0;
+static pthread_mutex_t sTraceFileLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceNewFile
+**
+** Description      Opens the trace file, in append mode, and writes the file
+**                  header if it is empty. Called with sTraceFileLock held.
+**
+** Returns          true if the file is open
+**
+*******************************************************************************/
+static bool phTmlNfc_TraceNewFile(void) {
+  struct stat st;
+  phTmlNfc_TraceFileHdr_t tFileHdr;
+
+  spTraceFile = fopen(PH_TMLNFC_TRACE_FILE, "ab");
+  if (spTraceFile == NULL) {
+    NXPLOG_TML_E("NCI trace: unable to open %s", PH_TMLNFC_TRACE_FILE);
+    return false;
+  }
+  sTraceFileSize = (stat(PH_TMLNFC_TRACE_FILE, &st) == 0) ? st.st_size : 0;
+  if (sTraceFileSize == 0) {
+    tFileHdr.dwMagic = PH_TMLNFC_TRACE_MAGIC;
+    tFileHdr.wVersion = PH_TMLNFC_TRACE_VERSION;
+    tFileHdr.wReserved = 0;
+    fwrite(&tFileHdr, sizeof(tFileHdr), 1, spTraceFile);
+    fflush(spTraceFile);
+    sTraceFileSize = sizeof(tFileHdr);
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceFileWrite
+**
+** Description      Appends whole records to the trace file. Once the file
+**                  would exceed PH_TMLNFC_TRACE_MAX_FILE_SIZE, it is moved to
+**                  PH_TMLNFC_TRACE_OLD_FILE and a new one is started.
+**                  Called with sTraceFileLock held.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_TraceFileWrite(const uint8_t* pData, uint32_t dwLength) {
+  if (spTraceFile == NULL || dwLength == 0) return;
+  if (sTraceFileSize + (long)dwLength > PH_TMLNFC_TRACE_MAX_FILE_SIZE) {
+    fclose(spTraceFile);
+    spTraceFile = NULL;
+    if (rename(PH_TMLNFC_TRACE_FILE, PH_TMLNFC_TRACE_OLD_FILE) != 0) {
+      NXPLOG_TML_E("NCI trace: rotation failed, errno %d", errno);
+      unlink(PH_TMLNFC_TRACE_FILE);
+    }
+    if (!phTmlNfc_TraceNewFile()) return;
+    NXPLOG_TML_D("NCI trace: max file size reached, file rotated");
+  }
+  fwrite(pData, 1, dwLength, spTraceFile);
+  /* keep the tail of the capture when the HAL crashes */
+  fflush(spTraceFile);
+  sTraceFileSize += dwLength;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceFlush
+**
+** Description      Swaps the record buffers and writes the queued records to
+**                  the file, off sTraceLock.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_TraceFlush(void) {
+  uint32_t dwIdx;
+  uint32_t dwLength;
+  uint32_t dwDropped;
+
+  pthread_mutex_lock(&sTraceFileLock);
+  pthread_mutex_lock(&sTraceLock);
+  dwIdx = sTraceBufIdx;
+  dwLength = sTraceBufLen;
+  dwDropped = sTraceDropped;
+  sTraceBufIdx ^= 1;
+  sTraceBufLen = 0;
+  sTraceDropped = 0;
+  pthread_mutex_unlock(&sTraceLock);
+
+  if (dwDropped != 0) {
+    NXPLOG_TML_E("NCI trace: %u records dropped, buffer full", dwDropped);
+  }
+  phTmlNfc_TraceFileWrite(sTraceBuf[dwIdx], dwLength);
+  pthread_mutex_unlock(&sTraceFileLock);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceFlushThread
+**
+** Description      Writes the queued records every PH_TMLNFC_TRACE_FLUSH_MS,
+**                  or sooner once half of the buffer is used, until the
+**                  capture is disabled.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phTmlNfc_TraceFlushThread(void* arg) {
+  struct timespec ts;
+
+  (void)arg;
+  while (sTraceState.load() == PH_TMLNFC_TRACE_ENABLED) {
+    pthread_mutex_lock(&sTraceLock);
+    if (sTraceBufLen < PH_TMLNFC_TRACE_BUF_SIZE / 2) {
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += PH_TMLNFC_TRACE_FLUSH_MS * 1000000L;
+      ts.tv_sec += ts.tv_nsec / 1000000000L;
+      ts.tv_nsec %= 1000000000L;
+      pthread_cond_timedwait(&sTraceCond, &sTraceLock, &ts);
+    }
+    pthread_mutex_unlock(&sTraceLock);
+    phTmlNfc_TraceFlush();
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceWrite
+**
+** Description      Queues one record for the flusher thread. The record is
+**                  dropped, and counted, if the buffer is full.
+**
+** Parameters       bDir     - record type, phTmlNfc_TraceDir_t
+**                  bPrefix  - optional first payload byte, -1 if none
+**                  pBuffer  - payload
+**                  wLength  - payload length, excluding bPrefix
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_TraceWrite(uint8_t bDir, int bPrefix,
+                                const uint8_t* pBuffer, uint16_t wLength) {
+  phTmlNfc_TraceRecHdr_t tRecHdr;
+  struct timespec ts;
+  uint8_t* pDst;
+  uint32_t dwRecLen;
+
+  pthread_mutex_lock(&sTraceLock);
+  if (sTraceState != PH_TMLNFC_TRACE_ENABLED) goto clean_and_return;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  tRecHdr.qwTimestamp = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  tRecHdr.bDir = bDir;
+  tRecHdr.bReserved = 0;
+  tRecHdr.wLength = wLength + ((bPrefix >= 0) ? 1 : 0);
+  dwRecLen = sizeof(tRecHdr) + tRecHdr.wLength;
+  if (sTraceBufLen + dwRecLen > PH_TMLNFC_TRACE_BUF_SIZE) {
+    sTraceDropped++;
+    pthread_cond_signal(&sTraceCond);
+    goto clean_and_return;
+  }
+  pDst = &sTraceBuf[sTraceBufIdx][sTraceBufLen];
+  memcpy(pDst, &tRecHdr, sizeof(tRecHdr));
+  pDst += sizeof(tRecHdr);
+  if (bPrefix >= 0) *pDst++ = (uint8_t)bPrefix;
+  if (wLength > 0) memcpy(pDst, pBuffer, wLength);
+  sTraceBufLen += dwRecLen;
+  if (sTraceBufLen >= PH_TMLNFC_TRACE_BUF_SIZE / 2) {
+    pthread_cond_signal(&sTraceCond);
+  }
+
+clean_and_return:
+  pthread_mutex_unlock(&sTraceLock);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceRecord
+**
+** Description      Records one packet exchanged with the NFCC or written by
+**                  libnfc-nci, if capture is enabled.
+**
+** Parameters       bDir     - PH_TMLNFC_TRACE_TX/RX/HOST_TX
+**                  pBuffer  - packet
+**                  wLength  - packet length
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_TraceRecord(uint8_t bDir, const uint8_t* pBuffer,
+                          uint16_t wLength) {
+  if (sTraceState == PH_TMLNFC_TRACE_DISABLED) return;
+  phTmlNfc_TraceWrite(bDir, -1, pBuffer, wLength);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceEvent
+**
+** Description      Records a HAL API call made by libnfc-nci, if capture is
+**                  enabled.
+**
+** Parameters       bEvt     - phTmlNfc_TraceEvt_t
+**                  pArgs    - arguments of the call, may be NULL
+**                  wLength  - length of pArgs
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_TraceEvent(uint8_t bEvt, const uint8_t* pArgs, uint16_t wLength) {
+  if (sTraceState == PH_TMLNFC_TRACE_DISABLED) return;
+  phTmlNfc_TraceWrite(PH_TMLNFC_TRACE_HOST_EVT, bEvt, pArgs, wLength);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceOpen
+**
+** Description      Reads the capture setting, opens the trace file and
+**                  starts the flusher thread. Called at HAL open, before the
+**                  TML threads exist, so that they never read the config or
+**                  open the file.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_TraceOpen(void) {
+  unsigned long num = 0;
+  bool bOpened;
+
+  if (sTraceForcedOff || sTraceState == PH_TMLNFC_TRACE_ENABLED) return;
+  if (!GetNxpNumValue(NAME_NXP_NCI_TRACE_CAPTURE, &num, sizeof(num)) ||
+      num != 1) {
+    return;
+  }
+  pthread_mutex_lock(&sTraceFileLock);
+  bOpened = phTmlNfc_TraceNewFile();
+  pthread_mutex_unlock(&sTraceFileLock);
+  if (!bOpened) return;
+
+  sTraceState = PH_TMLNFC_TRACE_ENABLED;
+  if (pthread_create(&sTraceThread, NULL, phTmlNfc_TraceFlushThread, NULL) !=
+      0) {
+    NXPLOG_TML_E("NCI trace: flusher thread creation failed");
+    sTraceState = PH_TMLNFC_TRACE_DISABLED;
+    pthread_mutex_lock(&sTraceFileLock);
+    fclose(spTraceFile);
+    spTraceFile = NULL;
+    pthread_mutex_unlock(&sTraceFileLock);
+    return;
+  }
+  sTraceThreadStarted = true;
+  pthread_setname_np(sTraceThread, "nxp_nci_trace");
+  NXPLOG_TML_D("NCI trace: capturing to %s", PH_TMLNFC_TRACE_FILE);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceClose
+**
+** Description      Stops and joins the flusher thread, writes the records
+**                  still queued and closes the trace file. Called at HAL
+**                  close, once the TML threads are stopped.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_TraceClose(void) {
+  pthread_mutex_lock(&sTraceLock);
+  sTraceState = PH_TMLNFC_TRACE_DISABLED;
+  pthread_cond_signal(&sTraceCond);
+  pthread_mutex_unlock(&sTraceLock);
+  if (!sTraceThreadStarted) return;
+
+  if (pthread_join(sTraceThread, NULL) != 0) {
+    NXPLOG_TML_E("NCI trace: failed to join flusher thread");
+  }
+  sTraceThreadStarted = false;
+  /* the records queued so far still go to the file */
+  phTmlNfc_TraceFlush();
+  pthread_mutex_lock(&sTraceFileLock);
+  if (spTraceFile != NULL) {
+    fclose(spTraceFile);
+    spTraceFile = NULL;
+  }
+  pthread_mutex_unlock(&sTraceFileLock);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TraceDisable
+**
+** Description      Stops the capture, whatever the config, and keeps it off
+**                  across HAL open. Used while a capture is replayed.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_TraceDisable(void) {
+  sTraceForcedOff = true;
+  phTmlNfc_TraceClose();
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * NCI trace capture at the TML boundary.
+ *
+ * When NXP_NCI_TRACE_CAPTURE is set to 1 in the config, every packet written
+ * to or read from the NFCC is appended to PH_TMLNFC_TRACE_FILE together with
+ * the packets and HAL API calls coming from libnfc-nci, so that the session
+ * can be replayed later through NfccReplayTransport. The setting is read and
+ * the file opened at HAL open, the records are queued in memory and written
+ * by a flusher thread that is joined at HAL close; the TML threads do no file
+ * I/O.
+ * Each file, the rotated one included, starts with its own header.
+ *
+ * File layout (little endian):
+ *   phTmlNfc_TraceFileHdr_t
+ *   { phTmlNfc_TraceRecHdr_t, wLength bytes of payload } ...
+ *
+ * Payload of a PH_TMLNFC_TRACE_HOST_EVT record is one phTmlNfc_TraceEvt_t
+ * byte followed by the arguments of the API call, if any.
+ */
+
+#ifndef PHTMLNFC_TRACE_H
+#define PHTMLNFC_TRACE_H
+
+#include <phNfcTypes.h>
+
+#define PH_TMLNFC_TRACE_MAGIC 0x5443494EU /* "NICT" */
+#define PH_TMLNFC_TRACE_VERSION 0x0001
+#define PH_TMLNFC_TRACE_FILE "/data/vendor/nfc/nxp_nci_trace.bin"
+/* Previous capture, once the file reached PH_TMLNFC_TRACE_MAX_FILE_SIZE */
+#define PH_TMLNFC_TRACE_OLD_FILE "/data/vendor/nfc/nxp_nci_trace.1.bin"
+/* The file is moved to PH_TMLNFC_TRACE_OLD_FILE and a new one is started
+ * once it reaches this size */
+#define PH_TMLNFC_TRACE_MAX_FILE_SIZE (8 * 1024 * 1024)
+/* Records are buffered and written by a flusher thread at this period */
+#define PH_TMLNFC_TRACE_FLUSH_MS 500
+#define PH_TMLNFC_TRACE_BUF_SIZE (64 * 1024)
+
+/* Direction/type of a trace record */
+typedef enum {
+  PH_TMLNFC_TRACE_TX = 0x00,      /* packet written to NFCC */
+  PH_TMLNFC_TRACE_RX = 0x01,      /* packet read from NFCC */
+  PH_TMLNFC_TRACE_HOST_TX = 0x02, /* packet written by libnfc-nci */
+  PH_TMLNFC_TRACE_HOST_EVT = 0x03 /* HAL API invoked by libnfc-nci */
+} phTmlNfc_TraceDir_t;
+
+/* HAL API invoked by libnfc-nci, first payload byte of HOST_EVT records */
+typedef enum {
+  PH_TMLNFC_TRACE_EVT_OPEN = 0x00,
+  PH_TMLNFC_TRACE_EVT_CORE_INITIALIZED, /* args: CORE_INIT rsp params */
+  PH_TMLNFC_TRACE_EVT_PRE_DISCOVER,
+  PH_TMLNFC_TRACE_EVT_CLOSE, /* args: 1 byte shutdown flag */
+  PH_TMLNFC_TRACE_EVT_POWER_CYCLE
+} phTmlNfc_TraceEvt_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t dwMagic;
+  uint16_t wVersion;
+  uint16_t wReserved;
+} phTmlNfc_TraceFileHdr_t;
+
+typedef struct __attribute__((packed)) {
+  uint64_t qwTimestamp; /* CLOCK_MONOTONIC, nano seconds */
+  uint8_t bDir;         /* phTmlNfc_TraceDir_t */
+  uint8_t bReserved;
+  uint16_t wLength; /* payload length */
+} phTmlNfc_TraceRecHdr_t;
+
+void phTmlNfc_TraceRecord(uint8_t bDir, const uint8_t* pBuffer,
+                          uint16_t wLength);
+void phTmlNfc_TraceEvent(uint8_t bEvt, const uint8_t* pArgs, uint16_t wLength);
+void phTmlNfc_TraceOpen(void);
+void phTmlNfc_TraceClose(void);
+void phTmlNfc_TraceDisable(void);
+
+#endif /* PHTMLNFC_TRACE_H */
@@ -25,11 +25,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <hardware/nfc.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
+#include <algorithm>
 
 #include <NfccI2cTransport.h>
 #include <phNfcStatus.h>
@@ -46,9 +49,37 @@
 #define FRAGMENTSIZE_MAX PHNFC_I2C_FRAGMENT_SIZE
 #define NORMAL_MODE_LEN_OFFSET 2
 #define FLUSH_BUFFER_SIZE 0xFF
+/* Adaptive fragmentation: the gap between fragments starts at the former
+ * fixed delay, shrinks after FRAG_CLEAN_RUN fragments accepted at once and
+ * doubles, with the fragment size halved, when the NFCC NACKs a fragment */
+#define FRAG_SIZE_MIN (FRAGMENTSIZE_MAX / 4)
+#define FRAG_GAP_INIT_US 500
+#define FRAG_GAP_MIN_US 50
+#define FRAG_GAP_MAX_US 4000
+#define FRAG_CLEAN_RUN 8
+/* a fragment write slower than this times the average widens the gap */
+#define FRAG_SLOW_FACTOR 2
+/* NXP_I2C_FRAGMENT_READY_POLL=1: a NACKed fragment is retried every
+ * FRAG_READY_POLL_US instead of after the gap */
+#define FRAG_READY_POLL_US 100
+/* a fragment still NACKed after this long fails the write */
+#define FRAG_READY_TIMEOUT_US (10 * 1000)
+/* NXP_I2C_FRAMED_READ_LEN: length of the first read() of a packet, the rest
+ * of a longer packet is read with a second one. 0 keeps the multi-read
+ * path: header, then payload. */
+#define FRAMED_READ_LEN_MAX (NORMAL_MODE_HEADER_LEN + 0xFF)
+#define FRAMED_READ_UNSUPPORTED (-2)
 extern phTmlNfc_i2cfragmentation_t fragmentation_enabled;
 extern phTmlNfc_Context_t* gpphTmlNfc_Context;
 extern spTransport gpTransportObj;
+
+static uint64_t I2cNowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 /*******************************************************************************
 **
 ** Function         Close
@@ -65,6 +96,31 @@ void NfccI2cTransport::Close(void *pDevHandle) {
     close((intptr_t)pDevHandle);
   }
   sem_destroy(&mTxRxSemaphore);
+  pthread_mutex_lock(&mWriteStatsLock);
+  NXPLOG_TML_D(
+      "%s write: %u frames %u fragments %llu bytes, %u nacks %u slow %u "
+      "failures, bus %llu us gap %llu us, frame max %llu us, size %u gap %u us",
+      __func__, mWriteStats.dwFrames, mWriteStats.dwFragments,
+      (unsigned long long)mWriteStats.qwBytes, mWriteStats.dwNacks,
+      mWriteStats.dwSlow, mWriteStats.dwFailures,
+      (unsigned long long)(mWriteStats.qwBusNs / 1000),
+      (unsigned long long)(mWriteStats.qwGapNs / 1000),
+      (unsigned long long)(mWriteStats.qwFrameMaxNs / 1000),
+      mWriteStats.dwFragSize, mWriteStats.dwGapUs);
+  pthread_mutex_unlock(&mWriteStatsLock);
+  pthread_mutex_lock(&mReadStatsLock);
+  NXPLOG_TML_D(
+      "%s read: %u packets %u reads, %u in one read, %llu pad bytes, "
+      "latency avg %llu us max %llu us, framed length %u",
+      __func__, mReadStats.dwPackets, mReadStats.dwReads,
+      mReadStats.dwSingleRead, (unsigned long long)mReadStats.qwPadBytes,
+      (unsigned long long)(mReadStats.dwPackets
+                               ? mReadStats.qwLatencyTotalNs /
+                                     mReadStats.dwPackets / 1000
+                               : 0),
+      (unsigned long long)(mReadStats.qwLatencyMaxNs / 1000),
+      mReadStats.dwFramedLen);
+  pthread_mutex_unlock(&mReadStatsLock);
   return;
 }
 
@@ -103,6 +159,33 @@ NFCSTATUS NfccI2cTransport::OpenAndConfigure(pphTmlNfc_Config_t pConfig,
     }
   }
 
+  mFragSize = FRAGMENTSIZE_MAX;
+  mFragGapUs = FRAG_GAP_INIT_US;
+  mFragCleanRun = 0;
+  mNsPerByte = 0;
+  mFragReadyPoll = false;
+  if (GetNxpNumValue(NAME_NXP_I2C_FRAGMENT_READY_POLL, &num, sizeof(num))) {
+    mFragReadyPoll = (num != 0);
+  }
+  num = 0;
+  mFramedReadLen = 0;
+  if (GetNxpNumValue(NAME_NXP_I2C_FRAMED_READ_LEN, &num, sizeof(num)) &&
+      num != 0) {
+    mFramedReadLen = std::min(std::max((int)std::min(num, 0xFFFFUL),
+                                       NORMAL_MODE_HEADER_LEN),
+                              FRAMED_READ_LEN_MAX);
+  }
+  num = 0;
+  pthread_mutex_lock(&mReadStatsLock);
+  memset(&mReadStats, 0x00, sizeof(mReadStats));
+  mReadStats.dwFramedLen = mFramedReadLen;
+  pthread_mutex_unlock(&mReadStatsLock);
+  pthread_mutex_lock(&mWriteStatsLock);
+  memset(&mWriteStats, 0x00, sizeof(mWriteStats));
+  mWriteStats.dwFragSize = mFragSize;
+  mWriteStats.dwGapUs = mFragGapUs;
+  pthread_mutex_unlock(&mWriteStatsLock);
+
   (void)gpTransportObj->NfccReset(*pLinkHandle, MODE_NFC_ENABLED);
 
   if (GetNxpNumValue(NAME_ENABLE_VEN_TOGGLE, &num, sizeof(num))) {
@@ -173,6 +256,8 @@ int NfccI2cTransport::Read(void *pDevHandle, uint8_t *pBuffer,
   int ret_Read;
   int ret_Select;
   int numRead = 0;
+  int numReads = 0;
+  uint64_t readyNs;
   struct timeval tv;
   fd_set rfds;
   uint16_t totalBtyesToRead = 0;
@@ -205,7 +290,15 @@ int NfccI2cTransport::Read(void *pDevHandle, uint8_t *pBuffer,
     NXPLOG_TML_D("%s Timeout", __func__);
     return -1;
   } else {
+    readyNs = I2cNowNs();
+    if (mFramedReadLen != 0) {
+      ret_Read = ReadFramed(pDevHandle, pBuffer, nNbBytesToRead, readyNs);
+      if (ret_Read != FRAMED_READ_UNSUPPORTED) {
+        return ret_Read;
+      }
+    }
     ret_Read = read((intptr_t)pDevHandle, pBuffer, totalBtyesToRead - numRead);
+    numReads++;
     if (ret_Read > 0 && !(pBuffer[0] == 0xFF && pBuffer[1] == 0xFF)) {
       SemTimedWait();
       numRead += ret_Read;
@@ -231,6 +324,7 @@ int NfccI2cTransport::Read(void *pDevHandle, uint8_t *pBuffer,
 
     if (numRead < totalBtyesToRead) {
       ret_Read = read((intptr_t)pDevHandle, (pBuffer + numRead), totalBtyesToRead - numRead);
+      numReads++;
 
       if (ret_Read != totalBtyesToRead - numRead) {
         SemPost();
@@ -247,6 +341,7 @@ int NfccI2cTransport::Read(void *pDevHandle, uint8_t *pBuffer,
     }
     if ((totalBtyesToRead - numRead) != 0) {
       ret_Read = read((intptr_t)pDevHandle, (pBuffer + numRead), totalBtyesToRead - numRead);
+      numReads++;
       if (ret_Read > 0) {
         numRead += ret_Read;
       } else if (ret_Read == 0) {
@@ -265,11 +360,117 @@ int NfccI2cTransport::Read(void *pDevHandle, uint8_t *pBuffer,
     } else {
       NXPLOG_TML_E("%s _>>>>> Empty packet recieved !!", __func__);
     }
+    ReadStatsAdd(numReads, 0, readyNs);
+  }
+  SemPost();
+  return numRead;
+}
+
+/*******************************************************************************
+**
+** Function         ReadFramed
+**
+** Description      Reads a packet with one read() of the speculative length,
+**                  trimmed to the length in its header. A longer packet is
+**                  completed with a second read(). The NFCC pads a read past
+**                  the end of the packet.
+**
+** Parameters       pDevHandle       - valid device handle
+**                  pBuffer          - buffer for read data
+**                  nNbBytesToRead   - size of the buffer
+**                  qwReadyNs        - time the device became readable
+**
+** Returns          numRead   - number of successfully read bytes
+**                  -1        - read operation failure
+**                  FRAMED_READ_UNSUPPORTED - length refused by the driver,
+**                              framed reads are disabled
+**
+*******************************************************************************/
+int NfccI2cTransport::ReadFramed(void *pDevHandle, uint8_t *pBuffer,
+                                 int nNbBytesToRead, uint64_t qwReadyNs) {
+  int ret_Read;
+  int numRead;
+  int readLen = std::min(mFramedReadLen, nNbBytesToRead);
+  int totalBtyesToRead;
+  int numReads = 1;
+
+  ret_Read = read((intptr_t)pDevHandle, pBuffer, readLen);
+  if (ret_Read < 0 && (errno == EINVAL || errno == EMSGSIZE)) {
+    NXPLOG_TML_E("%s read of %d refused, errno : %x, multi-read used",
+                 __func__, readLen, errno);
+    mFramedReadLen = 0;
+    pthread_mutex_lock(&mReadStatsLock);
+    mReadStats.dwFramedLen = 0;
+    pthread_mutex_unlock(&mReadStatsLock);
+    return FRAMED_READ_UNSUPPORTED;
+  }
+  if (ret_Read < NORMAL_MODE_HEADER_LEN ||
+      (pBuffer[0] == 0xFF && pBuffer[1] == 0xFF)) {
+    NXPLOG_TML_E("%s [hdr] ret : %d errno : %x", __func__, ret_Read, errno);
+    return -1;
+  }
+  SemTimedWait();
+
+  if (bFwDnldFlag && (pBuffer[0] != 0x00)) {
+    bFwDnldFlag = false;
+  }
+  if (bFwDnldFlag == true) {
+    totalBtyesToRead =
+        pBuffer[FW_DNLD_LEN_OFFSET] + FW_DNLD_HEADER_LEN + CRC_LEN;
+  } else {
+    totalBtyesToRead = pBuffer[NORMAL_MODE_LEN_OFFSET] + NORMAL_MODE_HEADER_LEN;
+  }
+  if (totalBtyesToRead > nNbBytesToRead) {
+    SemPost();
+    NXPLOG_TML_E("%s packet of %d larger than buffer", __func__,
+                 totalBtyesToRead);
+    return -1;
+  }
+
+  numRead = std::min(ret_Read, totalBtyesToRead);
+  if (numRead < totalBtyesToRead) {
+    ret_Read = read((intptr_t)pDevHandle, (pBuffer + numRead),
+                    totalBtyesToRead - numRead);
+    numReads++;
+    if (ret_Read != totalBtyesToRead - numRead) {
+      SemPost();
+      NXPLOG_TML_E("%s [pyld] errno : %x", __func__, errno);
+      return -1;
+    }
+    numRead = totalBtyesToRead;
   }
   SemPost();
+  ReadStatsAdd(numReads, numReads == 1 ? ret_Read - numRead : 0, qwReadyNs);
   return numRead;
 }
 
+/*******************************************************************************
+**
+** Function         ReadStatsAdd
+**
+** Description      Accounts a packet read
+**
+** Parameters       nReads         - read() calls
+**                  nPadBytes      - bytes read past the end of the packet
+**                  qwReadyNs      - time the device became readable
+**
+** Returns          none
+**
+*******************************************************************************/
+void NfccI2cTransport::ReadStatsAdd(int nReads, int nPadBytes,
+                                    uint64_t qwReadyNs) {
+  uint64_t latencyNs = I2cNowNs() - qwReadyNs;
+
+  pthread_mutex_lock(&mReadStatsLock);
+  mReadStats.dwPackets++;
+  mReadStats.dwReads += nReads;
+  if (nReads == 1) mReadStats.dwSingleRead++;
+  mReadStats.qwPadBytes += nPadBytes;
+  mReadStats.qwLatencyTotalNs += latencyNs;
+  mReadStats.qwLatencyMaxNs = std::max(mReadStats.qwLatencyMaxNs, latencyNs);
+  pthread_mutex_unlock(&mReadStatsLock);
+}
+
 /*******************************************************************************
 **
 ** Function         Write
@@ -285,11 +486,16 @@ int NfccI2cTransport::Read(void *pDevHandle, uint8_t *pBuffer,
 **                  -1         - write operation failure
 **
 *******************************************************************************/
-int NfccI2cTransport::Write(void *pDevHandle, uint8_t *pBuffer,
+int NfccI2cTransport::Write(void *pDevHandle, const uint8_t *pBuffer,
                             int nNbBytesToWrite) {
   int ret;
   int numWrote = 0;
   int numBytes = nNbBytesToWrite;
+  uint32_t waitedUs = 0;
+  uint32_t waitUs;
+  uint64_t frameStartNs;
+  uint64_t writeNs;
+  bool bFragmented;
   if (NULL == pDevHandle) {
     return -1;
   }
@@ -300,39 +506,150 @@ int NfccI2cTransport::Write(void *pDevHandle, uint8_t *pBuffer,
         __func__);
     return -1;
   }
+  /* only frames the NFCC cannot take at once are split, the adaptive size
+   * and gap apply to them alone */
+  bFragmented = (fragmentation_enabled == I2C_FRAGMENTATION_ENABLED &&
+                 nNbBytesToWrite > FRAGMENTSIZE_MAX);
+  frameStartNs = I2cNowNs();
   while (numWrote < nNbBytesToWrite) {
-    if (fragmentation_enabled == I2C_FRAGMENTATION_ENABLED &&
-        nNbBytesToWrite > FRAGMENTSIZE_MAX) {
-      if (nNbBytesToWrite - numWrote > FRAGMENTSIZE_MAX) {
-        numBytes = numWrote + FRAGMENTSIZE_MAX;
+    if (bFragmented) {
+      if (nNbBytesToWrite - numWrote > mFragSize) {
+        numBytes = numWrote + mFragSize;
       } else {
         numBytes = nNbBytesToWrite;
       }
     }
     SemTimedWait();
+    writeNs = I2cNowNs();
     ret = write((intptr_t)pDevHandle, pBuffer + numWrote, numBytes - numWrote);
+    writeNs = I2cNowNs() - writeNs;
     SemPost();
     if (ret > 0) {
       numWrote += ret;
-      if (fragmentation_enabled == I2C_FRAGMENTATION_ENABLED &&
-          numWrote < nNbBytesToWrite) {
-        usleep(500);
+      waitedUs = 0;
+      if (!bFragmented) {
+        pthread_mutex_lock(&mWriteStatsLock);
+        mWriteStats.qwBusNs += writeNs;
+        mWriteStats.qwBytes += ret;
+        pthread_mutex_unlock(&mWriteStatsLock);
+        continue;
+      }
+      FragAdapt(ret, writeNs, numWrote == ret);
+      if (numWrote < nNbBytesToWrite) {
+        FragWait(mFragGapUs);
       }
     } else if (ret == 0) {
       NXPLOG_TML_D("%s EOF", __func__);
-      return -1;
+      break;
     } else {
       NXPLOG_TML_D("%s errno : %x", __func__, errno);
-      if (errno == EINTR || errno == EAGAIN) {
+      if (errno == EINTR || (!bFragmented && errno == EAGAIN)) {
         continue;
       }
-      return -1;
+      /* NACK: the NFCC is not ready to take the fragment, e.g. in standby */
+      if (bFragmented &&
+          (errno == EAGAIN || errno == EREMOTEIO || errno == ENXIO) &&
+          waitedUs < FRAG_READY_TIMEOUT_US) {
+        FragAdapt(0, writeNs, numWrote == 0);
+        waitUs = mFragReadyPoll ? FRAG_READY_POLL_US : mFragGapUs;
+        FragWait(waitUs);
+        waitedUs += waitUs;
+        continue;
+      }
+      break;
     }
   }
 
+  pthread_mutex_lock(&mWriteStatsLock);
+  if (numWrote < nNbBytesToWrite) {
+    mWriteStats.dwFailures++;
+    numWrote = -1;
+  } else {
+    mWriteStats.dwFrames++;
+    mWriteStats.qwFrameMaxNs =
+        std::max(mWriteStats.qwFrameMaxNs, I2cNowNs() - frameStartNs);
+  }
+  pthread_mutex_unlock(&mWriteStatsLock);
   return numWrote;
 }
 
+/*******************************************************************************
+**
+** Function         FragAdapt
+**
+** Description      Adapts the fragment size and gap to the outcome of a
+**                  fragment write: a NACK doubles the gap and halves the
+**                  size, a slow write widens the gap, and FRAG_CLEAN_RUN
+**                  fragments accepted at once shrink the gap and double the
+**                  size back, within their limits. The first fragment of a
+**                  frame follows no gap and only updates the statistics.
+**
+** Parameters       nWritten       - bytes written, 0 if not accepted
+**                  qwWriteNs      - time spent in write()
+**                  bFirst         - first fragment of the frame
+**
+** Returns          none
+**
+*******************************************************************************/
+void NfccI2cTransport::FragAdapt(int nWritten, uint64_t qwWriteNs,
+                                 bool bFirst) {
+  uint64_t nsPerByte;
+
+  pthread_mutex_lock(&mWriteStatsLock);
+  mWriteStats.qwBusNs += qwWriteNs;
+  if (nWritten == 0) {
+    mWriteStats.dwNacks++;
+    if (bFirst) goto done;
+    mFragCleanRun = 0;
+    mFragGapUs = std::min(mFragGapUs * 2, (uint32_t)FRAG_GAP_MAX_US);
+    mFragSize = std::max(mFragSize / 2, FRAG_SIZE_MIN);
+  } else {
+    mWriteStats.dwFragments++;
+    mWriteStats.qwBytes += nWritten;
+    nsPerByte = qwWriteNs / nWritten;
+    if (mNsPerByte != 0 && nsPerByte > (uint64_t)mNsPerByte * FRAG_SLOW_FACTOR) {
+      mWriteStats.dwSlow++;
+      mFragCleanRun = 0;
+      mFragGapUs =
+          std::min(mFragGapUs + mFragGapUs / 4, (uint32_t)FRAG_GAP_MAX_US);
+    } else if (!bFirst && ++mFragCleanRun >= FRAG_CLEAN_RUN) {
+      mFragCleanRun = 0;
+      mFragGapUs =
+          std::max(mFragGapUs - mFragGapUs / 4, (uint32_t)FRAG_GAP_MIN_US);
+      mFragSize = std::min(mFragSize * 2, FRAGMENTSIZE_MAX);
+    }
+    /* 1/8 weight to the latest fragment */
+    nsPerByte = std::min(nsPerByte, (uint64_t)UINT32_MAX);
+    mNsPerByte = (mNsPerByte == 0)
+                     ? (uint32_t)nsPerByte
+                     : (uint32_t)((mNsPerByte * 7ULL + nsPerByte) / 8);
+  }
+done:
+  mWriteStats.dwFragSize = mFragSize;
+  mWriteStats.dwGapUs = mFragGapUs;
+  pthread_mutex_unlock(&mWriteStatsLock);
+}
+
+/*******************************************************************************
+**
+** Function         FragWait
+**
+** Description      Waits between fragments or before a retry
+**
+** Parameters       dwUs           - time to wait
+**
+** Returns          none
+**
+*******************************************************************************/
+void NfccI2cTransport::FragWait(uint32_t dwUs) {
+  uint64_t startNs = I2cNowNs();
+
+  usleep(dwUs);
+  pthread_mutex_lock(&mWriteStatsLock);
+  mWriteStats.qwGapNs += I2cNowNs() - startNs;
+  pthread_mutex_unlock(&mWriteStatsLock);
+}
+
 /*******************************************************************************
 **
 ** Function         Reset
@@ -434,6 +751,39 @@ void NfccI2cTransport::EnableFwDnldMode(bool mode) { bFwDnldFlag = mode; }
 *******************************************************************************/
 bool_t NfccI2cTransport::IsFwDnldModeEnabled(void) { return bFwDnldFlag; }
 
+/*******************************************************************************
+**
+** Function         WaitForData
+**
+** Description      Waits for the NFCC IRQ, the driver reports the device
+**                  readable while the IRQ line is asserted
+**
+** Parameters       pDevHandle     - valid device handle
+**                  nTimeoutMs     - maximum time to wait
+**
+** Returns           1   - data pending
+**                   0   - timeout
+**                  -1   - poll failure
+**
+*******************************************************************************/
+int NfccI2cTransport::WaitForData(void *pDevHandle, int nTimeoutMs) {
+  struct pollfd tPollFd;
+  int ret;
+
+  if (NULL == pDevHandle) {
+    return -1;
+  }
+  tPollFd.fd = (int)(intptr_t)pDevHandle;
+  tPollFd.events = POLLIN;
+  tPollFd.revents = 0;
+  ret = poll(&tPollFd, 1, nTimeoutMs);
+  if (ret < 0) {
+    NXPLOG_TML_E("%s errno : %x", __func__, errno);
+    return -1;
+  }
+  return (ret > 0 && (tPollFd.revents & POLLIN)) ? 1 : 0;
+}
+
 /*******************************************************************************
 **
 ** Function         SemPost
@@ -480,3 +830,39 @@ int NfccI2cTransport::SemTimedWait() {
   }
   return status;
 }
+
+/*******************************************************************************
+**
+** Function         GetWriteStats
+**
+** Description      Copies the fragment timing statistics of Write
+**
+** Parameters       pStats         - filled
+**
+** Returns           0   - success
+**
+*******************************************************************************/
+int NfccI2cTransport::GetWriteStats(NfccWriteStats_t *pStats) {
+  pthread_mutex_lock(&mWriteStatsLock);
+  *pStats = mWriteStats;
+  pthread_mutex_unlock(&mWriteStatsLock);
+  return 0;
+}
+
+/*******************************************************************************
+**
+** Function         GetReadStats
+**
+** Description      Copies the packet read statistics of Read
+**
+** Parameters       pStats         - filled
+**
+** Returns           0   - success
+**
+*******************************************************************************/
+int NfccI2cTransport::GetReadStats(NfccReadStats_t *pStats) {
+  pthread_mutex_lock(&mReadStatsLock);
+  *pStats = mReadStats;
+  pthread_mutex_unlock(&mReadStatsLock);
+  return 0;
+}
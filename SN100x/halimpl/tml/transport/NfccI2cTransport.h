@@ -59,6 +59,18 @@ class NfccI2cTransport : public NfccTransport {
  private:
   bool_t bFwDnldFlag = false;
   sem_t mTxRxSemaphore;
+  /* adaptive fragmentation of Write, reset on open */
+  int mFragSize;
+  uint32_t mFragGapUs;
+  uint32_t mFragCleanRun; /* fragments written since the last adaptation */
+  uint32_t mNsPerByte;    /* average fragment write time */
+  bool mFragReadyPoll;
+  NfccWriteStats_t mWriteStats;
+  pthread_mutex_t mWriteStatsLock = PTHREAD_MUTEX_INITIALIZER;
+  /* speculative length of framed reads, 0 for multi-read */
+  int mFramedReadLen;
+  NfccReadStats_t mReadStats;
+  pthread_mutex_t mReadStatsLock = PTHREAD_MUTEX_INITIALIZER;
   /*****************************************************************************
    **
    ** Function         SemTimedWait
@@ -83,6 +95,66 @@ class NfccI2cTransport : public NfccTransport {
    ****************************************************************************/
   void SemPost();
 
+  /*****************************************************************************
+   **
+   ** Function         FragAdapt
+   **
+   ** Description      Adapts the fragment size and gap to the outcome of a
+   **                  fragment write
+   **
+   ** Parameters       nWritten       - bytes written, 0 if not accepted
+   **                  qwWriteNs      - time spent in write()
+   **                  bFirst         - first fragment of the frame
+   **
+   ** Returns          none
+   ****************************************************************************/
+  void FragAdapt(int nWritten, uint64_t qwWriteNs, bool bFirst);
+
+  /*****************************************************************************
+   **
+   ** Function         FragWait
+   **
+   ** Description      Waits between fragments or before a retry
+   **
+   ** Parameters       dwUs           - time to wait
+   **
+   ** Returns          none
+   ****************************************************************************/
+  void FragWait(uint32_t dwUs);
+
+  /*****************************************************************************
+   **
+   ** Function         ReadFramed
+   **
+   ** Description      Reads a packet with one read() of the speculative
+   **                  length, trimmed to the length in its header
+   **
+   ** Parameters       pDevHandle       - valid device handle
+   **                  pBuffer          - buffer for read data
+   **                  nNbBytesToRead   - size of the buffer
+   **                  qwReadyNs        - time the device became readable
+   **
+   ** Returns          numRead   - number of successfully read bytes
+   **                  -1        - read operation failure
+   **                  FRAMED_READ_UNSUPPORTED - length refused by the driver
+   **
+   ****************************************************************************/
+  int ReadFramed(void *pDevHandle, uint8_t *pBuffer, int nNbBytesToRead,
+                 uint64_t qwReadyNs);
+
+  /*****************************************************************************
+   **
+   ** Function         ReadStatsAdd
+   **
+   ** Description      Accounts a packet read
+   **
+   ** Parameters       nReads         - read() calls
+   **                  nPadBytes      - bytes read past the end of the packet
+   **                  qwReadyNs      - time the device became readable
+   **
+   ** Returns          none
+   ****************************************************************************/
+  void ReadStatsAdd(int nReads, int nPadBytes, uint64_t qwReadyNs);
 
  public:
   /*****************************************************************************
@@ -147,7 +219,7 @@ class NfccI2cTransport : public NfccTransport {
   **                  -1         - write operation failure
   **
   *****************************************************************************/
-  int Write(void *pDevHandle, uint8_t *pBuffer, int nNbBytesToWrite);
+  int Write(void *pDevHandle, const uint8_t *pBuffer, int nNbBytesToWrite);
 
   /*****************************************************************************
    **
@@ -218,6 +290,23 @@ class NfccI2cTransport : public NfccTransport {
    ****************************************************************************/
   bool_t IsFwDnldModeEnabled(void);
 
+  /*****************************************************************************
+   **
+   ** Function         WaitForData
+   **
+   ** Description      Waits for the NFCC IRQ, the driver reports the device
+   **                  readable while the IRQ line is asserted
+   **
+   ** Parameters       pDevHandle     - valid device handle
+   **                  nTimeoutMs     - maximum time to wait
+   **
+   ** Returns           1   - data pending
+   **                   0   - timeout
+   **                  -1   - poll failure
+   **
+   ****************************************************************************/
+  int WaitForData(void *pDevHandle, int nTimeoutMs);
+
   /*******************************************************************************
   **
   ** Function         Flushdata
@@ -230,4 +319,30 @@ class NfccI2cTransport : public NfccTransport {
   **
   *******************************************************************************/
   bool Flushdata(pphTmlNfc_Config_t pConfig);
+
+  /*****************************************************************************
+   **
+   ** Function         GetWriteStats
+   **
+   ** Description      Copies the fragment timing statistics of Write
+   **
+   ** Parameters       pStats         - filled
+   **
+   ** Returns           0   - success
+   **
+   ****************************************************************************/
+  int GetWriteStats(NfccWriteStats_t *pStats);
+
+  /*****************************************************************************
+   **
+   ** Function         GetReadStats
+   **
+   ** Description      Copies the packet read statistics of Read
+   **
+   ** Parameters       pStats         - filled
+   **
+   ** Returns           0   - success
+   **
+   ****************************************************************************/
+  int GetReadStats(NfccReadStats_t *pStats);
 };
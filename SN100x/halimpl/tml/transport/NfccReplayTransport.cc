@@ -0,0 +1,408 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <NfccReplayTransport.h>
+#include <errno.h>
+#include <phNxpLog.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*******************************************************************************
+**
+** Function         NfccReplayTransport
+**
+** Description      Constructor
+**
+** Parameters       realTime - true to keep the captured timing
+**
+** Returns          None
+**
+*******************************************************************************/
+NfccReplayTransport::NfccReplayTransport(bool realTime) : mRealTime(realTime) {
+  pthread_condattr_t attr;
+
+  pthread_mutex_init(&mLock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&mCond, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+NfccReplayTransport::~NfccReplayTransport() {
+  pthread_cond_destroy(&mCond);
+  pthread_mutex_destroy(&mLock);
+}
+
+/*******************************************************************************
+**
+** Function         Now
+**
+** Description      CLOCK_MONOTONIC time used for the replay timing
+**
+** Returns          time in nano seconds
+**
+*******************************************************************************/
+uint64_t NfccReplayTransport::Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*******************************************************************************
+**
+** Function         Load
+**
+** Description      Loads a capture file written by phTmlNfc_Trace.
+**                  Records preceding the first OPEN event are skipped.
+**
+** Parameters       pFileName - capture file
+**
+** Returns          true if the capture holds at least one OPEN event
+**
+*******************************************************************************/
+bool NfccReplayTransport::Load(const char *pFileName) {
+  phTmlNfc_TraceFileHdr_t tFileHdr;
+  phTmlNfc_TraceRecHdr_t tRecHdr;
+  NfccReplayRecord_t record;
+  bool bOpenFound = false;
+  FILE *pFile = fopen(pFileName, "rb");
+
+  if (pFile == NULL) {
+    NXPLOG_TML_E("Replay: unable to open %s", pFileName);
+    return false;
+  }
+  if (fread(&tFileHdr, sizeof(tFileHdr), 1, pFile) != 1 ||
+      tFileHdr.dwMagic != PH_TMLNFC_TRACE_MAGIC ||
+      tFileHdr.wVersion != PH_TMLNFC_TRACE_VERSION) {
+    NXPLOG_TML_E("Replay: %s is not a NCI capture", pFileName);
+    fclose(pFile);
+    return false;
+  }
+  mRecords.clear();
+  while (fread(&tRecHdr, sizeof(tRecHdr), 1, pFile) == 1) {
+    record.qwTimestamp = tRecHdr.qwTimestamp;
+    record.bDir = tRecHdr.bDir;
+    record.bConsumed = false;
+    record.data.resize(tRecHdr.wLength);
+    if (tRecHdr.wLength > 0 &&
+        fread(record.data.data(), 1, tRecHdr.wLength, pFile) !=
+            tRecHdr.wLength) {
+      NXPLOG_TML_E("Replay: truncated record, capture end");
+      break;
+    }
+    if (!bOpenFound) {
+      if (record.bDir != PH_TMLNFC_TRACE_HOST_EVT || record.data.empty() ||
+          record.data[0] != PH_TMLNFC_TRACE_EVT_OPEN) {
+        continue;
+      }
+      bOpenFound = true;
+      mBaseTimestamp = record.qwTimestamp;
+    }
+    mRecords.push_back(record);
+  }
+  fclose(pFile);
+  mCursor = 0;
+  NXPLOG_TML_D("Replay: %zu records loaded", mRecords.size());
+  return bOpenFound;
+}
+
+/*******************************************************************************
+**
+** Function         AdvanceCursor
+**
+** Description      Moves the cursor past consumed records and wakes up the
+**                  waiting readers. Called with mLock held.
+**
+** Returns          None
+**
+*******************************************************************************/
+void NfccReplayTransport::AdvanceCursor() {
+  while (mCursor < mRecords.size() && mRecords[mCursor].bConsumed) mCursor++;
+  pthread_cond_broadcast(&mCond);
+}
+
+/*******************************************************************************
+**
+** Function         WaitForRecordTime
+**
+** Description      In real time mode, sleeps until the captured time of the
+**                  record relative to the start of the replay.
+**                  Called with mLock held.
+**
+** Parameters       record - record about to be played
+**
+** Returns          None
+**
+*******************************************************************************/
+void NfccReplayTransport::WaitForRecordTime(const NfccReplayRecord_t &record) {
+  struct timespec ts;
+  uint64_t target;
+
+  if (!mRealTime) return;
+  target = mStartTime + (record.qwTimestamp - mBaseTimestamp);
+  if (target <= Now()) return;
+  ts.tv_sec = target / 1000000000ULL;
+  ts.tv_nsec = target % 1000000000ULL;
+  pthread_mutex_unlock(&mLock);
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+  pthread_mutex_lock(&mLock);
+}
+
+/*******************************************************************************
+**
+** Function         WaitForProgress
+**
+** Description      Waits until another record is consumed. If nothing is
+**                  consumed for NFCC_REPLAY_STALL_TIMEOUT_MS while the HAL
+**                  is expected to write, the TX record is skipped.
+**                  Called with mLock held.
+**
+** Returns          None
+**
+*******************************************************************************/
+void NfccReplayTransport::WaitForProgress() {
+  struct timespec ts;
+  uint64_t deadline = Now() + NFCC_REPLAY_STALL_TIMEOUT_MS * 1000000ULL;
+  size_t cursor = mCursor;
+
+  ts.tv_sec = deadline / 1000000000ULL;
+  ts.tv_nsec = deadline % 1000000000ULL;
+  if (pthread_cond_timedwait(&mCond, &mLock, &ts) == ETIMEDOUT &&
+      cursor == mCursor && mCursor < mRecords.size() &&
+      mRecords[mCursor].bDir == PH_TMLNFC_TRACE_TX) {
+    NXPLOG_TML_E("Replay: record %zu was never written by HAL", mCursor);
+    mStats.dwTxMissing++;
+    mRecords[mCursor].bConsumed = true;
+    AdvanceCursor();
+  }
+}
+
+/*******************************************************************************
+**
+** Function         GetNextHostRecord
+**
+** Description      Blocks until all the records preceding the next
+**                  HOST_TX/HOST_EVT record are consumed, then consumes it.
+**
+** Parameters       pRecord - filled with the host record
+**
+** Returns          false once the capture is completely played
+**
+*******************************************************************************/
+bool NfccReplayTransport::GetNextHostRecord(const NfccReplayRecord_t **pRecord) {
+  bool status = false;
+
+  pthread_mutex_lock(&mLock);
+  if (mStartTime == 0) mStartTime = Now();
+  while (mCursor < mRecords.size() &&
+         mRecords[mCursor].bDir != PH_TMLNFC_TRACE_HOST_TX &&
+         mRecords[mCursor].bDir != PH_TMLNFC_TRACE_HOST_EVT) {
+    WaitForProgress();
+  }
+  if (mCursor < mRecords.size()) {
+    WaitForRecordTime(mRecords[mCursor]);
+    *pRecord = &mRecords[mCursor];
+    mRecords[mCursor].bConsumed = true;
+    AdvanceCursor();
+    status = true;
+  }
+  pthread_mutex_unlock(&mLock);
+  return status;
+}
+
+/*******************************************************************************
+**
+** Function         PopReadTime
+**
+** Description      Returns the time at which TML read a packet delivered to
+**                  libnfc-nci. Packets read before it which never reached
+**                  libnfc-nci are dropped.
+**
+** Parameters       pBuffer - packet received by the data callback
+**                  wLength - packet length
+**                  pTime   - filled with the read time, in nano seconds
+**
+** Returns          true if the packet was read from the capture
+**
+*******************************************************************************/
+bool NfccReplayTransport::PopReadTime(const uint8_t *pBuffer, uint16_t wLength,
+                                      uint64_t *pTime) {
+  bool status = false;
+
+  pthread_mutex_lock(&mLock);
+  for (auto it = mPendingRx.begin(); it != mPendingRx.end(); ++it) {
+    const std::vector<uint8_t> &data = it->second->data;
+    if (data.size() == wLength && memcmp(data.data(), pBuffer, wLength) == 0) {
+      *pTime = it->first;
+      mPendingRx.erase(mPendingRx.begin(), it + 1);
+      status = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mLock);
+  return status;
+}
+
+/*******************************************************************************
+**
+** Function         GetStats
+**
+** Description      Returns the replay counters
+**
+** Returns          NfccReplayStats_t
+**
+*******************************************************************************/
+NfccReplayStats_t NfccReplayTransport::GetStats() {
+  NfccReplayStats_t stats;
+
+  pthread_mutex_lock(&mLock);
+  stats = mStats;
+  pthread_mutex_unlock(&mLock);
+  return stats;
+}
+
+/*******************************************************************************
+**
+** Function         Close
+**
+** Description      Unblocks the pending Read, the capture stays loaded
+**
+** Parameters       pDevHandle - device handle
+**
+** Returns          None
+**
+*******************************************************************************/
+void NfccReplayTransport::Close(__attribute__((unused)) void *pDevHandle) {
+  pthread_mutex_lock(&mLock);
+  mClosed = true;
+  pthread_cond_broadcast(&mCond);
+  pthread_mutex_unlock(&mLock);
+}
+
+/*******************************************************************************
+**
+** Function         OpenAndConfigure
+**
+** Description      Opens the emulated NFCC
+**
+** Parameters       pConfig     - hardware information
+**                  pLinkHandle - device handle
+**
+** Returns          NFCSTATUS_SUCCESS
+**
+*******************************************************************************/
+NFCSTATUS NfccReplayTransport::OpenAndConfigure(
+    __attribute__((unused)) pphTmlNfc_Config_t pConfig, void **pLinkHandle) {
+  pthread_mutex_lock(&mLock);
+  mClosed = false;
+  if (mStartTime == 0) mStartTime = Now();
+  pthread_mutex_unlock(&mLock);
+  *pLinkHandle = (void *)this;
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         Read
+**
+** Description      Returns the next captured RX packet once all the records
+**                  preceding it are consumed.
+**
+** Parameters       pDevHandle     - valid device handle
+**                  pBuffer        - buffer for read data
+**                  nNbBytesToRead - size of pBuffer
+**
+** Returns          numRead   - number of bytes read
+**                  -1        - transport closed
+**
+*******************************************************************************/
+int NfccReplayTransport::Read(__attribute__((unused)) void *pDevHandle,
+                              uint8_t *pBuffer, int nNbBytesToRead) {
+  int numRead = -1;
+
+  pthread_mutex_lock(&mLock);
+  while (!mClosed && (mCursor >= mRecords.size() ||
+                      mRecords[mCursor].bDir != PH_TMLNFC_TRACE_RX)) {
+    if (mCursor >= mRecords.size())
+      pthread_cond_wait(&mCond, &mLock);
+    else
+      WaitForProgress();
+  }
+  if (!mClosed) {
+    NfccReplayRecord_t &record = mRecords[mCursor];
+    WaitForRecordTime(record);
+    numRead = ((int)record.data.size() < nNbBytesToRead) ? record.data.size()
+                                                         : nNbBytesToRead;
+    memcpy(pBuffer, record.data.data(), numRead);
+    record.bConsumed = true;
+    mPendingRx.push_back(std::make_pair(Now(), &record));
+    mStats.dwRxPkts++;
+    mStats.qwRxBytes += numRead;
+    AdvanceCursor();
+  }
+  pthread_mutex_unlock(&mLock);
+  return numRead;
+}
+
+/*******************************************************************************
+**
+** Function         Write
+**
+** Description      Checks the written packet against the next captured TX
+**                  record. TX records may be matched up to
+**                  NFCC_REPLAY_TX_WINDOW records ahead, but never past a host
+**                  record which is not played yet.
+**
+** Parameters       pDevHandle      - valid device handle
+**                  pBuffer         - buffer for written data
+**                  nNbBytesToWrite - number of bytes to write
+**
+** Returns          numWrote   - number of bytes written
+**
+*******************************************************************************/
+int NfccReplayTransport::Write(__attribute__((unused)) void *pDevHandle,
+                               const uint8_t *pBuffer, int nNbBytesToWrite) {
+  size_t end;
+  bool bFound = false;
+
+  pthread_mutex_lock(&mLock);
+  end = mCursor + NFCC_REPLAY_TX_WINDOW;
+  for (size_t i = mCursor; i < mRecords.size() && i < end; i++) {
+    if (mRecords[i].bConsumed || mRecords[i].bDir == PH_TMLNFC_TRACE_RX)
+      continue;
+    if (mRecords[i].bDir != PH_TMLNFC_TRACE_TX) break;
+    if ((int)mRecords[i].data.size() == nNbBytesToWrite &&
+        memcmp(mRecords[i].data.data(), pBuffer, nNbBytesToWrite) == 0) {
+      mStats.dwTxMatched++;
+    } else {
+      NXPLOG_TML_E("Replay: record %zu differs from written packet", i);
+      mStats.dwTxMismatched++;
+    }
+    mRecords[i].bConsumed = true;
+    AdvanceCursor();
+    bFound = true;
+    break;
+  }
+  if (!bFound) {
+    NXPLOG_TML_E("Replay: unexpected packet written by HAL");
+    mStats.dwTxUnexpected++;
+  }
+  pthread_mutex_unlock(&mLock);
+  return nNbBytesToWrite;
+}
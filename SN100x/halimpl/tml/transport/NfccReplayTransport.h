@@ -0,0 +1,197 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+#include <NfccTransport.h>
+#include <phTmlNfc_Trace.h>
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+/* Number of captured records a written packet may be matched ahead of, to
+ * tolerate a notification and a command crossing each other on the bus */
+#define NFCC_REPLAY_TX_WINDOW 8
+/* A captured TX record not written by the HAL within this time is reported
+ * as missing and skipped, so that a diverging replay does not hang */
+#define NFCC_REPLAY_STALL_TIMEOUT_MS 2000
+
+typedef struct {
+  uint64_t qwTimestamp;
+  uint8_t bDir;
+  bool bConsumed;
+  std::vector<uint8_t> data;
+} NfccReplayRecord_t;
+
+typedef struct {
+  uint32_t dwRxPkts;
+  uint64_t qwRxBytes;
+  uint32_t dwTxMatched;
+  uint32_t dwTxMismatched;
+  uint32_t dwTxUnexpected;
+  uint32_t dwTxMissing;
+} NfccReplayStats_t;
+
+/* Emulates the NFCC by playing back a capture recorded by phTmlNfc_Trace.
+ * Packets read by TML come from the RX records, packets written by TML are
+ * checked against the TX records. HOST_TX/HOST_EVT records are handed to the
+ * replay driver, which invokes the HAL API like libnfc-nci did. */
+class NfccReplayTransport : public NfccTransport {
+ private:
+  std::vector<NfccReplayRecord_t> mRecords;
+  /* index of the first record not consumed yet */
+  size_t mCursor = 0;
+  bool mRealTime = false;
+  bool mClosed = false;
+  uint64_t mStartTime = 0;
+  uint64_t mBaseTimestamp = 0;
+  NfccReplayStats_t mStats = {};
+  /* read timestamps of packets not yet seen by the replay driver */
+  std::deque<std::pair<uint64_t, const NfccReplayRecord_t*>> mPendingRx;
+  pthread_mutex_t mLock;
+  pthread_cond_t mCond;
+
+  /*****************************************************************************
+   **
+   ** Function         AdvanceCursor
+   **
+   ** Description      Moves the cursor past consumed records and wakes up
+   **                  the waiting readers. Called with mLock held.
+   **
+   ** Parameters       none
+   **
+   ** Returns          None
+   ****************************************************************************/
+  void AdvanceCursor();
+
+  /*****************************************************************************
+   **
+   ** Function         WaitForRecordTime
+   **
+   ** Description      In real time mode, sleeps until the captured time of
+   **                  the record relative to the start of the replay.
+   **                  Called with mLock held, the lock is released while
+   **                  sleeping.
+   **
+   ** Parameters       record - record about to be played
+   **
+   ** Returns          None
+   ****************************************************************************/
+  void WaitForRecordTime(const NfccReplayRecord_t &record);
+
+  /*****************************************************************************
+   **
+   ** Function         WaitForProgress
+   **
+   ** Description      Waits until another record is consumed. If nothing is
+   **                  consumed for NFCC_REPLAY_STALL_TIMEOUT_MS while the HAL
+   **                  is expected to write, the TX record is skipped.
+   **                  Called with mLock held.
+   **
+   ** Parameters       none
+   **
+   ** Returns          None
+   ****************************************************************************/
+  void WaitForProgress();
+
+ public:
+  /*****************************************************************************
+   **
+   ** Function         NfccReplayTransport
+   **
+   ** Description      Constructor
+   **
+   ** Parameters       realTime - true to keep the captured timing, false to
+   **                             replay as fast as possible
+   **
+   ** Returns          None
+   ****************************************************************************/
+  explicit NfccReplayTransport(bool realTime);
+
+  /*****************************************************************************
+   **
+   ** Function         Load
+   **
+   ** Description      Loads a capture file written by phTmlNfc_Trace.
+   **                  Records preceding the first OPEN event are skipped.
+   **
+   ** Parameters       pFileName - capture file
+   **
+   ** Returns          true if the capture holds at least one OPEN event
+   ****************************************************************************/
+  bool Load(const char *pFileName);
+
+  /*****************************************************************************
+   **
+   ** Function         GetNextHostRecord
+   **
+   ** Description      Blocks until all the records preceding the next
+   **                  HOST_TX/HOST_EVT record are consumed, then consumes it.
+   **
+   ** Parameters       pRecord - filled with the host record
+   **
+   ** Returns          false once the capture is completely played
+   ****************************************************************************/
+  bool GetNextHostRecord(const NfccReplayRecord_t **pRecord);
+
+  /*****************************************************************************
+   **
+   ** Function         PopReadTime
+   **
+   ** Description      Returns the time at which TML read a packet delivered
+   **                  to libnfc-nci. Packets read before it which never
+   **                  reached libnfc-nci are dropped.
+   **
+   ** Parameters       pBuffer - packet received by the data callback
+   **                  wLength - packet length
+   **                  pTime   - filled with the read time, in nano seconds
+   **
+   ** Returns          true if the packet was read from the capture
+   ****************************************************************************/
+  bool PopReadTime(const uint8_t *pBuffer, uint16_t wLength, uint64_t *pTime);
+
+  /*****************************************************************************
+   **
+   ** Function         GetStats
+   **
+   ** Description      Returns the replay counters
+   **
+   ** Parameters       none
+   **
+   ** Returns          NfccReplayStats_t
+   ****************************************************************************/
+  NfccReplayStats_t GetStats();
+
+  /*****************************************************************************
+   **
+   ** Function         Now
+   **
+   ** Description      CLOCK_MONOTONIC time used for the replay timing
+   **
+   ** Parameters       none
+   **
+   ** Returns          time in nano seconds
+   ****************************************************************************/
+  static uint64_t Now();
+
+  void Close(void *pDevHandle) override;
+  NFCSTATUS OpenAndConfigure(pphTmlNfc_Config_t pConfig,
+                             void **pLinkHandle) override;
+  int Read(void *pDevHandle, uint8_t *pBuffer, int nNbBytesToRead) override;
+  int Write(void *pDevHandle, const uint8_t *pBuffer, int nNbBytesToWrite) override;
+  ~NfccReplayTransport();
+};
@@ -38,6 +38,21 @@ void NfccTransport::EnableFwDnldMode(__attribute__((unused)) bool mode) {
 
 bool_t NfccTransport::IsFwDnldModeEnabled(void) { return false; }
 
+int NfccTransport::WaitForData(__attribute__((unused)) void *pDevHandle,
+                               __attribute__((unused)) int nTimeoutMs) {
+  return -1;
+}
+
 bool NfccTransport::Flushdata(__attribute__((unused)) pphTmlNfc_Config_t pConfig) {
     return true;
-}
\ No newline at end of file
+}
+
+int NfccTransport::GetWriteStats(__attribute__((unused))
+                                 NfccWriteStats_t *pStats) {
+  return -1;
+}
+
+int NfccTransport::GetReadStats(__attribute__((unused))
+                                NfccReadStats_t *pStats) {
+  return -1;
+}
@@ -51,6 +51,34 @@ enum EseResetType : long {
   MODE_ESE_RESET_PROTECTION_DISABLE_NFC = MODE_ESE_RESET_PROTECTION_DISABLE | SRC_NFC,
 };
 
+/* Returned by HAL_NFC_IOCTL_GET_WRITE_STATS, bus utilisation is
+ * qwBusNs / (qwBusNs + qwGapNs). Fragment counters and the adaptive size
+ * and gap are about frames over FRAGMENTSIZE_MAX only */
+typedef struct {
+  uint32_t dwFrames;
+  uint32_t dwFragments;
+  uint32_t dwNacks;    /* fragment writes not accepted by the NFCC */
+  uint32_t dwSlow;     /* fragment writes much slower than the average */
+  uint32_t dwFailures; /* frames not written */
+  uint64_t qwBytes;
+  uint64_t qwBusNs;    /* in write() */
+  uint64_t qwGapNs;    /* waiting between fragments and before retries */
+  uint64_t qwFrameMaxNs;
+  uint32_t dwFragSize; /* current */
+  uint32_t dwGapUs;    /* current */
+} NfccWriteStats_t;
+
+/* Returned by HAL_NFC_IOCTL_GET_READ_STATS, of the packets read */
+typedef struct {
+  uint32_t dwPackets;
+  uint32_t dwReads;      /* read() calls */
+  uint32_t dwSingleRead; /* packets fetched with one read() */
+  uint64_t qwPadBytes;   /* read past the end of the packets */
+  uint64_t qwLatencyTotalNs; /* from the device readable to the packet read */
+  uint64_t qwLatencyMaxNs;
+  uint32_t dwFramedLen;  /* speculative read length, 0 for multi-read */
+} NfccReadStats_t;
+
 extern phTmlNfc_i2cfragmentation_t fragmentation_enabled;
 
 class NfccTransport {
@@ -118,7 +146,7 @@ class NfccTransport {
    **                  -1         - write operation failure
    **
    *****************************************************************************/
-  virtual int Write(void *pDevHandle, uint8_t *pBuffer,
+  virtual int Write(void *pDevHandle, const uint8_t *pBuffer,
                     int nNbBytesToWrite) = 0;
 
   /*****************************************************************************
@@ -190,6 +218,23 @@ class NfccTransport {
    ****************************************************************************/
   virtual bool_t IsFwDnldModeEnabled(void);
 
+  /*****************************************************************************
+   **
+   ** Function         WaitForData
+   **
+   ** Description      Waits for the NFCC to signal pending data, IRQ line
+   **                  asserted, without reading it
+   **
+   ** Parameters       pDevHandle     - valid device handle
+   **                  nTimeoutMs     - maximum time to wait
+   **
+   ** Returns           1   - data pending
+   **                   0   - timeout
+   **                  -1   - not supported by the transport
+   **
+   ****************************************************************************/
+  virtual int WaitForData(void *pDevHandle, int nTimeoutMs);
+
   /*******************************************************************************
   **
   ** Function         Flushdata
@@ -203,6 +248,34 @@ class NfccTransport {
   *******************************************************************************/
   virtual bool Flushdata(pphTmlNfc_Config_t pConfig);
 
+  /*****************************************************************************
+   **
+   ** Function         GetWriteStats
+   **
+   ** Description      Copies the fragment timing statistics of Write
+   **
+   ** Parameters       pStats         - filled
+   **
+   ** Returns           0   - success
+   **                  -1   - not supported by the transport
+   **
+   ****************************************************************************/
+  virtual int GetWriteStats(NfccWriteStats_t *pStats);
+
+  /*****************************************************************************
+   **
+   ** Function         GetReadStats
+   **
+   ** Description      Copies the packet read statistics of Read
+   **
+   ** Parameters       pStats         - filled
+   **
+   ** Returns           0   - success
+   **                  -1   - not supported by the transport
+   **
+   ****************************************************************************/
+  virtual int GetReadStats(NfccReadStats_t *pStats);
+
   /*****************************************************************************
    **
    ** Function         ~NfccTransport
@@ -37,9 +37,13 @@
   * a configuration file will be selected dynamically and the device will be configured.
   */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <sys/stat.h>
+#include <atomic>
 #include <list>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <log/log.h>
@@ -77,6 +81,16 @@ typedef enum {
   CONF_FILE_NXP_RF,
   CONF_FILE_NXP_TRANSIT
 }tNXP_CONF_FILE;
+#define CONF_FILE_COUNT (CONF_FILE_NXP_TRANSIT + 1)
+
+static_assert(NXP_CONF_FILE_RF == CONF_FILE_NXP_RF &&
+                  NXP_CONF_FILE_TRANSIT == CONF_FILE_NXP_TRANSIT,
+              "conf file types out of sync with phNxpConfig.h");
+
+/* Serializes parameter lookups with runtime reload of the conf files */
+static pthread_mutex_t sConfigLock = PTHREAD_MUTEX_INITIALIZER;
+/* Bumped each time the settings change, see getNxpConfigGeneration() */
+static std::atomic<unsigned int> sConfigGeneration(0);
 
 const char rf_config_timestamp_path[] =
         "/data/vendor/nfc/libnfc-nxpRFConfigState.bin";
@@ -205,6 +219,7 @@ class CNfcConfig : public vector<const CNfcParam*> {
   friend void readOptionalConfig(const char* optional);
   bool isModified(tNXP_CONF_FILE aType);
   void resetModified(tNXP_CONF_FILE aType);
+  bool isOverlayEnabled() const { return mOverlayEnabled; }
 
   bool getValue(const char* name, char* pValue, size_t len) const;
   bool getValue(const char* name, unsigned long& rValue) const;
@@ -213,6 +228,8 @@ class CNfcConfig : public vector<const CNfcParam*> {
   const CNfcParam* find(const char* p_name) const;
   void readNxpTransitConfig(const char* fileName) const;
   void readNxpRFConfig(const char* fileName) const;
+  void applyOverlay(tNXP_CONF_FILE aType, const char* fileName,
+                    vector<string>* pChanged);
   void clean();
 
  private:
@@ -225,9 +242,17 @@ class CNfcConfig : public vector<const CNfcParam*> {
   void add(const CNfcParam* pParam);
   void dump();
   bool isAllowed(const char* name);
+  bool parseFile(const char* fileName, map<string, CNfcParam>& params);
+  CNfcParam getParam(const string& name) const;
+  bool setParam(const string& name, const CNfcParam& value);
   list<const CNfcParam*> m_list;
+  /* settings of the RF and transit files, applied over the main file */
+  map<string, CNfcParam> mOverlay[CONF_FILE_COUNT];
+  /* value each overlay setting hides, empty name if not set below */
+  map<string, CNfcParam> mShadow[CONF_FILE_COUNT];
   bool mValidFile;
   bool mDynamConfig;
+  bool mOverlayEnabled;
   uint32_t config_crc32_;
   uint32_t config_rf_crc32_;
   uint32_t config_tr_crc32_;
@@ -767,6 +792,7 @@ bool CNfcConfig::readConfig(const char* name, bool bResetContent) {
 CNfcConfig::CNfcConfig()
     : mValidFile(true),
       mDynamConfig(true),
+      mOverlayEnabled(false),
       config_crc32_(0),
       config_rf_crc32_(0),
       config_tr_crc32_(0),
@@ -850,6 +876,7 @@ CNfcConfig& CNfcConfig::GetInstance() {
     strlcpy(default_nxp_config_path, strPath.c_str(), MAX_DATA_CONFIG_PATH_LEN);
     theInstance.readConfig(strPath.c_str(), true);
 #if (NXP_EXTNS == TRUE)
+    theInstance.mOverlayEnabled = true;
     theInstance.readNxpRFConfig(nxp_rf_config_path);
     theInstance.readNxpTransitConfig(transit_config_path);
 #endif
@@ -981,7 +1008,8 @@ const CNfcParam* CNfcConfig::find(const char* p_name) const {
 *******************************************************************************/
 void CNfcConfig::readNxpTransitConfig(const char* fileName) const {
   ALOGD("readNxpTransitConfig-Enter..Reading %s", fileName);
-  CNfcConfig::GetInstance().readConfig(fileName, false);
+  CNfcConfig::GetInstance().applyOverlay(CONF_FILE_NXP_TRANSIT, fileName,
+                                         NULL);
 }
 
 /*******************************************************************************
@@ -995,7 +1023,136 @@ void CNfcConfig::readNxpTransitConfig(const char* fileName) const {
 *******************************************************************************/
 void CNfcConfig::readNxpRFConfig(const char* fileName) const {
   ALOGD("readNxpRFConfig-Enter..Reading %s", fileName);
-  CNfcConfig::GetInstance().readConfig(fileName, false);
+  CNfcConfig::GetInstance().applyOverlay(CONF_FILE_NXP_RF, fileName, NULL);
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::parseFile()
+**
+** Description: parse a conf file alone, current settings are left untouched
+**
+** Returns:     true if the file could be read
+**
+*******************************************************************************/
+bool CNfcConfig::parseFile(const char* fileName,
+                           map<string, CNfcParam>& params) {
+  vector<const CNfcParam*> current;
+  bool validFile = mValidFile;
+  bool found;
+
+  current.swap(*this);
+  found = readConfig(fileName, true);
+  for (iterator it = begin(), itEnd = end(); it != itEnd; ++it) {
+    params[string((*it)->c_str())] = **it;
+    delete *it;
+  }
+  clear();
+  swap(current);
+  mValidFile = validFile;
+  return found;
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::getParam()
+**
+** Description: get a copy of a setting
+**
+** Returns:     the setting, with an empty name if it does not exist
+**
+*******************************************************************************/
+CNfcParam CNfcConfig::getParam(const string& name) const {
+  for (const_iterator it = begin(), itEnd = end(); it != itEnd; ++it) {
+    if (**it == name) return **it;
+  }
+  return CNfcParam();
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::setParam()
+**
+** Description: replace, add or remove (empty value name) a setting,
+**              keeping the setting array sorted
+**
+** Returns:     true if the setting changed
+**
+*******************************************************************************/
+bool CNfcConfig::setParam(const string& name, const CNfcParam& value) {
+  iterator it = begin();
+
+  while (it != end() && **it < name) ++it;
+  if (it != end() && **it == name) {
+    if (!value.empty() && (*it)->numValue() == value.numValue() &&
+        strcmp((*it)->str_value(), value.str_value()) == 0 &&
+        (*it)->str_len() == value.str_len()) {
+      return false;
+    }
+    delete *it;
+    it = erase(it);
+  } else if (value.empty()) {
+    return false;
+  }
+  if (!value.empty()) insert(it, new CNfcParam(value));
+  sConfigGeneration.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::applyOverlay()
+**
+** Description: (re)apply the RF or transit conf file over the settings read
+**              before it. Settings the file no longer holds get back the
+**              value they had below it.
+**
+** Returns:     none, names of the settings which changed are appended to
+**              pChanged if not NULL
+**
+*******************************************************************************/
+void CNfcConfig::applyOverlay(tNXP_CONF_FILE aType, const char* fileName,
+                              vector<string>* pChanged) {
+  map<string, CNfcParam> params;
+  set<string> names;
+  map<string, CNfcParam>& shadow = mShadow[aType];
+  map<string, CNfcParam>& transit = mOverlay[CONF_FILE_NXP_TRANSIT];
+
+  if (!parseFile(fileName, params)) {
+    /* same as a fresh start without the file */
+    if (aType == CONF_FILE_NXP_RF)
+      config_rf_crc32_ = 0;
+    else
+      config_tr_crc32_ = 0;
+  }
+  for (auto& param : mOverlay[aType]) names.insert(param.first);
+  for (auto& param : params) names.insert(param.first);
+
+  for (const string& name : names) {
+    /* RF file sits below the transit file */
+    bool hidden = (aType == CONF_FILE_NXP_RF) && (transit.count(name) > 0);
+    CNfcParam below;
+    auto itShadow = shadow.find(name);
+    if (itShadow != shadow.end())
+      below = itShadow->second;
+    else if (hidden)
+      below = mShadow[CONF_FILE_NXP_TRANSIT][name];
+    else
+      below = getParam(name);
+
+    auto itParam = params.find(name);
+    CNfcParam value = (itParam != params.end()) ? itParam->second : below;
+    if (itParam != params.end())
+      shadow[name] = below;
+    else
+      shadow.erase(name);
+
+    if (hidden)
+      mShadow[CONF_FILE_NXP_TRANSIT][name] = value;
+    else if (setParam(name, value) && pChanged != NULL)
+      pChanged->push_back(name);
+  }
+  mOverlay[aType].swap(params);
 }
 
 /*******************************************************************************
@@ -1008,8 +1165,14 @@ void CNfcConfig::readNxpRFConfig(const char* fileName) const {
 **
 *******************************************************************************/
 void CNfcConfig::clean() {
+  mOverlayEnabled = false;
+  for (int i = 0; i < CONF_FILE_COUNT; i++) {
+    mOverlay[i].clear();
+    mShadow[i].clear();
+  }
   if (size() == 0) return;
 
+  sConfigGeneration.fetch_add(1, std::memory_order_release);
   for (iterator it = begin(), itEnd = end(); it != itEnd; ++it) delete *it;
   clear();
 }
@@ -1024,13 +1187,15 @@ void CNfcConfig::clean() {
 **
 *******************************************************************************/
 void CNfcConfig::add(const CNfcParam* pParam) {
-  if (m_list.size() == 0) {
-    m_list.push_back(pParam);
-    return;
-  }
+  /* checked first, the transit file alone may be parsed into an empty list */
   if ((mCurrentFile.find("nxpTransit") != std::string::npos) &&
       !isAllowed(pParam->c_str())) {
     ALOGD("%s Token restricted. Returning", __func__);
+    delete pParam;
+    return;
+  }
+  if (m_list.size() == 0) {
+    m_list.push_back(pParam);
     return;
   }
   for (list<const CNfcParam*>::iterator it = m_list.begin(),
@@ -1112,6 +1277,7 @@ void CNfcConfig::moveFromList() {
        it != itEnd; ++it)
     push_back(*it);
   m_list.clear();
+  sConfigGeneration.fetch_add(1, std::memory_order_release);
 }
 
 /*******************************************************************************
@@ -1160,8 +1326,10 @@ bool CNfcConfig::isModified(tNXP_CONF_FILE aType) {
   }
 
   fclose(fd);
-  ALOGD("stored_crc32 is %d config_crc32_ is %d", stored_crc32, config_crc32_);
 
+  /* a runtime reload may update the CRCs */
+  pthread_mutex_lock(&sConfigLock);
+  ALOGD("stored_crc32 is %d config_crc32_ is %d", stored_crc32, config_crc32_);
   switch (aType) {
     case CONF_FILE_NXP:
       isModified = stored_crc32 != config_crc32_;
@@ -1173,11 +1341,13 @@ bool CNfcConfig::isModified(tNXP_CONF_FILE aType) {
       isModified = stored_crc32 != config_tr_crc32_;
       break;
   }
+  pthread_mutex_unlock(&sConfigLock);
   return isModified;
 }
 
 void CNfcConfig::resetModified(tNXP_CONF_FILE aType) {
   FILE* fd = NULL;
+  uint32_t crc32 = 0;
 
   ALOGD("resetModified enter; conf file type is %d", aType);
   switch (aType) {
@@ -1200,17 +1370,21 @@ void CNfcConfig::resetModified(tNXP_CONF_FILE aType) {
     return;
   }
 
+  /* a runtime reload may update the CRCs */
+  pthread_mutex_lock(&sConfigLock);
   switch (aType) {
     case CONF_FILE_NXP:
-      fwrite(&config_crc32_, sizeof(uint32_t), 1, fd);
+      crc32 = config_crc32_;
       break;
     case CONF_FILE_NXP_RF:
-      fwrite(&config_rf_crc32_, sizeof(uint32_t), 1, fd);
+      crc32 = config_rf_crc32_;
       break;
     case CONF_FILE_NXP_TRANSIT:
-      fwrite(&config_tr_crc32_, sizeof(uint32_t), 1, fd);
+      crc32 = config_tr_crc32_;
       break;
   }
+  pthread_mutex_unlock(&sConfigLock);
+  fwrite(&crc32, sizeof(uint32_t), 1, fd);
   fclose(fd);
 }
 
@@ -1296,9 +1470,12 @@ void readOptionalConfig(const char* extra) {
 *******************************************************************************/
 extern "C" int GetNxpStrValue(const char* name, char* pValue,
                               unsigned long len) {
+  pthread_mutex_lock(&sConfigLock);
   CNfcConfig& rConfig = CNfcConfig::GetInstance();
+  int ret = rConfig.getValue(name, pValue, len);
+  pthread_mutex_unlock(&sConfigLock);
 
-  return rConfig.getValue(name, pValue, len);
+  return ret;
 }
 
 /*******************************************************************************
@@ -1320,9 +1497,12 @@ extern "C" int GetNxpStrValue(const char* name, char* pValue,
 *******************************************************************************/
 extern "C" int GetNxpByteArrayValue(const char* name, char* pValue,
                                     long bufflen, long* len) {
+  pthread_mutex_lock(&sConfigLock);
   CNfcConfig& rConfig = CNfcConfig::GetInstance();
+  int ret = rConfig.getValue(name, pValue, bufflen, len);
+  pthread_mutex_unlock(&sConfigLock);
 
-  return rConfig.getValue(name, pValue, bufflen, len);
+  return ret;
 }
 
 /*******************************************************************************
@@ -1338,10 +1518,14 @@ extern "C" int GetNxpNumValue(const char* name, void* pValue,
                               unsigned long len) {
   if (!pValue) return false;
 
+  pthread_mutex_lock(&sConfigLock);
   CNfcConfig& rConfig = CNfcConfig::GetInstance();
   const CNfcParam* pParam = rConfig.find(name);
 
-  if (pParam == NULL) return false;
+  if (pParam == NULL) {
+    pthread_mutex_unlock(&sConfigLock);
+    return false;
+  }
   unsigned long v = pParam->numValue();
   if (v == 0 && pParam->str_len() > 0 && pParam->str_len() < 4) {
     const unsigned char* p = (const unsigned char*)pParam->str_value();
@@ -1350,6 +1534,7 @@ extern "C" int GetNxpNumValue(const char* name, void* pValue,
       v += *p++;
     }
   }
+  pthread_mutex_unlock(&sConfigLock);
   switch (len) {
     case sizeof(unsigned long):
       *(static_cast<unsigned long*>(pValue)) = (unsigned long)v;
@@ -1408,9 +1593,11 @@ extern "C" void setNxpFwConfigPath(const char* name) {
 extern "C" void resetNxpConfig()
 
 {
+  pthread_mutex_lock(&sConfigLock);
   CNfcConfig& rConfig = CNfcConfig::GetInstance();
 
   rConfig.clean();
+  pthread_mutex_unlock(&sConfigLock);
 }
 
 /*******************************************************************************
@@ -1476,3 +1663,88 @@ extern "C" int updateNxpRfConfigTimestamp() {
   rConfig.resetModified(CONF_FILE_NXP_TRANSIT);
    return 0;
  }
+
+/*******************************************************************************
+**
+** Function:    updateNxpConfigFileTimestamp()
+**
+** Description: record the RF or transit conf file alone as applied, after a
+**              runtime reload sent all its changes to the NFCC
+**
+** Returns:     0 on success, -1 on invalid conf file
+**
+*******************************************************************************/
+extern "C" int updateNxpConfigFileTimestamp(int confFile) {
+  if (confFile != NXP_CONF_FILE_RF && confFile != NXP_CONF_FILE_TRANSIT)
+    return -1;
+  CNfcConfig& rConfig = CNfcConfig::GetInstance();
+  rConfig.resetModified((tNXP_CONF_FILE)confFile);
+  return 0;
+}
+
+/*******************************************************************************
+**
+** Function:    getNxpConfigFilePath()
+**
+** Description: get the path of a conf file which can be reloaded at runtime
+**
+** Returns:     path, NULL for an unknown conf file type
+**
+*******************************************************************************/
+extern "C" const char* getNxpConfigFilePath(int confFile) {
+  switch (confFile) {
+    case NXP_CONF_FILE_RF:
+      return nxp_rf_config_path;
+    case NXP_CONF_FILE_TRANSIT:
+      return transit_config_path;
+    default:
+      return NULL;
+  }
+}
+
+/*******************************************************************************
+**
+** Function:    reloadNxpConfigFile()
+**
+** Description: re-read the RF or transit conf file alone and update the
+**              settings it holds. pChangeCb is invoked, without the config
+**              lock held, for each setting whose value changed.
+**
+** Returns:     number of settings which changed, -1 on invalid conf file
+**
+*******************************************************************************/
+extern "C" int reloadNxpConfigFile(int confFile,
+                                   tNxpConfigChangeCback pChangeCb) {
+  vector<string> changed;
+  const char* fileName = getNxpConfigFilePath(confFile);
+
+  if (fileName == NULL) return -1;
+  ALOGD("%s: reloading %s", __func__, fileName);
+  pthread_mutex_lock(&sConfigLock);
+  CNfcConfig& rConfig = CNfcConfig::GetInstance();
+  /* the file is not in use with a static config */
+  if (rConfig.isOverlayEnabled())
+    rConfig.applyOverlay((tNXP_CONF_FILE)confFile, fileName, &changed);
+  pthread_mutex_unlock(&sConfigLock);
+
+  for (const string& name : changed) {
+    ALOGD("%s: %s changed", __func__, name.c_str());
+    if (pChangeCb != NULL) (*pChangeCb)(name.c_str());
+  }
+  return (int)changed.size();
+}
+
+/*******************************************************************************
+**
+** Function:    getNxpConfigGeneration()
+**
+** Description: get the generation of the settings, which changes each time
+**              a conf file is read, reloaded or the settings are reset.
+**              Lock free, for readers caching values derived from settings.
+**
+** Returns:     generation of the settings
+**
+*******************************************************************************/
+extern "C" unsigned int getNxpConfigGeneration() {
+  return sConfigGeneration.load(std::memory_order_acquire);
+}
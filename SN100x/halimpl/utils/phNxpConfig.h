@@ -55,6 +55,15 @@ int updateNxpRfConfigTimestamp();
 void setNxpRfConfigPath(const char* name);
 void setNxpFwConfigPath(const char* name);
 
+/* conf files which can be reloaded at runtime */
+#define NXP_CONF_FILE_RF 1
+#define NXP_CONF_FILE_TRANSIT 2
+typedef void (*tNxpConfigChangeCback)(const char* name);
+const char* getNxpConfigFilePath(int confFile);
+int updateNxpConfigFileTimestamp(int confFile);
+int reloadNxpConfigFile(int confFile, tNxpConfigChangeCback pChangeCb);
+unsigned int getNxpConfigGeneration(void);
+
 #ifdef __cplusplus
 };
 #endif
@@ -179,6 +188,16 @@ extern char Fw_Lib_Path[256];
 #define NAME_NXP_ENABLE_DISABLE_LOGS "NXP_ENABLE_DISABLE_LOGS"
 #define NAME_NXP_RDR_DISABLE_ENABLE_LPCD "NXP_RDR_DISABLE_ENABLE_LPCD"
 #define NAME_NXP_TRANSPORT "NXP_TRANSPORT"
+#define NAME_NXP_NCI_TRACE_CAPTURE "NXP_NCI_TRACE_CAPTURE"
+#define NAME_NXP_THREAD_POLICY_TML_READ "NXP_THREAD_POLICY_TML_READ"
+#define NAME_NXP_THREAD_POLICY_TML_WRITE "NXP_THREAD_POLICY_TML_WRITE"
+#define NAME_NXP_THREAD_POLICY_CLIENT "NXP_THREAD_POLICY_CLIENT"
+#define NAME_NXP_THREAD_MLOCK "NXP_THREAD_MLOCK"
+#define NAME_NXP_I2C_FRAGMENT_READY_POLL "NXP_I2C_FRAGMENT_READY_POLL"
+#define NAME_NXP_I2C_FRAMED_READ_LEN "NXP_I2C_FRAMED_READ_LEN"
+#define NAME_NXP_LIVENESS_IDLE_MS "NXP_LIVENESS_IDLE_MS"
+#define NAME_NXP_LIVENESS_PROBE_TIMEOUT_MS "NXP_LIVENESS_PROBE_TIMEOUT_MS"
+#define NAME_NXP_LIVENESS_MAX_MISSES "NXP_LIVENESS_MAX_MISSES"
 #define NAME_NXP_GET_HW_INFO_LOG "NXP_GET_HW_INFO_LOG"
 #define NAME_NXP_ISO_DEP_MERGE_SAK "NXP_ISO_DEP_MERGE_SAK"
 #define NAME_NXP_T4T_NDEF_NFCEE_AID "NXP_T4T_NDEF_NFCEE_AID"
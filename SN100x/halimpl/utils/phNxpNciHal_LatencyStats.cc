@@ -0,0 +1,355 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <phNxpLog.h>
+#include <phNxpNciHal_LatencyStats.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+
+#define LATENCY_MT_MASK 0xE0
+#define LATENCY_MT_DATA 0x00
+#define LATENCY_MT_CMD 0x20
+#define LATENCY_MT_RSP 0x40
+#define LATENCY_MT_NTF 0x60
+#define LATENCY_GID_MASK 0x0F
+#define LATENCY_OID_MASK 0x3F
+#define LATENCY_CONN_ID_MASK 0x0F
+#define LATENCY_NUM_GID 16
+#define LATENCY_NUM_OID 64
+#define LATENCY_NUM_CONN 16
+/* CORE_CONN_CREDITS_NTF: number of entries, then {conn id, credits} */
+#define LATENCY_GID_CORE 0x00
+#define LATENCY_OID_CORE_RESET 0x00
+#define LATENCY_OID_CORE_CONN_CREDITS 0x06
+#define LATENCY_CREDITS_NUM_OFFSET 3
+#define LATENCY_GID_RF 0x01
+#define LATENCY_OID_RF_DEACTIVATE 0x06
+/* static RF connection, its credits are reset on deactivation */
+#define LATENCY_CONN_ID_RF 0x00
+
+typedef struct {
+  std::atomic<uint16_t> wClass;
+  std::atomic<uint16_t> wOpcode;
+  std::atomic<uint32_t> dwCount;
+  std::atomic<uint32_t> dwMaxUs;
+  std::atomic<uint64_t> qwTotalUs;
+  std::atomic<uint32_t> dwHist[PH_NXP_LATENCY_HIST_BUCKETS];
+} phNxpNciHal_LatencyHistStats_t;
+
+/* Kept across HAL sessions, reset through the ioctl */
+static phNxpNciHal_LatencyHistStats_t sLatencyHist[PH_NXP_LATENCY_MAX_HISTS];
+static std::atomic<uint32_t> sLatencyNumHists;
+static std::atomic<uint32_t> sLatencyDropped;
+/* index + 1 of the histogram of each class, GID and OID, 0 if none yet */
+static std::atomic<uint8_t>
+    sLatencyHistIdx[PH_NXP_LATENCY_MAX][LATENCY_NUM_GID][LATENCY_NUM_OID];
+/* command waiting for its response, written time in us << 16 | GID << 8 |
+ * OID, 0 if none */
+static std::atomic<uint64_t> sLatencyPendingCmd;
+/* written time in us of the oldest data packet without credit, 0 if none */
+static std::atomic<uint64_t> sLatencyPendingData[LATENCY_NUM_CONN];
+
+static const char* const sLatencyClassName[PH_NXP_LATENCY_MAX] = {
+    "cmd_rsp", "ntf_delivery", "data_credit"};
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyNowUs
+**
+** Description      CLOCK_MONOTONIC time
+**
+** Returns          time in micro seconds
+**
+*******************************************************************************/
+uint64_t phNxpNciHal_latencyNowUs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyGetHist
+**
+** Description      Finds the histogram of an opcode, takes a free one when
+**                  the opcode is first seen
+**
+** Returns          Histogram, NULL if none is left
+**
+*******************************************************************************/
+static phNxpNciHal_LatencyHistStats_t* phNxpNciHal_latencyGetHist(
+    phNxpNciHal_LatencyClass_t eClass, uint8_t gid, uint8_t oid) {
+  std::atomic<uint8_t>* pIdx = &sLatencyHistIdx[eClass][gid][oid];
+  uint8_t idx = pIdx->load(std::memory_order_acquire);
+  uint32_t n;
+
+  if (idx != 0) return &sLatencyHist[idx - 1];
+  n = sLatencyNumHists.fetch_add(1, std::memory_order_relaxed);
+  if (n >= PH_NXP_LATENCY_MAX_HISTS) {
+    sLatencyNumHists.store(PH_NXP_LATENCY_MAX_HISTS,
+                           std::memory_order_relaxed);
+    return NULL;
+  }
+  sLatencyHist[n].wClass.store(eClass, std::memory_order_relaxed);
+  sLatencyHist[n].wOpcode.store((gid << 8) | oid, std::memory_order_relaxed);
+  if (pIdx->compare_exchange_strong(idx, n + 1, std::memory_order_acq_rel)) {
+    return &sLatencyHist[n];
+  }
+  /* taken by another thread meanwhile, this entry stays unused */
+  sLatencyHist[n].wClass.store(PH_NXP_LATENCY_MAX, std::memory_order_relaxed);
+  return &sLatencyHist[idx - 1];
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyRecord
+**
+** Description      Adds a sample to the histogram of an opcode
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_latencyRecord(phNxpNciHal_LatencyClass_t eClass,
+                                      uint8_t gid, uint8_t oid,
+                                      uint64_t qwStartUs, uint64_t qwEndUs) {
+  phNxpNciHal_LatencyHistStats_t* pHist =
+      phNxpNciHal_latencyGetHist(eClass, gid, oid);
+  uint64_t qwUs = (qwEndUs > qwStartUs) ? qwEndUs - qwStartUs : 0;
+  uint32_t dwUs = (qwUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)qwUs;
+  uint32_t dwMax;
+  int bucket = 0;
+
+  if (pHist == NULL) {
+    sLatencyDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if ((qwUs >> 6) != 0) {
+    bucket = 64 - __builtin_clzll(qwUs >> 6);
+    if (bucket >= PH_NXP_LATENCY_HIST_BUCKETS)
+      bucket = PH_NXP_LATENCY_HIST_BUCKETS - 1;
+  }
+  pHist->dwCount.fetch_add(1, std::memory_order_relaxed);
+  pHist->qwTotalUs.fetch_add(qwUs, std::memory_order_relaxed);
+  pHist->dwHist[bucket].fetch_add(1, std::memory_order_relaxed);
+  dwMax = pHist->dwMaxUs.load(std::memory_order_relaxed);
+  while (dwUs > dwMax &&
+         !pHist->dwMaxUs.compare_exchange_weak(dwMax, dwUs,
+                                               std::memory_order_relaxed)) {
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyOnTx
+**
+** Description      Starts the timing of a command or data packet, called
+**                  before it is written to the NFCC
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_latencyOnTx(const uint8_t* pData, uint16_t wLength) {
+  uint64_t qwNowUs;
+  uint64_t qwNone = 0;
+
+  if (pData == NULL || wLength < 3) return;
+  qwNowUs = phNxpNciHal_latencyNowUs();
+  switch (pData[0] & LATENCY_MT_MASK) {
+    case LATENCY_MT_CMD:
+      sLatencyPendingCmd.store((qwNowUs << 16) |
+                                   ((pData[0] & LATENCY_GID_MASK) << 8) |
+                                   (pData[1] & LATENCY_OID_MASK),
+                               std::memory_order_relaxed);
+      break;
+    case LATENCY_MT_DATA:
+      sLatencyPendingData[pData[0] & LATENCY_CONN_ID_MASK]
+          .compare_exchange_strong(qwNone, qwNowUs,
+                                   std::memory_order_relaxed);
+      break;
+    default:
+      break;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyOnRx
+**
+** Description      Ends the timing of the command matching a response, and
+**                  of the data packets of the connections given credits
+**
+** Parameters       pData     - packet read
+**                  wLength   - its length
+**                  qwRxUs    - time it was read
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_latencyOnRx(const uint8_t* pData, uint16_t wLength,
+                             uint64_t qwRxUs) {
+  uint8_t gid;
+  uint8_t oid;
+  uint64_t qwCmd;
+  uint64_t qwStartUs;
+
+  if (pData == NULL || wLength < 3) return;
+  gid = pData[0] & LATENCY_GID_MASK;
+  oid = pData[1] & LATENCY_OID_MASK;
+  switch (pData[0] & LATENCY_MT_MASK) {
+    case LATENCY_MT_RSP:
+      qwCmd = sLatencyPendingCmd.load(std::memory_order_relaxed);
+      if (qwCmd != 0 && (qwCmd & 0xFFFF) == (uint64_t)((gid << 8) | oid) &&
+          sLatencyPendingCmd.compare_exchange_strong(
+              qwCmd, 0, std::memory_order_relaxed)) {
+        phNxpNciHal_latencyRecord(PH_NXP_LATENCY_CMD_RSP, gid, oid,
+                                  qwCmd >> 16, qwRxUs);
+      }
+      break;
+    case LATENCY_MT_NTF:
+      if (gid == LATENCY_GID_CORE && oid == LATENCY_OID_CORE_CONN_CREDITS) {
+        /* number of entries follows the header */
+        if (wLength <= LATENCY_CREDITS_NUM_OFFSET) break;
+        for (int i = 0; i < pData[LATENCY_CREDITS_NUM_OFFSET]; i++) {
+          int offset = LATENCY_CREDITS_NUM_OFFSET + 1 + 2 * i;
+          uint8_t conn;
+          if (offset >= wLength) break;
+          conn = pData[offset] & LATENCY_CONN_ID_MASK;
+          qwStartUs = sLatencyPendingData[conn].exchange(
+              0, std::memory_order_relaxed);
+          if (qwStartUs != 0) {
+            phNxpNciHal_latencyRecord(PH_NXP_LATENCY_DATA_CREDIT, 0, conn,
+                                      qwStartUs, qwRxUs);
+          }
+        }
+      } else if (gid == LATENCY_GID_CORE && oid == LATENCY_OID_CORE_RESET) {
+        /* credits of all the connections are lost */
+        for (int i = 0; i < LATENCY_NUM_CONN; i++) {
+          sLatencyPendingData[i].store(0, std::memory_order_relaxed);
+        }
+      } else if (gid == LATENCY_GID_RF && oid == LATENCY_OID_RF_DEACTIVATE) {
+        sLatencyPendingData[LATENCY_CONN_ID_RF].store(
+            0, std::memory_order_relaxed);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyOnNtfDelivered
+**
+** Description      Times a notification from its read to its delivery to
+**                  libnfc-nci, called before the data callback
+**
+** Parameters       pData     - packet delivered
+**                  qwRxUs    - time it was read
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_latencyOnNtfDelivered(const uint8_t* pData, uint64_t qwRxUs) {
+  if (pData == NULL || (pData[0] & LATENCY_MT_MASK) != LATENCY_MT_NTF) return;
+  phNxpNciHal_latencyRecord(PH_NXP_LATENCY_NTF_DELIVERY,
+                            pData[0] & LATENCY_GID_MASK,
+                            pData[1] & LATENCY_OID_MASK, qwRxUs,
+                            phNxpNciHal_latencyNowUs());
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyStatsGet
+**
+** Description      Copies the histograms in use
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_latencyStatsGet(phNxpNciHal_LatencySnapshot_t* pSnapshot) {
+  uint32_t dwNum = sLatencyNumHists.load(std::memory_order_acquire);
+
+  memset(pSnapshot, 0x00, sizeof(*pSnapshot));
+  if (dwNum > PH_NXP_LATENCY_MAX_HISTS) dwNum = PH_NXP_LATENCY_MAX_HISTS;
+  pSnapshot->dwDropped = sLatencyDropped.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < dwNum; i++) {
+    phNxpNciHal_LatencyHistStats_t* pHist = &sLatencyHist[i];
+    phNxpNciHal_LatencyHist_t* pOut = &pSnapshot->tHist[pSnapshot->dwNumHists];
+    pOut->wClass = pHist->wClass.load(std::memory_order_relaxed);
+    if (pOut->wClass >= PH_NXP_LATENCY_MAX) continue;
+    pOut->wOpcode = pHist->wOpcode.load(std::memory_order_relaxed);
+    pOut->dwCount = pHist->dwCount.load(std::memory_order_relaxed);
+    pOut->dwMaxUs = pHist->dwMaxUs.load(std::memory_order_relaxed);
+    pOut->qwTotalUs = pHist->qwTotalUs.load(std::memory_order_relaxed);
+    for (int j = 0; j < PH_NXP_LATENCY_HIST_BUCKETS; j++) {
+      pOut->dwHist[j] = pHist->dwHist[j].load(std::memory_order_relaxed);
+    }
+    pSnapshot->dwNumHists++;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyStatsReset
+**
+** Description      Clears the histograms, the opcodes keep theirs
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_latencyStatsReset(void) {
+  for (int i = 0; i < PH_NXP_LATENCY_MAX_HISTS; i++) {
+    phNxpNciHal_LatencyHistStats_t* pHist = &sLatencyHist[i];
+    pHist->dwCount.store(0, std::memory_order_relaxed);
+    pHist->dwMaxUs.store(0, std::memory_order_relaxed);
+    pHist->qwTotalUs.store(0, std::memory_order_relaxed);
+    for (int j = 0; j < PH_NXP_LATENCY_HIST_BUCKETS; j++) {
+      pHist->dwHist[j].store(0, std::memory_order_relaxed);
+    }
+  }
+  sLatencyDropped.store(0, std::memory_order_relaxed);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_latencyStatsLog
+**
+** Description      Logs the histograms used. Called on HAL close.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_latencyStatsLog(void) {
+  phNxpNciHal_LatencySnapshot_t tSnapshot;
+
+  phNxpNciHal_latencyStatsGet(&tSnapshot);
+  for (uint32_t i = 0; i < tSnapshot.dwNumHists; i++) {
+    phNxpNciHal_LatencyHist_t* pHist = &tSnapshot.tHist[i];
+    if (pHist->dwCount == 0) continue;
+    NXPLOG_NCIHAL_D("latency %s 0x%02x 0x%02x: count %u, avg %llu us, max %u us",
+                    sLatencyClassName[pHist->wClass], pHist->wOpcode >> 8,
+                    pHist->wOpcode & 0xFF, pHist->dwCount,
+                    (unsigned long long)(pHist->qwTotalUs / pHist->dwCount),
+                    pHist->dwMaxUs);
+  }
+  if (tSnapshot.dwDropped != 0) {
+    NXPLOG_NCIHAL_D("latency: %u samples dropped", tSnapshot.dwDropped);
+  }
+}
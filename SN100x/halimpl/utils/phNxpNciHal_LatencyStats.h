@@ -0,0 +1,78 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Per opcode latency histograms of the NCI exchanges, always on.
+ *
+ *  - PH_NXP_LATENCY_CMD_RSP: command written to response read, by command
+ *  - PH_NXP_LATENCY_NTF_DELIVERY: notification read to its delivery to
+ *    libnfc-nci, by notification
+ *  - PH_NXP_LATENCY_DATA_CREDIT: data packet written to the credit returned
+ *    in CORE_CONN_CREDITS_NTF, by connection, for the oldest packet without
+ *    credit
+ *
+ * An opcode gets one of the PH_NXP_LATENCY_MAX_HISTS histograms when first
+ * seen; samples of opcodes seen once all are taken are counted as dropped.
+ * Updates are relaxed atomics. The histograms are kept across HAL sessions,
+ * read with HAL_NFC_IOCTL_GET_LATENCY_STATS and cleared with
+ * HAL_NFC_IOCTL_RESET_LATENCY_STATS.
+ */
+
+#ifndef _PHNXPNCIHAL_LATENCYSTATS_H_
+#define _PHNXPNCIHAL_LATENCYSTATS_H_
+
+#include <stdint.h>
+
+/* Latency buckets, bucket 0 is below 64 us, bucket n covers
+ * [2^(n+5), 2^(n+6)) us and the last one everything above */
+#define PH_NXP_LATENCY_HIST_BUCKETS 16
+#define PH_NXP_LATENCY_MAX_HISTS 64
+
+typedef enum {
+  PH_NXP_LATENCY_CMD_RSP = 0x00,
+  PH_NXP_LATENCY_NTF_DELIVERY,
+  PH_NXP_LATENCY_DATA_CREDIT,
+  PH_NXP_LATENCY_MAX
+} phNxpNciHal_LatencyClass_t;
+
+typedef struct {
+  uint16_t wClass;  /* phNxpNciHal_LatencyClass_t */
+  uint16_t wOpcode; /* GID << 8 | OID, connection id for data credits */
+  uint32_t dwCount;
+  uint32_t dwMaxUs;
+  uint64_t qwTotalUs;
+  uint32_t dwHist[PH_NXP_LATENCY_HIST_BUCKETS];
+} phNxpNciHal_LatencyHist_t;
+
+/* Snapshot returned by HAL_NFC_IOCTL_GET_LATENCY_STATS */
+typedef struct {
+  uint32_t dwNumHists; /* valid entries of tHist */
+  uint32_t dwDropped;
+  phNxpNciHal_LatencyHist_t tHist[PH_NXP_LATENCY_MAX_HISTS];
+} phNxpNciHal_LatencySnapshot_t;
+
+uint64_t phNxpNciHal_latencyNowUs(void);
+void phNxpNciHal_latencyOnTx(const uint8_t* pData, uint16_t wLength);
+void phNxpNciHal_latencyOnRx(const uint8_t* pData, uint16_t wLength,
+                             uint64_t qwRxUs);
+void phNxpNciHal_latencyOnNtfDelivered(const uint8_t* pData, uint64_t qwRxUs);
+void phNxpNciHal_latencyStatsGet(phNxpNciHal_LatencySnapshot_t* pSnapshot);
+void phNxpNciHal_latencyStatsReset(void);
+void phNxpNciHal_latencyStatsLog(void);
+
+#endif /* _PHNXPNCIHAL_LATENCYSTATS_H_ */
@@ -0,0 +1,347 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <errno.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal_LockStats.h>
+#include <string.h>
+#include <atomic>
+
+typedef struct {
+  std::atomic<uint64_t> qwCount;
+  std::atomic<uint64_t> qwContended;
+  std::atomic<uint64_t> qwTimeouts;
+  std::atomic<uint64_t> qwWaitTotalNs;
+  std::atomic<uint64_t> qwWaitMaxNs;
+  std::atomic<uint64_t> qwHoldTotalNs;
+  std::atomic<uint64_t> qwHoldMaxNs;
+  std::atomic<uint32_t> dwWaitHist[PH_NXP_LOCK_STATS_HIST_BUCKETS];
+  /* acquisition time of the current owner, hold time accounting */
+  std::atomic<uint64_t> qwAcquiredNs;
+} phNxpNciHal_LockSiteStats_t;
+
+/* Kept across HAL sessions, reset through the ioctl */
+static phNxpNciHal_LockSiteStats_t sLockStats[PH_NXP_LOCK_SITE_MAX];
+
+static const char* const sLockSiteName[PH_NXP_LOCK_SITE_MAX] = {
+    "monitor",       "write_cb",    "write_window", "mfc_ack",
+    "tml_busy_lock", "tml_wr_cmpl", "tml_rx_sem",   "tml_tx_sem",
+    "ext_cmd"};
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsNow
+**
+** Description      CLOCK_MONOTONIC time
+**
+** Returns          time in nano seconds
+**
+*******************************************************************************/
+uint64_t phNxpNciHal_lockStatsNow(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsAdd
+**
+** Description      Adds qwValue to a counter. The owner of a mutex site is
+**                  its only writer and does without the locked instruction.
+**
+** Returns          None
+**
+*******************************************************************************/
+template <typename T>
+static inline void phNxpNciHal_lockStatsAdd(std::atomic<T>* pCounter, T value,
+                                            bool bOwner) {
+  if (bOwner) {
+    pCounter->store(pCounter->load(std::memory_order_relaxed) + value,
+                    std::memory_order_relaxed);
+  } else {
+    pCounter->fetch_add(value, std::memory_order_relaxed);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsMax
+**
+** Description      Raises an atomic maximum to qwValue
+**
+** Returns          None
+**
+*******************************************************************************/
+static inline void phNxpNciHal_lockStatsMax(std::atomic<uint64_t>* pMax,
+                                            uint64_t qwValue) {
+  uint64_t qwCur = pMax->load(std::memory_order_relaxed);
+
+  while (qwValue > qwCur &&
+         !pMax->compare_exchange_weak(qwCur, qwValue,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsAddWait
+**
+** Description      Accounts an acquisition of the site
+**
+** Parameters       eSite     - lock site
+**                  qwWaitNs  - time spent waiting, 0 if not contended
+**                  bTimedOut - timed wait expired
+**                  bOwner    - called with the mutex of the site held
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_lockStatsAddWait(phNxpNciHal_LockSite_t eSite,
+                                         uint64_t qwWaitNs, bool bTimedOut,
+                                         bool bOwner) {
+  phNxpNciHal_LockSiteStats_t* pStats = &sLockStats[eSite];
+  uint64_t qwWaitUs = qwWaitNs / 1000;
+  int bucket = 0;
+
+  phNxpNciHal_lockStatsAdd<uint64_t>(&pStats->qwCount, 1, bOwner);
+  if (bTimedOut) {
+    phNxpNciHal_lockStatsAdd<uint64_t>(&pStats->qwTimeouts, 1, bOwner);
+  }
+  if (qwWaitNs != 0) {
+    phNxpNciHal_lockStatsAdd<uint64_t>(&pStats->qwContended, 1, bOwner);
+    phNxpNciHal_lockStatsAdd<uint64_t>(&pStats->qwWaitTotalNs, qwWaitNs,
+                                       bOwner);
+    phNxpNciHal_lockStatsMax(&pStats->qwWaitMaxNs, qwWaitNs);
+  }
+  if (qwWaitUs != 0) {
+    bucket = 64 - __builtin_clzll(qwWaitUs);
+    if (bucket >= PH_NXP_LOCK_STATS_HIST_BUCKETS)
+      bucket = PH_NXP_LOCK_STATS_HIST_BUCKETS - 1;
+  }
+  phNxpNciHal_lockStatsAdd<uint32_t>(&pStats->dwWaitHist[bucket], 1, bOwner);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsMutexLock
+**
+** Description      Locks pMutex and accounts the wait of the site
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_lockStatsMutexLock(phNxpNciHal_LockSite_t eSite,
+                                    pthread_mutex_t* pMutex) {
+  uint64_t qwStart = 0, qwNow;
+
+  if (pthread_mutex_trylock(pMutex) != 0) {
+    qwStart = phNxpNciHal_lockStatsNow();
+    pthread_mutex_lock(pMutex);
+  }
+  qwNow = phNxpNciHal_lockStatsNow();
+  sLockStats[eSite].qwAcquiredNs.store(qwNow, std::memory_order_relaxed);
+  phNxpNciHal_lockStatsAddWait(eSite, (qwStart != 0) ? (qwNow - qwStart) : 0,
+                               false, true);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsMutexUnlock
+**
+** Description      Accounts the hold time of the site and unlocks pMutex
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_lockStatsMutexUnlock(phNxpNciHal_LockSite_t eSite,
+                                      pthread_mutex_t* pMutex) {
+  phNxpNciHal_LockSiteStats_t* pStats = &sLockStats[eSite];
+  uint64_t qwAcquired = pStats->qwAcquiredNs.load(std::memory_order_relaxed);
+
+  if (qwAcquired != 0) {
+    uint64_t qwHold = phNxpNciHal_lockStatsNow() - qwAcquired;
+    phNxpNciHal_lockStatsAdd<uint64_t>(&pStats->qwHoldTotalNs, qwHold, true);
+    if (qwHold > pStats->qwHoldMaxNs.load(std::memory_order_relaxed))
+      pStats->qwHoldMaxNs.store(qwHold, std::memory_order_relaxed);
+  }
+  pthread_mutex_unlock(pMutex);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsSemWait
+**
+** Description      sem_wait restarted on EINTR, accounting the wait of the
+**                  site
+**
+** Returns          0 if the semaphore is taken, -1 otherwise
+**
+*******************************************************************************/
+int phNxpNciHal_lockStatsSemWait(phNxpNciHal_LockSite_t eSite, sem_t* pSem) {
+  uint64_t qwStart;
+  int s;
+
+  if (sem_trywait(pSem) == 0) {
+    phNxpNciHal_lockStatsAddWait(eSite, 0, false, false);
+    return 0;
+  }
+  qwStart = phNxpNciHal_lockStatsNow();
+  while ((s = sem_wait(pSem)) == -1 && errno == EINTR) {
+    continue; /* Restart if interrupted by handler */
+  }
+  phNxpNciHal_lockStatsAddWait(eSite, phNxpNciHal_lockStatsNow() - qwStart,
+                               false, false);
+  return s;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsSemTimedWait
+**
+** Description      sem_timedwait restarted on EINTR, accounting the wait and
+**                  the timeout of the site
+**
+** Returns          0 if the semaphore is taken, -1 with errno otherwise
+**
+*******************************************************************************/
+int phNxpNciHal_lockStatsSemTimedWait(phNxpNciHal_LockSite_t eSite,
+                                      sem_t* pSem,
+                                      const struct timespec* pAbsTimeout) {
+  uint64_t qwStart;
+  int s, err;
+
+  if (sem_trywait(pSem) == 0) {
+    phNxpNciHal_lockStatsAddWait(eSite, 0, false, false);
+    return 0;
+  }
+  qwStart = phNxpNciHal_lockStatsNow();
+  while ((s = sem_timedwait(pSem, pAbsTimeout)) == -1 && errno == EINTR) {
+    continue; /* Restart if interrupted by handler */
+  }
+  err = errno;
+  phNxpNciHal_lockStatsAddWait(eSite, phNxpNciHal_lockStatsNow() - qwStart,
+                               (s == -1 && err == ETIMEDOUT), false);
+  errno = err;
+  return s;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsRecordWait
+**
+** Description      Accounts a wait of the site done by the caller, e.g. on
+**                  a condition variable
+**
+** Parameters       eSite     - lock site
+**                  qwStartNs - phNxpNciHal_lockStatsNow() before the wait
+**                  bTimedOut - the wait expired
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_lockStatsRecordWait(phNxpNciHal_LockSite_t eSite,
+                                     uint64_t qwStartNs, bool bTimedOut) {
+  phNxpNciHal_lockStatsAddWait(eSite, phNxpNciHal_lockStatsNow() - qwStartNs,
+                               bTimedOut, false);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsGet
+**
+** Description      Copies the counters of all the sites. The sites are
+**                  updated concurrently, the snapshot is not atomic.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_lockStatsGet(phNxpNciHal_LockStatsSnapshot_t* pSnapshot) {
+  memset(pSnapshot, 0, sizeof(*pSnapshot));
+  pSnapshot->dwNumSites = PH_NXP_LOCK_SITE_MAX;
+  for (int i = 0; i < PH_NXP_LOCK_SITE_MAX; i++) {
+    phNxpNciHal_LockSiteStats_t* pStats = &sLockStats[i];
+    phNxpNciHal_LockStats_t* pOut = &pSnapshot->tSite[i];
+    pOut->qwCount = pStats->qwCount.load(std::memory_order_relaxed);
+    pOut->qwContended = pStats->qwContended.load(std::memory_order_relaxed);
+    pOut->qwTimeouts = pStats->qwTimeouts.load(std::memory_order_relaxed);
+    pOut->qwWaitTotalNs = pStats->qwWaitTotalNs.load(std::memory_order_relaxed);
+    pOut->qwWaitMaxNs = pStats->qwWaitMaxNs.load(std::memory_order_relaxed);
+    pOut->qwHoldTotalNs = pStats->qwHoldTotalNs.load(std::memory_order_relaxed);
+    pOut->qwHoldMaxNs = pStats->qwHoldMaxNs.load(std::memory_order_relaxed);
+    for (int j = 0; j < PH_NXP_LOCK_STATS_HIST_BUCKETS; j++) {
+      pOut->dwWaitHist[j] =
+          pStats->dwWaitHist[j].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsReset
+**
+** Description      Clears the counters of all the sites
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_lockStatsReset(void) {
+  for (int i = 0; i < PH_NXP_LOCK_SITE_MAX; i++) {
+    phNxpNciHal_LockSiteStats_t* pStats = &sLockStats[i];
+    pStats->qwCount.store(0, std::memory_order_relaxed);
+    pStats->qwContended.store(0, std::memory_order_relaxed);
+    pStats->qwTimeouts.store(0, std::memory_order_relaxed);
+    pStats->qwWaitTotalNs.store(0, std::memory_order_relaxed);
+    pStats->qwWaitMaxNs.store(0, std::memory_order_relaxed);
+    pStats->qwHoldTotalNs.store(0, std::memory_order_relaxed);
+    pStats->qwHoldMaxNs.store(0, std::memory_order_relaxed);
+    for (int j = 0; j < PH_NXP_LOCK_STATS_HIST_BUCKETS; j++) {
+      pStats->dwWaitHist[j].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lockStatsLog
+**
+** Description      Logs the counters of the sites used. Called on HAL close.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_lockStatsLog(void) {
+  phNxpNciHal_LockStatsSnapshot_t tSnapshot;
+
+  phNxpNciHal_lockStatsGet(&tSnapshot);
+  for (int i = 0; i < PH_NXP_LOCK_SITE_MAX; i++) {
+    phNxpNciHal_LockStats_t* pStats = &tSnapshot.tSite[i];
+    if (pStats->qwCount == 0) continue;
+    NXPLOG_NCIHAL_D(
+        "lock %s: count %llu, contended %llu, timeouts %llu, wait total %llu "
+        "us max %llu us, hold total %llu us max %llu us",
+        sLockSiteName[i], (unsigned long long)pStats->qwCount,
+        (unsigned long long)pStats->qwContended,
+        (unsigned long long)pStats->qwTimeouts,
+        (unsigned long long)(pStats->qwWaitTotalNs / 1000),
+        (unsigned long long)(pStats->qwWaitMaxNs / 1000),
+        (unsigned long long)(pStats->qwHoldTotalNs / 1000),
+        (unsigned long long)(pStats->qwHoldMaxNs / 1000));
+  }
+}
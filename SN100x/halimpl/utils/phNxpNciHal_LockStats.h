@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Contention accounting of the HAL and TML synchronization points.
+ *
+ * Each lock site counts its acquisitions, the ones which had to wait, the
+ * timed waits which expired, the total and max wait and hold times and a
+ * histogram of the wait times. Counters are updated with relaxed atomics,
+ * an uncontended mutex costs a trylock and two monotonic clock reads.
+ *
+ * The hold time is only tracked for mutexes released through
+ * phNxpNciHal_lockStatsMutexUnlock, one owner at a time.
+ */
+
+#ifndef _PHNXPNCIHAL_LOCKSTATS_H_
+#define _PHNXPNCIHAL_LOCKSTATS_H_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Wait time buckets, bucket 0 is below 1 us, bucket n covers
+ * [2^(n-1), 2^n) us and the last one everything above */
+#define PH_NXP_LOCK_STATS_HIST_BUCKETS 22
+
+typedef enum {
+  PH_NXP_LOCK_SITE_MONITOR = 0x00,    /* CONCURRENCY_LOCK */
+  PH_NXP_LOCK_SITE_WRITE_CB,          /* write_unlocked, TML write callback */
+  PH_NXP_LOCK_SITE_WRITE_WINDOW,      /* NCI command write window */
+  PH_NXP_LOCK_SITE_MFC_ACK,           /* MIFARE Classic ACK/NACK */
+  PH_NXP_LOCK_SITE_TML_BUSY_LOCK,     /* TML reader/writer sync, no hold */
+  PH_NXP_LOCK_SITE_TML_WRITE_COMPLETE,/* reader waiting for writer callback */
+  PH_NXP_LOCK_SITE_TML_RX_SEM,        /* reader thread waiting for a read */
+  PH_NXP_LOCK_SITE_TML_TX_SEM,        /* writer thread waiting for a write */
+  PH_NXP_LOCK_SITE_EXT_CMD,           /* HAL extension command */
+  PH_NXP_LOCK_SITE_MAX
+} phNxpNciHal_LockSite_t;
+
+typedef struct {
+  uint64_t qwCount;       /* acquisitions or waits */
+  uint64_t qwContended;   /* acquisitions which had to wait */
+  uint64_t qwTimeouts;    /* timed waits expired */
+  uint64_t qwWaitTotalNs;
+  uint64_t qwWaitMaxNs;
+  uint64_t qwHoldTotalNs;
+  uint64_t qwHoldMaxNs;
+  uint32_t dwWaitHist[PH_NXP_LOCK_STATS_HIST_BUCKETS];
+} phNxpNciHal_LockStats_t;
+
+/* Snapshot returned by HAL_NFC_IOCTL_GET_LOCK_STATS */
+typedef struct {
+  uint32_t dwNumSites; /* PH_NXP_LOCK_SITE_MAX */
+  phNxpNciHal_LockStats_t tSite[PH_NXP_LOCK_SITE_MAX];
+} phNxpNciHal_LockStatsSnapshot_t;
+
+uint64_t phNxpNciHal_lockStatsNow(void);
+void phNxpNciHal_lockStatsMutexLock(phNxpNciHal_LockSite_t eSite,
+                                    pthread_mutex_t* pMutex);
+void phNxpNciHal_lockStatsMutexUnlock(phNxpNciHal_LockSite_t eSite,
+                                      pthread_mutex_t* pMutex);
+int phNxpNciHal_lockStatsSemWait(phNxpNciHal_LockSite_t eSite, sem_t* pSem);
+int phNxpNciHal_lockStatsSemTimedWait(phNxpNciHal_LockSite_t eSite,
+                                      sem_t* pSem,
+                                      const struct timespec* pAbsTimeout);
+void phNxpNciHal_lockStatsRecordWait(phNxpNciHal_LockSite_t eSite,
+                                     uint64_t qwStartNs, bool bTimedOut);
+void phNxpNciHal_lockStatsGet(phNxpNciHal_LockStatsSnapshot_t* pSnapshot);
+void phNxpNciHal_lockStatsReset(void);
+void phNxpNciHal_lockStatsLog(void);
+
+#endif /* _PHNXPNCIHAL_LOCKSTATS_H_ */
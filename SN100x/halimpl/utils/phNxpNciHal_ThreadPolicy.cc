@@ -0,0 +1,233 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <errno.h>
+#include <phNxpConfig.h>
+#include <phNxpLog.h>
+#include <phNxpNciHal_ThreadPolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+/* {policy, priority, cpu mask (4 bytes)} */
+#define PH_NXP_THREAD_POLICY_CFG_LEN 6
+
+/* Indexed by phNxpNciHal_ThreadRole_t */
+static const char* const sPolicyCfg[PH_NXP_THREAD_MAX] = {
+    NAME_NXP_THREAD_POLICY_TML_READ, NAME_NXP_THREAD_POLICY_TML_WRITE,
+    NAME_NXP_THREAD_POLICY_CLIENT};
+static const char* const sRoleName[PH_NXP_THREAD_MAX] = {"tml_read",
+                                                         "tml_write", "client"};
+
+static pthread_once_t sMlockOnce = PTHREAD_ONCE_INIT;
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_threadPolicyMlock
+**
+** Description      Locks the current and future memory of the process, if
+**                  NXP_THREAD_MLOCK is set.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_threadPolicyMlock(void) {
+  unsigned long num = 0;
+
+  if (!GetNxpNumValue(NAME_NXP_THREAD_MLOCK, &num, sizeof(num)) || num == 0)
+    return;
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    NXPLOG_NCIHAL_E("%s: mlockall failed: %s", __func__, strerror(errno));
+  } else {
+    NXPLOG_NCIHAL_D("%s: memory locked", __func__);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_threadPolicyApply
+**
+** Description      Applies the configured scheduling class, priority and cpu
+**                  affinity of eRole to the calling thread. Called by each
+**                  thread when it starts.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_threadPolicyApply(phNxpNciHal_ThreadRole_t eRole) {
+  uint8_t cfg[PH_NXP_THREAD_POLICY_CFG_LEN] = {0};
+  struct sched_param param;
+  cpu_set_t cpus;
+  uint32_t mask;
+  long retlen = 0;
+  int policy;
+  int err;
+
+  if (eRole >= PH_NXP_THREAD_MAX) return;
+  if (!GetNxpByteArrayValue(sPolicyCfg[eRole], (char*)cfg, sizeof(cfg),
+                            &retlen) ||
+      retlen != PH_NXP_THREAD_POLICY_CFG_LEN) {
+    return;
+  }
+  pthread_once(&sMlockOnce, phNxpNciHal_threadPolicyMlock);
+
+  switch (cfg[0]) {
+    case PH_NXP_THREAD_POLICY_FIFO:
+      policy = SCHED_FIFO;
+      break;
+    case PH_NXP_THREAD_POLICY_RR:
+      policy = SCHED_RR;
+      break;
+    default:
+      policy = SCHED_OTHER;
+      break;
+  }
+  memset(&param, 0x00, sizeof(param));
+  if (policy != SCHED_OTHER) {
+    param.sched_priority =
+        std::min(std::max((int)cfg[1], sched_get_priority_min(policy)),
+                 sched_get_priority_max(policy));
+  }
+  err = pthread_setschedparam(pthread_self(), policy, &param);
+  if (err != 0) {
+    NXPLOG_NCIHAL_E("%s: %s: policy %d prio %d failed: %s", __func__,
+                    sRoleName[eRole], policy, param.sched_priority,
+                    strerror(err));
+  }
+
+  mask = cfg[2] | (cfg[3] << 8) | (cfg[4] << 16) | ((uint32_t)cfg[5] << 24);
+  if (mask != 0) {
+    CPU_ZERO(&cpus);
+    for (int i = 0; i < 32; i++) {
+      if (mask & (1U << i)) CPU_SET(i, &cpus);
+    }
+    /* 0 is the calling thread */
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+      NXPLOG_NCIHAL_E("%s: %s: cpu mask 0x%x failed: %s", __func__,
+                      sRoleName[eRole], mask, strerror(errno));
+    }
+  }
+  NXPLOG_NCIHAL_D("%s: %s: policy %d prio %d cpu mask 0x%x", __func__,
+                  sRoleName[eRole], policy, param.sched_priority, mask);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_threadPolicyProbeThread
+**
+** Description      Wakes up every period with the policy of the role and
+**                  records how late each wakeup was.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phNxpNciHal_threadPolicyProbeThread(void* arg) {
+  phNxpNciHal_JitterProbe_t* pProbe = (phNxpNciHal_JitterProbe_t*)arg;
+  std::vector<uint32_t> lateUs;
+  struct sched_param param;
+  struct timespec next, now;
+  uint64_t totalUs = 0;
+  int64_t lateNs;
+  int64_t nextNs;
+
+  phNxpNciHal_threadPolicyApply((phNxpNciHal_ThreadRole_t)pProbe->dwRole);
+  if (pthread_getschedparam(pthread_self(), &pProbe->dwPolicy, &param) == 0) {
+    pProbe->dwPriority = param.sched_priority;
+  }
+  lateUs.reserve(pProbe->dwIterations);
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  for (uint32_t i = 0; i < pProbe->dwIterations; i++) {
+    /* 64 bits, long is 32 bits on arm32 */
+    nextNs = (int64_t)next.tv_nsec + (int64_t)pProbe->dwPeriodUs * 1000;
+    next.tv_sec += (time_t)(nextNs / 1000000000LL);
+    next.tv_nsec = (long)(nextNs % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) ==
+           EINTR) {
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    lateNs = (int64_t)(now.tv_sec - next.tv_sec) * 1000000000LL +
+             (now.tv_nsec - next.tv_nsec);
+    lateUs.push_back((uint32_t)(std::max(lateNs, (int64_t)0) / 1000));
+    totalUs += lateUs.back();
+  }
+
+  pProbe->dwSamples = lateUs.size();
+  if (!lateUs.empty()) {
+    std::sort(lateUs.begin(), lateUs.end());
+    pProbe->dwMinUs = lateUs.front();
+    pProbe->dwMaxUs = lateUs.back();
+    pProbe->dwAvgUs = (uint32_t)(totalUs / lateUs.size());
+    pProbe->dwP99Us = lateUs[(lateUs.size() - 1) * 99 / 100];
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_threadPolicyProbe
+**
+** Description      Runs the wakeup jitter probe, see
+**                  phNxpNciHal_JitterProbe_t. Blocks for about
+**                  dwIterations * dwPeriodUs, at most
+**                  PH_NXP_JITTER_PROBE_MAX_DURATION_MS.
+**
+** Returns          0 on success, -1 on invalid or out of range parameter or
+**                  thread failure
+**
+*******************************************************************************/
+int phNxpNciHal_threadPolicyProbe(phNxpNciHal_JitterProbe_t* pProbe) {
+  pthread_t thread;
+
+  if (pProbe == NULL || pProbe->dwRole > PH_NXP_THREAD_MAX ||
+      pProbe->dwIterations == 0 ||
+      pProbe->dwIterations > PH_NXP_JITTER_PROBE_MAX_ITERATIONS ||
+      pProbe->dwPeriodUs < PH_NXP_JITTER_PROBE_MIN_PERIOD_US ||
+      pProbe->dwPeriodUs > PH_NXP_JITTER_PROBE_MAX_PERIOD_US) {
+    NXPLOG_NCIHAL_E("%s: invalid parameter", __func__);
+    return -1;
+  }
+  if ((uint64_t)pProbe->dwIterations * pProbe->dwPeriodUs >
+      (uint64_t)PH_NXP_JITTER_PROBE_MAX_DURATION_MS * 1000) {
+    NXPLOG_NCIHAL_E("%s: %u x %u us exceeds %u ms", __func__,
+                    pProbe->dwIterations, pProbe->dwPeriodUs,
+                    PH_NXP_JITTER_PROBE_MAX_DURATION_MS);
+    return -1;
+  }
+  pProbe->dwPolicy = SCHED_OTHER;
+  pProbe->dwPriority = 0;
+  pProbe->dwSamples = 0;
+  pProbe->dwMinUs = pProbe->dwAvgUs = pProbe->dwP99Us = pProbe->dwMaxUs = 0;
+  if (pthread_create(&thread, NULL, phNxpNciHal_threadPolicyProbeThread,
+                     pProbe) != 0) {
+    NXPLOG_NCIHAL_E("%s: pthread_create failed", __func__);
+    return -1;
+  }
+  pthread_join(thread, NULL);
+  NXPLOG_NCIHAL_D(
+      "%s: role %u policy %d prio %d, %u wakeups every %u us late by min %u "
+      "avg %u p99 %u max %u us",
+      __func__, pProbe->dwRole, pProbe->dwPolicy, pProbe->dwPriority,
+      pProbe->dwSamples, pProbe->dwPeriodUs, pProbe->dwMinUs, pProbe->dwAvgUs,
+      pProbe->dwP99Us, pProbe->dwMaxUs);
+  return 0;
+}
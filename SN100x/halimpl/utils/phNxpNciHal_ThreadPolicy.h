@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Scheduling policy of the HAL and TML threads.
+ *
+ * Each thread applies the policy of its role when it starts, read from
+ *   NXP_THREAD_POLICY_TML_READ, NXP_THREAD_POLICY_TML_WRITE and
+ *   NXP_THREAD_POLICY_CLIENT = {policy, priority, cpu mask (4 bytes, LSB
+ *   first)}
+ * with policy 0 for SCHED_OTHER, 1 for SCHED_FIFO and 2 for SCHED_RR, and
+ * a cpu mask of 0 for any cpu. A thread without a policy keeps the default
+ * one. NXP_THREAD_MLOCK=1 locks the memory of the process, once, when the
+ * first policy is applied.
+ *
+ * Real-time classes and mlockall need CAP_SYS_NICE, respectively
+ * CAP_IPC_LOCK, or matching rlimits for the service; a policy which cannot
+ * be applied is logged and the thread runs with the default one.
+ *
+ * HAL_NFC_IOCTL_RUN_JITTER_PROBE runs a periodic timer on a thread with the
+ * policy of a role and returns how late its wakeups were. It holds the
+ * binder thread of the caller, so a probe is limited to
+ * PH_NXP_JITTER_PROBE_MAX_DURATION_MS.
+ */
+
+#ifndef _PHNXPNCIHAL_THREADPOLICY_H_
+#define _PHNXPNCIHAL_THREADPOLICY_H_
+
+#include <stdint.h>
+
+typedef enum {
+  PH_NXP_THREAD_TML_READ = 0x00, /* phTmlNfc_TmlThread */
+  PH_NXP_THREAD_TML_WRITE,       /* phTmlNfc_TmlWriterThread */
+  PH_NXP_THREAD_CLIENT,          /* phNxpNciHal_client_thread */
+  PH_NXP_THREAD_MAX              /* probe only: default policy */
+} phNxpNciHal_ThreadRole_t;
+
+#define PH_NXP_THREAD_POLICY_OTHER 0x00
+#define PH_NXP_THREAD_POLICY_FIFO 0x01
+#define PH_NXP_THREAD_POLICY_RR 0x02
+
+#define PH_NXP_JITTER_PROBE_MAX_ITERATIONS 10000
+#define PH_NXP_JITTER_PROBE_MIN_PERIOD_US 100
+#define PH_NXP_JITTER_PROBE_MAX_PERIOD_US 100000
+/* dwIterations * dwPeriodUs */
+#define PH_NXP_JITTER_PROBE_MAX_DURATION_MS 2000
+
+/* HAL_NFC_IOCTL_RUN_JITTER_PROBE */
+typedef struct {
+  /* in */
+  uint32_t dwRole; /* phNxpNciHal_ThreadRole_t */
+  uint32_t dwIterations;
+  uint32_t dwPeriodUs;
+  /* out, wakeup lateness */
+  int32_t dwPolicy; /* in effect on the probe thread, SCHED_* */
+  int32_t dwPriority;
+  uint32_t dwSamples;
+  uint32_t dwMinUs;
+  uint32_t dwAvgUs;
+  uint32_t dwP99Us;
+  uint32_t dwMaxUs;
+} phNxpNciHal_JitterProbe_t;
+
+void phNxpNciHal_threadPolicyApply(phNxpNciHal_ThreadRole_t eRole);
+int phNxpNciHal_threadPolicyProbe(phNxpNciHal_JitterProbe_t* pProbe);
+
+#endif /* _PHNXPNCIHAL_THREADPOLICY_H_ */
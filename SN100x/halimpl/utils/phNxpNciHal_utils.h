@@ -21,6 +21,7 @@
 
 #include <assert.h>
 #include <phNfcStatus.h>
+#include <phNxpNciHal_LockStats.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <errno.h>
@@ -101,11 +102,15 @@ void phNxpNciHal_emergency_recovery(uint8_t status);
 #define REENTRANCE_UNLOCK()      \
   if (phNxpNciHal_get_monitor()) \
   pthread_mutex_unlock(&phNxpNciHal_get_monitor()->reentrance_mutex)
-#define CONCURRENCY_LOCK()       \
-  if (phNxpNciHal_get_monitor()) \
-  pthread_mutex_lock(&phNxpNciHal_get_monitor()->concurrency_mutex)
-#define CONCURRENCY_UNLOCK()     \
-  if (phNxpNciHal_get_monitor()) \
-  pthread_mutex_unlock(&phNxpNciHal_get_monitor()->concurrency_mutex)
+#define CONCURRENCY_LOCK()                                   \
+  if (phNxpNciHal_get_monitor())                             \
+  phNxpNciHal_lockStatsMutexLock(                            \
+      PH_NXP_LOCK_SITE_MONITOR,                              \
+      &phNxpNciHal_get_monitor()->concurrency_mutex)
+#define CONCURRENCY_UNLOCK()                                 \
+  if (phNxpNciHal_get_monitor())                             \
+  phNxpNciHal_lockStatsMutexUnlock(                          \
+      PH_NXP_LOCK_SITE_MONITOR,                              \
+      &phNxpNciHal_get_monitor()->concurrency_mutex)
 
 #endif /* _PHNXPNCIHAL_UTILS_H_ */
@@ -17,6 +17,7 @@
 #ifndef ICHANNEL_H_
 #define ICHANNEL_H_
 
+#include <stddef.h>
 #include "data_types.h"
 typedef enum InterfaceInfo{
   INTF_NFC = 0,
@@ -115,5 +116,171 @@ void (*doeSE_JcopDownLoadReset)();
 uint8_t (*getInterfaceInfo)();
 }IChannel_t;
 
+/* Version of IChannelExt_t filled by the channel provider */
+#define ICHANNEL_EXT_VERSION 2
+/* First version with the batched transceive */
+#define ICHANNEL_EXT_VERSION_BATCH 1
+/* First version with maxApduLen */
+#define ICHANNEL_EXT_VERSION_MAX_APDU_LEN 2
+/* Largest short command APDU, CLA INS P1 P2 Lc, 255 bytes of data and Le */
+#define ICHANNEL_SHORT_APDU_MAX_LEN 261
+/* Status word mask comparing SW1 and SW2 */
+#define ICHANNEL_SW_MASK_ALL 0xFFFF
+
+typedef struct IChannel_Apdu
+{
+    uint8_t* cmd;        /* command APDU */
+    int32_t  cmdLen;
+    uint8_t* rsp;        /* buffer for the response APDU */
+    int32_t  rspMaxLen;
+    int32_t  rspLen;     /* set for every APDU sent */
+}IChannel_Apdu_t;
+
+/* Completion of transceiveBatchAsync, called from the channel context */
+typedef void (*IChannel_BatchCb_t)(void* ctx, bool status, int32_t numDone);
+
+/*
+ * Optional batched transceive of the channel, kept apart from IChannel_t
+ * whose layout is shared with the existing providers.
+ *
+ * The APDUs are sent in order. A response whose status word does not match
+ * expectedSw under swMask stops the batch, numDone is then the index of that
+ * APDU and its response is available. numDone equals num when every response
+ * matched. A transport failure returns false with numDone APDUs matched.
+ *
+ * No provider fills it yet: the eSE HAL only hands out IChannel_t, and
+ * JCDNLD_Init and performLSDownload pass no extension. Until a provider
+ * calls JCDNLD_InitExt or performLSDownloadExt, IChannel_TransceiveBatch
+ * always takes its per APDU fallback and transceiveBatchAsync is not used.
+ */
+typedef struct IChannelExt
+{
+    uint16_t version;
+
+/*******************************************************************************
+**
+** Function:        transceiveBatch
+**
+** Description:     Send a batch of APDUs to the secure element; read their
+**                  responses until a status word mismatch.
+**                  apdus: APDUs to transmit and their response buffers.
+**                  num: Number of APDUs.
+**                  expectedSw: Status word of a successful response.
+**                  swMask: Bits of the status word to compare.
+**                  numDone: Number of APDUs with the expected status word.
+**                  timeoutMillisec: timeout in millisecond, for each APDU
+**
+** Returns:         True if ok.
+**
+*******************************************************************************/
+bool (*transceiveBatch) (IChannel_Apdu_t* apdus, int32_t num, uint16_t expectedSw,
+                     uint16_t swMask, int32_t& numDone, int32_t timeoutMillisec);
+
+/*******************************************************************************
+**
+** Function:        transceiveBatchAsync
+**
+** Description:     Same as transceiveBatch, returns once the batch is queued.
+**                  The APDUs must remain valid until cb is called with the
+**                  status and numDone of the batch.
+**
+** Returns:         True if queued, cb is not called otherwise.
+**
+*******************************************************************************/
+bool (*transceiveBatchAsync) (IChannel_Apdu_t* apdus, int32_t num, uint16_t expectedSw,
+                     uint16_t swMask, int32_t timeoutMillisec, IChannel_BatchCb_t cb,
+                     void* ctx);
+
+/*******************************************************************************
+**
+** Variable:        maxApduLen
+**
+** Description:     Largest command APDU accepted by both the channel and the
+**                  secure element, above ICHANNEL_SHORT_APDU_MAX_LEN when they
+**                  support extended length APDUs. 0 if unknown. Only read
+**                  when version is ICHANNEL_EXT_VERSION_MAX_APDU_LEN or more.
+**                  A provider would derive it from its transport and the eSE
+**                  ATR; as no provider exists yet, it is never set.
+**
+*******************************************************************************/
+int32_t maxApduLen;
+}IChannelExt_t;
+
+/*******************************************************************************
+**
+** Function:        IChannelExt_Size
+**
+** Description:     Size of the IChannelExt_t filled by a provider of the
+**                  given version, which may predate the last members.
+**
+** Returns:         Size in bytes.
+**
+*******************************************************************************/
+static inline size_t IChannelExt_Size(uint16_t version)
+{
+    return (version >= ICHANNEL_EXT_VERSION_MAX_APDU_LEN) ? sizeof(IChannelExt_t)
+                                                          : offsetof(IChannelExt_t, maxApduLen);
+}
+
+/*******************************************************************************
+**
+** Function:        IChannelExt_MaxApduLen
+**
+** Description:     Largest command APDU of the channel, see maxApduLen.
+**
+** Returns:         Length in bytes, ICHANNEL_SHORT_APDU_MAX_LEN if unknown.
+**
+*******************************************************************************/
+static inline int32_t IChannelExt_MaxApduLen(const IChannelExt_t* channelExt)
+{
+    if((channelExt == NULL) || (channelExt->version < ICHANNEL_EXT_VERSION_MAX_APDU_LEN) ||
+       (channelExt->maxApduLen < ICHANNEL_SHORT_APDU_MAX_LEN))
+    {
+        return ICHANNEL_SHORT_APDU_MAX_LEN;
+    }
+    return channelExt->maxApduLen;
+}
+
+/*******************************************************************************
+**
+** Function:        IChannel_TransceiveBatch
+**
+** Description:     Sends a batch through IChannelExt_t when the channel
+**                  supports it, one APDU at a time with transceive otherwise.
+**                  Same semantic as transceiveBatch.
+**
+** Returns:         True if ok.
+**
+*******************************************************************************/
+static inline bool IChannel_TransceiveBatch(IChannel_t* channel, IChannelExt_t* channelExt,
+                     IChannel_Apdu_t* apdus, int32_t num, uint16_t expectedSw,
+                     uint16_t swMask, int32_t& numDone, int32_t timeoutMillisec)
+{
+    numDone = 0;
+    if((channelExt != NULL) && (channelExt->version >= ICHANNEL_EXT_VERSION_BATCH) &&
+       (channelExt->transceiveBatch != NULL))
+    {
+        return channelExt->transceiveBatch(apdus, num, expectedSw, swMask,
+                                           numDone, timeoutMillisec);
+    }
+    for(; numDone < num; numDone++)
+    {
+        IChannel_Apdu_t* pApdu = &apdus[numDone];
+        pApdu->rspLen = 0;
+        if(!channel->transceive(pApdu->cmd, pApdu->cmdLen, pApdu->rsp,
+                                pApdu->rspMaxLen, pApdu->rspLen, timeoutMillisec))
+        {
+            return false;
+        }
+        if((pApdu->rspLen < 2) ||
+           ((((pApdu->rsp[pApdu->rspLen - 2] << 8) | pApdu->rsp[pApdu->rspLen - 1]) &
+             swMask) != (expectedSw & swMask)))
+        {
+            break;
+        }
+    }
+    return true;
+}
+
 
 #endif /* ICHANNEL_H_ */
@@ -29,6 +29,20 @@
 *******************************************************************************/
 unsigned char JCDNLD_Init(IChannel *channel);
 
+/*******************************************************************************
+**
+** Function:        JCDNLD_InitExt
+**
+** Description:     Initializes the JCOP library and opens the DWP communication
+**                  channel, the image is sent through the batched transceive
+**                  of channelExt. No eSE HAL calls it yet, JCDNLD_Init
+**                  passes a NULL channelExt.
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+unsigned char JCDNLD_InitExt(IChannel *channel, IChannelExt_t *channelExt);
+
 /*******************************************************************************
 **
 ** Function:        JCDNLD_StartDownload
@@ -16,6 +16,7 @@
 
 #include "data_types.h"
 #include "IChannel.h"
+#include <semaphore.h>
 #include <stdio.h>
 
 typedef struct JcopOs_TranscieveInfo
@@ -35,6 +36,21 @@ typedef struct JcopOs_Version_Info
     uint8_t OtherValid;
     uint8_t ver_status;
 }JcopOs_Version_Info_t;
+/* Progress inside an image file, saved every JCOP_CKPT_INTERVAL APDUs */
+typedef struct JcopOs_Checkpoint
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t  cur_state;   /* image file being loaded */
+    uint8_t  reserved;
+    uint32_t fls_size;
+    uint32_t fls_hash;    /* the image file must not have changed */
+    uint32_t offset;      /* file offset of the next APDU */
+    uint32_t apdu_index;  /* APDUs acknowledged so far */
+    JcopOs_Version_Info_t version_info; /* GetInfo before the image load */
+    uint32_t crc;         /* hash of all the fields above */
+}JcopOs_Checkpoint_t;
+
 typedef struct JcopOs_ImageInfo
 {
     FILE *fp;
@@ -43,6 +59,7 @@ typedef struct JcopOs_ImageInfo
     int   index;
     uint8_t cur_state;
     JcopOs_Version_Info_t    version_info;
+    bool  resumed;        /* image load started from a checkpoint */
 }JcopOs_ImageInfo_t;
 typedef struct JcopOs_Dwnld_Context
 {
@@ -50,6 +67,7 @@ typedef struct JcopOs_Dwnld_Context
     JcopOs_ImageInfo_t       Image_info;
     JcopOs_TranscieveInfo_t  pJcopOs_TransInfo;
     IChannel_t               *channel;
+    IChannelExt_t            channelExt;  /* zeroed if not supported */
 }JcopOs_Dwnld_Context_t,*pJcopOs_Dwnld_Context_t;
 
 
@@ -80,6 +98,28 @@ static uint8_t Uai_GetInfo_APDU[] = {0x80,0xCA,0x00,0xFE,0x02,0xDF,0x43,0x00};
 
 #define JCOP_MAX_BUF_SIZE 10240
 
+#define JCOP_CKPT_MAGIC    0x4A434B50 /* "JCKP" */
+#define JCOP_CKPT_VERSION  0x0002
+/* Acknowledged APDUs between two checkpoints */
+#define JCOP_CKPT_INTERVAL 16
+
+/* APDUs of the image sent in one batch */
+#define JCOP_BATCH_MAX_APDUS 8
+
+/* APDUs of the image in flight, the next batch is read from the image file
+ * while the current one is processed by the eSE */
+typedef struct JcopOs_Batch
+{
+    IChannel_Apdu_t apdu[JCOP_BATCH_MAX_APDUS];
+    uint32_t offset[JCOP_BATCH_MAX_APDUS]; /* file offset after each APDU */
+    int32_t  num;
+    int32_t  numDone;     /* APDUs answered with 9000 */
+    bool     stat;        /* transceive status */
+    bool     readFailed;  /* image read error after the APDUs */
+    bool     pending;     /* queued to transceiveBatchAsync */
+    sem_t    done;
+}JcopOs_Batch_t;
+
 class JcopOsDwnld
 {
 public:
@@ -118,7 +158,7 @@ bool getJcopOsFileInfo();
 ** Returns:         True if ok.
 **
 *******************************************************************************/
-bool initialize (IChannel_t *channel);
+bool initialize (IChannel_t *channel, IChannelExt_t *channelExt = NULL);
 
 /*******************************************************************************
 **
@@ -152,4 +192,11 @@ static JcopOsDwnld sJcopDwnld;
 bool mIsInit;
 tJBL_STATUS GetJcopOsState(JcopOs_ImageInfo_t *Os_info, uint8_t *counter);
 tJBL_STATUS SetJcopOsState(JcopOs_ImageInfo_t *Os_info, uint8_t state);
+bool GetJcopOsCheckpoint(JcopOs_ImageInfo_t *Os_info, uint32_t fls_hash, JcopOs_Checkpoint_t *pCkpt);
+tJBL_STATUS SetJcopOsCheckpoint(JcopOs_Checkpoint_t *pCkpt);
+void ClearJcopOsCheckpoint();
+int ReadJcopOsApdu(FILE *fp, uint8_t *pBuf, int32_t *pLen);
+void FillJcopOsBatch(JcopOs_ImageInfo_t *Os_info, JcopOs_Batch_t *pBatch);
+bool SendJcopOsBatch(JcopOs_Batch_t *pBatch, int32_t timeout);
+void WaitJcopOsBatch(JcopOs_Batch_t *pBatch);
 };
@@ -37,7 +37,23 @@ extern pJcopOs_Dwnld_Context_t gpJcopOs_Dwnld_Context;
 *******************************************************************************/
 tJBL_STATUS JCDNLD_Init(IChannel_t *channel)
 {
-    static const char fn[] = "JCDNLD_Init";
+    return JCDNLD_InitExt(channel, NULL);
+}
+
+/*******************************************************************************
+**
+** Function:        JCDNLD_InitExt
+**
+** Description:     Initializes the JCOP library and opens the DWP communication
+**                  channel, the image is sent through the batched transceive
+**                  of channelExt
+**
+** Returns:         true if ok.
+**
+*******************************************************************************/
+tJBL_STATUS JCDNLD_InitExt(IChannel_t *channel, IChannelExt_t *channelExt)
+{
+    static const char fn[] = "JCDNLD_InitExt";
     bool    stat = false;
     jcHandle = EE_ERROR_OPEN_FAIL;
     DLOG_IF(INFO, nfc_debug_enabled)
@@ -54,7 +70,7 @@ tJBL_STATUS JCDNLD_Init(IChannel_t *channel)
     /*TODO: inUse assignment should be with protection like using semaphore*/
     inUse = true;
     jd = JcopOsDwnld::getInstance();
-    stat = jd->initialize (channel);
+    stat = jd->initialize (channel, channelExt);
     if(stat != true)
     {
         LOG(ERROR) << StringPrintf("%s: failed", fn);
@@ -23,6 +23,9 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <libgen.h>
 
 using android::base::StringPrintf;
 
@@ -52,9 +55,27 @@ static const char *path[3] = {"/vendor/etc/JcopOs_Update1.apdu",
 static const char *JCOP_INFO_PATH[2] = {"/data/vendor/nfc/jcop_info.txt",
                             "/data/vendor/secure_element/jcop_info.txt"};
 
+static const char *JCOP_CKPT_PATH[2] = {"/data/vendor/nfc/jcop_ckpt.bin",
+                            "/data/vendor/secure_element/jcop_ckpt.bin"};
+
 static const char *uai_path[2] = {"/vendor/etc/cci.apdu",
                                   "/vendor/etc/jci.apdu"};
 
+#define JCOP_HASH_INIT 0x811C9DC5
+
+/* FNV-1a, used to identify the image file and the responses. Its
+ * multiplication wraps by design. */
+__attribute__((no_sanitize("unsigned-integer-overflow")))
+static uint32_t JcopOs_Hash(uint32_t hash, const uint8_t *pData, size_t len)
+{
+    for(size_t i = 0; i < len; i++)
+    {
+        hash ^= pData[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
 inline int FSCANF_BYTE(FILE *stream, const char *format, void* pVal)
 {
     int Result = 0;
@@ -142,11 +163,12 @@ bool JcopOsDwnld::getJcopOsFileInfo()
 **
 ** Description:     Initialize all member variables.
 **                  native: Native data.
+**                  channelExt: batched transceive of the channel, optional
 **
 ** Returns:         True if ok.
 **
 *******************************************************************************/
-bool JcopOsDwnld::initialize (IChannel_t *channel)
+bool JcopOsDwnld::initialize (IChannel_t *channel, IChannelExt_t *channelExt)
 {
     static const char fn [] = "JcopOsDwnld::initialize";
     isUaiEnabled = false;
@@ -194,6 +216,11 @@ bool JcopOsDwnld::initialize (IChannel_t *channel)
     }
     mIsInit = true;
     memcpy(gpJcopOs_Dwnld_Context->channel, channel, sizeof(IChannel_t));
+    if(channelExt != NULL)
+    {
+        memcpy(&gpJcopOs_Dwnld_Context->channelExt, channelExt,
+               IChannelExt_Size(channelExt->version));
+    }
     DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf ("%s: exit", fn);
     return (true);
@@ -750,13 +777,20 @@ tJBL_STATUS JcopOsDwnld::GetInfo(JcopOs_ImageInfo_t* pImageInfo, tJBL_STATUS sta
 tJBL_STATUS JcopOsDwnld::load_JcopOS_image(JcopOs_ImageInfo_t *Os_info, tJBL_STATUS status, JcopOs_TranscieveInfo_t *pTranscv_Info)
 {
     static const char fn [] = "JcopOsDwnld::load_JcopOS_image";
-    bool stat = false;
     int wResult;
-    int32_t wIndex,wCount=0;
-    int32_t wLen;
+    int32_t i;
+    uint32_t fls_hash = JCOP_HASH_INIT;
+    uint32_t resume_index = 0;
+    uint8_t readBuf[1024];
+    size_t readLen;
+    JcopOs_Checkpoint_t ckpt;
+    JcopOs_Batch_t batch[2];
+    JcopOs_Batch_t *pCur, *pNext;
+    IChannel_Apdu_t *pApdu;
+    uint8_t *pBatchBuf = NULL;
+    bool async, refill;
 
     IChannel_t *mchannel = gpJcopOs_Dwnld_Context->channel;
-    int32_t recvBufferActualSize = 0;
     DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: enter", fn);
     if(Os_info == NULL ||
@@ -765,6 +799,8 @@ tJBL_STATUS JcopOsDwnld::load_JcopOS_image(JcopOs_ImageInfo_t *Os_info, tJBL_STA
         LOG(ERROR) << StringPrintf("%s: invalid parameter", fn);
         return status;
     }
+    Os_info->resumed = false;
+    memset(&ckpt, 0, sizeof(ckpt));
     Os_info->fp = fopen(Os_info->fls_path, "r");
 
     if (Os_info->fp == NULL) {
@@ -772,6 +808,23 @@ tJBL_STATUS JcopOsDwnld::load_JcopOS_image(JcopOs_ImageInfo_t *Os_info, tJBL_STA
                     Os_info->fls_path, strerror(errno));
         return STATUS_FILE_NOT_FOUND;
     }
+    /* command and response buffers of both batches */
+    pBatchBuf = (uint8_t*)malloc(2 * JCOP_BATCH_MAX_APDUS *
+                                 (JCOP_MAX_BUF_SIZE + sizeof(pTranscv_Info->sRecvData)));
+    if (pBatchBuf == NULL) {
+        LOG(ERROR) << StringPrintf("%s: Memory allocation for batch is failed", fn);
+        goto exit;
+    }
+    memset(batch, 0, sizeof(batch));
+    for (i = 0; i < 2 * JCOP_BATCH_MAX_APDUS; i++) {
+        pApdu = &batch[i / JCOP_BATCH_MAX_APDUS].apdu[i % JCOP_BATCH_MAX_APDUS];
+        pApdu->cmd = &pBatchBuf[i * (JCOP_MAX_BUF_SIZE + sizeof(pTranscv_Info->sRecvData))];
+        pApdu->rsp = pApdu->cmd + JCOP_MAX_BUF_SIZE;
+        pApdu->rspMaxLen = sizeof(pTranscv_Info->sRecvData);
+    }
+    sem_init(&batch[0].done, 0, 0);
+    sem_init(&batch[1].done, 0, 0);
+
     wResult = fseek(Os_info->fp, 0L, SEEK_END);
     if (wResult) {
         LOG(ERROR) << StringPrintf("Error seeking end OS image file %s", strerror(errno));
@@ -787,99 +840,123 @@ tJBL_STATUS JcopOsDwnld::load_JcopOS_image(JcopOs_ImageInfo_t *Os_info, tJBL_STA
         LOG(ERROR) << StringPrintf("Error seeking start image file %s", strerror(errno));
         goto exit;
     }
-    while(!feof(Os_info->fp))
+    while((readLen = fread(readBuf, 1, sizeof(readBuf), Os_info->fp)) > 0)
     {
-        LOG(ERROR) << StringPrintf("%s; Start of line processing", fn);
+        fls_hash = JcopOs_Hash(fls_hash, readBuf, readLen);
+    }
+    rewind(Os_info->fp);
 
-        wIndex=0;
-        wLen=0;
-        wCount=0;
-        memset(pTranscv_Info->sSendData,0x00,JCOP_MAX_BUF_SIZE);
-        pTranscv_Info->sSendlength=0;
+    /* Resume from the last checkpoint of this image, if the image and the
+     * eSE state reported by GetInfo did not change since */
+    if(GetJcopOsCheckpoint(Os_info, fls_hash, &ckpt) &&
+       fseek(Os_info->fp, ckpt.offset, SEEK_SET) == 0)
+    {
+        LOG(ERROR) << StringPrintf("%s: resuming at APDU %u, offset %u", fn,
+                                   ckpt.apdu_index, ckpt.offset);
+        Os_info->resumed = true;
+    }
+    else
+    {
+        rewind(Os_info->fp);
+        memset(&ckpt, 0, sizeof(ckpt));
+        ckpt.magic = JCOP_CKPT_MAGIC;
+        ckpt.version = JCOP_CKPT_VERSION;
+        ckpt.cur_state = Os_info->cur_state;
+        ckpt.fls_size = (uint32_t)Os_info->fls_size;
+        ckpt.fls_hash = fls_hash;
+        ckpt.version_info = Os_info->version_info;
+    }
+    resume_index = ckpt.apdu_index;
 
-        LOG(ERROR) << StringPrintf("%s; wIndex = 0", fn);
-        for(wCount =0; (wCount < 5 && !feof(Os_info->fp)); wCount++, wIndex++)
-        {
-            wResult = FSCANF_BYTE(Os_info->fp,"%2X",&pTranscv_Info->sSendData[wIndex]);
-        }
-        if(wResult != 0)
+    pCur = &batch[0];
+    FillJcopOsBatch(Os_info, pCur);
+    while(pCur->num > 0 || pCur->readFailed)
+    {
+        pNext = (pCur == &batch[0]) ? &batch[1] : &batch[0];
+        pNext->num = 0;
+        pNext->readFailed = false;
+        async = false;
+        if(pCur->num > 0)
         {
-            wLen = pTranscv_Info->sSendData[4];
-            LOG(ERROR) << StringPrintf("%s; Read 5byes success & len=%d", fn,wLen);
-            if(wLen == 0x00)
+            LOG(ERROR) << StringPrintf("%s: start transceive of %d APDUs", fn, pCur->num);
+            async = SendJcopOsBatch(pCur, pTranscv_Info->timeout);
+            if(async)
             {
-                LOG(ERROR) << StringPrintf("%s: Extended APDU", fn);
-                wResult = FSCANF_BYTE(Os_info->fp,"%2X",&pTranscv_Info->sSendData[wIndex++]);
-                wResult = FSCANF_BYTE(Os_info->fp,"%2X",&pTranscv_Info->sSendData[wIndex++]);
-                wLen = ((pTranscv_Info->sSendData[5] << 8) | (pTranscv_Info->sSendData[6]));
-            }
-            for(wCount =0; (wCount < wLen && !feof(Os_info->fp)); wCount++, wIndex++)
-            {
-                wResult = FSCANF_BYTE(Os_info->fp,"%2X",&pTranscv_Info->sSendData[wIndex]);
+                /* read the next APDUs while the eSE processes these ones */
+                FillJcopOsBatch(Os_info, pNext);
             }
+            WaitJcopOsBatch(pCur);
         }
-        else
+        for(i = 0; i < pCur->numDone; i++)
         {
-            LOG(ERROR) << StringPrintf("%s: JcopOs image Read failed", fn);
-            goto exit;
-        }
-
-        pTranscv_Info->sSendlength = wIndex;
-        LOG(ERROR) << StringPrintf("%s: start transceive for length %d", fn, pTranscv_Info->sSendlength);
-        if((pTranscv_Info->sSendlength != 0x03) &&
-           (pTranscv_Info->sSendData[0] != 0x00) &&
-           (pTranscv_Info->sSendData[1] != 0x00))
-        {
-
-            stat = mchannel->transceive(pTranscv_Info->sSendData,
-                                    pTranscv_Info->sSendlength,
-                                    pTranscv_Info->sRecvData,
-                                    pTranscv_Info->sRecvlength,
-                                    recvBufferActualSize,
-                                    pTranscv_Info->timeout);
-        }
-        else
-        {
-            LOG(ERROR) << StringPrintf("%s: Invalid packet", fn);
-            continue;
+            status = STATUS_SUCCESS;
+            ckpt.apdu_index++;
+            ckpt.offset = pCur->offset[i];
+            if((ckpt.apdu_index % JCOP_CKPT_INTERVAL) == 0)
+            {
+                SetJcopOsCheckpoint(&ckpt);
+            }
         }
-        if(stat != true)
+        if(pCur->stat != true)
         {
-            LOG(ERROR) << StringPrintf("%s: Transceive failed; status=0x%X", fn, stat);
+            LOG(ERROR) << StringPrintf("%s: Transceive failed; status=0x%X", fn, pCur->stat);
             status = STATUS_FAILED;
             goto exit;
         }
-        else if(recvBufferActualSize != 0 &&
-                pTranscv_Info->sRecvData[recvBufferActualSize-2] == 0x90 &&
-                pTranscv_Info->sRecvData[recvBufferActualSize-1] == 0x00)
+        refill = !async;
+        if(pCur->numDone < pCur->num)
         {
-            //LOG(ERROR) << StringPrintf("%s: END transceive for length %d", fn, pTranscv_Info->sSendlength);
-            status = STATUS_SUCCESS;
-        }
-        else if(pTranscv_Info->sRecvData[recvBufferActualSize-2] == 0x6F &&
-                pTranscv_Info->sRecvData[recvBufferActualSize-1] == 0x00)
-        {
-            LOG(ERROR) << StringPrintf("%s: JcopOs is already upto date-No update required exiting", fn);
-            Os_info->version_info.ver_status = STATUS_UPTO_DATE;
+            pApdu = &pCur->apdu[pCur->numDone];
+            memcpy(pTranscv_Info->sRecvData, pApdu->rsp, pApdu->rspLen);
+            if(pApdu->rspLen >= 2 &&
+               pApdu->rsp[pApdu->rspLen-2] == 0x6F &&
+               pApdu->rsp[pApdu->rspLen-1] == 0x00)
+            {
+                LOG(ERROR) << StringPrintf("%s: JcopOs is already upto date-No update required exiting", fn);
+                Os_info->version_info.ver_status = STATUS_UPTO_DATE;
+                status = STATUS_FAILED;
+                break;
+            }
+            else if(pApdu->rspLen >= 2 &&
+                    pApdu->rsp[pApdu->rspLen-2] == 0x6F &&
+                    pApdu->rsp[pApdu->rspLen-1] == 0xA1)
+            {
+                LOG(ERROR) << StringPrintf("%s: JcopOs is already up to date-No update required exiting", fn);
+                Os_info->version_info.ver_status = STATUS_UPTO_DATE;
+                status = STATUS_UPTO_DATE;
+                break;
+            }
             status = STATUS_FAILED;
-            break;
+            LOG(ERROR) << StringPrintf("%s: Invalid response", fn);
+            /* go on after the rejected APDU, the ones read ahead are dropped */
+            if(fseek(Os_info->fp, pCur->offset[pCur->numDone], SEEK_SET) != 0)
+            {
+                LOG(ERROR) << StringPrintf("%s: JcopOs image seek failed", fn);
+                goto exit;
+            }
+            pNext->num = 0;
+            pNext->readFailed = false;
+            refill = true;
         }
-        else if(pTranscv_Info->sRecvData[recvBufferActualSize-2] == 0x6F &&
-                pTranscv_Info->sRecvData[recvBufferActualSize-1] == 0xA1)
+        else if(pCur->readFailed)
         {
-            LOG(ERROR) << StringPrintf("%s: JcopOs is already up to date-No update required exiting", fn);
-            Os_info->version_info.ver_status = STATUS_UPTO_DATE;
-            status = STATUS_UPTO_DATE;
-            break;
+            LOG(ERROR) << StringPrintf("%s: JcopOs image Read failed", fn);
+            goto exit;
         }
-        else
+        if(refill)
         {
-            status = STATUS_FAILED;
-            LOG(ERROR) << StringPrintf("%s: Invalid response", fn);
+            FillJcopOsBatch(Os_info, pNext);
         }
-        LOG(ERROR) << StringPrintf("%s: Going for next line", fn);
+        LOG(ERROR) << StringPrintf("%s: Going for next batch", fn);
+        pCur = pNext;
     }
 
+    if(status == STATUS_SUCCESS || status == STATUS_UPTO_DATE ||
+       Os_info->version_info.ver_status == STATUS_UPTO_DATE)
+    {
+        /* image done, nothing left to resume */
+        ClearJcopOsCheckpoint();
+    }
     if(status == STATUS_SUCCESS)
     {
         Os_info->cur_state++;
@@ -894,12 +971,184 @@ tJBL_STATUS JcopOsDwnld::load_JcopOS_image(JcopOs_ImageInfo_t *Os_info, tJBL_STA
     }
 
 exit:
+    if(status == STATUS_FAILED && ckpt.magic == JCOP_CKPT_MAGIC)
+    {
+        if(Os_info->resumed && ckpt.apdu_index == resume_index)
+        {
+            /* eSE did not accept the image from the checkpoint */
+            LOG(ERROR) << StringPrintf("%s: resume rejected, restarting image", fn);
+            ClearJcopOsCheckpoint();
+        }
+        else if(ckpt.apdu_index != resume_index &&
+                Os_info->version_info.ver_status != STATUS_UPTO_DATE)
+        {
+            /* save the exact progress for the retry */
+            SetJcopOsCheckpoint(&ckpt);
+        }
+    }
+    if(pBatchBuf != NULL)
+    {
+        sem_destroy(&batch[0].done);
+        sem_destroy(&batch[1].done);
+        free(pBatchBuf);
+    }
     mchannel->doeSE_JcopDownLoadReset();
     LOG(ERROR) << StringPrintf("%s close fp and exit; status= 0x%X", fn,status);
     wResult = fclose(Os_info->fp);
     return status;
 }
 
+/*******************************************************************************
+**
+** Function:        ReadJcopOsApdu
+**
+** Description:     Reads the next APDU of the image file
+**
+** Returns:         1 if an APDU is read, 0 if the line is not an APDU to send,
+**                  -1 on read error.
+**
+*******************************************************************************/
+int JcopOsDwnld::ReadJcopOsApdu(FILE *fp, uint8_t *pBuf, int32_t *pLen)
+{
+    static const char fn [] = "JcopOsDwnld::ReadJcopOsApdu";
+    int wResult = 0;
+    int32_t wIndex = 0, wCount = 0;
+    int32_t wLen = 0;
+
+    LOG(ERROR) << StringPrintf("%s; Start of line processing", fn);
+    memset(pBuf, 0x00, JCOP_MAX_BUF_SIZE);
+    for(wCount =0; (wCount < 5 && !feof(fp)); wCount++, wIndex++)
+    {
+        wResult = FSCANF_BYTE(fp,"%2X",&pBuf[wIndex]);
+    }
+    if(wResult == 0)
+    {
+        return -1;
+    }
+    wLen = pBuf[4];
+    LOG(ERROR) << StringPrintf("%s; Read 5byes success & len=%d", fn,wLen);
+    if(wLen == 0x00)
+    {
+        LOG(ERROR) << StringPrintf("%s: Extended APDU", fn);
+        wResult = FSCANF_BYTE(fp,"%2X",&pBuf[wIndex++]);
+        wResult = FSCANF_BYTE(fp,"%2X",&pBuf[wIndex++]);
+        wLen = ((pBuf[5] << 8) | (pBuf[6]));
+    }
+    if(wIndex + wLen > JCOP_MAX_BUF_SIZE)
+    {
+        LOG(ERROR) << StringPrintf("%s: APDU too long %d", fn, wLen);
+        return -1;
+    }
+    for(wCount =0; (wCount < wLen && !feof(fp)); wCount++, wIndex++)
+    {
+        wResult = FSCANF_BYTE(fp,"%2X",&pBuf[wIndex]);
+    }
+    *pLen = wIndex;
+    if((wIndex == 0x03) || (pBuf[0] == 0x00) || (pBuf[1] == 0x00))
+    {
+        LOG(ERROR) << StringPrintf("%s: Invalid packet", fn);
+        return 0;
+    }
+    return 1;
+}
+
+/*******************************************************************************
+**
+** Function:        FillJcopOsBatch
+**
+** Description:     Reads the next APDUs of the image file into the batch
+**
+** Returns:         None
+**
+*******************************************************************************/
+void JcopOsDwnld::FillJcopOsBatch(JcopOs_ImageInfo_t *Os_info, JcopOs_Batch_t *pBatch)
+{
+    int wResult;
+    IChannel_Apdu_t *pApdu;
+
+    pBatch->num = 0;
+    pBatch->numDone = 0;
+    pBatch->stat = true;
+    pBatch->readFailed = false;
+    while((pBatch->num < JCOP_BATCH_MAX_APDUS) && !feof(Os_info->fp))
+    {
+        pApdu = &pBatch->apdu[pBatch->num];
+        wResult = ReadJcopOsApdu(Os_info->fp, pApdu->cmd, &pApdu->cmdLen);
+        if(wResult < 0)
+        {
+            pBatch->readFailed = true;
+            break;
+        }
+        else if(wResult > 0)
+        {
+            pApdu->rspLen = 0;
+            pBatch->offset[pBatch->num++] = (uint32_t)ftell(Os_info->fp);
+        }
+    }
+}
+
+/* Completion of transceiveBatchAsync */
+static void JcopOs_BatchDone(void *ctx, bool status, int32_t numDone)
+{
+    JcopOs_Batch_t *pBatch = (JcopOs_Batch_t*)ctx;
+    pBatch->stat = status;
+    pBatch->numDone = numDone;
+    sem_post(&pBatch->done);
+}
+
+/*******************************************************************************
+**
+** Function:        SendJcopOsBatch
+**
+** Description:     Sends the APDUs of the batch, stopping at the first response
+**                  other than 9000. Queues them when the channel supports
+**                  transceiveBatchAsync, WaitJcopOsBatch has to be called
+**                  before using the responses.
+**
+** Returns:         True if the batch is queued.
+**
+*******************************************************************************/
+bool JcopOsDwnld::SendJcopOsBatch(JcopOs_Batch_t *pBatch, int32_t timeout)
+{
+    IChannelExt_t *pExt = &gpJcopOs_Dwnld_Context->channelExt;
+
+    pBatch->pending = false;
+    if((pExt->version >= ICHANNEL_EXT_VERSION_BATCH) && (pExt->transceiveBatchAsync != NULL))
+    {
+        pBatch->pending = pExt->transceiveBatchAsync(pBatch->apdu, pBatch->num, 0x9000,
+                                                     ICHANNEL_SW_MASK_ALL, timeout,
+                                                     JcopOs_BatchDone, pBatch);
+    }
+    if(!pBatch->pending)
+    {
+        pBatch->stat = IChannel_TransceiveBatch(gpJcopOs_Dwnld_Context->channel, pExt,
+                                                pBatch->apdu, pBatch->num, 0x9000,
+                                                ICHANNEL_SW_MASK_ALL, pBatch->numDone,
+                                                timeout);
+    }
+    return pBatch->pending;
+}
+
+/*******************************************************************************
+**
+** Function:        WaitJcopOsBatch
+**
+** Description:     Waits for the completion of a queued batch
+**
+** Returns:         None
+**
+*******************************************************************************/
+void JcopOsDwnld::WaitJcopOsBatch(JcopOs_Batch_t *pBatch)
+{
+    if(pBatch->pending)
+    {
+        while((sem_wait(&pBatch->done) == -1) && (errno == EINTR))
+        {
+        }
+        pBatch->pending = false;
+    }
+}
+
 /*******************************************************************************
 **
 ** Function:        GetJcopOsState
@@ -1025,6 +1274,148 @@ tJBL_STATUS JcopOsDwnld::SetJcopOsState(JcopOs_ImageInfo_t *Os_info, uint8_t sta
     return status;
 }
 
+/*******************************************************************************
+**
+** Function:        GetJcopOsCheckpoint
+**
+** Description:     Reads the checkpoint of the image file to load. It is
+**                  valid only if it was saved for the same image file
+**                  content and if the eSE reported the same state in
+**                  GetInfo as when the image load started.
+**
+** Returns:         True if the image load can resume from pCkpt.
+**
+*******************************************************************************/
+bool JcopOsDwnld::GetJcopOsCheckpoint(JcopOs_ImageInfo_t *Os_info, uint32_t fls_hash, JcopOs_Checkpoint_t *pCkpt)
+{
+    static const char fn [] = "JcopOsDwnld::GetJcopOsCheckpoint";
+    IChannel_t *mchannel = gpJcopOs_Dwnld_Context->channel;
+    const char *reason = NULL;
+    size_t count;
+    FILE *fp;
+
+    fp = fopen(JCOP_CKPT_PATH[mchannel->getInterfaceInfo()], "r");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    count = fread(pCkpt, sizeof(JcopOs_Checkpoint_t), 1, fp);
+    fclose(fp);
+
+    if (count != 1)
+    {
+        reason = "truncated";
+    }
+    else if (pCkpt->magic != JCOP_CKPT_MAGIC ||
+             pCkpt->version != JCOP_CKPT_VERSION ||
+             pCkpt->crc != JcopOs_Hash(JCOP_HASH_INIT, (uint8_t *)pCkpt,
+                                       offsetof(JcopOs_Checkpoint_t, crc)))
+    {
+        reason = "corrupted";
+    }
+    else if (pCkpt->cur_state != Os_info->cur_state ||
+             pCkpt->fls_size != (uint32_t)Os_info->fls_size ||
+             pCkpt->fls_hash != fls_hash ||
+             pCkpt->offset > pCkpt->fls_size)
+    {
+        reason = "saved for another image";
+    }
+    else if (pCkpt->version_info.osid != Os_info->version_info.osid ||
+             pCkpt->version_info.ver1 != Os_info->version_info.ver1 ||
+             pCkpt->version_info.ver0 != Os_info->version_info.ver0 ||
+             pCkpt->version_info.OtherValid != Os_info->version_info.OtherValid)
+    {
+        reason = "eSE state changed";
+    }
+
+    if (reason != NULL)
+    {
+        LOG(ERROR) << StringPrintf("%s: checkpoint %s, discarded", fn, reason);
+        ClearJcopOsCheckpoint();
+        return false;
+    }
+    DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: state %d APDU %u", fn, pCkpt->cur_state,
+                      pCkpt->apdu_index);
+    return true;
+}
+
+/*******************************************************************************
+**
+** Function:        SetJcopOsCheckpoint
+**
+** Description:     Saves the checkpoint durably. It is written to a
+**                  temporary file first so that a power loss leaves either
+**                  the previous or the new checkpoint; the directory is
+**                  synced after the rename so that the new one stays.
+**
+** Returns:         Success if ok.
+**
+*******************************************************************************/
+tJBL_STATUS JcopOsDwnld::SetJcopOsCheckpoint(JcopOs_Checkpoint_t *pCkpt)
+{
+    static const char fn [] = "JcopOsDwnld::SetJcopOsCheckpoint";
+    IChannel_t *mchannel = gpJcopOs_Dwnld_Context->channel;
+    const char *ckpt_path = JCOP_CKPT_PATH[mchannel->getInterfaceInfo()];
+    char tmp_path[256];
+    char dir_path[256];
+    bool written;
+    FILE *fp;
+    int dir_fd;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", ckpt_path);
+    pCkpt->crc = JcopOs_Hash(JCOP_HASH_INIT, (uint8_t *)pCkpt,
+                             offsetof(JcopOs_Checkpoint_t, crc));
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL)
+    {
+        LOG(ERROR) << StringPrintf("%s: Error opening <%s>: %s", fn, tmp_path,
+                                   strerror(errno));
+        return STATUS_FAILED;
+    }
+    written = (fwrite(pCkpt, sizeof(JcopOs_Checkpoint_t), 1, fp) == 1) &&
+              (fflush(fp) == 0) && (fdatasync(fileno(fp)) == 0);
+    fclose(fp);
+    if (!written || rename(tmp_path, ckpt_path) != 0)
+    {
+        LOG(ERROR) << StringPrintf("%s: Error saving checkpoint: %s", fn,
+                                   strerror(errno));
+        unlink(tmp_path);
+        return STATUS_FAILED;
+    }
+    /* dirname() may modify its argument */
+    snprintf(dir_path, sizeof(dir_path), "%s", ckpt_path);
+    dir_fd = open(dirname(dir_path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0 || fsync(dir_fd) != 0)
+    {
+        LOG(ERROR) << StringPrintf("%s: Error syncing <%s>: %s", fn, dir_path,
+                                   strerror(errno));
+        if (dir_fd >= 0) close(dir_fd);
+        return STATUS_FAILED;
+    }
+    close(dir_fd);
+    DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: state %d APDU %u offset %u", fn, pCkpt->cur_state,
+                      pCkpt->apdu_index, pCkpt->offset);
+    return STATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function:        ClearJcopOsCheckpoint
+**
+** Description:     Removes the checkpoint, the next image load starts from
+**                  the first APDU.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void JcopOsDwnld::ClearJcopOsCheckpoint()
+{
+    IChannel_t *mchannel = gpJcopOs_Dwnld_Context->channel;
+    unlink(JCOP_CKPT_PATH[mchannel->getInterfaceInfo()]);
+}
+
 #if 0
 void *JcopOsDwnld::GetMemory(uint32_t size)
 {
@@ -56,6 +56,32 @@ unsigned char LSC_Start(const char* name, const char* dest, uint8_t* pdata,
 *******************************************************************************/
 tLSC_STATUS performLSDownload(IChannel_t* data);
 
+/*******************************************************************************
+**
+** Function:        performLSDownloadExt
+**
+** Description:     Perform LS during hal init, sending the buffered load
+**                  commands through the batched transceive of the channel.
+**                  No eSE HAL calls it yet, performLSDownload passes a NULL
+**                  dataExt.
+**
+** Returns:         SUCCESS of ok
+**
+*******************************************************************************/
+tLSC_STATUS performLSDownloadExt(IChannel_t* data, IChannelExt_t* dataExt);
+
+/*******************************************************************************
+**
+** Function:        LSC_RebuildOutFile
+**
+** Description:     Writes the out file dest of the last LS update from its
+**                  response journal
+**
+** Returns:         SUCCESS if ok
+**
+*******************************************************************************/
+tLSC_STATUS LSC_RebuildOutFile(const char* dest);
+
 void* phLS_memset(void* buff, int val, size_t len);
 void* phLS_memcpy(void* dest, const void* src, size_t len);
 void* phLS_memalloc(uint32_t size);
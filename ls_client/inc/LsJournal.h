@@ -0,0 +1,130 @@
+/*******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *****************************************************************************/
+
+/*
+ * Response journal of the Loader Service script execution.
+ *
+ * The responses of the script are appended as binary records to
+ * <out file>.jrnl, preallocated when created. Records are buffered and
+ * written with one fdatasync per group of LSJ_GROUP_COMMIT_RECORDS, and when
+ * the journal is closed. The script is not copied: the header holds its
+ * path, size and SHA-256.
+ *
+ * LSJ_Rebuild checks the script still matches the header, then writes the
+ * out file in the legacy format: the script followed by one line per
+ * response, the hex of its 61 | 43 | 44 TLV.
+ */
+
+#ifndef LSJOURNAL_H_
+#define LSJOURNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "LsClient.h"
+
+#define LSJ_SUFFIX ".jrnl"
+#define LSJ_MAGIC 0x314A534C /* "LSJ1" */
+#define LSJ_VERSION 0x01
+#define LSJ_SCRIPT_HASH_LEN 32
+#define LSJ_PATH_LEN 384
+/* Covers the responses of a usual script, the file grows past it if needed */
+#define LSJ_PREALLOC_SIZE (64 * 1024)
+#define LSJ_BUF_SIZE 4096
+#define LSJ_GROUP_COMMIT_RECORDS 16
+
+typedef struct Lsj_Header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t scriptSize;
+  uint8_t scriptHash[LSJ_SCRIPT_HASH_LEN];
+  char scriptPath[LSJ_PATH_LEN];
+} Lsj_Header_t;
+
+/* Followed by len bytes of response */
+typedef struct Lsj_RecordHdr {
+  uint16_t tag; /* Ls_TagType */
+  uint16_t len;
+} Lsj_RecordHdr_t;
+
+typedef struct Lsj_Journal {
+  int fd;
+  uint32_t pending; /* records appended since the last commit */
+  size_t bufLen;
+  uint8_t buf[LSJ_BUF_SIZE];
+} Lsj_Journal_t;
+
+/*******************************************************************************
+**
+** Function:        LSJ_Open
+**
+** Description:     Creates the journal of the out file outPath, for the
+**                  script at scriptPath
+**
+** Returns:         Journal, NULL if it could not be created
+**
+*******************************************************************************/
+Lsj_Journal_t* LSJ_Open(const char* outPath, const char* scriptPath);
+
+/*******************************************************************************
+**
+** Function:        LSJ_Append
+**
+** Description:     Appends a response, committed with its group
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Append(Lsj_Journal_t* pJournal, uint16_t tag,
+                       const uint8_t* pData, int32_t len);
+
+/*******************************************************************************
+**
+** Function:        LSJ_Commit
+**
+** Description:     Writes the buffered records and syncs the journal
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Commit(Lsj_Journal_t* pJournal);
+
+/*******************************************************************************
+**
+** Function:        LSJ_Close
+**
+** Description:     Commits and releases the journal
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Close(Lsj_Journal_t* pJournal);
+
+/*******************************************************************************
+**
+** Function:        LSJ_Rebuild
+**
+** Description:     Writes the out file outPath in the legacy format from its
+**                  journal, if the script still matches it
+**
+** Returns:         SUCCESS if ok, STATUS_FILE_NOT_FOUND if there is no
+**                  journal or the script is gone or changed
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Rebuild(const char* outPath);
+
+#endif /* LSJOURNAL_H_ */
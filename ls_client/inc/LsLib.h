@@ -21,6 +21,7 @@
 
 #define NXP_LS_AID
 #include "LsClient.h"
+#include "LsJournal.h"
 #include <stdio.h>
 #include "../../inc/IChannel.h"
 #include "phNxpConfig.h"
@@ -44,7 +45,7 @@ typedef struct Lsc_ImageInfo {
   int fls_size;
   char fls_path[384];
   int bytes_read;
-  FILE* fResp;
+  Lsj_Journal_t* pJournal; /* responses, if bytes_wrote is 0xAA */
   int fls_RespSize;
   char fls_RespPath[384];
   int bytes_wrote;
@@ -60,6 +61,7 @@ typedef enum {
 
 typedef struct Lsc_lib_Context {
   IChannel_t            *mchannel;
+  IChannelExt_t         *mchannelExt; /* NULL if no batched transceive */
   Lsc_ImageInfo_t Image_info;
   Lsc_TranscieveInfo_t Transcv_Info;
 } Lsc_Dwnld_Context_t, *pLsc_Dwnld_Context_t;
@@ -145,6 +147,10 @@ static uint8_t ArrayOfAIDs[NOOFAIDS][LENOFAIDS] = {
 
 #define JCOP3_WR
 #define MAX_SIZE 0xFF
+/* Buffered load commands sent in one batch */
+#define LSC_BATCH_MAX_APDUS 16
+/* Extended length APDU header, CLA INS P1 P2 and 3 bytes of Lc */
+#define LSC_EXT_APDU_HDR_LEN 0x07
 #define PARAM_P1_OFFSET 0x02
 #define FIRST_BLOCK 0x05
 #define LAST_BLOCK 0x84
@@ -184,11 +190,12 @@ static const char *LS_STATUS_PATH[2] = {"/data/vendor/nfc/LS_Status.txt",
 **
 ** Description:     Initialize all member variables.
 **                  native: Native data.
+**                  channelExt: batched transceive of the channel, optional
 **
 ** Returns:         True if ok.
 **
 *******************************************************************************/
-bool    initialize (IChannel_t *channel);
+bool    initialize (IChannel_t *channel, IChannelExt_t *channelExt = NULL);
 
 /*******************************************************************************
 **
@@ -287,8 +294,8 @@ static tLSC_STATUS LSC_update_seq_handler(
 **
 ** Function:        Write_Response_To_OutFile
 **
-** Description:     Write the response to Out file
-**                  with length recvlen from buffer RecvData.
+** Description:     Appends the response with length recvlen from buffer
+**                  RecvData to the journal of the Out file, see LSJ_Rebuild
 **
 ** Returns:         Success if OK
 **
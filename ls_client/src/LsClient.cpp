@@ -24,6 +24,7 @@
 #include <pthread.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
 /*static char gethex(const char *s, char **endptr);
 char *convert(const char *s, int *length);*/
@@ -65,6 +66,20 @@ tLSC_STATUS LSC_Start(const char* name, const char* dest, uint8_t* pdata,
 **
 *******************************************************************************/
 tLSC_STATUS performLSDownload(IChannel_t* data) {
+  return performLSDownloadExt(data, NULL);
+}
+
+/*******************************************************************************
+**
+** Function:        performLSDownloadExt
+**
+** Description:     Perform LS during hal init, sending the buffered load
+**                  commands through the batched transceive of the channel
+**
+** Returns:         SUCCESS of ok
+**
+*******************************************************************************/
+tLSC_STATUS performLSDownloadExt(IChannel_t* data, IChannelExt_t* dataExt) {
   tLSC_STATUS status = STATUS_FAILED;
 
   const char* lsUpdateBackupPath =
@@ -86,47 +101,35 @@ tLSC_STATUS performLSDownload(IChannel_t* data) {
   /*Check and update if any new LS AID is available*/
   updateLsAid(mchannel->getInterfaceInfo());
 
-  if(!initialize ((IChannel_t*) data))
+  if(!initialize ((IChannel_t*) data, dataExt))
     return status;
 
 
   uint8_t resSW[4] = {0x4e, 0x02, 0x69, 0x87};
-  FILE* fIn, *fOut;
-  if ((fIn = fopen(lsUpdateBackupPath, "rb")) == NULL) {
+  /* The responses go to the journal of the out file, referencing the script
+   * instead of copying it, LSC_RebuildOutFile writes the out file from it */
+  if (access(lsUpdateBackupPath, R_OK) != 0) {
     ALOGE("%s Cannot open file %s\n", __func__, lsUpdateBackupPath);
     ALOGE("%s Error : %s", __func__, strerror(errno));
     return status;
   } else {
-    ALOGD("%s File opened %s\n", __func__, lsUpdateBackupPath);
-    if ((fOut = fopen(lsUpdateBackupOutPath[mchannel->getInterfaceInfo()], "wb")) == NULL) {
-      ALOGE("%s Failed to open file %s\n", __func__,
+    if ((remove(lsUpdateBackupOutPath[mchannel->getInterfaceInfo()]) != 0) &&
+        (errno != ENOENT)) {
+      ALOGE("%s Failed to remove stale file %s\n", __func__,
         lsUpdateBackupOutPath[mchannel->getInterfaceInfo()]);
-      fclose(fIn);
-      return status;
-    } else {
-      ALOGD("%s File opened %s\n", __func__,
-        lsUpdateBackupOutPath[mchannel->getInterfaceInfo()]);
-
-      fseek(fIn, 0L, SEEK_END);
-      size_t fsize = ftell(fIn);
-      rewind(fIn);
-      if((long)fsize > 0) {
-        char* lsUpdateBuf = (char*)malloc(fsize + 1);
-        if (fread(lsUpdateBuf, fsize, 1, fIn) != 1) {
-          ALOGE("%s: Failed to read file", __func__);
-        }
-        if (fwrite(lsUpdateBuf, fsize, 1, fOut) != 1) {
-          ALOGE("%s ERROR - Failed to write %zu bytes to file\n", __func__, fsize);
-        }
-        free(lsUpdateBuf);
-      }
-      fclose(fIn);
-      fclose(fOut);
     }
     status = LSC_Start(lsUpdateBackupPath, lsUpdateBackupOutPath[mchannel->getInterfaceInfo()],
                        (uint8_t*)hash, (uint16_t)sizeof(hash), resSW);
     resSW[0]=0x4e;
     ALOGD("%s LSC_Start completed\n", __func__);
+    /* Legacy readers expect the out file, failed updates included. It is
+     * written before the script may be removed, the journal cannot be
+     * checked without it */
+    if (LSC_RebuildOutFile(lsUpdateBackupOutPath[mchannel->getInterfaceInfo()]) !=
+        STATUS_SUCCESS) {
+      ALOGE("%s Failed to write %s\n", __func__,
+        lsUpdateBackupOutPath[mchannel->getInterfaceInfo()]);
+    }
     if (status == STATUS_SUCCESS) {
       if (remove(lsUpdateBackupPath) == 0) {
         ALOGD("%s  : %s file deleted successfully\n", __func__,
@@ -141,6 +144,24 @@ tLSC_STATUS performLSDownload(IChannel_t* data) {
   return status;
 }
 
+/*******************************************************************************
+**
+** Function:        LSC_RebuildOutFile
+**
+** Description:     Writes the out file dest of the last LS update from its
+**                  response journal
+**
+** Returns:         SUCCESS if ok
+**
+*******************************************************************************/
+tLSC_STATUS LSC_RebuildOutFile(const char* dest) {
+  if (dest == NULL) {
+    ALOGE("Invalid parameter");
+    return STATUS_FAILED;
+  }
+  return LSJ_Rebuild(dest);
+}
+
 /*******************************************************************************
 **
 ** Function:        datahex
@@ -0,0 +1,484 @@
+/*******************************************************************************
+ *
+ *  Copyright 2021 NXP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <cutils/log.h>
+#include <LsJournal.h>
+#include <LsLib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/sha.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+**
+** Function:        LSJ_JournalPath
+**
+** Description:     Gets the journal path of the out file outPath
+**
+** Returns:         true if ok, false if the path is too long
+**
+*******************************************************************************/
+static bool LSJ_JournalPath(const char* outPath, char* pPath, size_t size) {
+  int len = snprintf(pPath, size, "%s%s", outPath, LSJ_SUFFIX);
+  return (len > 0) && ((size_t)len < size);
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_HashScript
+**
+** Description:     Computes the size and SHA-256 of the script
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+static tLSC_STATUS LSJ_HashScript(const char* scriptPath, uint64_t* pSize,
+                                  uint8_t* pHash) {
+  uint8_t chunk[LSJ_BUF_SIZE];
+  SHA256_CTX ctx;
+  ssize_t rdLen;
+  int fd;
+
+  fd = open(scriptPath, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    ALOGE("%s: cannot open %s: %s", __func__, scriptPath, strerror(errno));
+    return STATUS_FILE_NOT_FOUND;
+  }
+  *pSize = 0;
+  SHA256_Init(&ctx);
+  while ((rdLen = TEMP_FAILURE_RETRY(read(fd, chunk, sizeof(chunk)))) > 0) {
+    SHA256_Update(&ctx, chunk, rdLen);
+    *pSize += rdLen;
+  }
+  close(fd);
+  if (rdLen < 0) {
+    ALOGE("%s: cannot read %s: %s", __func__, scriptPath, strerror(errno));
+    return STATUS_FAILED;
+  }
+  SHA256_Final(pHash, &ctx);
+  return STATUS_OK;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_WriteAll
+**
+** Description:     Writes len bytes, retrying on partial writes
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+static tLSC_STATUS LSJ_WriteAll(int fd, const uint8_t* pData, size_t len) {
+  while (len > 0) {
+    ssize_t wrLen = TEMP_FAILURE_RETRY(write(fd, pData, len));
+    if (wrLen <= 0) {
+      ALOGE("%s: write failed: %s", __func__, strerror(errno));
+      return STATUS_FAILED;
+    }
+    pData += wrLen;
+    len -= wrLen;
+  }
+  return STATUS_OK;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_Flush
+**
+** Description:     Writes the buffered records, without syncing
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+static tLSC_STATUS LSJ_Flush(Lsj_Journal_t* pJournal) {
+  tLSC_STATUS status = LSJ_WriteAll(pJournal->fd, pJournal->buf,
+                                    pJournal->bufLen);
+  pJournal->bufLen = 0;
+  return status;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_Open
+**
+** Description:     Creates the journal of the out file outPath, for the
+**                  script at scriptPath
+**
+** Returns:         Journal, NULL if it could not be created
+**
+*******************************************************************************/
+Lsj_Journal_t* LSJ_Open(const char* outPath, const char* scriptPath) {
+  Lsj_Journal_t* pJournal = NULL;
+  Lsj_Header_t hdr;
+  char path[LSJ_PATH_LEN + sizeof(LSJ_SUFFIX)];
+
+  memset(&hdr, 0x00, sizeof(hdr));
+  hdr.magic = LSJ_MAGIC;
+  hdr.version = LSJ_VERSION;
+  if (strlcpy(hdr.scriptPath, scriptPath, sizeof(hdr.scriptPath)) >=
+          sizeof(hdr.scriptPath) ||
+      !LSJ_JournalPath(outPath, path, sizeof(path))) {
+    ALOGE("%s: path too long", __func__);
+    return NULL;
+  }
+  if (LSJ_HashScript(scriptPath, &hdr.scriptSize, hdr.scriptHash) !=
+      STATUS_OK) {
+    return NULL;
+  }
+
+  pJournal = (Lsj_Journal_t*)malloc(sizeof(Lsj_Journal_t));
+  if (pJournal == NULL) {
+    ALOGE("%s: memory allocation failed", __func__);
+    return NULL;
+  }
+  pJournal->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+  if (pJournal->fd < 0) {
+    ALOGE("%s: cannot create %s: %s", __func__, path, strerror(errno));
+    free(pJournal);
+    return NULL;
+  }
+  /* The size stays the end of the records, the rebuild reads up to it */
+  if (fallocate(pJournal->fd, FALLOC_FL_KEEP_SIZE, 0, LSJ_PREALLOC_SIZE) !=
+      0) {
+    ALOGD("%s: no preallocation: %s", __func__, strerror(errno));
+  }
+  pJournal->pending = 0;
+  memcpy(pJournal->buf, &hdr, sizeof(hdr));
+  pJournal->bufLen = sizeof(hdr);
+  /* The header is durable before the first response */
+  if (LSJ_Commit(pJournal) != STATUS_OK) {
+    close(pJournal->fd);
+    free(pJournal);
+    return NULL;
+  }
+  ALOGD("%s: %s, script %llu bytes", __func__, path,
+        (unsigned long long)hdr.scriptSize);
+  return pJournal;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_Append
+**
+** Description:     Appends a response, committed with its group
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Append(Lsj_Journal_t* pJournal, uint16_t tag,
+                       const uint8_t* pData, int32_t len) {
+  Lsj_RecordHdr_t rec;
+
+  if (pJournal == NULL || len < 0 || len > 0xFFFF) {
+    return STATUS_FAILED;
+  }
+  rec.tag = tag;
+  rec.len = (uint16_t)len;
+  if (pJournal->bufLen + sizeof(rec) + len > sizeof(pJournal->buf)) {
+    if (LSJ_Flush(pJournal) != STATUS_OK) return STATUS_FAILED;
+  }
+  if (sizeof(rec) + len > sizeof(pJournal->buf)) {
+    /* Larger than the buffer, written as is */
+    if ((LSJ_WriteAll(pJournal->fd, (const uint8_t*)&rec, sizeof(rec)) !=
+         STATUS_OK) ||
+        (LSJ_WriteAll(pJournal->fd, pData, len) != STATUS_OK)) {
+      return STATUS_FAILED;
+    }
+  } else {
+    memcpy(&pJournal->buf[pJournal->bufLen], &rec, sizeof(rec));
+    memcpy(&pJournal->buf[pJournal->bufLen + sizeof(rec)], pData, len);
+    pJournal->bufLen += sizeof(rec) + len;
+  }
+  if (++pJournal->pending >= LSJ_GROUP_COMMIT_RECORDS) {
+    return LSJ_Commit(pJournal);
+  }
+  return STATUS_OK;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_Commit
+**
+** Description:     Writes the buffered records and syncs the journal
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Commit(Lsj_Journal_t* pJournal) {
+  if (pJournal == NULL) return STATUS_FAILED;
+  pJournal->pending = 0;
+  if (LSJ_Flush(pJournal) != STATUS_OK) return STATUS_FAILED;
+  if (fdatasync(pJournal->fd) != 0) {
+    ALOGE("%s: fdatasync failed: %s", __func__, strerror(errno));
+    return STATUS_FAILED;
+  }
+  return STATUS_OK;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_Close
+**
+** Description:     Commits and releases the journal
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Close(Lsj_Journal_t* pJournal) {
+  tLSC_STATUS status;
+
+  if (pJournal == NULL) return STATUS_FAILED;
+  status = LSJ_Commit(pJournal);
+  close(pJournal->fd);
+  free(pJournal);
+  return status;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_ResponseTlvHdr
+**
+** Description:     Builds the 61 | 43 | 44 TLV header of a response of
+**                  recvlen bytes in the legacy out file
+**
+** Returns:         Length of the header
+**
+*******************************************************************************/
+static uint8_t LSJ_ResponseTlvHdr(int32_t recvlen, Ls_TagType tType,
+                                  uint8_t* tagBuffer) {
+  int32_t tag44Len = 0;
+  int32_t tag61Len = 0;
+  uint8_t tag43Len = 1;
+  uint8_t tag43off = 0;
+  uint8_t tag44off = 0;
+  uint8_t ucTag44[3] = {0x00, 0x00, 0x00};
+  uint8_t tagLen = 0;
+
+  tagBuffer[0] = 0x61;
+  /*Certificate TAG occupies 2 bytes*/
+  if (tType == LS_Cert) {
+    tag43Len = 2;
+  }
+  /* |TAG | LEN(BERTLV)|                                VAL |
+   * | 61 |      XX    |  TAG | LEN |     VAL    | TAG | LEN(BERTLV) |      VAL
+   *|
+   *                   |  43  | 1/2 | 7F21/60/40 | 44  | apduRespLen |
+   *apduResponse |
+   **/
+  if (recvlen < 0x80) {
+    tag44Len = 1;
+    ucTag44[0] = recvlen;
+    tag61Len = recvlen + 4 + tag43Len;
+
+    if (tag61Len & 0x80) {
+      tagBuffer[1] = 0x81;
+      tagBuffer[2] = tag61Len;
+      tag43off = 3;
+      tag44off = 5 + tag43Len;
+      tagLen = tag44off + 2;
+    } else {
+      tagBuffer[1] = tag61Len;
+      tag43off = 2;
+      tag44off = 4 + tag43Len;
+      tagLen = tag44off + 2;
+    }
+  } else if ((recvlen >= 0x80) && (recvlen <= 0xFF)) {
+    ucTag44[0] = 0x81;
+    ucTag44[1] = recvlen;
+    tag61Len = recvlen + 5 + tag43Len;
+    tag44Len = 2;
+
+    if ((tag61Len & 0xFF00) != 0) {
+      tagBuffer[1] = 0x82;
+      tagBuffer[2] = (tag61Len & 0xFF00) >> 8;
+      tagBuffer[3] = (tag61Len & 0xFF);
+      tag43off = 4;
+      tag44off = 6 + tag43Len;
+      tagLen = tag44off + 3;
+    } else {
+      tagBuffer[1] = 0x81;
+      tagBuffer[2] = (tag61Len & 0xFF);
+      tag43off = 3;
+      tag44off = 5 + tag43Len;
+      tagLen = tag44off + 3;
+    }
+  } else if ((recvlen > 0xFF) && (recvlen <= 0xFFFF)) {
+    ucTag44[0] = 0x82;
+    ucTag44[1] = (recvlen & 0xFF00) >> 8;
+    ucTag44[2] = (recvlen & 0xFF);
+    tag44Len = 3;
+
+    tag61Len = recvlen + 6 + tag43Len;
+
+    if ((tag61Len & 0xFF00) != 0) {
+      tagBuffer[1] = 0x82;
+      tagBuffer[2] = (tag61Len & 0xFF00) >> 8;
+      tagBuffer[3] = (tag61Len & 0xFF);
+      tag43off = 4;
+      tag44off = 6 + tag43Len;
+      tagLen = tag44off + 4;
+    }
+  }
+  tagBuffer[tag43off] = 0x43;
+  tagBuffer[tag43off + 1] = tag43Len;
+  tagBuffer[tag44off] = 0x44;
+  memcpy(&tagBuffer[tag44off + 1], &ucTag44[0], tag44Len);
+
+  if (tType == LS_Cert) {
+    tagBuffer[tag43off + 2] = 0x7F;
+    tagBuffer[tag43off + 3] = 0x21;
+  } else if (tType == LS_Sign) {
+    tagBuffer[tag43off + 2] = 0x60;
+  } else if (tType == LS_Comm) {
+    tagBuffer[tag43off + 2] = 0x40;
+  } else {
+    /*Do nothing*/
+  }
+  return tagLen;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_WriteResponseLine
+**
+** Description:     Writes a response as a line of the legacy out file
+**
+** Returns:         SUCCESS if ok.
+**
+*******************************************************************************/
+static tLSC_STATUS LSJ_WriteResponseLine(FILE* fOut, uint16_t tag,
+                                         const uint8_t* pData, uint16_t len) {
+  static const char hex[] = "0123456789ABCDEF";
+  uint8_t tagBuffer[12] = {0};
+  uint8_t tagLen = LSJ_ResponseTlvHdr(len, (Ls_TagType)tag, tagBuffer);
+  size_t lineLen = 2 * (tagLen + (size_t)len) + 1;
+  char* pLine = (char*)malloc(lineLen);
+  size_t off = 0;
+  tLSC_STATUS status = STATUS_OK;
+
+  if (pLine == NULL) return STATUS_FAILED;
+  for (uint8_t i = 0; i < tagLen; i++) {
+    pLine[off++] = hex[tagBuffer[i] >> 4];
+    pLine[off++] = hex[tagBuffer[i] & 0x0F];
+  }
+  for (uint16_t i = 0; i < len; i++) {
+    pLine[off++] = hex[pData[i] >> 4];
+    pLine[off++] = hex[pData[i] & 0x0F];
+  }
+  pLine[off++] = '\n';
+  if (fwrite(pLine, off, 1, fOut) != 1) {
+    ALOGE("%s: write failed: %s", __func__, strerror(errno));
+    status = STATUS_FAILED;
+  }
+  free(pLine);
+  return status;
+}
+
+/*******************************************************************************
+**
+** Function:        LSJ_Rebuild
+**
+** Description:     Writes the out file outPath in the legacy format from its
+**                  journal, if the script still matches it
+**
+** Returns:         SUCCESS if ok, STATUS_FILE_NOT_FOUND if there is no
+**                  journal or the script is gone or changed
+**
+*******************************************************************************/
+tLSC_STATUS LSJ_Rebuild(const char* outPath) {
+  char path[LSJ_PATH_LEN + sizeof(LSJ_SUFFIX)];
+  uint8_t chunk[LSJ_BUF_SIZE];
+  uint8_t hash[LSJ_SCRIPT_HASH_LEN];
+  uint8_t* pData = NULL;
+  Lsj_Header_t hdr;
+  Lsj_RecordHdr_t rec;
+  uint64_t scriptSize = 0;
+  uint32_t numRecords = 0;
+  tLSC_STATUS status = STATUS_FAILED;
+  FILE* fJournal = NULL;
+  FILE* fScript = NULL;
+  FILE* fOut = NULL;
+  size_t rdLen;
+
+  if (!LSJ_JournalPath(outPath, path, sizeof(path))) {
+    ALOGE("%s: path too long", __func__);
+    return STATUS_FAILED;
+  }
+  if ((fJournal = fopen(path, "rb")) == NULL) {
+    ALOGE("%s: cannot open %s: %s", __func__, path, strerror(errno));
+    return STATUS_FILE_NOT_FOUND;
+  }
+  if ((fread(&hdr, sizeof(hdr), 1, fJournal) != 1) ||
+      (hdr.magic != LSJ_MAGIC) || (hdr.version != LSJ_VERSION)) {
+    ALOGE("%s: invalid journal %s", __func__, path);
+    goto exit;
+  }
+  hdr.scriptPath[sizeof(hdr.scriptPath) - 1] = '\0';
+  /* Verify the script referenced by the journal */
+  status = LSJ_HashScript(hdr.scriptPath, &scriptSize, hash);
+  if (status != STATUS_OK) goto exit;
+  if ((scriptSize != hdr.scriptSize) ||
+      (memcmp(hash, hdr.scriptHash, sizeof(hash)) != 0)) {
+    ALOGE("%s: %s changed since the journal was written", __func__,
+          hdr.scriptPath);
+    status = STATUS_FILE_NOT_FOUND;
+    goto exit;
+  }
+  status = STATUS_FAILED;
+  if ((fScript = fopen(hdr.scriptPath, "rb")) == NULL) {
+    ALOGE("%s: cannot open %s: %s", __func__, hdr.scriptPath,
+          strerror(errno));
+    status = STATUS_FILE_NOT_FOUND;
+    goto exit;
+  }
+  if ((fOut = fopen(outPath, "wb")) == NULL) {
+    ALOGE("%s: cannot create %s: %s", __func__, outPath, strerror(errno));
+    goto exit;
+  }
+  while ((rdLen = fread(chunk, 1, sizeof(chunk), fScript)) > 0) {
+    if (fwrite(chunk, rdLen, 1, fOut) != 1) {
+      ALOGE("%s: write failed: %s", __func__, strerror(errno));
+      goto exit;
+    }
+  }
+  pData = (uint8_t*)malloc(0xFFFF);
+  if (pData == NULL) goto exit;
+  while (fread(&rec, sizeof(rec), 1, fJournal) == 1) {
+    if (fread(pData, 1, rec.len, fJournal) != rec.len) {
+      /* Not committed when the update stopped */
+      ALOGE("%s: truncated record dropped", __func__);
+      break;
+    }
+    if (LSJ_WriteResponseLine(fOut, rec.tag, pData, rec.len) != STATUS_OK) {
+      goto exit;
+    }
+    numRecords++;
+  }
+  if (fflush(fOut) != 0) goto exit;
+  status = STATUS_OK;
+  ALOGD("%s: %s rebuilt, %u responses", __func__, outPath, numRecords);
+exit:
+  free(pData);
+  if (fOut != NULL && fclose(fOut) != 0) status = STATUS_FAILED;
+  if (fScript != NULL) fclose(fScript);
+  fclose(fJournal);
+  return status;
+}
@@ -62,11 +62,12 @@ tLSC_STATUS (*Applet_load_seqhandler[])(Lsc_ImageInfo_t* pContext,
 **
 ** Description:     Initialize all member variables.
 **                  native: Native data.
+**                  channelExt: batched transceive of the channel, optional
 **
 ** Returns:         True if ok.
 **
 *******************************************************************************/
-bool initialize (IChannel_t* channel)
+bool initialize (IChannel_t* channel, IChannelExt_t* channelExt)
 {
     static const char fn [] = "Ala_initialize";
 
@@ -83,6 +84,7 @@ bool initialize (IChannel_t* channel)
         return (false);
     }
     gpLsc_Dwnld_Context->mchannel = channel;
+    gpLsc_Dwnld_Context->mchannelExt = channelExt;
     if((channel != NULL) &&
        (channel->open) != NULL)
     {
@@ -442,13 +444,13 @@ tLSC_STATUS LSC_loadapplet(Lsc_ImageInfo_t* Os_info, tLSC_STATUS status,
   }
   Os_info->bytes_read = 0;
   if (Os_info->bytes_wrote == 0xAA) {
-    Os_info->fResp = fopen(Os_info->fls_RespPath, "a+");
-    if (Os_info->fResp == NULL) {
-      ALOGE("Error opening response recording file <%s> for reading: %s",
-            Os_info->fls_RespPath, strerror(errno));
+    Os_info->pJournal = LSJ_Open(Os_info->fls_RespPath, Os_info->fls_path);
+    if (Os_info->pJournal == NULL) {
+      ALOGE("Error creating response journal of <%s>",
+            Os_info->fls_RespPath);
       return status;
     }
-    ALOGD("%s: Response OUT FILE path is successfully created", fn);
+    ALOGD("%s: Response journal is successfully created", fn);
   } else {
     ALOGD("%s: Response Out file is optional as per input", fn);
   }
@@ -458,6 +460,10 @@ tLSC_STATUS LSC_loadapplet(Lsc_ImageInfo_t* Os_info, tLSC_STATUS status,
   if (Os_info->fp == NULL) {
     ALOGE("Error opening OS image file <%s> for reading: %s", Os_info->fls_path,
           strerror(errno));
+    if (Os_info->bytes_wrote == 0xAA) {
+      LSJ_Close(Os_info->pJournal);
+      Os_info->pJournal = NULL;
+    }
     return status;
   }
   wResult = fseek(Os_info->fp, 0L, SEEK_END);
@@ -602,7 +608,8 @@ tLSC_STATUS LSC_loadapplet(Lsc_ImageInfo_t* Os_info, tLSC_STATUS status,
     }
   }
   if (Os_info->bytes_wrote == 0xAA) {
-    fclose(Os_info->fResp);
+    LSJ_Close(Os_info->pJournal);
+    Os_info->pJournal = NULL;
   }
   LSC_UpdateExeStatus(LS_SUCCESS_STATUS);
   wResult = fclose(Os_info->fp);
@@ -611,7 +618,8 @@ tLSC_STATUS LSC_loadapplet(Lsc_ImageInfo_t* Os_info, tLSC_STATUS status,
 exit:
   wResult = fclose(Os_info->fp);
   if (Os_info->bytes_wrote == 0xAA) {
-    fclose(Os_info->fResp);
+    LSJ_Close(Os_info->pJournal);
+    Os_info->pJournal = NULL;
   }
   /*Script ends with SW 6320 and reached END OF FILE*/
   if (reachEOFCheck == true) {
@@ -1384,79 +1392,197 @@ tLSC_STATUS Bufferize_load_cmds(Lsc_ImageInfo_t* Os_info, tLSC_STATUS status,
   return status;
 }
 
+/*******************************************************************************
+**
+** Function:        Coalesce_Load_cmds
+**
+** Description:     Repacks the LOAD commands which follow the INSTALL for load
+**                  in pApdus into as few extended length LOAD commands of at
+**                  most maxApduLen bytes as possible, numbered again from 0.
+**                  The load file is a byte stream, the card does not depend
+**                  on how it is split in blocks. Secured LOAD commands, whose
+**                  MAC covers each command, and LOAD commands which do not
+**                  all carry Le or all omit it are left unchanged.
+**                  *ppBuf receives the buffer of the new commands.
+**                  Only reached when the channel extension reports a
+**                  maxApduLen, which no provider does yet (see IChannel.h).
+**
+** Returns:         Number of commands, numCmds if they are left unchanged.
+**
+*******************************************************************************/
+static int32_t Coalesce_Load_cmds(IChannel_Apdu_t* pApdus, int32_t numCmds,
+                                  int32_t maxApduLen, uint8_t** ppBuf) {
+  static const char fn[] = "Coalesce_Load_cmds";
+  int32_t totalData = 0, maxData, numLoads, src, srcOff, i;
+  bool hasLe = false;
+  uint8_t cla, *pOut;
+
+  *ppBuf = NULL;
+  if (numCmds < 3) return numCmds;
+  cla = pApdus[1].cmd[0];
+  for (i = 1; i < numCmds; i++) {
+    uint8_t* pCmd = pApdus[i].cmd;
+    int32_t lc = (pApdus[i].cmdLen > 4) ? pCmd[4] : 0;
+    if ((lc == 0) || (pCmd[0] != cla) || (cla & 0x0C) ||
+        (pCmd[1] != LOAD_CMD_ID) ||
+        ((pApdus[i].cmdLen != 5 + lc) && (pApdus[i].cmdLen != 6 + lc))) {
+      ALOGD("%s: LOAD commands left unchanged", fn);
+      return numCmds;
+    }
+    if (i == 1) {
+      hasLe = (pApdus[i].cmdLen == 6 + lc);
+    } else if (hasLe != (pApdus[i].cmdLen == 6 + lc)) {
+      ALOGD("%s: Le differs, LOAD commands left unchanged", fn);
+      return numCmds;
+    }
+    totalData += lc;
+  }
+  maxData = maxApduLen - LSC_EXT_APDU_HDR_LEN - (hasLe ? 2 : 0);
+  if (maxData > 0xFFFF) maxData = 0xFFFF;
+  if (maxData <= MAX_SIZE) return numCmds;
+  numLoads = (totalData + maxData - 1) / maxData;
+  if (numLoads >= numCmds - 1) return numCmds;
+
+  *ppBuf = (uint8_t*)phLS_memalloc(totalData +
+                                   numLoads * (LSC_EXT_APDU_HDR_LEN + 2));
+  if (*ppBuf == NULL) {
+    ALOGE("%s: memory allocation failed", fn);
+    return numCmds;
+  }
+  pOut = *ppBuf;
+  src = 1;
+  srcOff = 0;
+  for (i = 0; i < numLoads; i++) {
+    int32_t len = (totalData < maxData) ? totalData : maxData;
+    uint8_t* pCmd = pOut;
+    *pOut++ = cla;
+    *pOut++ = LOAD_CMD_ID;
+    *pOut++ = (i == numLoads - 1) ? LOAD_LAST_BLOCK : LOAD_MORE_BLOCKS;
+    *pOut++ = (uint8_t)i;
+    *pOut++ = 0x00;
+    *pOut++ = (uint8_t)(len >> 8);
+    *pOut++ = (uint8_t)len;
+    totalData -= len;
+    /* blocks of the source commands may be split across new commands. A
+     * new command holds more than any source one, so the source commands
+     * still to be read are after pApdus[1 + i], replaced below */
+    while (len > 0) {
+      int32_t lc = pApdus[src].cmd[4];
+      int32_t chunk = ((lc - srcOff) < len) ? (lc - srcOff) : len;
+      memcpy(pOut, &pApdus[src].cmd[5 + srcOff], chunk);
+      pOut += chunk;
+      len -= chunk;
+      srcOff += chunk;
+      if (srcOff == lc) {
+        src++;
+        srcOff = 0;
+      }
+    }
+    if (hasLe) {
+      *pOut++ = 0x00;
+      *pOut++ = 0x00;
+    }
+    pApdus[1 + i].cmd = pCmd;
+    pApdus[1 + i].cmdLen = (int32_t)(pOut - pCmd);
+  }
+  ALOGD("%s: %d LOAD commands repacked in %d", fn, numCmds - 1, numLoads);
+  return 1 + numLoads;
+}
+
 tLSC_STATUS Send_Backall_Loadcmds(Lsc_ImageInfo_t* Os_info, tLSC_STATUS status,
                                   Lsc_TranscieveInfo_t* pTranscv_Info) {
   static const char fn[] = "Send_Backall_Loadcmds";
-  tLSC_STATUS transStat = STATUS_FAILED;
-  status = STATUS_FAILED;
-  phNxpLs_data cmdApdu;
-  phNxpLs_data rspApdu;
+  IChannel_Apdu_t* pApdus = NULL;
+  IChannel_Apdu_t* pApdu;
+  uint8_t* pRspBuf = NULL;
+  uint8_t* pLoadBuf = NULL;
+  int32_t numCmds = cmd_count, idx, num = 0, numDone = 0;
   int32_t recvBufferActualSize = 0;
+  bool transStat;
+  status = STATUS_FAILED;
   ALOGD("%s: enter", fn);
   pBuffer = Cmd_Buffer;  // Points to start of first cmd to send
   if (cmd_count == 0x00) {
     ALOGE("No cmds stored to send to eSE");
+  } else if (((pRspBuf = (uint8_t*)phLS_memalloc(
+                   LSC_BATCH_MAX_APDUS * sizeof(pTranscv_Info->sRecvData))) ==
+              NULL) ||
+             ((pApdus = (IChannel_Apdu_t*)phLS_memalloc(
+                   cmd_count * sizeof(IChannel_Apdu_t))) == NULL)) {
+    ALOGE("%s: memory allocation failed", fn);
   } else {
-    while (cmd_count-- > 0) {
-      phLS_memset(&cmdApdu, 0x00, sizeof(phNxpLs_data));
-      phLS_memset(&rspApdu, 0x00, sizeof(phNxpLs_data));
-
-      cmdApdu.len = (int32_t)(pBuffer[0]);
-      cmdApdu.p_data =
-          (uint8_t*)phLS_memalloc(cmdApdu.len * sizeof(uint8_t));
-      pBuffer = pBuffer + 1 + cmdApdu.len;
-
-      memcpy(cmdApdu.p_data, &pBuffer[1], cmdApdu.len);
-
-      transStat = LSC_Transceive(&cmdApdu, &rspApdu);
+    for (idx = 0; idx < cmd_count; idx++) {
+      pApdus[idx].cmdLen = (int32_t)(pBuffer[0]);
+      pApdus[idx].cmd = &pBuffer[1];
+      pBuffer = pBuffer + 1 + pApdus[idx].cmdLen;
+    }
+    if (IChannelExt_MaxApduLen(gpLsc_Dwnld_Context->mchannelExt) >
+        ICHANNEL_SHORT_APDU_MAX_LEN) {
+      numCmds = Coalesce_Load_cmds(
+          pApdus, cmd_count,
+          IChannelExt_MaxApduLen(gpLsc_Dwnld_Context->mchannelExt),
+          &pLoadBuf);
+    }
+    for (idx = 0; idx < numCmds; idx += num) {
+      /* Send the buffered cmds by batches. A batch stops at the first
+       * response other than 9000, the sequence goes on after it unless
+       * neither SW1 is 0x90 nor SW2 is 0x00; a failed transceive only
+       * skips its cmd */
+      for (num = 0; (num < LSC_BATCH_MAX_APDUS) && (idx + num < numCmds);
+           num++) {
+        pApdu = &pApdus[idx + num];
+        pApdu->rsp = &pRspBuf[num * sizeof(pTranscv_Info->sRecvData)];
+        pApdu->rspMaxLen = sizeof(pTranscv_Info->sRecvData);
+        pApdu->rspLen = 0;
+      }
 
-      memcpy(pTranscv_Info->sRecvData, rspApdu.p_data, rspApdu.len);
-      recvBufferActualSize = rspApdu.len;
-      phLS_free(cmdApdu.p_data);
-      if (transStat != STATUS_SUCCESS || (recvBufferActualSize < 2)) {
-        ALOGE("%s: Transceive failed; status=0x%X", fn, transStat);
-      } else if (cmd_count == 0x00)  // Last command in the buffer
-      {
-        if (islastcmdLoad == false) {
+      transStat = IChannel_TransceiveBatch(
+          gpLsc_Dwnld_Context->mchannel, gpLsc_Dwnld_Context->mchannelExt,
+          &pApdus[idx], num, 0x9000, ICHANNEL_SW_MASK_ALL, numDone,
+          gTransceiveTimeout);
+      if (!transStat || (numDone < num)) {
+        /* the next batch starts after the cmd which stopped this one */
+        pApdu = &pApdus[idx + numDone];
+        num = numDone + 1;
+        recvBufferActualSize = pApdu->rspLen;
+        if (!transStat || (recvBufferActualSize < 2)) {
+          ALOGE("%s: Transceive failed; cmd %d", fn, idx + numDone);
+          continue;
+        }
+        memcpy(pTranscv_Info->sRecvData, pApdu->rsp, recvBufferActualSize);
+        if (idx + num == numCmds) {  // Last command in the buffer
           status =
               Process_EseResponse(pTranscv_Info, recvBufferActualSize, Os_info);
-        } else if ((recvBufferActualSize == 0x02) &&
-                   (pTranscv_Info->sRecvData[recvBufferActualSize - 2] ==
+        } else if ((pTranscv_Info->sRecvData[recvBufferActualSize - 2] !=
                     0x90) &&
-                   (pTranscv_Info->sRecvData[recvBufferActualSize - 1] ==
+                   (pTranscv_Info->sRecvData[recvBufferActualSize - 1] !=
                     0x00)) {
+          /*Error condition hence exiting the loop*/
+          status =
+              Process_EseResponse(pTranscv_Info, recvBufferActualSize, Os_info);
+          break;
+        }
+        continue;
+      }
+      if (idx + num == numCmds)  // Last command in the buffer
+      {
+        pApdu = &pApdus[idx + num - 1];
+        memcpy(pTranscv_Info->sRecvData, pApdu->rsp, pApdu->rspLen);
+        recvBufferActualSize = pApdu->rspLen;
+        if ((islastcmdLoad == true) && (recvBufferActualSize == 0x02)) {
           recvBufferActualSize = 0x03;
           pTranscv_Info->sRecvData[0] = 0x00;
           pTranscv_Info->sRecvData[1] = 0x90;
           pTranscv_Info->sRecvData[2] = 0x00;
-          status =
-              Process_EseResponse(pTranscv_Info, recvBufferActualSize, Os_info);
-        } else {
-          status =
-              Process_EseResponse(pTranscv_Info, recvBufferActualSize, Os_info);
         }
-      } else if ((recvBufferActualSize == 0x02) &&
-                 (pTranscv_Info->sRecvData[0] == 0x90) &&
-                 (pTranscv_Info->sRecvData[1] == 0x00)) {
-        /*Do not do anything
-         * send next command in the buffer*/
-      } else if ((recvBufferActualSize == 0x03) &&
-                 (pTranscv_Info->sRecvData[0] == 0x00) &&
-                 (pTranscv_Info->sRecvData[1] == 0x90) &&
-                 (pTranscv_Info->sRecvData[2] == 0x00)) {
-        /*Do not do anything
-         * Send next cmd in the buffer*/
-      } else if ((pTranscv_Info->sRecvData[recvBufferActualSize - 2] != 0x90) &&
-                 (pTranscv_Info->sRecvData[recvBufferActualSize - 1] != 0x00)) {
-        /*Error condition hence exiting the loop*/
         status =
             Process_EseResponse(pTranscv_Info, recvBufferActualSize, Os_info);
-        /*If the sending of Load fails reset the count*/
-        cmd_count = 0;
-        break;
       }
     }
   }
+  if (pLoadBuf != NULL) phLS_free(pLoadBuf);
+  if (pApdus != NULL) phLS_free(pApdus);
+  if (pRspBuf != NULL) phLS_free(pRspBuf);
   memset(Cmd_Buffer, 0, sizeof(Cmd_Buffer));
   pBuffer = Cmd_Buffer;  // point back to start of line
   cmd_count = 0x00;
@@ -1528,8 +1654,8 @@ uint8_t Numof_lengthbytes(uint8_t* read_buf, int32_t* pLen) {
 **
 ** Function:        Write_Response_To_OutFile
 **
-** Description:     Write the response to Out file
-**                  with length recvlen from buffer RecvData.
+** Description:     Appends the response with length recvlen from buffer
+**                  RecvData to the journal of the Out file, see LSJ_Rebuild
 **
 ** Returns:         Success if OK
 **
@@ -1537,131 +1663,20 @@ uint8_t Numof_lengthbytes(uint8_t* read_buf, int32_t* pLen) {
 tLSC_STATUS Write_Response_To_OutFile(Lsc_ImageInfo_t* image_info,
                                       uint8_t* RecvData, int32_t recvlen,
                                       Ls_TagType tType) {
-  int32_t respLen = 0;
-  tLSC_STATUS wStatus = STATUS_FAILED;
   static const char fn[] = "Write_Response_to_OutFile";
-  int32_t status = 0;
-  uint8_t tagBuffer[12] = {0x61, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  int32_t tag44Len = 0;
-  int32_t tag61Len = 0;
-  uint8_t tag43Len = 1;
-  uint8_t tag43off = 0;
-  uint8_t tag44off = 0;
-  uint8_t ucTag44[3] = {0x00, 0x00, 0x00};
-  uint8_t tagLen = 0;
-  uint8_t tempLen = 0;
+  tLSC_STATUS wStatus = STATUS_FAILED;
   /*If the Response out file is NULL or Other than LS commands*/
   if ((image_info->bytes_wrote == 0x55) || (tType == LS_Default)) {
     return STATUS_OK;
   }
-  /*Certificate TAG occupies 2 bytes*/
-  if (tType == LS_Cert) {
-    tag43Len = 2;
+  wStatus = LSJ_Append(image_info->pJournal, (uint16_t)tType, RecvData,
+                       recvlen);
+  if (wStatus != STATUS_OK) {
+    ALOGE("%s: Invalid Response during journal append; status=0x%x", fn,
+          wStatus);
   }
-  ALOGE("%s: Enter", fn);
-
-  /* |TAG | LEN(BERTLV)|                                VAL |
-   * | 61 |      XX    |  TAG | LEN |     VAL    | TAG | LEN(BERTLV) |      VAL
-   *|
-   *                   |  43  | 1/2 | 7F21/60/40 | 44  | apduRespLen |
-   *apduResponse |
-   **/
-  if (recvlen < 0x80) {
-    tag44Len = 1;
-    ucTag44[0] = recvlen;
-    tag61Len = recvlen + 4 + tag43Len;
-
-    if (tag61Len & 0x80) {
-      tagBuffer[1] = 0x81;
-      tagBuffer[2] = tag61Len;
-      tag43off = 3;
-      tag44off = 5 + tag43Len;
-      tagLen = tag44off + 2;
-    } else {
-      tagBuffer[1] = tag61Len;
-      tag43off = 2;
-      tag44off = 4 + tag43Len;
-      tagLen = tag44off + 2;
-    }
-  } else if ((recvlen >= 0x80) && (recvlen <= 0xFF)) {
-    ucTag44[0] = 0x81;
-    ucTag44[1] = recvlen;
-    tag61Len = recvlen + 5 + tag43Len;
-    tag44Len = 2;
-
-    if ((tag61Len & 0xFF00) != 0) {
-      tagBuffer[1] = 0x82;
-      tagBuffer[2] = (tag61Len & 0xFF00) >> 8;
-      tagBuffer[3] = (tag61Len & 0xFF);
-      tag43off = 4;
-      tag44off = 6 + tag43Len;
-      tagLen = tag44off + 3;
-    } else {
-      tagBuffer[1] = 0x81;
-      tagBuffer[2] = (tag61Len & 0xFF);
-      tag43off = 3;
-      tag44off = 5 + tag43Len;
-      tagLen = tag44off + 3;
-    }
-  } else if ((recvlen > 0xFF) && (recvlen <= 0xFFFF)) {
-    ucTag44[0] = 0x82;
-    ucTag44[1] = (recvlen & 0xFF00) >> 8;
-    ucTag44[2] = (recvlen & 0xFF);
-    tag44Len = 3;
-
-    tag61Len = recvlen + 6 + tag43Len;
-
-    if ((tag61Len & 0xFF00) != 0) {
-      tagBuffer[1] = 0x82;
-      tagBuffer[2] = (tag61Len & 0xFF00) >> 8;
-      tagBuffer[3] = (tag61Len & 0xFF);
-      tag43off = 4;
-      tag44off = 6 + tag43Len;
-      tagLen = tag44off + 4;
-    }
-  }
-  tagBuffer[tag43off] = 0x43;
-  tagBuffer[tag43off + 1] = tag43Len;
-  tagBuffer[tag44off] = 0x44;
-  memcpy(&tagBuffer[tag44off + 1], &ucTag44[0], tag44Len);
-
-  if (tType == LS_Cert) {
-    tagBuffer[tag43off + 2] = 0x7F;
-    tagBuffer[tag43off + 3] = 0x21;
-  } else if (tType == LS_Sign) {
-    tagBuffer[tag43off + 2] = 0x60;
-  } else if (tType == LS_Comm) {
-    tagBuffer[tag43off + 2] = 0x40;
-  } else {
-    /*Do nothing*/
-  }
-  while (tempLen < tagLen) {
-    status = fprintf(image_info->fResp, "%02X", tagBuffer[tempLen++]);
-    if (status != 2) {
-      ALOGE("%s: Invalid Response during fprintf; status=0x%x", fn, (status));
-      wStatus = STATUS_FAILED;
-      break;
-    }
-  }
-  /*Updating the response data into out script*/
-  while (respLen < recvlen) {
-    status = fprintf(image_info->fResp, "%02X", RecvData[respLen++]);
-    if (status != 2) {
-      ALOGE("%s: Invalid Response during fprintf; status=0x%x", fn, (status));
-      wStatus = STATUS_FAILED;
-      break;
-    }
-  }
-  if (status == 2) {
-    fprintf(image_info->fResp, "%s\n", "");
-    ALOGE("%s: SUCCESS Response written to script out file; status=0x%x", fn,
-          (status));
-    wStatus = STATUS_OK;
-  }
-  fflush(image_info->fResp);
   return wStatus;
 }
-
 /*******************************************************************************
 **
 ** Function:        Check_Certificate_Tag